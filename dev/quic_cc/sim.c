@@ -0,0 +1,826 @@
+/*
+ * QUIC congestion control simulator. Runs a bulk sender using one of the
+ * congestion control algorithms of src/quic_cc_*.c together with the loss
+ * detection of src/quic_loss.c over a scripted bottleneck link, driven by a
+ * virtual clock. Nothing is sent on the network, so that a run of several
+ * minutes of traffic only takes a fraction of a second and is reproducible.
+ *
+ * The link is a FIFO queue drained at a configurable rate, followed by a
+ * propagation delay covering the whole round trip. Packets which do not fit
+ * into the queue are dropped at its tail, and packets entering the queue may
+ * also be dropped at random. Every packet leaving the link is acknowledged
+ * individually and without any ACK delay.
+ *
+ * The link profile is read from a file (or stdin with "-"), one step per line,
+ * each one being applied from its date on. Empty lines and lines starting with
+ * '#' are ignored:
+ *
+ *    <date_ms> <rate_kbps> <rtt_ms> <loss_pct> <queue_kB>
+ *
+ * Without a file, a single 10 Mbps, 40 ms RTT, lossless link with a 64 kB
+ * queue is used. Every <interval> ms, a line is reported with the goodput,
+ * congestion window, bytes in flight, smoothed RTT, queueing delay and losses
+ * observed during this interval. A summary is emitted at the end of the run.
+ *
+ * Compilation via Makefile, once haproxy was built with USE_QUIC:
+ *   make dev/quic_cc/sim USE_OPENSSL=1 USE_QUIC=1
+ *
+ * Example run (bufferbloat then a lossy step):
+ *   printf '0 20000 30 0 1024\n10000 5000 30 0.5 64\n' | \
+ *     ./dev/quic_cc/sim -a bbr -d 20000 -
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef USE_OPENSSL
+#define USE_OPENSSL
+#endif
+#ifndef USE_QUIC
+#define USE_QUIC
+#endif
+
+#include <import/eb64tree.h>
+
+#include <haproxy/api.h>
+#include <haproxy/chunk.h>
+#include <haproxy/clock.h>
+#include <haproxy/list.h>
+#include <haproxy/pool.h>
+#include <haproxy/proto_quic.h>
+#include <haproxy/quic_cc.h>
+#include <haproxy/quic_cc_drs.h>
+#include <haproxy/quic_conn-t.h>
+#include <haproxy/quic_loss.h>
+#include <haproxy/quic_tune.h>
+#include <haproxy/quic_tx.h>
+#include <haproxy/ticks.h>
+#include <haproxy/trace.h>
+
+#define SIM_MAX_STEPS 1024
+
+/* Smallest packet worth building when limited by the congestion window: a
+ * short header, a STREAM frame with a few bytes of data and the AEAD tag.
+ */
+#define SIM_MIN_PKT_LEN 64
+
+/* One step of the link profile */
+struct sim_step {
+	uint64_t date;        /* ns, relative to the start of the run */
+	uint64_t rate;        /* bits per second, >= 1 */
+	uint64_t rtt;         /* ns, two-way propagation delay */
+	uint32_t loss;        /* random loss probability, per 2^32 */
+	uint64_t qlen;        /* queue size limit in bytes */
+};
+
+enum sim_ev_type {
+	SIM_EV_STEP = 0,      /* apply the next link step */
+	SIM_EV_DEQ,           /* the head of the queue was fully transmitted */
+	SIM_EV_ACK,           /* an ACK for one packet reaches the sender */
+	SIM_EV_TIMER,         /* loss detection / PTO timer */
+	SIM_EV_PACING,        /* sender wakeup after pacing */
+	SIM_EV_REPORT,        /* periodic report */
+};
+
+/* Events are indexed by their date in ns. Packets crossing the link are
+ * events too, either queued or propagating.
+ */
+struct sim_ev {
+	struct eb64_node node;
+	struct list list;     /* attach point in the bottleneck queue */
+	enum sim_ev_type type;
+	uint64_t pn;          /* packet number (DEQ/ACK) */
+	size_t len;           /* packet length (DEQ/ACK) */
+	uint64_t enq_date;    /* date the packet entered the queue (DEQ/ACK) */
+};
+
+/* Counters, both for the whole run and for the current report interval */
+struct sim_stats {
+	uint64_t sent_pkts;
+	uint64_t sent_bytes;
+	uint64_t acked_bytes;
+	uint64_t lost_pkts;   /* declared lost by the sender */
+	uint64_t drop_tail;   /* dropped by a full queue */
+	uint64_t drop_rand;   /* dropped at random */
+	uint64_t qdelay_sum;  /* ns, sum of queueing delays of delivered packets */
+	uint64_t qdelay_max;  /* ns */
+	uint64_t delivered;   /* packets leaving the link */
+	uint64_t capacity;    /* bits which could have been transmitted */
+};
+
+static struct sim_step steps[SIM_MAX_STEPS];
+static int nb_steps;
+static int cur_step = -1;
+
+static struct eb_root events = EB_ROOT;
+static struct list queue = LIST_HEAD_INIT(queue);
+static uint64_t queue_bytes;
+static int link_busy;
+
+static struct sim_ev step_ev = { .type = SIM_EV_STEP };
+static struct sim_ev timer_ev = { .type = SIM_EV_TIMER };
+static struct sim_ev pacing_ev = { .type = SIM_EV_PACING };
+static struct sim_ev report_ev = { .type = SIM_EV_REPORT };
+
+static uint64_t sim_date;  /* ns, virtual date */
+static uint64_t cap_date;  /* ns, last link capacity accounting */
+static struct sim_stats tot, cur;
+
+/* sender */
+static struct quic_conn qc;
+static struct quic_cc_path path;
+static struct quic_pktns pktns;
+static int pacing = 1;
+static uint64_t pace_cur;
+static uint pace_credit;
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+
+/* the base of the virtual clock, so that now_ms never equals TICK_ETERNITY */
+#define SIM_EPOCH 1000000000ULL
+
+/*
+ * Stubs for the symbols the congestion control code depends on.
+ */
+THREAD_LOCAL unsigned int now_ms;
+THREAD_LOCAL struct cshared quic_mem_diff;
+static uint64_t quic_mem_global;
+struct pool_head *pool_head_quic_tx_packet;
+struct trace_source trace_quic = { };
+
+struct quic_tune quic_tune = {
+	.fe = {
+		.cc_max_frame_loss = QUIC_DFLT_CC_MAX_FRAME_LOSS,
+		.cc_max_win_size   = QUIC_DFLT_CC_MAX_WIN_SIZE,
+		.cc_reorder_ratio  = QUIC_DFLT_CC_REORDER_RATIO,
+		.fb_opts = QUIC_TUNE_FB_TX_PACING,
+	},
+	.mem_tx_max = QUIC_MAX_TX_MEM,
+};
+
+void __pool_free(struct pool_head *pool, void *ptr)
+{
+	free(ptr);
+}
+
+void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
+             const struct ist where, const struct ist ist_func,
+             const void *a1, const void *a2, const void *a3, const void *a4,
+             void (*cb)(enum trace_level level, uint64_t mask, const struct trace_source *src,
+                        const struct ist where, const struct ist func,
+                        const void *a1, const void *a2, const void *a3, const void *a4),
+             const struct ist msg)
+{
+}
+
+int chunk_appendf(struct buffer *chk, const char *fmt, ...)
+{
+	return 0;
+}
+
+void complain(int *counter, const char *msg, int taint)
+{
+	fputs(msg, stderr);
+}
+
+void ha_backtrace_to_stderr(void)
+{
+}
+
+/* xorshift64*, seeded with -s */
+uint64_t ha_random64(void)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return rnd_state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Frames are not simulated, lost data is implicitly sent again by the bulk
+ * sender.
+ */
+int qc_handle_frms_of_lost_pkt(struct quic_conn *qc,
+                               struct quic_tx_packet *pkt,
+                               struct list *pktns_frm_list)
+{
+	return 1;
+}
+
+/*
+ * Virtual clock and events
+ */
+static inline void sim_set_date(uint64_t date)
+{
+	sim_date = date;
+	now_ms = (SIM_EPOCH + sim_date) / 1000000;
+}
+
+static inline void sim_ev_queue(struct sim_ev *ev, uint64_t date)
+{
+	eb64_delete(&ev->node);
+	ev->node.key = date;
+	eb64_insert(&events, &ev->node);
+}
+
+static struct sim_ev *sim_ev_new(enum sim_ev_type type)
+{
+	struct sim_ev *ev = calloc(1, sizeof(*ev));
+
+	if (!ev) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	ev->type = type;
+	return ev;
+}
+
+/* Account the capacity of the link up to the current date. */
+static void sim_account_capacity(void)
+{
+	uint64_t bits;
+
+	if (cur_step < 0)
+		return;
+	bits = (sim_date - cap_date) * steps[cur_step].rate / 1000000000ULL;
+	cur.capacity += bits;
+	tot.capacity += bits;
+	cap_date = sim_date;
+}
+
+/*
+ * Bottleneck link
+ */
+
+/* Start transmitting the packet at the head of the queue if the link is idle. */
+static void sim_link_kick(void)
+{
+	struct sim_ev *ev;
+
+	if (link_busy || LIST_ISEMPTY(&queue))
+		return;
+
+	ev = LIST_NEXT(&queue, struct sim_ev *, list);
+	sim_ev_queue(ev, sim_date + ev->len * 8 * 1000000000ULL / steps[cur_step].rate);
+	link_busy = 1;
+}
+
+/* Offer a <len> bytes packet with <pn> as number to the link. */
+static void sim_link_enqueue(uint64_t pn, size_t len)
+{
+	struct sim_step *step = &steps[cur_step];
+	struct sim_ev *ev;
+
+	if (step->loss && (uint32_t)ha_random64() < step->loss) {
+		cur.drop_rand++;
+		tot.drop_rand++;
+		return;
+	}
+
+	if (queue_bytes + len > step->qlen && !LIST_ISEMPTY(&queue)) {
+		cur.drop_tail++;
+		tot.drop_tail++;
+		return;
+	}
+
+	ev = sim_ev_new(SIM_EV_DEQ);
+	ev->pn = pn;
+	ev->len = len;
+	ev->enq_date = sim_date;
+	LIST_APPEND(&queue, &ev->list);
+	queue_bytes += len;
+	sim_link_kick();
+}
+
+/* The head of the queue left the link, it propagates to the receiver which
+ * acknowledges it immediately.
+ */
+static void sim_link_dequeue(struct sim_ev *ev)
+{
+	uint64_t qdelay;
+
+	LIST_DELETE(&ev->list);
+	queue_bytes -= ev->len;
+	link_busy = 0;
+
+	qdelay = sim_date - ev->enq_date - ev->len * 8 * 1000000000ULL / steps[cur_step].rate;
+	if ((int64_t)qdelay < 0)
+		qdelay = 0;
+	cur.qdelay_sum += qdelay;
+	tot.qdelay_sum += qdelay;
+	if (qdelay > cur.qdelay_max)
+		cur.qdelay_max = qdelay;
+	if (qdelay > tot.qdelay_max)
+		tot.qdelay_max = qdelay;
+	cur.delivered++;
+	tot.delivered++;
+
+	ev->type = SIM_EV_ACK;
+	sim_ev_queue(ev, sim_date + steps[cur_step].rtt);
+	sim_link_kick();
+}
+
+/*
+ * Sender. The code below mirrors what the QUIC stack does around the
+ * congestion controller in quic_tx.c, quic_rx.c and quic_conn.c.
+ */
+
+/* Mirrors qc_set_timer() for the application packet number space. */
+static void sim_set_timer(void)
+{
+	struct quic_pktns *p;
+	unsigned int timer = TICK_ETERNITY;
+
+	p = quic_loss_pktns(&qc);
+	if (tick_isset(p->tx.loss_time))
+		timer = p->tx.loss_time;
+	else if (path.ifae_pkts)
+		quic_pto_pktns(&qc, 1, &timer);
+
+	eb64_delete(&timer_ev.node);
+	if (!tick_isset(timer))
+		return;
+
+	if (tick_is_expired(timer, now_ms))
+		sim_ev_queue(&timer_ev, sim_date);
+	else
+		sim_ev_queue(&timer_ev, (uint64_t)timer * 1000000 - SIM_EPOCH);
+}
+
+/* Mirrors quic_pacing_reload(), with a 1ms scheduling delay. */
+static uint sim_pacing_reload(void)
+{
+	const uint64_t inter = path.cc.algo->pacing_inter(&path.cc);
+	uint64_t inc;
+	uint credit_max, pkt_ms;
+
+	pkt_ms = path.cc.algo->pacing_burst ?
+	  path.cc.algo->pacing_burst(&path.cc) : (1000000 + inter - 1) / inter;
+
+	if (sim_date > pace_cur) {
+		inc = (pkt_ms * (sim_date - pace_cur) + 999999) / 1000000;
+		credit_max = (1500000ULL * pkt_ms + 999999) / 1000000;
+		credit_max = MAX(credit_max, 2);
+		pace_credit = MIN(pace_credit + inc, credit_max);
+		pace_cur = sim_date;
+	}
+
+	return pace_credit;
+}
+
+/* Mirrors qcc_wakeup_pacing(). */
+static void sim_pacing_wakeup(void)
+{
+	const uint inter = path.cc.algo->pacing_inter(&path.cc);
+	const uint expire = MAX((inter + 999999) / 1000000, 1);
+
+	if (!pacing_ev.node.node.leaf_p)
+		sim_ev_queue(&pacing_ev, ((uint64_t)now_ms + expire) * 1000000 - SIM_EPOCH);
+}
+
+/* Build and emit one ack-eliciting packet of at most <room> bytes. */
+static void sim_send_pkt(size_t room)
+{
+	struct quic_cc *cc = &path.cc;
+	struct quic_tx_packet *pkt;
+
+	pkt = calloc(1, sizeof(*pkt));
+	if (!pkt) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	LIST_INIT(&pkt->list);
+	LIST_INIT(&pkt->frms);
+	pkt->len = MIN(path.mtu, room);
+	pkt->in_flight_len = pkt->len;
+	pkt->pktns = &pktns;
+	pkt->flags = QUIC_FL_TX_PACKET_ACK_ELICITING;
+	pkt->refcnt = 1;
+	pkt->largest_acked_pn = -1;
+	pkt->type = QUIC_PACKET_TYPE_SHORT;
+	pkt->pn_node.key = ++pktns.tx.next_pn;
+	eb64_insert(&pktns.tx.pkts, &pkt->pn_node);
+	path.prep_in_flight += pkt->len;
+
+	pkt->time_sent_ns = SIM_EPOCH + sim_date;
+	pkt->time_sent_ms = now_ms;
+	pktns.tx.time_of_last_eliciting = now_ms;
+	path.ifae_pkts++;
+	if (cc->algo->on_transmit)
+		cc->algo->on_transmit(cc);
+	if (cc->algo->drs_on_transmit)
+		cc->algo->drs_on_transmit(cc, pkt);
+	path.in_flight += pkt->in_flight_len;
+	pktns.tx.in_flight += pkt->in_flight_len;
+	if (quic_tune_test(QUIC_TUNE_FB_CC_HYSTART, &qc))
+		cc->algo->hystart_start_round(cc, pkt->pn_node.key);
+
+	cur.sent_pkts++;
+	tot.sent_pkts++;
+	cur.sent_bytes += pkt->len;
+	tot.sent_bytes += pkt->len;
+	sim_link_enqueue(pkt->pn_node.key, pkt->len);
+}
+
+/* Emit as many packets as the congestion window, the PTO probes and the pacing
+ * credit allow. The sender always has data to send.
+ */
+static void sim_send(void)
+{
+	uint max = UINT_MAX;
+	uint sent = 0;
+	size_t room;
+
+	if (pacing && !pktns.tx.pto_probe) {
+		if (!sim_pacing_reload()) {
+			sim_pacing_wakeup();
+			return;
+		}
+		max = pace_credit;
+	}
+
+	while (sent < max) {
+		if (pktns.tx.pto_probe) {
+			pktns.tx.pto_probe--;
+			room = path.mtu;
+		}
+		else if ((room = quic_cc_path_prep_data(&path)) < SIM_MIN_PKT_LEN) {
+			break;
+		}
+		sim_send_pkt(room);
+		sent++;
+	}
+
+	if (pacing && max != UINT_MAX) {
+		pace_credit -= sent;
+		if (path.cc.algo->check_app_limited)
+			path.cc.algo->check_app_limited(&path.cc, sent);
+		if (sent == max)
+			sim_pacing_wakeup();
+	}
+
+	if (sent)
+		sim_set_timer();
+}
+
+/* Mirrors qc_notify_cc_of_newly_acked_pkts(). */
+static void sim_notify_acked(struct list *newly_acked_pkts,
+                             unsigned int bytes_lost, unsigned int rtt)
+{
+	struct quic_tx_packet *pkt, *tmp;
+	struct quic_cc_event ev = { .type = QUIC_CC_EVT_ACK, };
+	struct quic_cc_path *p = &path;
+	struct quic_cc_drs *drs =
+		p->cc.algo->get_drs ? p->cc.algo->get_drs(&p->cc) : NULL;
+	unsigned int bytes_delivered = 0, pkt_delivered = 0;
+	uint64_t time_ns = SIM_EPOCH + sim_date;
+
+	list_for_each_entry_safe(pkt, tmp, newly_acked_pkts, list) {
+		pkt->pktns->tx.in_flight -= pkt->in_flight_len;
+		p->prep_in_flight -= pkt->in_flight_len;
+		if (pkt->flags & QUIC_FL_TX_PACKET_ACK_ELICITING)
+			p->ifae_pkts--;
+		bytes_delivered += pkt->len;
+		pkt_delivered = pkt->rs.delivered;
+		ev.ack.acked = pkt->in_flight_len;
+		ev.ack.time_sent = pkt->time_sent_ms;
+		ev.ack.pn = pkt->pn_node.key;
+		quic_cc_event(&p->cc, &ev);
+		p->in_flight -= pkt->in_flight_len;
+		if (drs && (pkt->flags & QUIC_FL_TX_PACKET_ACK_ELICITING))
+			quic_cc_drs_update_rate_sample(drs, pkt, time_ns);
+		cur.acked_bytes += pkt->len;
+		tot.acked_bytes += pkt->len;
+		LIST_DEL_INIT(&pkt->list);
+		quic_tx_packet_refdec(pkt);
+	}
+
+	if (drs) {
+		quic_cc_drs_on_ack_recv(drs, p, pkt_delivered);
+		drs->lost += bytes_lost;
+	}
+	if (p->cc.algo->on_ack_rcvd)
+		p->cc.algo->on_ack_rcvd(&p->cc, bytes_delivered, pkt_delivered,
+		                        rtt, bytes_lost, now_ms);
+}
+
+/* Release <lost> packets, counting them. */
+static void sim_release_lost(struct list *lost)
+{
+	struct quic_tx_packet *pkt;
+	uint64_t nb = 0;
+
+	list_for_each_entry(pkt, lost, list)
+		nb++;
+	cur.lost_pkts += nb;
+	tot.lost_pkts += nb;
+	qc_release_lost_pkts(&qc, &pktns, lost, now_ms);
+}
+
+/* Handle an ACK frame acknowledging only <pn>, as qc_parse_ack_frm() and its
+ * caller do. Acknowledgements of packets already declared lost are ignored.
+ */
+static void sim_recv_ack(uint64_t pn)
+{
+	struct list newly_acked_pkts = LIST_HEAD_INIT(newly_acked_pkts);
+	struct list lost_pkts = LIST_HEAD_INIT(lost_pkts);
+	struct quic_tx_packet *pkt;
+	struct eb64_node *node;
+	unsigned int rtt_sample = 0, bytes_lost = 0;
+
+	node = eb64_lookup(&pktns.tx.pkts, pn);
+	if (!node)
+		return;
+
+	pkt = eb64_entry(node, struct quic_tx_packet, pn_node);
+	if ((int64_t)pn > pktns.rx.largest_acked_pn &&
+	    (pkt->flags & QUIC_FL_TX_PACKET_ACK_ELICITING)) {
+		rtt_sample = tick_remain(pkt->time_sent_ms, now_ms);
+		pktns.rx.largest_acked_pn = pn;
+	}
+	eb64_delete(&pkt->pn_node);
+	LIST_APPEND(&newly_acked_pkts, &pkt->list);
+
+	if (!eb_is_empty(&pktns.tx.pkts)) {
+		qc_packet_loss_lookup(&pktns, &qc, &lost_pkts, &bytes_lost);
+		sim_release_lost(&lost_pkts);
+	}
+
+	sim_notify_acked(&newly_acked_pkts, bytes_lost, rtt_sample);
+	path.loss.pto_count = 0;
+	if (rtt_sample)
+		quic_loss_srtt_update(&path.loss, rtt_sample, 0, &qc);
+	sim_set_timer();
+}
+
+/* Mirrors qc_process_timer() for the application packet number space. */
+static void sim_process_timer(void)
+{
+	struct quic_pktns *p = quic_loss_pktns(&qc);
+
+	if (tick_isset(p->tx.loss_time)) {
+		struct list lost_pkts = LIST_HEAD_INIT(lost_pkts);
+
+		qc_packet_loss_lookup(p, &qc, &lost_pkts, NULL);
+		sim_release_lost(&lost_pkts);
+		sim_set_timer();
+		return;
+	}
+
+	if (path.in_flight)
+		pktns.tx.pto_probe = QUIC_MAX_NB_PTO_DGRAMS;
+	path.loss.pto_count++;
+}
+
+/*
+ * Reports
+ */
+static void sim_report_header(void)
+{
+	printf("#%9s %10s %10s %9s %9s %8s %8s %8s %7s %7s %7s\n",
+	       "time_ms", "link_kbps", "gput_kbps", "cwnd_kB", "infl_kB", "srtt_ms",
+	       "qdel_ms", "qmax_ms", "lost", "dtail", "drand");
+}
+
+static void sim_report(uint64_t interval)
+{
+	sim_account_capacity();
+	printf("%10llu %10llu %10llu %9.1f %9.1f %8u %8.1f %8.1f %7llu %7llu %7llu\n",
+	       (ullong)(sim_date / 1000000),
+	       (ullong)(steps[cur_step].rate / 1000),
+	       (ullong)(cur.acked_bytes * 8 * 1000000 / interval),
+	       path.cwnd / 1000.0, path.in_flight / 1000.0, path.loss.srtt,
+	       cur.delivered ? cur.qdelay_sum / cur.delivered / 1000000.0 : 0.0,
+	       cur.qdelay_max / 1000000.0,
+	       (ullong)cur.lost_pkts, (ullong)cur.drop_tail, (ullong)cur.drop_rand);
+	memset(&cur, 0, sizeof(cur));
+}
+
+static void sim_summary(const char *algo)
+{
+	sim_account_capacity();
+	printf("# algo=%s duration_ms=%llu sent_pkts=%llu sent_bytes=%llu acked_bytes=%llu\n"
+	       "# goodput_kbps=%llu link_util=%.1f%% retrans=%.2f%% lost=%llu drop_tail=%llu drop_rand=%llu\n"
+	       "# srtt_ms=%u rtt_min_ms=%u qdelay_avg_ms=%.1f qdelay_max_ms=%.1f reordered=%llu\n",
+	       algo, (ullong)(sim_date / 1000000), (ullong)tot.sent_pkts,
+	       (ullong)tot.sent_bytes, (ullong)tot.acked_bytes,
+	       (ullong)(sim_date ? tot.acked_bytes * 8 * 1000000 / sim_date : 0),
+	       tot.capacity ? tot.acked_bytes * 8 * 100.0 / tot.capacity : 0.0,
+	       tot.sent_pkts ? tot.lost_pkts * 100.0 / tot.sent_pkts : 0.0,
+	       (ullong)tot.lost_pkts, (ullong)tot.drop_tail, (ullong)tot.drop_rand,
+	       path.loss.srtt, path.loss.rtt_min,
+	       tot.delivered ? tot.qdelay_sum / tot.delivered / 1000000.0 : 0.0,
+	       tot.qdelay_max / 1000000.0, (ullong)path.loss.nb_reordered_pkt);
+}
+
+/*
+ * Setup
+ */
+
+/* Parse the link profile from <f>. Returns 0 on success, -1 on error. */
+static int sim_load_steps(FILE *f, const char *name)
+{
+	char line[256];
+	int lnum = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long date, rate, rtt, qlen;
+		double loss;
+		char *p = line;
+
+		lnum++;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (!*p || *p == '\n' || *p == '#')
+			continue;
+
+		if (sscanf(p, "%llu %llu %llu %lf %llu", &date, &rate, &rtt, &loss, &qlen) != 5 ||
+		    !rate || loss < 0 || loss > 100) {
+			fprintf(stderr, "%s:%d: expected '<date_ms> <rate_kbps> <rtt_ms> <loss_pct> <queue_kB>'\n",
+			        name, lnum);
+			return -1;
+		}
+
+		if (nb_steps == SIM_MAX_STEPS) {
+			fprintf(stderr, "%s:%d: too many steps (max %d)\n", name, lnum, SIM_MAX_STEPS);
+			return -1;
+		}
+
+		if (nb_steps && date * 1000000 < steps[nb_steps - 1].date) {
+			fprintf(stderr, "%s:%d: steps must be sorted by date\n", name, lnum);
+			return -1;
+		}
+
+		steps[nb_steps].date = date * 1000000;
+		steps[nb_steps].rate = rate * 1000;
+		steps[nb_steps].rtt  = rtt * 1000000;
+		steps[nb_steps].loss = loss / 100.0 * 4294967295.0;
+		steps[nb_steps].qlen = qlen * 1000;
+		nb_steps++;
+	}
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+	        "Usage: %s [options] [profile|-]\n"
+	        "  -a <algo>   congestion control algorithm: newreno, cubic, bbr, nocc (cubic)\n"
+	        "  -d <ms>     duration of the run (10000)\n"
+	        "  -i <ms>     report interval, 0 for the summary only (100)\n"
+	        "  -w <bytes>  maximum congestion window (%d)\n"
+	        "  -s <seed>   random seed for losses (0)\n"
+	        "  -H          enable HyStart++ (cubic only)\n"
+	        "  -P          disable pacing\n"
+	        "Profile lines: <date_ms> <rate_kbps> <rtt_ms> <loss_pct> <queue_kB>\n",
+	        name, QUIC_DFLT_CC_MAX_WIN_SIZE);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct quic_cc_algo *algo = &quic_cc_algo_cubic;
+	const char *algo_name = "cubic";
+	uint64_t duration = 10000 * 1000000ULL;
+	uint64_t interval = 100 * 1000000ULL;
+	struct eb64_node *node;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "a:d:i:w:s:HP")) != -1) {
+		switch (opt) {
+		case 'a':
+			algo_name = optarg;
+			if (strcmp(optarg, "newreno") == 0)
+				algo = &quic_cc_algo_nr;
+			else if (strcmp(optarg, "cubic") == 0)
+				algo = &quic_cc_algo_cubic;
+			else if (strcmp(optarg, "bbr") == 0)
+				algo = &quic_cc_algo_bbr;
+			else if (strcmp(optarg, "nocc") == 0)
+				algo = &quic_cc_algo_nocc;
+			else
+				usage(argv[0]);
+			break;
+		case 'd':
+			duration = strtoull(optarg, NULL, 10) * 1000000ULL;
+			break;
+		case 'i':
+			interval = strtoull(optarg, NULL, 10) * 1000000ULL;
+			break;
+		case 'w':
+			quic_tune.fe.cc_max_win_size = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			rnd_state ^= strtoull(optarg, NULL, 10) * 0x9e3779b97f4a7c15ULL;
+			if (!rnd_state)
+				rnd_state = 1;
+			break;
+		case 'H':
+			quic_tune.fe.fb_opts |= QUIC_TUNE_FB_CC_HYSTART;
+			break;
+		case 'P':
+			pacing = 0;
+			quic_tune.fe.fb_opts &= ~QUIC_TUNE_FB_TX_PACING;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind < argc) {
+		FILE *f = stdin;
+		int ret;
+
+		if (strcmp(argv[optind], "-") != 0) {
+			f = fopen(argv[optind], "r");
+			if (!f) {
+				fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+				return 1;
+			}
+		}
+		ret = sim_load_steps(f, argv[optind]);
+		if (f != stdin)
+			fclose(f);
+		if (ret < 0)
+			return 1;
+	}
+
+	if (!nb_steps) {
+		steps[0] = (struct sim_step){ .rate = 10000000, .rtt = 40000000, .qlen = 64000 };
+		nb_steps = 1;
+	}
+
+	if (!duration)
+		usage(argv[0]);
+
+	if (algo == &quic_cc_algo_bbr)
+		quic_tune.fe.fb_opts &= ~QUIC_TUNE_FB_CC_HYSTART;
+
+	sim_set_date(0);
+	cshared_init(&quic_mem_diff, &quic_mem_global, 0);
+
+	LIST_INIT(&qc.pktns_list);
+	LIST_INIT(&pktns.tx.frms);
+	pktns.tx.next_pn = -1;
+	pktns.tx.pkts = EB_ROOT_UNIQUE;
+	pktns.tx.loss_time = TICK_ETERNITY;
+	pktns.rx.largest_pn = -1;
+	pktns.rx.largest_acked_pn = -1;
+	LIST_APPEND(&qc.pktns_list, &pktns.list);
+	qc.apktns = &pktns;
+	qc.path = &path;
+	qc.state = QUIC_HS_ST_CONFIRMED;
+	qc.max_ack_delay = 0;  /* ACKs are never delayed */
+	quic_cc_path_init(&path, 1, quic_tune.fe.cc_max_win_size, algo, &qc);
+
+	/* the first step is applied immediately, whatever its date */
+	steps[0].date = 0;
+	sim_ev_queue(&step_ev, 0);
+	if (interval) {
+		sim_report_header();
+		sim_ev_queue(&report_ev, interval);
+	}
+
+	while ((node = eb64_first(&events)) && node->key <= duration) {
+		struct sim_ev *ev = eb64_entry(node, struct sim_ev, node);
+
+		eb64_delete(node);
+		sim_set_date(node->key);
+
+		switch (ev->type) {
+		case SIM_EV_STEP:
+			sim_account_capacity();
+			cur_step++;
+			if (cur_step + 1 < nb_steps)
+				sim_ev_queue(&step_ev, steps[cur_step + 1].date);
+			break;
+		case SIM_EV_DEQ:
+			sim_link_dequeue(ev);
+			break;
+		case SIM_EV_ACK:
+			sim_recv_ack(ev->pn);
+			free(ev);
+			break;
+		case SIM_EV_TIMER:
+			sim_process_timer();
+			break;
+		case SIM_EV_PACING:
+			break;
+		case SIM_EV_REPORT:
+			sim_report(interval);
+			sim_ev_queue(&report_ev, sim_date + interval);
+			break;
+		}
+
+		sim_send();
+	}
+
+	sim_set_date(duration);
+	sim_summary(algo_name);
+	return 0;
+}
@@ -118,6 +118,9 @@ struct activity {
 	unsigned int pool_fail;    // failed a pool allocation
 	unsigned int buf_wait;     // waited on a buffer allocation
 	unsigned int check_started;// number of times a check was started on this thread
+	unsigned int conn_shared;  // idle conns picked from the thread group's shared pool
+	unsigned int stolen_tasks; // tasks this thread stole from other threads of its group
+	unsigned int lost_tasks;   // tasks other threads of the group stole from this one
 #if defined(DEBUG_DEV)
 	/* keep these ones at the end */
 	unsigned int ctr0;         // general purposee debug counter
@@ -771,6 +771,29 @@ static inline void bl_init(struct bl_elem *head, uint32_t nbelem)
 	head->next = 1;
 }
 
+/* Grows the array <head> to <nbelem> elements, which must not be lower than
+ * its current size, and must fit into the allocated area. The new cells are
+ * appended to the free list as an implicit free area till the end. If the free
+ * list already ends with such an area, it simply extends it.
+ */
+static inline void bl_grow(struct bl_elem *head, uint32_t nbelem)
+{
+	uint32_t e;
+
+	BUG_ON_HOT(nbelem < head->buf.size);
+	memset(head + head->buf.size, 0, (nbelem - head->buf.size) * sizeof(*head));
+
+	if (!head->next)
+		head->next = head->buf.size;
+	else {
+		for (e = head->next; head[e].next && head[e].next != ~0U; e = head[e].next)
+			;
+		if (head[e].next == ~0U)
+			head[e].next = head->buf.size;
+	}
+	head->buf.size = nbelem;
+}
+
 /* Puts the cell at index <idx> back into the list <head>. It must have been
  * freed from its buffer before calling this, and must correspond to the head
  * of the caller. It returns the new head for the caller (the next cell
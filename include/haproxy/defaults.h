@@ -457,6 +457,25 @@
 #define DEFAULT_SSL_CTX_CACHE 1000
 #endif
 
+/* max number of private key operations taken at once by a crypto thread */
+#ifndef DEFAULT_SSL_OFFLOAD_BATCH
+#define DEFAULT_SSL_OFFLOAD_BATCH 16
+#endif
+
+/* number of sessions per server shared between all threads */
+#ifndef DEFAULT_SSL_SRV_SESS_POOL
+#define DEFAULT_SSL_SRV_SESS_POOL 8
+#endif
+
+/* lifetime and overlap of the TLS ticket keys derived from a secret, in seconds */
+#ifndef DEFAULT_SSL_TICKET_KEY_LIFETIME
+#define DEFAULT_SSL_TICKET_KEY_LIFETIME 3600
+#endif
+
+#ifndef DEFAULT_SSL_TICKET_KEY_OVERLAP
+#define DEFAULT_SSL_TICKET_KEY_OVERLAP 3600
+#endif
+
 /* approximate stream size (for maxconn estimate) */
 #ifndef STREAM_MAX_COST
 #define STREAM_MAX_COST (sizeof(struct stream) + \
@@ -32,10 +32,44 @@
 #include <import/ist.h>
 #include <haproxy/api.h>
 #include <haproxy/buf-t.h>
+#include <haproxy/pool.h>
+#include <haproxy/hpack-tbl-t.h>
 #include <haproxy/http-t.h>
 
+extern struct pool_head *pool_head_hpack_enc;
+
 int hpack_encode_header(struct buffer *out, const struct ist n,
 			const struct ist v);
+int hpack_enc_encode_header(struct hpack_enc *enc, struct buffer *out,
+			    const struct ist n, const struct ist v);
+int hpack_enc_encode_dtsu(struct hpack_enc *enc, struct buffer *out);
+struct hpack_enc *hpack_enc_alloc(uint32_t max_size, int huff);
+void hpack_enc_abort(struct hpack_enc *enc);
+
+/* free an encoder context */
+static inline void hpack_enc_free(struct hpack_enc *enc)
+{
+	pool_free(pool_head_hpack_enc, enc);
+}
+
+/* Sets the maximum table size the peer's decoder accepts to <size>. The new
+ * size will be applied when the next dynamic table size update is emitted
+ * using hpack_enc_encode_dtsu() at the beginning of the next header block.
+ */
+static inline void hpack_enc_set_max_size(struct hpack_enc *enc, uint32_t size)
+{
+	enc->max_size = size;
+}
+
+/* Must be called before starting to encode a new header block with encoder
+ * context <enc>, which may be NULL. It validates all changes made to the
+ * table for the previous block.
+ */
+static inline void hpack_enc_begin(struct hpack_enc *enc)
+{
+	if (enc)
+		enc->flags &= ~HPACK_ENC_F_SAVED;
+}
 
 /* Returns the number of bytes required to encode the string length <len>. The
  * number of usable bits is an integral multiple of 7 plus 6 for the last byte.
@@ -82,16 +116,17 @@ static inline int hpack_encode_len(char *out, int pos, int len)
 /* Tries to encode header field index <idx> with short value <val> into the
  * aligned buffer <out>. Returns non-zero on success, 0 on failure (buffer
  * full). The caller is responsible for ensuring that the length of <val> is
- * strictly lower than 127, and that <idx> is lower than 64 (static list only),
- * and that the buffer is aligned (head==0).
+ * strictly lower than 127, and that <idx> is lower than 15 (static list only),
+ * and that the buffer is aligned (head==0). The field is not indexed so that
+ * the peer's dynamic table only contains what an encoder context put there.
  */
 static inline int hpack_encode_short_idx(struct buffer *out, int idx, struct ist val)
 {
 	if (out->data + 2 + val.len > out->size)
 		return 0;
 
-	/* literal header field with incremental indexing */
-	out->area[out->data++] = idx | 0x40;
+	/* literal header field without indexing */
+	out->area[out->data++] = idx;
 	out->area[out->data++] = val.len;
 	ist2bin(&out->area[out->data], val);
 	out->data += val.len;
@@ -100,8 +135,9 @@ static inline int hpack_encode_short_idx(struct buffer *out, int idx, struct ist
 
 /* Tries to encode header field index <idx> with long value <val> into the
  * aligned buffer <out>. Returns non-zero on success, 0 on failure (buffer
- * full). The caller is responsible for ensuring <idx> is lower than 64 (static
- * list only), and that the buffer is aligned (head==0).
+ * full). The caller is responsible for ensuring <idx> is lower than 15 (static
+ * list only), and that the buffer is aligned (head==0). The field is not
+ * indexed.
  */
 static inline int hpack_encode_long_idx(struct buffer *out, int idx, struct ist val)
 {
@@ -111,10 +147,10 @@ static inline int hpack_encode_long_idx(struct buffer *out, int idx, struct ist
 	    1 + len + hpack_len_to_bytes(val.len) + val.len > out->size)
 		return 0;
 
-	/* emit literal with indexing (7541#6.2.1) :
-	 * [ 0 | 1 | Index (6+) ]
+	/* emit literal without indexing (7541#6.2.2) :
+	 * [ 0 | 0 | 0 | 0 | Index (4+) ]
 	 */
-	out->area[len++] = idx | 0x40;
+	out->area[len++] = idx;
 	len = hpack_encode_len(out->area, len, val.len);
 	memcpy(out->area + len, val.ptr, val.len);
 	len += val.len;
@@ -164,7 +200,7 @@ static inline int hpack_encode_int_status(struct buffer *out, unsigned int statu
 		goto fail;
 
 	/* basic encoding of the status code */
-	out->area[len - 5] = 0x48; // indexed name -- name=":status" (idx 8)
+	out->area[len - 5] = 0x08; // literal without indexing -- name=":status" (idx 8)
 	out->area[len - 4] = 0x03; // 3 bytes status
 	out->area[len - 3] = '0' + status / 100;
 	out->area[len - 2] = '0' + status / 10 % 10;
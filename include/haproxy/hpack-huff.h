@@ -29,7 +29,8 @@
 
 #include <inttypes.h>
 
-int huff_enc(const char *s, char *out);
+int huff_enc_len(const char *s, int len);
+int huff_enc(const char *s, int len, char *out);
 int huff_dec(const uint8_t *huff, int hlen, char *out, int olen);
 
 #endif /* _HAPROXY_HPACK_HUFF_H */
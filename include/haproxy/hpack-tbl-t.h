@@ -116,6 +116,37 @@ struct hpack_dht {
 	struct hpack_dte dte[VAR_ARRAY]; /* dynamic table entries */
 };
 
+/* Encoder context. It keeps a mirror of the peer's dynamic table so that
+ * header fields which were already sent with incremental indexing may be
+ * referenced by their index. Entries are located using two small hashed
+ * indexes, one on the name+value and one on the name only, which store the
+ * insertion number of the last entry matching the hash. An insertion number
+ * <ins> designates the dynamic table entry <ins_cnt - ins> (1-based), and is
+ * only valid as long as this one is still lower than or equal to the number
+ * of entries in the table. Hash collisions simply replace older references,
+ * and a reference is always checked against the table contents before use.
+ *
+ * Since a header block may fail to be committed (e.g. buffer full) after some
+ * entries were inserted, a copy of the context is taken before the first
+ * modification of each block so that it can be restored if the block is
+ * aborted (see hpack_enc_begin() and hpack_enc_abort()).
+ */
+#define HPACK_ENC_IDX_BITS      6
+#define HPACK_ENC_IDX_SLOTS     (1U << HPACK_ENC_IDX_BITS)
+
+#define HPACK_ENC_F_HUFF        0x0001  /* huffman-encode strings when shorter */
+#define HPACK_ENC_F_SAVED       0x0002  /* a snapshot was taken for the current block */
+
+struct hpack_enc {
+	uint32_t alloc;                           /* allocated table size in bytes (max usable size) */
+	uint32_t max_size;                        /* max table size accepted by the peer's decoder */
+	uint32_t ins_cnt;                         /* number of insertions since the table was created */
+	uint32_t flags;                           /* HPACK_ENC_F_* */
+	uint32_t fv_idx[HPACK_ENC_IDX_SLOTS];     /* insertion number + 1 by name+value hash, 0=none */
+	uint32_t n_idx[HPACK_ENC_IDX_SLOTS];      /* insertion number + 1 by name hash, 0=none */
+	struct hpack_dht dht;                     /* mirror of the peer's table, MUST BE LAST */
+};
+
 /* supported hpack encoding/decoding errors */
 enum {
 	HPACK_ERR_NONE = 0,           /* no error */
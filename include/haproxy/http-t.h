@@ -176,6 +176,12 @@ struct http_uri_parser {
 	enum http_uri_parser_format format; /* rfc 7230 5.3 HTTP URI format */
 };
 
+/* RFC9218 extensible priorities: urgency ranges from 0 (highest priority) to
+ * 7 (lowest), and responses are non-incremental by default.
+ */
+#define HTTP_PRIO_URG_DFLT   3
+#define HTTP_PRIO_URG_MAX    7
+
 #endif /* _HAPROXY_HTTP_T_H */
 
 /*
@@ -69,6 +69,7 @@ int http_find_next_url_param(const char **chunks,
 int http_parse_header(const struct ist hdr, struct ist *name, struct ist *value);
 int http_parse_stline(const struct ist line, struct ist *p1, struct ist *p2, struct ist *p3);
 int http_parse_status_val(const struct ist value, struct ist *status, struct ist *reason);
+void http_parse_priority(const struct ist value, uint8_t *urgency, uint8_t *incremental);
 
 int http_compare_etags(struct ist etag1, struct ist etag2);
 
@@ -175,8 +175,9 @@ struct bind_conf {
 	unsigned long long crt_ignerr_bitfield[IGNERR_BF_SIZE];  /* ignored verify errors in handshake if depth == 0 */
 	void *initial_ctx;             /* SSL context for initial negotiation */
 	int ssl_options;           /* ssl options */
-	struct eb_root sni_ctx;    /* sni_ctx tree of all known certs full-names sorted by name */
-	struct eb_root sni_w_ctx;  /* sni_ctx tree of all known certs wildcards sorted by name */
+	struct sni_ctx **sni_hash; /* hashed index of the sni_ctx of all known certs full-names and wildcards, or NULL */
+	unsigned int sni_hash_bits;  /* the index holds 1 << sni_hash_bits buckets */
+	unsigned int sni_hash_count; /* number of sni_ctx in the index */
 	struct tls_keys_ref *keys_ref; /* TLS ticket keys reference */
 
 	char *ca_sign_file;        /* CAFile used to generate and sign server certificates */
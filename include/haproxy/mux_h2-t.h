@@ -73,6 +73,9 @@
 
 #define H2_CF_IDL_PING          0x04000000  // timer task scheduled for a PING emission
 #define H2_CF_IDL_PING_SENT     0x08000000  // PING emitted, or will be on next tasklet run, waiting for ACK
+#define H2_CF_BDP_PING          0x10000000  // a BDP estimation PING must be emitted
+#define H2_CF_BDP_PING_SENT     0x20000000  // BDP estimation PING emitted, waiting for ACK
+#define H2_CF_BDP_SETTINGS      0x40000000  // a SETTINGS frame with a larger initial window size must be emitted
 
 /* This function is used to report flags in debugging tools. Please reflect
  * below any single-bit flag addition above in the same order via the
@@ -91,7 +94,8 @@ static forceinline char *h2c_show_flags(char *buf, size_t len, const char *delim
 	_(H2_CF_GOAWAY_SENT, _(H2_CF_GOAWAY_FAILED, _(H2_CF_WAIT_FOR_HS, _(H2_CF_IS_BACK,
 	_(H2_CF_WINDOW_OPENED, _(H2_CF_RCVD_SHUT, _(H2_CF_END_REACHED,
 	_(H2_CF_RCVD_RFC8441, _(H2_CF_SHTS_UPDATED, _(H2_CF_DTSU_EMITTED,
-	_(H2_CF_ERR_PENDING, _(H2_CF_ERROR)))))))))))))))))))))))));
+	_(H2_CF_ERR_PENDING, _(H2_CF_ERROR, _(H2_CF_IDL_PING, _(H2_CF_IDL_PING_SENT,
+	_(H2_CF_BDP_PING, _(H2_CF_BDP_PING_SENT, _(H2_CF_BDP_SETTINGS))))))))))))))))))))))))))))));
 	/* epilogue */
 	_(~0U);
 	return buf;
@@ -191,6 +195,11 @@ enum h2_ss {
 /* 32 buffers: one for the ring's root, rest for the mbuf itself */
 #define H2C_MBUF_CNT 32
 
+/* number of consecutive BDP samples without growth after which rx window
+ * autotuning stops sending PINGs.
+ */
+#define H2_BDP_STABLE_SAMPLES 3
+
 /**** tiny state decoding functions for debug helpers ****/
 
 /* returns a h2c state as an abbreviated 3-letter string, or "???" if unknown */
@@ -183,6 +183,8 @@ struct qcs {
 	uint64_t err; /* error code to transmit via RESET_STREAM */
 
 	int start; /* base timestamp for http-request timeout */
+	uint8_t urgency;     /* RFC9218 urgency, 0 (highest) to 7 (lowest) */
+	uint8_t incremental; /* RFC9218 incremental flag */
 
 	struct {
 		struct tot_time base; /* total QCS lifetime */
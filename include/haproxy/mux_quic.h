@@ -39,6 +39,8 @@ int qcc_release_stream_txbuf(struct qcs *qcs);
 int qcc_stream_can_send(const struct qcs *qcs);
 void qcc_reset_stream(struct qcs *qcs, int err);
 void qcc_send_stream(struct qcs *qcs, int urg, int count);
+void qcs_set_prio(struct qcs *qcs, uint8_t urgency, uint8_t incremental);
+void qcc_set_stream_prio(struct qcc *qcc, uint64_t id, uint8_t urgency, uint8_t incremental);
 void qcc_abort_stream_read(struct qcs *qcs);
 int qcc_recv(struct qcc *qcc, uint64_t id, uint64_t len, uint64_t offset,
              char fin, char *data);
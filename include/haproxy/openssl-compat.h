@@ -123,6 +123,12 @@ enum ssl_encryption_level_t {
 #define HAVE_SSL_CTX_get0_privatekey
 #endif
 
+#if defined(SSL_MODE_ASYNC) && (HA_OPENSSL_VERSION_NUMBER >= 0x10100000L) && !defined(OPENSSL_NO_DEPRECATED_3_0) && \
+    !defined(OPENSSL_IS_BORINGSSL) && !defined(OPENSSL_IS_AWSLC) && !defined(USE_OPENSSL_WOLFSSL)
+/* async jobs and RSA/EC key methods, used to offload private key operations */
+#define HAVE_SSL_ASYNC_OFFLOAD
+#endif
+
 #if HA_OPENSSL_VERSION_NUMBER >= 0x1000104fL || defined(USE_OPENSSL_WOLFSSL) || defined(OPENSSL_IS_AWSLC)
 /* CRYPTO_memcmp() is present since openssl 1.0.1d */
 #define HAVE_CRYPTO_memcmp
@@ -190,6 +190,9 @@ enum PR_SRV_STATE_FILE {
 /* unused: 0x00000400 to  0x80000000 */
 /* end of proxy->options3 */
 
+/* bits for proxy->queue_delay.flags */
+#define PR_QD_F_LIFO             0x00000001 /* serve newest queued requests first while overloaded */
+
 /* Cookie settings for pr->ck_opts */
 #define PR_CK_RW        0x00000001      /* rewrite all direct cookies with the right serverid */
 #define PR_CK_IND       0x00000002      /* keep only indirect cookies */
@@ -397,6 +400,12 @@ struct proxy {
 		int clientfin;                  /* timeout to apply to client half-closed connections */
 		int serverfin;                  /* timeout to apply to server half-closed connections */
 	} timeout;
+	struct {
+		unsigned int target;            /* target queue sojourn time in ms (0=disabled) */
+		unsigned int interval;          /* time in ms the target may be exceeded before dropping */
+		int status;                     /* HTTP status returned for dropped requests */
+		unsigned int flags;             /* PR_QD_F_* */
+	} queue_delay;
 	__decl_thread(HA_RWLOCK_T lock);        /* may be taken under the server's lock */
 
 	char *id;				/* proxy id (name), indexed by <conf.name_node> below */
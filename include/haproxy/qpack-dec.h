@@ -25,6 +25,7 @@
 
 struct buffer;
 struct http_hdr;
+struct qpack_enc;
 
 /* Internal QPACK processing errors.
  *Nothing to see with the RFC.
@@ -49,7 +50,7 @@ struct qpack_dec {
 int qpack_decode_fs(const unsigned char *buf, uint64_t len, struct buffer *tmp,
                     struct http_hdr *list, int list_size);
 int qpack_decode_enc(struct buffer *buf, int fin, void *ctx);
-int qpack_decode_dec(struct buffer *buf, int fin, void *ctx);
+int qpack_decode_dec(struct buffer *buf, int fin, void *ctx, struct qpack_enc *enc);
 
 int qpack_err_decode(const int value);
 
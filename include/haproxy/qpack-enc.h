@@ -3,6 +3,7 @@
 
 #include <haproxy/http-t.h>
 #include <haproxy/istbuf.h>
+#include <haproxy/qpack-tbl-t.h>
 
 struct buffer;
 
@@ -14,4 +15,15 @@ int qpack_encode_path(struct buffer *out, const struct ist path);
 int qpack_encode_auth(struct buffer *out, const struct ist auth);
 int qpack_encode_header(struct buffer *out, const struct ist n, const struct ist v);
 
+struct qpack_enc *qpack_enc_alloc(uint32_t capacity, uint64_t max_capacity, uint32_t max_blocked);
+void qpack_enc_free(struct qpack_enc *enc);
+int qpack_enc_encode_sdtc(struct qpack_enc *enc, struct buffer *ins);
+int qpack_enc_field_section_begin(struct qpack_enc *enc, struct buffer *out, uint64_t id);
+int qpack_enc_encode_header(struct qpack_enc *enc, struct buffer *out, struct buffer *ins,
+                            const struct ist n, const struct ist v);
+void qpack_enc_field_section_end(struct qpack_enc *enc, struct buffer *out);
+int qpack_enc_section_ack(struct qpack_enc *enc, uint64_t id);
+void qpack_enc_stream_cancel(struct qpack_enc *enc, uint64_t id);
+int qpack_enc_insert_count_inc(struct qpack_enc *enc, uint64_t inc);
+
 #endif /* QPACK_ENC_H_ */
@@ -42,6 +42,8 @@
 #define QPACK_DEC_INST_ICINC    0x00 // Insert Count Increment
 #define QPACK_DEC_INST_SCCL     0x40 // Stream Cancellation
 #define QPACK_DEC_INST_SACK     0x80 // Section Acknowledgment
+/* Maximum length of a decoder instruction, made of a single 62-bit integer */
+#define QPACK_DEC_INST_MAX      16
 
 /* RFC 9204 6. Error Handling */
 enum qpack_err {
@@ -61,6 +61,48 @@ struct qpack_dht {
 	struct qpack_dte dte[VAR_ARRAY]; /* dynamic table entries */
 };
 
+/* Encoder context. The dynamic table mirrors the one of the peer's decoder.
+ * Entries are designated by their absolute index (RFC9204#3.2.4), which is
+ * their insertion number. Two small hashed indexes (name+value and name only)
+ * give the absolute index + 1 of the last inserted entry matching a hash, they
+ * are always verified against the table before use. The field sections which
+ * reference the table and were not acknowledged yet by the decoder are kept
+ * in <sect> in emission order, as they prevent referenced entries from being
+ * evicted, and may block the decoder until the Known Received Count covers
+ * their Required Insert Count.
+ */
+#define QPACK_ENC_IDX_BITS      6
+#define QPACK_ENC_IDX_SLOTS     (1U << QPACK_ENC_IDX_BITS)
+#define QPACK_ENC_MAX_SECT      32      /* max unacknowledged sections referencing the table */
+#define QPACK_ENC_MAX_SIZE      65536   /* max supported table capacity */
+
+#define QPACK_ENC_F_REF         0x0001  /* current section may reference the dynamic table */
+#define QPACK_ENC_F_BLOCK       0x0002  /* current section may reference unacknowledged entries */
+
+struct qpack_enc_sect {
+	uint64_t id;                              /* stream ID */
+	uint64_t ric;                             /* Required Insert Count */
+	uint64_t min_ref;                         /* lowest absolute index referenced */
+};
+
+struct qpack_enc {
+	struct qpack_dht *dht;                    /* mirror of the peer's table */
+	uint64_t ins_cnt;                         /* Insert Count */
+	uint64_t krc;                             /* Known Received Count */
+	uint64_t max_entries;                     /* MaxEntries, from the peer's max capacity (RFC9204#3.2.2) */
+	uint32_t max_blocked;                     /* max number of streams we may block */
+	uint32_t flags;                           /* QPACK_ENC_F_* for the current section */
+	uint32_t nb_sect;                         /* number of entries in <sect> */
+	uint64_t id;                              /* stream ID of the current section */
+	uint64_t base;                            /* Base of the current section */
+	uint64_t ric;                             /* Required Insert Count of the current section */
+	uint64_t min_ref;                         /* lowest absolute index referenced by the current section */
+	size_t pfx;                               /* offset of the current section's prefix in the output buffer */
+	struct qpack_enc_sect sect[QPACK_ENC_MAX_SECT]; /* unacknowledged sections, oldest first */
+	uint64_t fv_idx[QPACK_ENC_IDX_SLOTS];     /* absolute index + 1 by name+value hash, 0=none */
+	uint64_t n_idx[QPACK_ENC_IDX_SLOTS];      /* absolute index + 1 by name hash, 0=none */
+};
+
 /* static header table as in draft-ietf-quic-qpack-20 Appendix A. [0] unused. */
 #define QPACK_SHT_SIZE 99
 
@@ -31,9 +31,14 @@ struct server;
 struct stream;
 struct queue;
 
+/* pendconn flags */
+#define PENDCONN_F_DROPPED   0x00000001  /* dropped by the queue delay control */
+
 struct pendconn {
 	int            strm_flags; /* stream flags */
 	unsigned int   queue_idx;  /* value of proxy/server queue_idx at time of enqueue */
+	unsigned int   enq_date;   /* date (now_ms) at which the entry was queued */
+	unsigned int   flags;      /* PENDCONN_F_* */
 	struct stream *strm;
 	struct queue  *queue;      /* the queue the entry is queued into */
 	struct server *target;     /* the server that was assigned, = srv except if srv==NULL */
@@ -48,6 +53,15 @@ struct queue {
 	__decl_thread(HA_SPINLOCK_T lock);      /* for manipulations in the tree */
 	unsigned int idx;			/* current queuing index */
 	unsigned int length;                    /* number of entries */
+
+	/* queue delay control state (see "queue-delay-target"), only
+	 * manipulated under the queue's lock.
+	 */
+	unsigned int first_above;               /* date at which the sojourn time will have exceeded the target for an interval */
+	unsigned int drop_next;                 /* date of the next drop while in dropping state */
+	unsigned int drop_count;                /* number of drops since entering the dropping state */
+	unsigned int drop_last;                 /* value of drop_count when last entering the dropping state */
+	unsigned int dropping;                  /* non-zero while the queue is in dropping (overload) state */
 };
 
 #endif /* _HAPROXY_QUEUE_T_H */
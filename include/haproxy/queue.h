@@ -29,6 +29,7 @@
 #include <haproxy/queue-t.h>
 #include <haproxy/server-t.h>
 #include <haproxy/stream-t.h>
+#include <haproxy/ticks.h>
 
 extern struct pool_head *pool_head_pendconn;
 
@@ -120,6 +121,10 @@ static inline void queue_init(struct queue *queue, struct proxy *px, struct serv
 	queue->idx = 0;
 	queue->px = px;
 	queue->sv = sv;
+	queue->first_above = TICK_ETERNITY;
+	queue->drop_next = TICK_ETERNITY;
+	queue->drop_count = queue->drop_last = 0;
+	queue->dropping = 0;
 	HA_SPIN_INIT(&queue->lock);
 }
 
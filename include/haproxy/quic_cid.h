@@ -16,6 +16,7 @@
 #include <haproxy/proto_quic.h>
 
 extern struct quic_cid_tree *quic_cid_trees;
+extern int quic_cid_steering;
 
 struct quic_connection_id *new_quic_cid(struct eb_root *root,
                                         struct quic_conn *qc,
@@ -63,6 +64,19 @@ static inline void quic_cid_dump(struct buffer *buf,
 	chunk_appendf(buf, ")");
 }
 
+/* Set the first byte of <cid> so that it designates the socket at index <idx>
+ * among the <cnt> ones of a reuseport group with CID steering, while keeping
+ * the remaining of its random value.
+ */
+static inline void quic_cid_steer(unsigned char *cid, uint idx, uint cnt)
+{
+	uint b = cid[0] - cid[0] % cnt + idx;
+
+	if (b > 255)
+		b -= cnt;
+	cid[0] = b;
+}
+
 /* Return tree index where <cid> is stored. */
 static inline uchar _quic_cid_tree_idx(const unsigned char *cid)
 {
@@ -7,7 +7,9 @@ extern struct pool_head *pool_head_quic_rx_packet;
 
 #include <import/eb64tree.h>
 #include <haproxy/api-t.h>
+#include <haproxy/list-t.h>
 #include <haproxy/quic_cid-t.h>
+#include <haproxy/quic_tls-t.h>
 #include <inttypes.h>
 #include <sys/socket.h>
 
@@ -23,6 +25,10 @@ struct quic_version;
 #define QUIC_FL_RX_PACKET_DGRAM_FIRST   (1UL << 1)
 /* Spin bit set */
 #define QUIC_FL_RX_PACKET_SPIN_BIT   (1UL << 2)
+/* Packet payload already decrypted by a decryption job */
+#define QUIC_FL_RX_PACKET_DECRYPTED     (1UL << 3)
+/* Packet payload decryption failed in a decryption job */
+#define QUIC_FL_RX_PACKET_DECRYPT_ERR   (1UL << 4)
 
 struct quic_rx_packet {
 	struct list list;
@@ -58,4 +64,48 @@ struct quic_rx_packet {
 	unsigned int time_received;
 };
 
+/* Minimum number of 1-RTT packets pending on a connection for their payload
+ * decryption to be shared with helper threads, and maximum number of packets
+ * per decryption job.
+ */
+#define QUIC_RX_DECRYPT_JOB_MIN      32
+#define QUIC_RX_DECRYPT_JOB_MAX     256
+/* Maximum number of helper threads per decryption job */
+#define QUIC_RX_DECRYPT_MAX_HELPERS  16
+
+struct quic_rx_decrypt_job;
+
+/* Reference to a decryption job queued on a helper thread */
+struct quic_rx_decrypt_ref {
+	struct mt_list el;                     /* attach point to quic_rx_decrypt_queue <jobs> */
+	struct quic_rx_decrypt_job *job;
+};
+
+/* Payload decryption of a batch of packets of the same connection with the
+ * same keys. The owner thread and the helpers claim packets by incrementing
+ * <next>. The owner sets <closed> once done and waits for <active> to drop to
+ * zero before processing the packets, so helpers must never touch the packets
+ * nor the keys once <closed> is set. The job is released by the last holder
+ * of a reference.
+ */
+struct quic_rx_decrypt_job {
+	const QUIC_AEAD *aead;
+	unsigned char *key;
+	unsigned char *iv;
+	size_t ivlen;
+	uint count;                            /* number of packets in <pkts> */
+	uint next;                             /* index of the next packet to decrypt */
+	uint active;                           /* number of helpers working on the job */
+	uint closed;                           /* set by the owner once done */
+	uint refcnt;                           /* owner + queued helpers */
+	struct quic_rx_decrypt_ref refs[QUIC_RX_DECRYPT_MAX_HELPERS];
+	struct quic_rx_packet *pkts[QUIC_RX_DECRYPT_JOB_MAX];
+};
+
+/* Per-thread list of decryption jobs to help with */
+struct quic_rx_decrypt_queue {
+	struct mt_list jobs;                   /* list of quic_rx_decrypt_ref */
+	struct tasklet *tasklet;               /* helper processing <jobs> */
+};
+
 #endif /* _HAPROXY_RX_T_H */
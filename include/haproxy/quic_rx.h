@@ -25,6 +25,8 @@
 #include <haproxy/quic_conn-t.h>
 #include <haproxy/quic_rx-t.h>
 
+extern struct pool_head *pool_head_quic_rx_decrypt_job;
+
 int quic_dgram_parse(struct quic_dgram *dgram, struct quic_conn *from_qc,
                      enum obj_type *obj_type);
 int qc_treat_rx_pkts(struct quic_conn *qc);
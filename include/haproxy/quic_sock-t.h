@@ -17,6 +17,34 @@ struct quic_accept_queue {
 	struct tasklet *tasklet;  /* task responsible to call listener_accept */
 };
 
+/* Datagrams emitted on listener sockets may be gathered in a per-thread TX
+ * batch and sent at once with a single sendmmsg() call. Consecutive datagrams
+ * sharing the same socket and addresses are merged into a single GSO message
+ * when possible.
+ */
+#define QUIC_TX_BATCH_BUFSZ     (256 * 1024) /* storage for batched datagrams */
+#define QUIC_TX_BATCH_MAXMSG    64           /* max number of batched messages */
+
+/* One message of a TX batch: one datagram or several ones using GSO */
+struct quic_tx_batch_msg {
+	struct listener *li;              /* listener whose socket is used */
+	struct sockaddr_storage dst;      /* peer address */
+	struct sockaddr_storage src;      /* source address, only if <use_src> */
+	uint32_t ofs;                     /* offset of the message in the batch's storage */
+	uint32_t len;                     /* total length of the message */
+	uint16_t gso;                     /* segment size if more than one datagram, otherwise 0 */
+	uint16_t use_src;                 /* non-zero if <src> must be set on emission */
+};
+
+/* Per-thread TX batch */
+struct quic_tx_batch {
+	char *area;                       /* storage for messages contents */
+	uint32_t data;                    /* bytes used in <area> */
+	uint32_t count;                   /* number of messages in <msgs> */
+	struct tasklet *tasklet;          /* tasklet responsible for flushing the batch */
+	struct quic_tx_batch_msg msgs[QUIC_TX_BATCH_MAXMSG];
+};
+
 /* Buffer used to receive QUIC datagrams on random thread and redispatch them
  * to the connection thread.
  */
@@ -27,6 +27,8 @@
 
 #define QUIC_TUNE_FE_LISTEN_OFF    0x00000001
 #define QUIC_TUNE_FE_SOCK_PER_CONN 0x00000002
+#define QUIC_TUNE_FE_TX_BATCH      0x00000004
+#define QUIC_TUNE_FE_CID_STEERING  0x00000008
 
 #define QUIC_TUNE_FB_TX_PACING  0x00000001
 #define QUIC_TUNE_FB_TX_UDP_GSO 0x00000002
@@ -41,9 +43,11 @@ struct quic_tune {
 		uint max_idle_timeout;
 		uint sec_glitches_threshold;
 		uint sec_retry_threshold;
+		uint sec_0rtt_replay_window; /* 0-RTT anti-replay window in ms, 0=disabled */
 		uint stream_data_ratio;
 		uint stream_max_concurrent;
 		uint stream_rxbuf;
+		uint rx_decrypt_helpers; /* max helper threads per decryption job, 0=disabled */
 		uint opts;    /* QUIC_TUNE_FE_* options specific to FE side */
 		uint fb_opts; /* QUIC_TUNE_FB_* options shared by both side */
 	} fe;
@@ -58,10 +62,13 @@ struct quic_tune {
 		uint stream_data_ratio;
 		uint stream_max_concurrent;
 		uint stream_rxbuf;
+		uint rx_decrypt_helpers; /* max helper threads per decryption job, 0=disabled */
 		uint fb_opts; /* QUIC_TUNE_FB_* options shared by both side */
 	} be;
 
 	uint64_t mem_tx_max;
+	uint qpack_enc_tbl_size;       /* QPACK encoder dynamic table capacity, 0=disabled */
+	uint qpack_enc_blocked_streams; /* max streams the QPACK encoder may block */
 };
 
 #endif /* USE_QUIC */
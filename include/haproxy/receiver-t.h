@@ -85,6 +85,8 @@ struct receiver {
 	enum quic_sock_mode quic_mode;   /* QUIC socket allocation strategy */
 	unsigned int quic_curr_handshake; /* count of active QUIC handshakes */
 	unsigned int quic_curr_accept;   /* count of QUIC conns waiting for accept */
+	unsigned int quic_steer_idx;     /* socket index in the reuseport group for CID steering */
+	unsigned int quic_steer_cnt;     /* number of sockets in the reuseport group, 0=no CID steering */
 #endif
 	struct {
 		struct task *task;  /* Task used to open connection for reverse. */
@@ -276,6 +276,11 @@ struct srv_per_thread {
 	struct ceb_root *idle_conns;            /* Shareable idle connections */
 	struct ceb_root *safe_conns;            /* Safe idle connections */
 	struct ceb_root *avail_conns;           /* Connections in use, but with still new streams available */
+	unsigned int avail_nb;                  /* number of connections in avail_conns (atomic) */
+	unsigned int avail_strms;               /* streams carried by the connections in avail_conns */
+	unsigned int avail_busiest;             /* streams carried by the busiest connection in avail_conns */
+	unsigned int avail_busiest_nb;          /* number of connections carrying avail_busiest streams */
+	unsigned int parked_conns;              /* idle conns of this thread parked in the group's shared pool (idle_conns_lock) */
 };
 
 /* Each server will have one occurrence of this structure per thread group */
@@ -288,6 +293,9 @@ struct srv_per_tgroup {
 	unsigned int self_served;		/* Number of connection we dequeued from our own queue */
 	unsigned int dequeuing;                 /* non-zero = dequeuing in progress (atomic) */
 	unsigned int next_takeover;             /* thread ID to try to steal connections from next time */
+	struct task *prewarm_task;              /* task keeping "pool-min-idle" connections open for this group, or NULL */
+	unsigned int prewarm_next;              /* group-relative thread ID to open the next pre-warmed connections on */
+	struct mt_list shared_conns[2];         /* parked idle (0) and safe (1) conns any thread of the group may pick */
 	struct eb_root *lb_tree;                 /* For LB algos with split between thread groups, the tree to be used, for each group */
 	unsigned npos, lpos;			/* next and last positions in the LB tree, protected by LB lock */
 	unsigned rweight;			/* remainder of weight in the current LB tree */
@@ -355,6 +363,8 @@ struct server {
 	unsigned int pool_purge_delay;          /* Delay before starting to purge the idle conns pool */
 	unsigned int low_idle_conns;            /* min idle connection count to start picking from other threads */
 	unsigned int max_idle_conns;            /* Max number of connection allowed in the orphan connections list */
+	unsigned int min_idle_conns;            /* Min number of idle connections to keep pre-established per thread group */
+	unsigned int target_streams;            /* streams per multiplexed conn above which a new conn is preferred, 0 = none */
 	int max_reuse;                          /* Max number of requests on a same connection */
 	struct task *warmup;                    /* the task dedicated to the warmup when slowstart is set */
 
@@ -471,7 +481,7 @@ struct server {
 	char *sni_expr;             /* Temporary variable to store a sample expression for SNI */
 	struct {
 		void *ctx;
-		struct {
+		struct srv_ssl_sess {
 			/* ptr/size may be shared R/O with other threads under read lock
 			 * "sess_lock", however only the owning thread may change them
 			 * (under write lock).
@@ -483,6 +493,12 @@ struct server {
 			__decl_thread(HA_RWLOCK_T sess_lock);
 		} * reused_sess;
 
+		/* pool of the last sessions received by any thread, which any
+		 * thread may change under write lock (tune.ssl.srv-sess-pool-size).
+		 */
+		struct srv_ssl_sess *shared_sess;
+		uint shared_sess_idx;           /* next shared_sess entry to be written */
+
 		struct ckch_inst *inst; /* Instance of the ckch_store in which the certificate was loaded (might be null if server has no certificate) */
 		__decl_thread(HA_RWLOCK_T lock); /* lock the cache and SSL_CTX during commit operations */
 
@@ -102,6 +102,9 @@ struct connection *srv_lookup_conn_next(struct ceb_root **tree, struct connectio
 void _srv_add_idle(struct server *srv, struct connection *conn, int is_safe);
 int srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_safe);
 void srv_add_to_avail_list(struct server *srv, struct connection *conn);
+void srv_set_avail_strms(struct server *srv, struct connection *conn, int thr, uint strms);
+void srv_refresh_avail_conn(struct connection *conn);
+struct connection *srv_pick_shared_conn(struct server *srv, int is_safe, int64_t hash, int *thr);
 struct task *srv_cleanup_toremove_conns(struct task *task, void *context, unsigned int state);
 
 int srv_apply_track(struct server *srv, struct proxy *curproxy);
@@ -319,6 +322,16 @@ static inline void srv_use_conn(struct server *srv, struct connection *conn)
 		HA_ATOMIC_STORE(&srv->est_need_conns, curr);
 }
 
+/* Wakes up the task in charge of refilling the pre-warmed idle connections of
+ * the current thread group of <srv>, if any. This is meant to be called when
+ * an idle connection was just picked from the server's idle trees.
+ */
+static inline void srv_wakeup_prewarm(struct server *srv)
+{
+	if (srv->min_idle_conns)
+		task_wakeup(srv->per_tgrp[tgid - 1].prewarm_task, TASK_WOKEN_OTHER);
+}
+
 /* checks if minconn and maxconn are consistent to each other
  * and automatically adjust them if it is not the case
  * This logic was historically implemented in check_config_validity()
@@ -34,6 +34,10 @@ int ssl_sock_load_files_into_ckch(const char *path, struct ckch_data *data, stru
 int ssl_sock_load_pem_into_ckch(const char *path, char *buf, struct ckch_data *datackch , char **err);
 void ssl_sock_free_cert_key_and_chain_contents(struct ckch_data *data);
 
+int ckch_preload_add(const char *path);
+void ckch_preload_run(void);
+void ckch_preload_flush(void);
+
 int ssl_sock_load_key_into_ckch(const char *path, char *buf, struct ckch_data *data , char **err);
 int ssl_sock_load_ocsp_response_from_file(const char *ocsp_path, char *buf, struct ckch_data *data, char **err);
 int ssl_sock_load_sctl_from_file(const char *sctl_path, char *buf, struct ckch_data *data, char **err);
@@ -141,11 +141,14 @@ struct sni_ctx {
 	int order;                /* load order for the certificate */
 	unsigned int neg:1;       /* reject if match */
 	unsigned int wild:1;      /* wildcard sni */
+	unsigned int indexed:1;   /* inserted in the bind_conf's SNI index */
 	struct pkey_info kinfo;   /* pkey info */
 	struct ssl_bind_conf *conf; /* ptr to a crtlist's ssl_conf, must not be free from here */
 	struct list by_ckch_inst; /* chained in ckch_inst's list of sni_ctx */
 	struct ckch_inst *ckch_inst; /* instance used to create this sni_ctx */
-	struct ebmb_node name;    /* node holding the servername value */
+	struct sni_ctx *hash_next; /* next sni_ctx in the same bucket of the bind_conf's SNI index */
+	unsigned int hash;        /* hash of the servername value */
+	char name[VAR_ARRAY];     /* servername value */
 };
 
 struct tls_sess_key_128 {
@@ -174,6 +177,9 @@ struct tls_keys_ref {
 	union tls_sess_key *tlskeys;
 	int tls_ticket_enc_index;
 	int key_size_bits;
+	unsigned char *secret; /* secret the keys are derived from ("tls-ticket-secret"), or NULL */
+	int secret_len;
+	unsigned long long epoch; /* epoch of the derived key used for encryption */
 	__decl_thread(HA_RWLOCK_T lock); /* lock used to protect the ref */
 };
 
@@ -193,6 +199,7 @@ struct issuer_chain {
 };
 
 struct connection;
+struct stktable;
 
 typedef void (*ssl_sock_msg_callback_func)(struct connection *conn,
 	int write_p, int version, int content_type,
@@ -316,11 +323,22 @@ struct global_ssl {
 	unsigned int hard_max_record; /* SSL max record size hard limit */
 	unsigned int default_dh_param; /* SSL maximum DH parameter size */
 	int ctx_cache; /* max number of entries in the ssl_ctx cache. */
+	int lazy_ctx_cache; /* max number of lazy SSL_CTX kept instantiated, 0=not lazy */
 	int capture_buffer_size; /* Size of the capture buffer. */
 	int keylog; /* activate keylog  */
 	int extra_files; /* which files not defined in the configuration file are we looking for */
 	int extra_files_noext; /* whether we remove the extension when looking up a extra file */
 	int security_level;    /* configure the openssl security level */
+	int load_threads;      /* number of threads used to preload certificates, 0/1=off */
+	int offload_threads;   /* number of crypto threads for private key operations, 0=off */
+	int offload_batch;     /* max number of operations processed at once by a crypto thread */
+	int srv_sess_pool;     /* number of server sessions shared between threads */
+	unsigned int ticket_key_lifetime; /* time during which a derived ticket key encrypts tickets, in seconds */
+	unsigned int ticket_key_overlap;  /* time during which it still decrypts them after, in seconds */
+	char *sess_table_name;      /* from "ssl-session-table" */
+	struct stktable *sess_table; /* stick-table sharing the sessions with peers, or NULL */
+	char *gencert_table_name;      /* from "ssl-gencert-table" */
+	struct stktable *gencert_table; /* stick-table sharing the generated certificates, or NULL */
 
 #ifndef OPENSSL_NO_OCSP
 	struct {
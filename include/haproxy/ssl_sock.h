@@ -59,6 +59,7 @@ extern struct stats_module ssl_stats_module;
 
 int ssl_sock_prep_ctx_and_inst(struct bind_conf *bind_conf, struct ssl_bind_conf *ssl_conf,
 			       SSL_CTX *ctx, struct ckch_inst *ckch_inst, char **err);
+SSL_CTX *ckch_inst_get_lazy_ctx(struct ckch_inst *inst);
 int ssl_sock_prep_srv_ctx_and_inst(const struct server *srv, SSL_CTX *ctx,
 				   struct ckch_inst *ckch_inst);
 int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf);
@@ -122,6 +123,10 @@ int ssl_sock_switchctx_wolfSSL_cbk(WOLFSSL* ssl, void* arg);
 
 int increment_sslconn();
 void ssl_sock_load_cert_sni(struct ckch_inst *ckch_inst, struct bind_conf *bind_conf);
+void ssl_sock_delete_sni(struct bind_conf *bind_conf, struct sni_ctx *sni);
+struct sni_ctx *ssl_sock_lookup_sni(struct bind_conf *bind_conf, const char *name, int wild);
+struct sni_ctx *ssl_sock_lookup_sni_next(struct bind_conf *bind_conf, struct sni_ctx *sni);
+struct sni_ctx *ssl_sock_next_sni(struct bind_conf *bind_conf, struct sni_ctx *sni);
 struct sni_ctx *ssl_sock_chose_sni_ctx(struct bind_conf *s, struct connection *conn,
                                        const char *servername, int have_rsa_sig, int have_ecdsa_sig);
 #ifdef SSL_MODE_ASYNC
@@ -61,6 +61,8 @@ enum {
 	STKTABLE_DT_GPC_RATE,      /* array of gpc_rate */
 	STKTABLE_DT_GLITCH_CNT,    /* cumulated number of front glitches */
 	STKTABLE_DT_GLITCH_RATE,   /* rate of front glitches */
+	STKTABLE_DT_SSL_SESS,      /* encoded SSL session */
+	STKTABLE_DT_SSL_GENCERT,   /* encoded generated certificate */
 
 	STKTABLE_STATIC_DATA_TYPES,/* number of types above */
 	/* up to STKTABLE_EXTRA_DATA_TYPES types may be registered here, always
@@ -76,6 +78,7 @@ enum {
 	STD_T_ULL,                /* data is of type unsigned long long */
 	STD_T_FRQP,               /* data is of type freq_ctr */
 	STD_T_DICT,               /* data is of type key of dictionary entry */
+	STD_T_BLOB,               /* data is a pointer to an allocated stktable_blob */
 };
 
 /* The types of optional arguments to stored data */
@@ -112,6 +115,12 @@ enum {
 #define STKCTR_TRACK_BACKEND 1
 #define STKCTR_TRACK_CONTENT 2
 
+/* opaque binary data stored in a stick-table entry */
+struct stktable_blob {
+	size_t len;                       /* length of <data> */
+	unsigned char data[VAR_ARRAY];    /* the data itself */
+};
+
 /* stick_table extra data. This is mainly used for casting or size computation */
 union stktable_data {
 	/* standard types for easy casting */
@@ -120,6 +129,7 @@ union stktable_data {
 	unsigned long long std_t_ull;
 	struct freq_ctr std_t_frqp;
 	struct dict_entry *std_t_dict;
+	struct stktable_blob *std_t_blob;
 } __attribute__((packed, aligned(sizeof(int))));
 
 /* known data types */
@@ -137,6 +137,8 @@ static inline int stktable_type_size(int type)
 		return sizeof(struct freq_ctr);
 	case STD_T_DICT:
 		return sizeof(struct dict_entry *);
+	case STD_T_BLOB:
+		return sizeof(struct stktable_blob *);
 	}
 	return 0;
 }
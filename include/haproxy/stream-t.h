@@ -157,6 +157,7 @@ enum {
 	STRM_ET_DATA_TO    = 0x0100,  /* timeout during data phase */
 	STRM_ET_DATA_ERR   = 0x0200,  /* error during data phase */
 	STRM_ET_DATA_ABRT  = 0x0400,  /* data phase aborted by external cause */
+	STRM_ET_QUEUE_DROP = 0x0800,  /* dropped from the queue by the delay control */
 };
 
 
@@ -195,7 +196,7 @@ static forceinline char *strm_et_show_flags(char *buf, size_t len, const char *d
 	_(STRM_ET_QUEUE_TO, _(STRM_ET_QUEUE_ERR, _(STRM_ET_QUEUE_ABRT,
 	_(STRM_ET_CONN_TO, _(STRM_ET_CONN_ERR, _(STRM_ET_CONN_ABRT,
 	_(STRM_ET_CONN_RES, _(STRM_ET_CONN_OTHER, _(STRM_ET_DATA_TO,
-	_(STRM_ET_DATA_ERR, _(STRM_ET_DATA_ABRT)))))))))));
+	_(STRM_ET_DATA_ERR, _(STRM_ET_DATA_ABRT, _(STRM_ET_QUEUE_DROP))))))))))));
 	/* epilogue */
 	_(~0U);
 	return buf;
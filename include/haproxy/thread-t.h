@@ -192,6 +192,7 @@ enum lock_label {
 	SHCTX_LOCK,
 	SSL_LOCK,
 	SSL_GEN_CERTS_LOCK,
+	SSL_LAZY_CTX_LOCK,
 	PATREF_LOCK,
 	PATEXP_LOCK,
 	VARS_LOCK,
@@ -64,7 +64,7 @@ enum {
 #define TH_FL_SLEEPING          0x00000008  /* thread won't check its task list before next wakeup */
 #define TH_FL_STARTED           0x00000010  /* set once the thread starts */
 #define TH_FL_IN_LOOP           0x00000020  /* set only inside the polling loop */
-/* unused                       0x00000040 */
+#define TH_FL_STEAL_NOTIFIED    0x00000040  /* work stealing: a sibling was already woken up in this round */
 #define TH_FL_IN_SIG_HANDLER    0x00000080  /* thread currently in the generic signal handler */
 #define TH_FL_IN_DBG_HANDLER    0x00000100  /* thread currently in the debug signal handler */
 #define TH_FL_IN_WDT_HANDLER    0x00000200  /* thread currently in the wdt signal handler */
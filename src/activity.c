@@ -1596,6 +1596,9 @@ static int cli_io_handler_show_activity(struct appctx *appctx)
 #ifdef USE_THREAD
 		case __LINE__: SHOW_VAL("accq_ring:",    accept_queue_ring_len(&accept_queue_rings[thr]), _tot); break;
 		case __LINE__: SHOW_VAL("fd_takeover:",  activity[thr].fd_takeover, _tot); break;
+		case __LINE__: SHOW_VAL("conn_shared:",  activity[thr].conn_shared, _tot); break;
+		case __LINE__: SHOW_VAL("stolen_tasks:", activity[thr].stolen_tasks, _tot); break;
+		case __LINE__: SHOW_VAL("lost_tasks:",   activity[thr].lost_tasks, _tot); break;
 		case __LINE__: SHOW_VAL("check_adopted:",activity[thr].check_adopted, _tot); break;
 #endif
 		case __LINE__: SHOW_VAL("check_started:",activity[thr].check_started, _tot); break;
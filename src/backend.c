@@ -1343,6 +1343,19 @@ struct connection *conn_backend_get(int reuse_mode,
 	if (!(global.tune.options & GTUNE_IDLE_POOL_SHARED))
 		goto done;
 
+	/* Connections parked by the threads of our group are directly
+	 * reachable, and since they're in excess on their thread, it's always
+	 * worth picking them before considering a new connection.
+	 */
+	conn = srv_pick_shared_conn(srv, is_safe, hash, &i);
+	if (conn) {
+		if (i != tid)
+			_HA_ATOMIC_INC(&activity[tid].fd_takeover);
+		_HA_ATOMIC_INC(&activity[tid].conn_shared);
+		goto done;
+	}
+	i = tid;
+
 	/* Are we allowed to pick from another thread ? We'll still try
 	 * it if we're running low on FDs as we don't want to create
 	 * extra conns in this case, otherwise we can give up if we have
@@ -1426,6 +1439,7 @@ struct connection *conn_backend_get(int reuse_mode,
 		_HA_ATOMIC_DEC(&srv->curr_idle_thr[i]);
 		conn->flags &= ~CO_FL_LIST_MASK;
 		__ha_barrier_atomic_store();
+		srv_wakeup_prewarm(srv);
 
 		if (reuse_mode == PR_O_REUSE_SAFE && conn->mux->flags & MX_FL_HOL_RISK) {
 			/* attach the connection to the session private list */
@@ -1653,6 +1667,42 @@ int64_t be_calculate_conn_hash(struct server *srv, struct stream *strm,
 	return conn_calculate_hash(&hash_params);
 }
 
+/* Looks up the available connections of <srv> on the current thread for one
+ * matching <hash>, and returns the one carrying the fewest streams, or NULL if
+ * none matches. In order to bound the lookup cost when many connections share
+ * the same hash, only the first 16 candidates are compared.
+ */
+static struct connection *be_lookup_least_busy_conn(struct server *srv, int64_t hash)
+{
+	struct ceb_root **tree = &srv->per_thr[tid].avail_conns;
+	struct connection *conn, *best = NULL;
+	int best_used = 0;
+	int visited = 0;
+
+	for (conn = srv_lookup_conn(tree, hash); conn; conn = srv_lookup_conn_next(tree, conn)) {
+		int used = conn->mux->used_streams(conn);
+
+		if (!best || used < best_used) {
+			best = conn;
+			best_used = used;
+			if (!used)
+				break;
+		}
+		if (++visited >= 16)
+			break;
+	}
+	return best;
+}
+
+/* Returns non-zero if a new connection may be established to <srv> instead of
+ * adding one more stream to an already busy multiplexed one.
+ */
+static inline int be_may_open_conn(const struct server *srv)
+{
+	return !(srv->flags & (SRV_F_RHTTP | SRV_F_STRICT_MAXCONN)) &&
+	       ha_used_fds < global.tune.pool_low_count;
+}
+
 /* Try to reuse a connection, first from <sess> session, then to <srv> server
  * lists if not NULL, matching <hash> value and <be> reuse policy. If reuse is
  * on <be> proxy successful, connection is attached to <sc> stconn instance.
@@ -1677,6 +1727,7 @@ int be_reuse_connection(int64_t hash, struct session *sess,
                         struct stconn *sc, enum obj_type *target, int not_first_req)
 {
 	struct connection *srv_conn;
+	struct connection *busy_conn = NULL;
 	const int reuse_mode = be_reuse_mode(be, srv);
 
 	/* first, search for a matching connection in the session's idle conns */
@@ -1704,10 +1755,19 @@ int be_reuse_connection(int64_t hash, struct session *sess,
 		 * that there is no concurrency issues.
 		 */
 		if (!ceb_isempty(&srv->per_thr[tid].avail_conns)) {
-			srv_conn = srv_lookup_conn(&srv->per_thr[tid].avail_conns, hash);
+			srv_conn = be_lookup_least_busy_conn(srv, hash);
 			if (srv_conn) {
 				/* connection cannot be in idle list if used as an avail idle conn. */
 				BUG_ON(LIST_INLIST(&srv_conn->idle_list));
+
+				/* past the target occupancy, an idle or a new
+				 * connection is preferred, see below.
+				 */
+				if (srv->target_streams &&
+				    srv_conn->mux->used_streams(srv_conn) >= srv->target_streams) {
+					busy_conn = srv_conn;
+					srv_conn = NULL;
+				}
 				//DBG_TRACE_STATE("reuse connection from avail", STRM_EV_STRM_PROC|STRM_EV_CS_ST, strm);
 			}
 		}
@@ -1742,6 +1802,13 @@ int be_reuse_connection(int64_t hash, struct session *sess,
 				//DBG_TRACE_STATE("reuse connection from idle/safe", STRM_EV_STRM_PROC|STRM_EV_CS_ST, strm);
 			}
 		}
+
+		/* all matching available connections are busy and no idle one
+		 * was found: only pile up on the least busy one if we're not
+		 * allowed to establish a new one.
+		 */
+		if (!srv_conn && busy_conn && !be_may_open_conn(srv))
+			srv_conn = busy_conn;
 	}
 
 	if (srv_conn) {
@@ -1761,6 +1828,8 @@ int be_reuse_connection(int64_t hash, struct session *sess,
 						goto err;
 					sc_ep_clr(sc, ~SE_FL_DETACHED);
 				}
+				else
+					srv_refresh_avail_conn(srv_conn);
 			}
 			else {
 				/* TODO cannot reuse conn finally due to no more avail
@@ -2495,7 +2564,9 @@ void back_try_conn_req(struct stream *s)
 	}
 	else if (sc->state == SC_ST_QUE) {
 		/* connection request was queued, check for any update */
-		if (!pendconn_dequeue(s)) {
+		int ret = pendconn_dequeue(s);
+
+		if (!ret) {
 			/* The connection is not in the queue anymore. Either
 			 * we have a server connection slot available and we
 			 * go directly to the assigned state, or we need to
@@ -2512,6 +2583,28 @@ void back_try_conn_req(struct stream *s)
 			goto end;
 		}
 
+		if (ret < 0) {
+			/* The connection request was dropped from the queue
+			 * by the queue delay control.
+			 */
+			s->conn_exp = TICK_ETERNITY;
+			s->logs.t_queue = ns_to_ms(now_ns - s->logs.accept_ts);
+
+			if (s->sv_tgcounters)
+				_HA_ATOMIC_INC(&s->sv_tgcounters->failed_conns);
+			if (s->be_tgcounters)
+				_HA_ATOMIC_INC(&s->be_tgcounters->failed_conns);
+			sc_abort(sc);
+			sc_shutdown(sc);
+			if (!s->conn_err_type)
+				s->conn_err_type = STRM_ET_QUEUE_DROP;
+			sc->state = SC_ST_CLO;
+			if (s->srv_error)
+				s->srv_error(s, sc);
+			DBG_TRACE_STATE("connection request dropped from queue", STRM_EV_STRM_PROC|STRM_EV_CS_ST|STRM_EV_STRM_ERR, s);
+			goto end;
+		}
+
 		/* Connection request still in queue... */
 		if (s->flags & SF_CONN_EXP) {
 			/* ... and timeout expired */
@@ -13,8 +13,10 @@
 #include <haproxy/global.h>
 #include <haproxy/listener.h>
 #include <haproxy/proxy.h>
+#include <haproxy/qpack-tbl-t.h>
 #include <haproxy/quic_cc.h>
 #include <haproxy/quic_rules.h>
+#include <haproxy/quic_rx-t.h>
 #include <haproxy/quic_tune.h>
 #include <haproxy/tools.h>
 
@@ -320,6 +322,13 @@ static int cfg_parse_quic_time(char **args, int section_type,
 		                                 &quic_tune.fe.max_idle_timeout;
 		*ptr = time;
 	}
+	else if (strcmp(suffix, "fe.sec.0rtt-replay-window") == 0) {
+		if (time < 1000) {
+			memprintf(err, "'%s' expects a value of at least 1s.", name);
+			return -1;
+		}
+		quic_tune.fe.sec_0rtt_replay_window = time;
+	}
 	/* legacy options */
 	else if (strcmp(name + prefix_len, "frontend.max-idle-timeout") == 0) {
 		memprintf(err, "'%s' is deprecated in 3.3 and will be removed in 3.5. "
@@ -372,6 +381,16 @@ static int cfg_parse_quic_tune_setting(char **args, int section_type,
 
 		quic_tune.mem_tx_max = mem_max;
 	}
+	else if (strcmp(suffix, "qpack.encoder-table-size") == 0) {
+		if (arg < 256 || arg > QPACK_ENC_MAX_SIZE) {
+			memprintf(err, "'%s' expects a value between 256 and %d.", args[0], QPACK_ENC_MAX_SIZE);
+			return -1;
+		}
+		quic_tune.qpack_enc_tbl_size = arg;
+	}
+	else if (strcmp(suffix, "qpack.encoder-blocked-streams") == 0) {
+		quic_tune.qpack_enc_blocked_streams = arg;
+	}
 	else if (strcmp(suffix, "be.cc.cubic-min-losses") == 0 ||
 	         strcmp(suffix, "fe.cc.cubic-min-losses") == 0) {
 		uint *ptr = (suffix[0] == 'b') ? &quic_tune.be.cc_cubic_min_losses :
@@ -407,6 +426,17 @@ static int cfg_parse_quic_tune_setting(char **args, int section_type,
 		                                 &quic_tune.fe.cc_reorder_ratio;
 		*ptr = arg;
 	}
+	else if (strcmp(suffix, "be.rx.decrypt-helpers") == 0 ||
+	         strcmp(suffix, "fe.rx.decrypt-helpers") == 0) {
+		uint *ptr = (suffix[0] == 'b') ? &quic_tune.be.rx_decrypt_helpers :
+		                                 &quic_tune.fe.rx_decrypt_helpers;
+		if (arg > QUIC_RX_DECRYPT_MAX_HELPERS) {
+			memprintf(err, "'%s' expects an integer argument between 1 and %d.",
+			          args[0], QUIC_RX_DECRYPT_MAX_HELPERS);
+			return -1;
+		}
+		*ptr = arg;
+	}
 	else if (strcmp(suffix, "be.sec.glitches-threshold") == 0 ||
 	         strcmp(suffix, "fe.sec.glitches-threshold") == 0) {
 		uint *ptr = (suffix[0] == 'b') ? &quic_tune.be.sec_glitches_threshold :
@@ -637,6 +667,18 @@ static int cfg_parse_quic_tune_on_off(char **args, int section_type, struct prox
 		else
 			*ptr &= ~QUIC_TUNE_FB_TX_PACING;
 	}
+	else if (strcmp(suffix, "fe.cid-steering") == 0) {
+		if (on)
+			quic_tune.fe.opts |= QUIC_TUNE_FE_CID_STEERING;
+		else
+			quic_tune.fe.opts &= ~QUIC_TUNE_FE_CID_STEERING;
+	}
+	else if (strcmp(suffix, "fe.tx.batch") == 0) {
+		if (on)
+			quic_tune.fe.opts |= QUIC_TUNE_FE_TX_BATCH;
+		else
+			quic_tune.fe.opts &= ~QUIC_TUNE_FE_TX_BATCH;
+	}
 	else if (strcmp(suffix, "be.tx.udp-gso") == 0 ||
 	         strcmp(suffix, "fe.tx.udp-gso") == 0) {
 		uint *ptr = (suffix[0] == 'b') ? &quic_tune.be.fb_opts :
@@ -662,6 +704,8 @@ static int cfg_parse_quic_tune_on_off(char **args, int section_type, struct prox
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.quic.listen", cfg_parse_quic_tune_on_off },
 	{ CFG_GLOBAL, "tune.quic.mem.tx-max", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.qpack.encoder-blocked-streams", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.qpack.encoder-table-size", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.zero-copy-fwd-send", cfg_parse_quic_tune_on_off },
 
 	{ CFG_GLOBAL, "tune.quic.fe.cc.cubic-min-losses", cfg_parse_quic_tune_setting },
@@ -669,13 +713,17 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.quic.fe.cc.max-frame-loss", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.cc.max-win-size", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.cc.reorder-ratio", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.fe.cid-steering", cfg_parse_quic_tune_on_off },
 	{ CFG_GLOBAL, "tune.quic.fe.max-idle-timeout", cfg_parse_quic_time },
+	{ CFG_GLOBAL, "tune.quic.fe.rx.decrypt-helpers", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.fe.sec.0rtt-replay-window", cfg_parse_quic_time },
 	{ CFG_GLOBAL, "tune.quic.fe.sec.glitches-threshold", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.sec.retry-threshold", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.sock-per-conn", cfg_parse_quic_tune_sock_per_conn },
 	{ CFG_GLOBAL, "tune.quic.fe.stream.data-ratio", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.stream.max-concurrent", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.fe.stream.rxbuf", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.fe.tx.batch", cfg_parse_quic_tune_on_off },
 	{ CFG_GLOBAL, "tune.quic.fe.tx.pacing", cfg_parse_quic_tune_on_off },
 	{ CFG_GLOBAL, "tune.quic.fe.tx.udp-gso", cfg_parse_quic_tune_on_off },
 
@@ -685,6 +733,7 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.quic.be.cc.max-win-size", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.be.cc.reorder-ratio", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.be.max-idle-timeout", cfg_parse_quic_time },
+	{ CFG_GLOBAL, "tune.quic.be.rx.decrypt-helpers", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.be.sec.glitches-threshold", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.be.stream.data-ratio", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.be.stream.max-concurrent", cfg_parse_quic_tune_setting },
@@ -44,6 +44,7 @@
 #include <haproxy/ssl_ckch.h>
 #include <haproxy/ssl_crtlist.h>
 #include <haproxy/ssl_ocsp.h>
+#include <haproxy/ssl_offload.h>
 #include <haproxy/ssl_sock.h>
 
 
@@ -142,6 +143,41 @@ static int ssl_parse_global_ssl_async(char **args, int section_type, struct prox
 #endif
 }
 
+/* parse the "tune.ssl.offload-threads" keyword in global section.
+ * Returns <0 on alert, >0 on warning, 0 on success.
+ */
+static int ssl_parse_global_offload_threads(char **args, int section_type, struct proxy *curpx,
+                                            const struct proxy *defpx, const char *file, int line,
+                                            char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0) {
+		memprintf(err, "'%s' expects an integer argument.", args[0]);
+		return -1;
+	}
+
+	global_ssl.offload_threads = atoi(args[1]);
+	if (global_ssl.offload_threads < 0) {
+		memprintf(err, "'%s' expects a positive numeric value.", args[0]);
+		return -1;
+	}
+
+	if (!global_ssl.offload_threads)
+		return 0;
+
+	if (ssl_offload_init(err) != 0) {
+		memprintf(err, "'%s': %s", args[0], *err);
+		global_ssl.offload_threads = 0;
+		return -1;
+	}
+
+	/* the offloaded operations rely on async jobs */
+	global_ssl.async = 1;
+	return 0;
+}
+
 #if defined(USE_ENGINE) && !defined(OPENSSL_NO_ENGINE)
 /* parse the "ssl-engine" keyword in global section.
  * Returns <0 on alert, >0 on warning, 0 on success.
@@ -396,6 +432,14 @@ static int ssl_parse_global_int(char **args, int section_type, struct proxy *cur
 		target = (int *)&global_ssl.hard_max_record;
 	else if (strcmp(args[0], "tune.ssl.ssl-ctx-cache-size") == 0)
 		target = &global_ssl.ctx_cache;
+	else if (strcmp(args[0], "tune.ssl.load-threads") == 0)
+		target = &global_ssl.load_threads;
+	else if (strcmp(args[0], "tune.ssl.lazy-ctx-cache-size") == 0)
+		target = &global_ssl.lazy_ctx_cache;
+	else if (strcmp(args[0], "tune.ssl.offload-batch") == 0)
+		target = &global_ssl.offload_batch;
+	else if (strcmp(args[0], "tune.ssl.srv-sess-pool-size") == 0)
+		target = &global_ssl.srv_sess_pool;
 	else if (strcmp(args[0], "maxsslconn") == 0)
 		target = &global.maxsslconn;
 	else if (strcmp(args[0], "tune.ssl.capture-buffer-size") == 0)
@@ -509,24 +553,31 @@ static int ssl_parse_global_private_cache(char **args, int section_type, struct
 	return 0;
 }
 
-/* parse "ssl.lifetime".
+/* parse "tune.ssl.lifetime", "tune.ssl.ticket-key-lifetime" and
+ * "tune.ssl.ticket-key-overlap".
  * Returns <0 on alert, >0 on warning, 0 on success.
  */
 static int ssl_parse_global_lifetime(char **args, int section_type, struct proxy *curpx,
                                      const struct proxy *defpx, const char *file, int line,
                                      char **err)
 {
+	unsigned int *target = &global_ssl.life_time;
 	const char *res;
 
+	if (strcmp(args[0], "tune.ssl.ticket-key-lifetime") == 0)
+		target = &global_ssl.ticket_key_lifetime;
+	else if (strcmp(args[0], "tune.ssl.ticket-key-overlap") == 0)
+		target = &global_ssl.ticket_key_overlap;
+
 	if (too_many_args(1, args, err, NULL))
 		return -1;
 
 	if (*(args[1]) == 0) {
-		memprintf(err, "'%s' expects ssl sessions <lifetime> in seconds as argument.", args[0]);
+		memprintf(err, "'%s' expects a <time> in seconds as argument.", args[0]);
 		return -1;
 	}
 
-	res = parse_time_err(args[1], &global_ssl.life_time, TIME_UNIT_S);
+	res = parse_time_err(args[1], target, TIME_UNIT_S);
 	if (res == PARSE_TIME_OVER) {
 		memprintf(err, "timer overflow in argument '%s' to <%s> (maximum value is 2147483647 s or ~68 years).",
 			  args[1], args[0]);
@@ -541,6 +592,10 @@ static int ssl_parse_global_lifetime(char **args, int section_type, struct proxy
 		memprintf(err, "unexpected character '%c' in argument to <%s>.", *res, args[0]);
 		return -1;
 	}
+	else if (target == &global_ssl.ticket_key_lifetime && !*target) {
+		memprintf(err, "'%s' expects a strictly positive value.", args[0]);
+		return -1;
+	}
 	return 0;
 }
 
@@ -1424,8 +1479,17 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 		goto fail;
 	}
 
+	if (conf->keys_ref && conf->keys_ref->secret) {
+		memprintf(err, "'%s' : TLS ticket keys already derived from a secret for this bind line", args[cur_arg]);
+		goto fail;
+	}
+
 	keys_ref = tlskeys_ref_lookup(args[cur_arg + 1]);
 	if (keys_ref) {
+		if (keys_ref->secret) {
+			memprintf(err, "'%s' : '%s' is already used as a TLS ticket secret file", args[cur_arg], args[cur_arg + 1]);
+			return ERR_ALERT | ERR_FATAL;
+		}
 		keys_ref->refcount++;
 		conf->keys_ref = keys_ref;
 		return 0;
@@ -1521,6 +1585,112 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 #endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
 }
 
+/* parse the "tls-ticket-secret" bind keyword */
+static int bind_parse_tls_ticket_secret(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+#if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
+	FILE *f = NULL;
+	char thisline[LINESIZE];
+	unsigned char secret[256];
+	struct tls_keys_ref *keys_ref = NULL;
+	int len;
+
+	if (!*args[cur_arg + 1]) {
+		memprintf(err, "'%s' : missing TLS ticket secret file path", args[cur_arg]);
+		goto fail;
+	}
+
+	if (conf->keys_ref) {
+		memprintf(err, "'%s' : TLS ticket keys already set for this bind line", args[cur_arg]);
+		goto fail;
+	}
+
+	keys_ref = tlskeys_ref_lookup(args[cur_arg + 1]);
+	if (keys_ref) {
+		if (!keys_ref->secret) {
+			memprintf(err, "'%s' : '%s' is already used as a TLS ticket keys file", args[cur_arg], args[cur_arg + 1]);
+			keys_ref = NULL;
+			goto fail;
+		}
+		keys_ref->refcount++;
+		conf->keys_ref = keys_ref;
+		return 0;
+	}
+
+	if ((f = fopen(args[cur_arg + 1], "r")) == NULL) {
+		memprintf(err, "'%s' : unable to load TLS ticket secret file", args[cur_arg+1]);
+		goto fail;
+	}
+
+	if (fgets(thisline, sizeof(thisline), f) == NULL) {
+		memprintf(err, "'%s' : empty TLS ticket secret file", args[cur_arg+1]);
+		goto fail;
+	}
+	fclose(f);
+	f = NULL;
+
+	len = strlen(thisline);
+	while (len && (thisline[len - 1] == '\n' || thisline[len - 1] == '\r'))
+		thisline[--len] = 0;
+
+	len = base64dec(thisline, len, (char *)secret, sizeof(secret));
+	if (len < 0) {
+		memprintf(err, "'%s' : unable to decode base64 TLS ticket secret", args[cur_arg+1]);
+		goto fail;
+	}
+	else if (len < 16) {
+		memprintf(err, "'%s' : TLS ticket secret too short (at least 16 bytes are required)", args[cur_arg+1]);
+		goto fail;
+	}
+
+	keys_ref = calloc(1, sizeof(*keys_ref));
+	if (!keys_ref) {
+		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
+		goto fail;
+	}
+
+	/* the keys are derived on first use */
+	keys_ref->tlskeys = calloc(TLS_TICKETS_NO, sizeof(union tls_sess_key));
+	keys_ref->filename = strdup(args[cur_arg + 1]);
+	keys_ref->secret = malloc(len);
+	if (!keys_ref->tlskeys || !keys_ref->filename || !keys_ref->secret) {
+		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
+		goto fail;
+	}
+
+	memcpy(keys_ref->secret, secret, len);
+	keys_ref->secret_len = len;
+	keys_ref->key_size_bits = 256;
+	keys_ref->unique_id = -1;
+	keys_ref->refcount = 1;
+	HA_RWLOCK_INIT(&keys_ref->lock);
+	conf->keys_ref = keys_ref;
+
+	LIST_INSERT(&tlskeys_reference, &keys_ref->list);
+	memset(secret, 0, sizeof(secret));
+	memset(thisline, 0, sizeof(thisline));
+
+	return 0;
+
+  fail:
+	memset(secret, 0, sizeof(secret));
+	memset(thisline, 0, sizeof(thisline));
+	if (f)
+		fclose(f);
+	if (keys_ref) {
+		free(keys_ref->filename);
+		free(keys_ref->tlskeys);
+		free(keys_ref->secret);
+		free(keys_ref);
+	}
+	return ERR_ALERT | ERR_FATAL;
+
+#else
+	memprintf(err, "'%s' : TLS ticket callback extension not supported", args[cur_arg]);
+	return ERR_ALERT | ERR_FATAL;
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
+}
+
 /* parse the "verify" bind keyword */
 static int ssl_bind_parse_verify(char **args, int cur_arg, struct proxy *px, struct ssl_bind_conf *conf, int from_cli, char **err)
 {
@@ -2346,6 +2516,37 @@ static int ssl_parse_skip_self_issued_ca(char **args, int section_type, struct p
 #endif
 }
 
+/* parse the "ssl-session-table" and "ssl-gencert-table" keywords in global
+ * section. The table is resolved once the configuration is fully parsed.
+ */
+static int ssl_parse_global_sess_table(char **args, int section_type, struct proxy *curpx,
+                                       const struct proxy *defpx, const char *file, int line,
+                                       char **err)
+{
+	char **target;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[0], "ssl-gencert-table") == 0)
+		target = &global_ssl.gencert_table_name;
+	else
+		target = &global_ssl.sess_table_name;
+
+	if (!*args[1]) {
+		memprintf(err, "global statement '%s' expects a table name.", args[0]);
+		return -1;
+	}
+
+	free(*target);
+	*target = strdup(args[1]);
+	if (!*target) {
+		memprintf(err, "global statement '%s': out of memory.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 struct cfg_crt_node {
 	int linenum;
 	char *filename;
@@ -2653,6 +2854,7 @@ static struct bind_kw_list bind_kws = { "SSL", { }, {
 	{ "strict-sni",            bind_parse_strict_sni,         0 }, /* refuse negotiation if sni doesn't match a certificate */
 	{ "tls-tickets",           bind_parse_no_tls_tickets,     0 }, /* enable session resumption tickets */
 	{ "tls-ticket-keys",       bind_parse_tls_ticket_keys,    1 }, /* set file to load TLS ticket keys from */
+	{ "tls-ticket-secret",     bind_parse_tls_ticket_secret,  1 }, /* set file to load the secret to derive TLS ticket keys from */
 	{ "verify",                bind_parse_verify,             1 }, /* set SSL verify method */
 	{ "npn",                   bind_parse_npn,                1 }, /* set NPN supported protocols */
 	{ "prefer-client-ciphers", bind_parse_pcc,                0 }, /* prefer client ciphers */
@@ -2732,6 +2934,7 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 #ifndef OPENSSL_NO_DH
 	{ CFG_GLOBAL, "ssl-dh-param-file", ssl_parse_global_dh_param_file },
 #endif
+	{ CFG_GLOBAL, "ssl-gencert-table", ssl_parse_global_sess_table },
 	{ CFG_GLOBAL, "ssl-mode-async",  ssl_parse_global_ssl_async },
 #if defined(USE_ENGINE) && !defined(OPENSSL_NO_ENGINE)
 	{ CFG_GLOBAL, "ssl-engine",  ssl_parse_global_ssl_engine },
@@ -2742,14 +2945,22 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "ssl-provider-path",  ssl_parse_global_ssl_provider_path },
 #endif
 	{ CFG_GLOBAL, "ssl-security-level", ssl_parse_security_level },
+	{ CFG_GLOBAL, "ssl-session-table", ssl_parse_global_sess_table },
 	{ CFG_GLOBAL, "ssl-skip-self-issued-ca", ssl_parse_skip_self_issued_ca },
 	{ CFG_GLOBAL, "tune.ssl.cachesize", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.default-dh-param", ssl_parse_global_default_dh },
 	{ CFG_GLOBAL, "tune.ssl.force-private-cache",  ssl_parse_global_private_cache },
+	{ CFG_GLOBAL, "tune.ssl.lazy-ctx-cache-size", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.lifetime", ssl_parse_global_lifetime },
+	{ CFG_GLOBAL, "tune.ssl.load-threads", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.maxrecord", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.offload-batch", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.offload-threads", ssl_parse_global_offload_threads },
 	{ CFG_GLOBAL, "tune.ssl.hard-maxrecord", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.srv-sess-pool-size", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.ssl-ctx-cache-size", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.ticket-key-lifetime", ssl_parse_global_lifetime },
+	{ CFG_GLOBAL, "tune.ssl.ticket-key-overlap", ssl_parse_global_lifetime },
 	{ CFG_GLOBAL, "tune.ssl.capture-cipherlist-size", ssl_parse_global_capture_buffer },
 	{ CFG_GLOBAL, "tune.ssl.capture-buffer-size", ssl_parse_global_capture_buffer },
 	{ CFG_GLOBAL, "tune.ssl.keylog", ssl_parse_global_keylog },
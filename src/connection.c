@@ -74,7 +74,8 @@ struct conn_tlv_list *conn_get_tlv(struct connection *conn, int type)
 
 /* Remove <conn> idle connection from its attached tree (idle, safe or avail)
  * for the server in the connection's target and thread <thr>. If also present
- * in the secondary server idle list, conn is removed from it.
+ * in the secondary server idle list, conn is removed from it. A connection
+ * parked in the thread group's shared pool is withdrawn from it instead.
  *
  * Must be called with idle_conns_lock held.
  */
@@ -89,7 +90,19 @@ void conn_delete_from_tree(struct connection *conn, int thr)
 	 *  - if it's in a tree and has CO_FL_IDLE_LIST, it's the idle_tree
 	 *  - if it's not in a tree and has CO_FL_SESS_IDLE, it's in the
 	 *    session's list (but we don't care here).
+	 *  - if it has CO_FL_PARKED, it's in the shared pool and not in a tree.
+	 *    A thread picking it from the pool holds the element locked and
+	 *    only unlinks it under this same lock, so the delete below cannot
+	 *    race with it.
 	 */
+	if (conn->flags & CO_FL_PARKED) {
+		LIST_DEL_INIT(&conn->idle_list);
+		MT_LIST_DELETE(&conn->toremove_list);
+		conn->flags &= ~CO_FL_PARKED;
+		srv->per_thr[thr].parked_conns--;
+		return;
+	}
+
 	if (LIST_INLIST(&conn->idle_list)) {
 		LIST_DEL_INIT(&conn->idle_list);
 		conn_tree = (conn->flags & CO_FL_SAFE_LIST) ?
@@ -97,6 +110,12 @@ void conn_delete_from_tree(struct connection *conn, int thr)
 			&srv->per_thr[thr].idle_conns;
 	} else {
 		conn_tree = &srv->per_thr[thr].avail_conns;
+		if (ceb_intree(&conn->hash_node.node)) {
+			ceb64_item_delete(conn_tree, hash_node.node, hash_node.key, conn);
+			_HA_ATOMIC_DEC(&srv->per_thr[thr].avail_nb);
+			srv_set_avail_strms(srv, conn, thr, 0);
+			return;
+		}
 	}
 
 	ceb64_item_delete(conn_tree, hash_node.node, hash_node.key, conn);
@@ -510,6 +529,7 @@ void conn_init(struct connection *conn, void *target)
 	conn->handle.fd = DEAD_FD_MAGIC;
 	conn->err_code = CO_ER_NONE;
 	conn->term_evts_log = 0;
+	conn->avail_strms = 0;
 	conn->target = target;
 	conn->destroy_cb = NULL;
 	conn->proxy_netns = NULL;
@@ -40,6 +40,7 @@
 #include <haproxy/quic_enc.h>
 #include <haproxy/quic_fctl.h>
 #include <haproxy/quic_frame.h>
+#include <haproxy/quic_tune.h>
 #include <haproxy/quic_utils.h>
 #include <haproxy/stats-t.h>
 #include <haproxy/tools.h>
@@ -124,6 +125,7 @@ INITCALL1(STG_REGISTER, trace_register_source, TRACE_SOURCE);
 #define H3_CF_UNI_QPACK_DEC_SET 0x00000008  /* Remote QPACK decoder stream opened */
 #define H3_CF_UNI_QPACK_ENC_SET 0x00000010  /* Remote QPACK encoder stream opened */
 #define H3_CF_GOAWAY_SENT       0x00000020  /* GOAWAY sent on local control stream */
+#define H3_CF_QPACK_ENC_INIT    0x00000040  /* QPACK encoder dynamic table setup already attempted */
 
 /* Default settings */
 static uint64_t h3_settings_qpack_max_table_capacity = 0;
@@ -133,6 +135,8 @@ static uint64_t h3_settings_max_field_section_size = QUIC_VARINT_8_BYTE_MAX; /*
 struct h3c {
 	struct qcc *qcc;
 	struct qcs *ctrl_strm; /* Control stream */
+	struct qcs *qenc_strm; /* QPACK encoder stream */
+	struct qpack_enc *qenc; /* QPACK encoder context, NULL if the dynamic table is unused */
 	int err;
 	uint32_t flags;
 
@@ -269,13 +273,15 @@ static ssize_t h3_init_uni_stream(struct h3c *h3c, struct qcs *qcs,
 static ssize_t h3_parse_uni_stream_no_h3(struct qcs *qcs, struct buffer *b, int fin)
 {
 	struct h3s *h3s = qcs->ctx;
+	ssize_t ret = 0;
 
 	/* Function reserved to non-HTTP/3 unidirectional streams. */
 	BUG_ON(!quic_stream_is_uni(qcs->id) || !(h3s->flags & H3_SF_UNI_NO_H3));
 
 	switch (h3s->type) {
 	case H3S_T_QPACK_DEC:
-		if (qpack_decode_dec(b, fin, qcs))
+		ret = qpack_decode_dec(b, fin, qcs, h3s->h3c->qenc);
+		if (ret < 0)
 			return -1;
 		break;
 	case H3S_T_QPACK_ENC:
@@ -288,8 +294,8 @@ static ssize_t h3_parse_uni_stream_no_h3(struct qcs *qcs, struct buffer *b, int
 		ABORT_NOW();
 	}
 
-	/* TODO adjust return code */
-	return 0;
+	/* TODO adjust return code for the encoder stream */
+	return ret;
 }
 
 /* Decode a H3 frame header from <rxbuf> buffer. The frame type is stored in
@@ -388,6 +394,21 @@ static int h3_check_frame_valid(struct h3c *h3c, struct qcs *qcs, uint64_t ftype
 			ret = H3_ERR_MISSING_SETTINGS;
 		break;
 
+	case H3_FT_PRIORITY_UPDATE_REQ:
+	case H3_FT_PRIORITY_UPDATE_PUSH:
+		/* RFC 9218 7.2. The PRIORITY_UPDATE Frame
+		 *
+		 * The PRIORITY_UPDATE frame MUST be sent on the client control
+		 * stream. Receiving a PRIORITY_UPDATE frame on a stream other
+		 * than the client control stream MUST be treated as a connection
+		 * error of type H3_FRAME_UNEXPECTED.
+		 */
+		if (h3s->type != H3S_T_CTRL || conn_is_back(qcs->qcc->conn))
+			ret = H3_ERR_FRAME_UNEXPECTED;
+		else if (!(h3c->flags & H3_CF_SETTINGS_RECV))
+			ret = H3_ERR_MISSING_SETTINGS;
+		break;
+
 	case H3_FT_SETTINGS:
 		/* RFC 9114 7.2.4. SETTINGS
 		 *
@@ -615,6 +636,7 @@ static ssize_t h3_req_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 	int hdr_idx, ret;
 	int cookie = -1, last_cookie = -1, i;
 	int relaxed = !!(h3c->qcc->proxy->options2 & PR_O2_REQBUG_OK);
+	uint8_t urgency = HTTP_PRIO_URG_DFLT, incremental = 0;
 	int qpack_err;
 
 	/* RFC 9114 4.1.2. Malformed Requests and Responses
@@ -1007,6 +1029,10 @@ static ssize_t h3_req_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 			len = -1;
 			goto out;
 		}
+		else if (isteq(list[hdr_idx].n, ist("priority"))) {
+			/* RFC 9218 5. the client may indicate the response's priority */
+			http_parse_priority(list[hdr_idx].v, &urgency, &incremental);
+		}
 
 		if (!htx_add_header(htx, list[hdr_idx].n, _h3_trim_header(list[hdr_idx].v))) {
 			len = -1;
@@ -1054,6 +1080,8 @@ static ssize_t h3_req_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 	htx_to_buf(htx, &htx_buf);
 	htx = NULL;
 
+	qcs_set_prio(qcs, urgency, incremental);
+
 	if (qcs_attach_sc(qcs, &htx_buf, fin)) {
 		len = -1;
 		goto out;
@@ -1587,6 +1615,70 @@ static ssize_t h3_data_to_htx(struct qcs *qcs, const struct buffer *buf,
 	return -1;
 }
 
+/* Parse a PRIORITY_UPDATE frame of type <ftype> and length <len> from <buf>
+ * received on control stream <qcs>, and apply the new priority to the
+ * designated request stream. Streams which are not opened yet or already
+ * closed are ignored.
+ *
+ * Returns the frame length on success else a negative error code, with
+ * h3c.err set.
+ */
+static ssize_t h3_parse_priority_update_frm(struct qcs *qcs, const struct buffer *buf,
+                                            size_t len, uint64_t ftype)
+{
+	struct h3c *h3c = qcs->qcc->ctx;
+	uint8_t urgency = HTTP_PRIO_URG_DFLT;
+	uint8_t incremental = 0;
+	struct buffer b;
+	struct ist value;
+	uint64_t id;
+	size_t ret = 0;
+
+	TRACE_ENTER(H3_EV_RX_FRAME, qcs->qcc->conn, qcs);
+
+	/* Work on a copy of <buf>. */
+	b = b_make(b_orig(buf), b_size(buf), b_head_ofs(buf), len);
+	if (!b_quic_dec_int(&id, &b, &ret)) {
+		h3c->err = H3_ERR_FRAME_ERROR;
+		qcc_report_glitch(h3c->qcc, 1);
+		TRACE_DEVEL("leaving on error", H3_EV_RX_FRAME, qcs->qcc->conn, qcs);
+		return -1;
+	}
+
+	/* RFC 9218 7.2. The PRIORITY_UPDATE Frame
+	 *
+	 * When the PRIORITY_UPDATE frame applies to a request stream, clients
+	 * SHOULD provide a prioritized element ID that refers to a stream in
+	 * the "open", "half-closed (local)", or "idle" state [...] If a server
+	 * receives a PRIORITY_UPDATE frame whose Prioritized Element ID is not
+	 * a client-initiated bidirectional stream, it MUST be treated as a
+	 * connection error of type H3_ID_ERROR.
+	 *
+	 * As no push ID is ever granted, push updates are invalid as well.
+	 */
+	if (ftype == H3_FT_PRIORITY_UPDATE_PUSH || qcs_id_type(id) != QCS_CLT_BIDI) {
+		h3c->err = H3_ERR_ID_ERROR;
+		qcc_report_glitch(h3c->qcc, 1);
+		TRACE_DEVEL("leaving on error", H3_EV_RX_FRAME, qcs->qcc->conn, qcs);
+		return -1;
+	}
+
+	/* the field value may wrap at the end of the buffer */
+	value = ist2(b_head(&b), b_data(&b));
+	if (b_contig_data(&b, 0) < b_data(&b)) {
+		struct buffer *tmp = get_trash_chunk();
+
+		b_getblk(&b, tmp->area, b_data(&b), 0);
+		value = ist2(tmp->area, b_data(&b));
+	}
+
+	http_parse_priority(value, &urgency, &incremental);
+	qcc_set_stream_prio(qcs->qcc, id, urgency, incremental);
+
+	TRACE_LEAVE(H3_EV_RX_FRAME, qcs->qcc->conn, qcs);
+	return len;
+}
+
 /* Parse a SETTINGS frame of length <len> of payload <buf>.
  *
  * Returns the number of consumed bytes or a negative error code.
@@ -1840,6 +1932,15 @@ static ssize_t h3_rcv_buf(struct qcs *qcs, struct buffer *b, int fin)
 			/* Not supported */
 			ret = flen;
 			break;
+		case H3_FT_PRIORITY_UPDATE_REQ:
+		case H3_FT_PRIORITY_UPDATE_PUSH:
+			ret = h3_parse_priority_update_frm(qcs, b, flen, ftype);
+			if (ret < 0) {
+				TRACE_ERROR("error on PRIORITY_UPDATE parsing", H3_EV_RX_FRAME, qcs->qcc->conn, qcs);
+				qcc_set_error(qcs->qcc, h3c->err, 1);
+				goto err;
+			}
+			break;
 		case H3_FT_SETTINGS:
 			ret = h3_parse_settings_frm(qcs->qcc->ctx, b, flen);
 			if (ret < 0) {
@@ -1973,14 +2074,132 @@ static int h3_control_send(struct qcs *qcs, void *ctx)
 	return -1;
 }
 
-/* Encode header field name <n> value <v> into <buf> buffer using QPACK. Strip
- * any leading/trailing WS in value prior to encoding.
+/* Set up the QPACK encoder dynamic table for <h3c> if enabled and accepted by
+ * the peer: the encoder stream is opened and announces the table capacity.
+ * This is only attempted once, after the peer's SETTINGS were received. On
+ * failure headers are simply encoded without the dynamic table.
+ */
+static void h3_qpack_enc_init(struct h3c *h3c)
+{
+	struct qcc *qcc = h3c->qcc;
+	struct qpack_enc *qenc;
+	struct buffer *res;
+	struct qcs *qcs;
+	uint32_t capacity;
+	size_t data;
+	int err;
+
+	if ((h3c->flags & H3_CF_QPACK_ENC_INIT) || !(h3c->flags & H3_CF_SETTINGS_RECV))
+		return;
+
+	h3c->flags |= H3_CF_QPACK_ENC_INIT;
+
+	capacity = MIN(quic_tune.qpack_enc_tbl_size, h3c->qpack_max_table_capacity);
+	if (capacity < 32 || !qcc_fctl_avail_streams(qcc, 0))
+		return;
+
+	qenc = qpack_enc_alloc(capacity, h3c->qpack_max_table_capacity,
+	                       MIN(quic_tune.qpack_enc_blocked_streams, h3c->qpack_blocked_streams));
+	if (!qenc) {
+		TRACE_ERROR("cannot allocate QPACK encoder", H3_EV_H3C_NEW, qcc->conn);
+		return;
+	}
+
+	qcs = qcc_init_stream_local(qcc, 0);
+	if (!qcs) {
+		TRACE_ERROR("cannot init QPACK encoder stream", H3_EV_H3C_NEW, qcc->conn);
+		qpack_enc_free(qenc);
+		return;
+	}
+
+	qcs_send_metadata(qcs);
+
+	res = qcc_get_stream_txbuf(qcs, &err, 0);
+	if (!res) {
+		TRACE_ERROR("cannot allocate Tx buffer", H3_EV_H3C_NEW, qcc->conn, qcs);
+		goto err;
+	}
+
+	data = b_data(res);
+	if (!b_quic_enc_int(res, H3_UNI_S_T_QPACK_ENC, 0) ||
+	    qpack_enc_encode_sdtc(qenc, res)) {
+		res->data = data;
+		goto err;
+	}
+
+	qcc_send_stream(qcs, 1, b_data(res) - data);
+	h3c->qenc_strm = qcs;
+	h3c->qenc = qenc;
+	return;
+
+ err:
+	/* the stream was opened but its type could not be sent: reset it,
+	 * which the peer must tolerate (RFC9114 6.2).
+	 */
+	qcc_reset_stream(qcs, H3_ERR_INTERNAL_ERROR);
+	qpack_enc_free(qenc);
+}
+
+/* Returns the Tx buffer of the QPACK encoder stream of <h3c> into which
+ * encoder instructions may be emitted, or NULL if none is available.
+ */
+static struct buffer *h3_qpack_enc_txbuf(struct h3c *h3c)
+{
+	struct qcs *qcs = h3c->qenc_strm;
+	struct buffer *res;
+	int err;
+
+	if (qfctl_sblocked(&qcs->tx.fc) || qfctl_sblocked(&h3c->qcc->tx.fc))
+		return NULL;
+
+	res = qcc_get_stream_txbuf(qcs, &err, 0);
+	if (res && !b_room(res) && !qcc_release_stream_txbuf(qcs))
+		res = qcc_get_stream_txbuf(qcs, &err, 0);
+	return res;
+}
+
+/* Starts the encoding of a field section for <qcs> into <buf>, using the
+ * QPACK encoder dynamic table if enabled.
  *
  * Returns 0 on success else non zero.
  */
-static int h3_encode_header(struct buffer *buf,
+static int h3_encode_field_section_line(struct qcs *qcs, struct buffer *buf)
+{
+	struct h3c *h3c = qcs->qcc->ctx;
+
+	if (unlikely(quic_tune.qpack_enc_tbl_size) && !h3c->qenc)
+		h3_qpack_enc_init(h3c);
+
+	if (h3c->qenc)
+		return qpack_enc_field_section_begin(h3c->qenc, buf, qcs->id);
+
+	return qpack_encode_field_section_line(buf);
+}
+
+/* Terminates the field section for <qcs> encoded into <buf>. This must be
+ * called once all of its fields were encoded.
+ */
+static void h3_encode_field_section_end(struct qcs *qcs, struct buffer *buf)
+{
+	struct h3c *h3c = qcs->qcc->ctx;
+
+	if (h3c->qenc)
+		qpack_enc_field_section_end(h3c->qenc, buf);
+}
+
+/* Encode header field name <n> value <v> for <qcs> into <buf> buffer using
+ * QPACK. Strip any leading/trailing WS in value prior to encoding.
+ *
+ * Returns 0 on success else non zero.
+ */
+static int h3_encode_header(struct qcs *qcs, struct buffer *buf,
                             const struct ist n, const struct ist v)
 {
+	struct h3c *h3c = qcs->qcc->ctx;
+	struct buffer *ins;
+	size_t data;
+	int ret;
+
 	struct ist v_strip;
 	char *ptr;
 
@@ -1993,7 +2212,18 @@ static int h3_encode_header(struct buffer *buf,
 			break;
 	}
 
-	return qpack_encode_header(buf, n, v_strip);
+	if (!h3c->qenc)
+		return qpack_encode_header(buf, n, v_strip);
+
+	/* encoder instructions are sent as soon as emitted, even if the field
+	 * section has to be encoded again, as the table was updated.
+	 */
+	ins = h3_qpack_enc_txbuf(h3c);
+	data = ins ? b_data(ins) : 0;
+	ret = qpack_enc_encode_header(h3c->qenc, buf, ins, n, v_strip);
+	if (ins && b_data(ins) > data)
+		qcc_send_stream(h3c->qenc_strm, 1, b_data(ins) - data);
+	return ret;
 }
 
 /* Convert a HTX start-line and associated headers stored in <htx> into a
@@ -2081,7 +2311,7 @@ static int h3_req_headers_send(struct qcs *qcs, struct htx *htx)
 
 	TRACE_DATA("encoding HEADERS frame", H3_EV_TX_FRAME|H3_EV_TX_HDR,
 	           qcs->qcc->conn, qcs);
-	if (qpack_encode_field_section_line(&headers_buf))
+	if (h3_encode_field_section_line(qcs, &headers_buf))
 		goto err_full;
 
 	if (qpack_encode_method(&headers_buf, sl->info.req.meth, meth))
@@ -2168,10 +2398,12 @@ static int h3_req_headers_send(struct qcs *qcs, struct htx *htx)
 		if (istlen(auth) && isteq(list[hdr].n, ist("host")))
 			continue;
 
-		if (h3_encode_header(&headers_buf, list[hdr].n, list[hdr].v))
+		if (h3_encode_header(qcs, &headers_buf, list[hdr].n, list[hdr].v))
 			goto err_full;
 	}
 
+	h3_encode_field_section_end(qcs, &headers_buf);
+
 	/* Now that all headers are encoded, we are certain that res buffer is
 	 * big enough
 	 */
@@ -2312,7 +2544,7 @@ static int h3_resp_headers_send(struct qcs *qcs, struct htx *htx)
 
 	TRACE_DATA("encoding HEADERS frame", H3_EV_TX_FRAME|H3_EV_TX_HDR,
 	           qcs->qcc->conn, qcs);
-	if (qpack_encode_field_section_line(&headers_buf))
+	if (h3_encode_field_section_line(qcs, &headers_buf))
 		goto err_full;
 	if (qpack_encode_int_status(&headers_buf, status)) {
 		TRACE_ERROR("error during status code encoding", H3_EV_TX_FRAME|H3_EV_TX_HDR, qcs->qcc->conn, qcs);
@@ -2356,10 +2588,12 @@ static int h3_resp_headers_send(struct qcs *qcs, struct htx *htx)
 			list[hdr].v = ist("trailers");
 		}
 
-		if (h3_encode_header(&headers_buf, list[hdr].n, list[hdr].v))
+		if (h3_encode_header(qcs, &headers_buf, list[hdr].n, list[hdr].v))
 			goto err_full;
 	}
 
+	h3_encode_field_section_end(qcs, &headers_buf);
+
 	/* Now that all headers are encoded, we are certain that res buffer is
 	 * big enough
 	 */
@@ -2524,7 +2758,7 @@ static int h3_resp_trailers_send(struct qcs *qcs, struct htx *htx)
 	/* Start the headers after frame type + length */
 	headers_buf = b_make(b_peek(res, b_data(res) + 9), b_contig_space(res) - 9, 0, 0);
 
-	if (qpack_encode_field_section_line(&headers_buf)) {
+	if (h3_encode_field_section_line(qcs, &headers_buf)) {
 		TRACE_STATE("not enough room for trailers section line", H3_EV_TX_FRAME|H3_EV_TX_HDR, qcs->qcc->conn, qcs);
 		if (qcc_release_stream_txbuf(qcs))
 			goto end;
@@ -2550,7 +2784,7 @@ static int h3_resp_trailers_send(struct qcs *qcs, struct htx *htx)
 			continue;
 		}
 
-		if (h3_encode_header(&headers_buf, list[hdr].n, list[hdr].v)) {
+		if (h3_encode_header(qcs, &headers_buf, list[hdr].n, list[hdr].v)) {
 			TRACE_STATE("not enough room for all trailers", H3_EV_TX_FRAME|H3_EV_TX_HDR, qcs->qcc->conn, qcs);
 			if (qcc_release_stream_txbuf(qcs))
 				goto end;
@@ -2568,6 +2802,8 @@ static int h3_resp_trailers_send(struct qcs *qcs, struct htx *htx)
 		TRACE_DATA("skipping trailer", H3_EV_TX_FRAME|H3_EV_TX_HDR, qcs->qcc->conn, qcs);
 	}
 	else {
+		h3_encode_field_section_end(qcs, &headers_buf);
+
 		/* Now that all headers are encoded, we are certain that res
 		 * buffer is big enough.
 		 */
@@ -3136,6 +3372,10 @@ static int h3_init(struct qcc *qcc)
 
 	h3c->qcc = qcc;
 	h3c->ctrl_strm = NULL;
+	h3c->qenc_strm = NULL;
+	h3c->qenc = NULL;
+	h3c->qpack_max_table_capacity = 0;
+	h3c->qpack_blocked_streams = 0;
 	h3c->err = 0;
 	h3c->flags = 0;
 	h3c->id_goaway = 0;
@@ -3255,6 +3495,8 @@ static void h3_shutdown(void *ctx)
 static void h3_release(void *ctx)
 {
 	struct h3c *h3c = ctx;
+
+	qpack_enc_free(h3c->qenc);
 	pool_free(pool_head_h3c, h3c);
 }
 
@@ -3282,6 +3524,8 @@ static inline const char *h3_ft_str(uint64_t type)
 	case H3_FT_MAX_PUSH_ID:  return "MAX_PUSH_ID";
 	case H3_FT_CANCEL_PUSH:  return "CANCEL_PUSH";
 	case H3_FT_GOAWAY:       return "GOAWAY";
+	case H3_FT_PRIORITY_UPDATE_REQ:  return "PRIORITY_UPDATE";
+	case H3_FT_PRIORITY_UPDATE_PUSH: return "PRIORITY_UPDATE_PUSH";
 	default:                 return "_UNKNOWN_";
 	}
 }
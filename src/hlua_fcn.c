@@ -872,6 +872,13 @@ static void hlua_stktable_entry(lua_State *L, struct stktable *t, struct stksess
 			lua_pushstring(L, de ? (char *)de->value.key : "-");
 			break;
 		}
+		case STD_T_BLOB: {
+			struct stktable_blob *blob;
+
+			blob = stktable_data_cast(ptr, std_t_blob);
+			lua_pushinteger(L, blob ? blob->len : 0);
+			break;
+		}
 		}
 
 		lua_settable(L, -3);
@@ -32,7 +32,27 @@
 
 #include <import/ist.h>
 #include <haproxy/hpack-enc.h>
+#include <haproxy/hpack-huff.h>
+#include <haproxy/hpack-tbl.h>
 #include <haproxy/http-hdr-t.h>
+#include <haproxy/pool.h>
+#include <haproxy/thread.h>
+#include <haproxy/xxhash.h>
+
+/* pool of encoder contexts, only created when the encoder table is enabled */
+struct pool_head *pool_head_hpack_enc __read_mostly = NULL;
+
+/* per-thread copy of the encoder context being modified, used to roll back
+ * changes made to the table when a header block is aborted.
+ */
+static THREAD_LOCAL struct hpack_enc *hpack_enc_bkp = NULL;
+
+/* indexing policy for a header field */
+enum hpack_enc_pol {
+	HPACK_ENC_POL_INDEX = 0,  /* literal with incremental indexing */
+	HPACK_ENC_POL_NOIDX,      /* literal without indexing */
+	HPACK_ENC_POL_NEVER,      /* literal never indexed, never looked up */
+};
 
 /*
  * HPACK encoding: these tables were generated using gen-enc.c
@@ -138,6 +158,321 @@ const signed short hpack_pos_len[32] = {
          /*   24: */   -1,  609,   -1,  636,   -1,   -1,   -1,   -1,
 };
 
+/* Returns the index of header field name <n> in the static table, or 0 if not
+ * found.
+ */
+static inline int hpack_lookup_static_name(const struct ist n)
+{
+	int pos;
+
+	if (n.len >= sizeof(hpack_pos_len) / sizeof(hpack_pos_len[0]))
+		return 0;
+
+	pos = hpack_pos_len[n.len];
+	if (pos < 0)
+		return 0;
+
+	/* At least one header field of this length exist */
+	do {
+		char idx;
+
+		pos++;
+		idx = hpack_enc_stream[pos++];
+		pos += n.len;
+		if (isteq(ist2(&hpack_enc_stream[pos - n.len], n.len), n))
+			return idx;
+	} while ((unsigned char)hpack_enc_stream[pos] == n.len);
+
+	return 0;
+}
+
+/* Returns the number of bytes needed to encode integer <v> on a prefix of
+ * <bits> bits (RFC7541#5.1).
+ */
+static inline int hpack_int_len(uint32_t v, int bits)
+{
+	uint32_t max = (1U << bits) - 1;
+	int len = 1;
+
+	if (v < max)
+		return len;
+
+	for (v -= max; v >= 128; v >>= 7)
+		len++;
+	return len + 1;
+}
+
+/* Encodes integer <v> on a prefix of <bits> bits at <out>+<pos>, with the
+ * upper bits of the first byte set to <code>, and returns the new position.
+ * The caller is responsible for checking for available room using
+ * hpack_int_len() first.
+ */
+static inline int hpack_encode_int(char *out, int pos, uint8_t code, int bits, uint32_t v)
+{
+	uint32_t max = (1U << bits) - 1;
+
+	if (v < max) {
+		out[pos++] = code | v;
+		return pos;
+	}
+
+	out[pos++] = code | max;
+	for (v -= max; v >= 128; v >>= 7)
+		out[pos++] = v | 128;
+	out[pos++] = v;
+	return pos;
+}
+
+/* Encodes string literal <str> at <out>+<pos> without exceeding <size>, using
+ * huffman encoding if enabled in <enc> and shorter. Returns the new position,
+ * or a negative value if there is not enough room.
+ */
+static inline int hpack_enc_str(const struct hpack_enc *enc, char *out, int pos, int size, const struct ist str)
+{
+	int hlen = str.len;
+
+	if (enc->flags & HPACK_ENC_F_HUFF)
+		hlen = huff_enc_len(str.ptr, str.len);
+
+	if (hlen < str.len) {
+		if (pos + hpack_int_len(hlen, 7) + hlen > size)
+			return -1;
+		pos = hpack_encode_int(out, pos, 0x80, 7, hlen);
+		pos += huff_enc(str.ptr, str.len, out + pos);
+	}
+	else {
+		if (pos + hpack_int_len(str.len, 7) + str.len > size)
+			return -1;
+		pos = hpack_encode_int(out, pos, 0x00, 7, str.len);
+		memcpy(out + pos, str.ptr, str.len);
+		pos += str.len;
+	}
+	return pos;
+}
+
+/* Returns the indexing policy for header field <n>:<v> with encoder context
+ * <enc>. Fields carrying credentials are never indexed (RFC7541#7.1.3), those
+ * whose value is almost always different are not indexed so as not to evict
+ * useful entries, and neither are those too large to leave room for at least
+ * one other entry of the same size.
+ */
+static inline enum hpack_enc_pol hpack_enc_policy(const struct hpack_enc *enc, const struct ist n, const struct ist v)
+{
+	if (isteq(n, ist("authorization")) ||
+	    isteq(n, ist("proxy-authorization")) ||
+	    isteq(n, ist("cookie")) ||
+	    isteq(n, ist("set-cookie")))
+		return HPACK_ENC_POL_NEVER;
+
+	if (2 * (n.len + v.len + 32) > enc->dht.size)
+		return HPACK_ENC_POL_NOIDX;
+
+	if (isteq(n, ist("content-length")) ||
+	    isteq(n, ist("date")) ||
+	    isteq(n, ist("age")) ||
+	    isteq(n, ist("etag")) ||
+	    isteq(n, ist("expires")) ||
+	    isteq(n, ist("last-modified")) ||
+	    isteq(n, ist("location")) ||
+	    isteq(n, ist("if-modified-since")) ||
+	    isteq(n, ist("if-none-match")) ||
+	    isteq(n, ist("content-range")))
+		return HPACK_ENC_POL_NOIDX;
+
+	return HPACK_ENC_POL_INDEX;
+}
+
+/* Checks that reference <ref> (insertion number + 1) found in one of the
+ * indexes of <enc> still designates an entry of the dynamic table whose name
+ * is <n> and, if <v> is not NULL, whose value is <v>. Returns the entry's
+ * index in the HPACK address space if so, otherwise 0.
+ */
+static inline uint32_t hpack_enc_lookup(const struct hpack_enc *enc, uint32_t ref,
+                                        const struct ist n, const struct ist *v)
+{
+	const struct hpack_dte *dte;
+	uint32_t didx;
+
+	if (!ref)
+		return 0;
+
+	didx = enc->ins_cnt - (ref - 1);
+	if (didx > enc->dht.used)
+		return 0;
+
+	dte = hpack_get_dte(&enc->dht, didx);
+	if (!dte || !isteq(hpack_get_name(&enc->dht, dte), n))
+		return 0;
+
+	if (v && !isteq(hpack_get_value(&enc->dht, dte), *v))
+		return 0;
+
+	return HPACK_SHT_SIZE - 1 + didx;
+}
+
+/* Saves a copy of encoder context <enc> before its first modification in the
+ * current header block. Returns non-zero on success or if a copy was already
+ * made, otherwise zero, in which case the table must not be modified.
+ */
+static inline int hpack_enc_save(struct hpack_enc *enc)
+{
+	if (enc->flags & HPACK_ENC_F_SAVED)
+		return 1;
+
+	if (!hpack_enc_bkp) {
+		hpack_enc_bkp = pool_alloc(pool_head_hpack_enc);
+		if (!hpack_enc_bkp)
+			return 0;
+	}
+
+	memcpy(hpack_enc_bkp, enc, offsetof(struct hpack_enc, dht) + enc->alloc);
+	enc->flags |= HPACK_ENC_F_SAVED;
+	return 1;
+}
+
+/* Aborts the current header block for encoder context <enc>, which may be
+ * NULL: all modifications made to the table since hpack_enc_begin() are
+ * rolled back. It must be called when a header block that was being encoded
+ * will not be sent, including when it's going to be encoded again.
+ */
+void hpack_enc_abort(struct hpack_enc *enc)
+{
+	if (enc && (enc->flags & HPACK_ENC_F_SAVED))
+		memcpy(enc, hpack_enc_bkp, offsetof(struct hpack_enc, dht) + enc->alloc);
+}
+
+/* Allocates an encoder context whose table may grow up to the size of the
+ * pool's objects. The table size starts at <max_size> (or less), which must
+ * be the peer decoder's initial table size. Strings are huffman-encoded when
+ * shorter if <huff> is non-zero. Returns NULL on allocation failure.
+ */
+struct hpack_enc *hpack_enc_alloc(uint32_t max_size, int huff)
+{
+	struct hpack_enc *enc;
+
+	if (unlikely(!pool_head_hpack_enc))
+		return NULL;
+
+	enc = pool_alloc(pool_head_hpack_enc);
+	if (!enc)
+		return NULL;
+
+	enc->alloc = pool_head_hpack_enc->size - offsetof(struct hpack_enc, dht);
+	enc->max_size = max_size;
+	enc->ins_cnt = 0;
+	enc->flags = huff ? HPACK_ENC_F_HUFF : 0;
+	memset(enc->fv_idx, 0, sizeof(enc->fv_idx));
+	memset(enc->n_idx, 0, sizeof(enc->n_idx));
+	hpack_dht_init(&enc->dht, MIN(max_size, enc->alloc));
+	return enc;
+}
+
+/* Emits into the chunk <out> the dynamic table size updates needed to apply
+ * the maximum size last set by hpack_enc_set_max_size(). This must be done at
+ * the beginning of a header block. The table is flushed with an update to
+ * size zero, then set to the new size, bounded by the allocated size. Since
+ * the result does not depend on the previous state, this doesn't need to be
+ * rolled back if the block is aborted. Returns non-zero on success, 0 on
+ * failure (buffer full).
+ */
+int hpack_enc_encode_dtsu(struct hpack_enc *enc, struct buffer *out)
+{
+	uint32_t size = MIN(enc->max_size, enc->alloc);
+	int len = out->data;
+
+	if (len + 1 + hpack_int_len(size, 5) > out->size)
+		return 0;
+
+	/* [ 0 | 0 | 1 | Max size (5+) ] */
+	out->area[len++] = 0x20;
+	len = hpack_encode_int(out->area, len, 0x20, 5, size);
+	out->data = len;
+
+	hpack_dht_init(&enc->dht, size);
+	return 1;
+}
+
+/* Tries to encode header whose name is <n> and value <v> into the chunk <out>
+ * using encoder context <enc>. Fields present in the dynamic table are sent
+ * as indexed fields, others are sent as literals, reusing a static or dynamic
+ * name index when possible, and are inserted into the table depending on the
+ * indexing policy. Returns non-zero on success, 0 on failure (buffer full).
+ * In case of failure the table may have been modified, so the whole header
+ * block must be aborted using hpack_enc_abort().
+ */
+int hpack_enc_encode_header(struct hpack_enc *enc, struct buffer *out,
+			    const struct ist n, const struct ist v)
+{
+	enum hpack_enc_pol pol;
+	int len = out->data;
+	int size = out->size;
+	uint32_t hn, hnv;
+	uint32_t idx;
+
+	pol = hpack_enc_policy(enc, n, v);
+	hn  = XXH32(n.ptr, n.len, 0);
+	hnv = XXH32(v.ptr, v.len, hn);
+
+	if (pol != HPACK_ENC_POL_NEVER) {
+		/* indexed header field (7541#6.1) : [ 1 | Index (7+) ] */
+		idx = hpack_enc_lookup(enc, enc->fv_idx[hnv & (HPACK_ENC_IDX_SLOTS - 1)], n, &v);
+		if (idx) {
+			if (len + hpack_int_len(idx, 7) > size)
+				return 0;
+			out->data = hpack_encode_int(out->area, len, 0x80, 7, idx);
+			return 1;
+		}
+	}
+
+	idx = hpack_lookup_static_name(n);
+	if (!idx)
+		idx = hpack_enc_lookup(enc, enc->n_idx[hn & (HPACK_ENC_IDX_SLOTS - 1)], n, NULL);
+
+	if (pol == HPACK_ENC_POL_INDEX && !hpack_enc_save(enc))
+		pol = HPACK_ENC_POL_NOIDX;
+
+	if (pol == HPACK_ENC_POL_INDEX) {
+		/* literal with incremental indexing (7541#6.2.1) :
+		 * [ 0 | 1 | Index (6+) ]
+		 */
+		if (len + hpack_int_len(idx, 6) > size)
+			return 0;
+		len = hpack_encode_int(out->area, len, 0x40, 6, idx);
+	}
+	else {
+		/* literal without indexing / never indexed (7541#6.2.2/6.2.3) :
+		 * [ 0 | 0 | 0 | N | Index (4+) ]
+		 */
+		if (len + hpack_int_len(idx, 4) > size)
+			return 0;
+		len = hpack_encode_int(out->area, len, (pol == HPACK_ENC_POL_NEVER) ? 0x10 : 0x00, 4, idx);
+	}
+
+	if (!idx) {
+		len = hpack_enc_str(enc, out->area, len, size, n);
+		if (len < 0)
+			return 0;
+	}
+
+	len = hpack_enc_str(enc, out->area, len, size, v);
+	if (len < 0)
+		return 0;
+
+	if (pol == HPACK_ENC_POL_INDEX) {
+		/* the policy guarantees that the entry fits in the table, older
+		 * ones are evicted exactly as the peer's decoder will do.
+		 */
+		if (hpack_dht_insert(&enc->dht, n, v) < 0)
+			return 0;
+		enc->ins_cnt++;
+		enc->fv_idx[hnv & (HPACK_ENC_IDX_SLOTS - 1)] = enc->ins_cnt;
+		enc->n_idx[hn & (HPACK_ENC_IDX_SLOTS - 1)] = enc->ins_cnt;
+	}
+
+	out->data = len;
+	return 1;
+}
+
 /* Tries to encode header whose name is <n> and value <v> into the chunk <out>.
  * Returns non-zero on success, 0 on failure (buffer full).
  */
@@ -146,35 +481,21 @@ int hpack_encode_header(struct buffer *out, const struct ist n,
 {
 	int len = out->data;
 	int size = out->size;
-	int pos;
+	int idx;
 
 	if (len >= size)
 		return 0;
 
 	/* look for the header field <n> in the static table */
-	if (n.len >= sizeof(hpack_pos_len) / sizeof(hpack_pos_len[0]))
-		goto make_literal;
-
-	pos = hpack_pos_len[n.len];
-	if (pos >= 0) {
-		/* At least one header field of this length exist */
-		do {
-			char idx;
-
-			pos++;
-			idx = hpack_enc_stream[pos++];
-			pos += n.len;
-			if (isteq(ist2(&hpack_enc_stream[pos - n.len], n.len), n)) {
-				/* emit literal with indexing (7541#6.2.1) :
-				 * [ 0 | 1 | Index (6+) ]
-				 */
-				out->area[len++] = idx | 0x40;
-				goto emit_value;
-			}
-		} while ((unsigned char)hpack_enc_stream[pos] == n.len);
+	idx = hpack_lookup_static_name(n);
+	if (idx) {
+		/* emit literal with indexing (7541#6.2.1) :
+		 * [ 0 | 1 | Index (6+) ]
+		 */
+		out->area[len++] = idx | 0x40;
+		goto emit_value;
 	}
 
- make_literal:
 	if (likely(n.len < 127 && len + 2 + n.len <= size)) {
 		out->area[len++] = 0x00;      /* literal without indexing -- new name */
 		out->area[len++] = n.len;     /* single-byte length encoding */
@@ -208,3 +529,12 @@ int hpack_encode_header(struct buffer *out, const struct ist n,
 	out->data = len;
 	return 1;
 }
+
+/* releases the thread's copy of the encoder context */
+static void hpack_enc_free_bkp(void)
+{
+	pool_free(pool_head_hpack_enc, hpack_enc_bkp);
+	hpack_enc_bkp = NULL;
+}
+
+REGISTER_PER_THREAD_FREE(hpack_enc_free_bkp);
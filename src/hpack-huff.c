@@ -701,25 +701,45 @@ uint8_t rht_bit15_11_11_4[192] = {
 	/* Note, for [0xff], l==30 and bits 2..3 give 00:0x0a, 01:0x0d, 10:0x16, 11:EOS */
 };
 
-/* huffman-encode string <s> into the huff_tmp buffer and returns the amount
- * of output bytes. The caller must ensure the output is large enough (ie at
- * least 4 times as long as s).
- *
- * FIXME: bits are only counted for now, no code is emitted!
+/* returns the number of bytes needed to huffman-encode the <len> bytes of
+ * string <s>, including the final padding.
+ */
+int huff_enc_len(const char *s, int len)
+{
+	unsigned int bits = 0;
+
+	while (len-- > 0)
+		bits += ht[(uint8_t)*s++].b;
+	return (bits + 7) / 8;
+}
+
+/* huffman-encode the <len> bytes of string <s> into <out> and returns the
+ * amount of output bytes. The caller must ensure the output is large enough
+ * (i.e. at least huff_enc_len(s, len) bytes). The last byte is padded with
+ * the most significant bits of the EOS code as mandated by RFC7541#5.2.
  */
-int huff_enc(const char *s, char *out)
+int huff_enc(const char *s, int len, char *out)
 {
+	char *out_start = out;
+	uint64_t code = 0;
 	int bits = 0;
 
-	while (*s) {
-		bits += ht[(uint8_t)*s].b;
-		s++;
+	while (len-- > 0) {
+		const struct huff *h = &ht[(uint8_t)*s++];
+
+		/* at most 7 pending bits plus 30 new ones */
+		code = (code << h->b) | h->c;
+		bits += h->b;
+		while (bits >= 8) {
+			bits -= 8;
+			*out++ = code >> bits;
+		}
 	}
-	bits += 7;
 
-	/*  FIXME: huffman code is not emitted yet. */
-	//memset(out, 'H', bits / 8);
-	return bits / 8;
+	if (bits)
+		*out++ = (code << (8 - bits)) | (0xff >> bits);
+
+	return out - out_start;
 }
 
 /* pass a huffman string, it will decode it and return the new output size or
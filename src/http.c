@@ -1436,6 +1436,87 @@ int http_parse_status_val(const struct ist value, struct ist *status, struct ist
 }
 
 
+/* Skips an RFC8941 sf-string starting at <p> (which must point to the opening
+ * double quote) and returns a pointer past the closing one, or <end>.
+ */
+static inline const char *http_skip_sf_string(const char *p, const char *end)
+{
+	for (p++; p < end && *p != '"'; p++) {
+		if (*p == '\\' && p + 1 < end)
+			p++;
+	}
+	return p < end ? p + 1 : end;
+}
+
+/* Parses <value>, the value of an RFC9218 "priority" header field or of a
+ * PRIORITY_UPDATE frame, which is an RFC8941 dictionary. <urgency> and
+ * <incremental> are only updated for the "u" and "i" members which are present
+ * and valid, so the caller must preset them (to HTTP_PRIO_URG_DFLT and 0, or
+ * to the previously known values). As mandated by RFC9218#4, unknown members,
+ * parameters and invalid values are ignored, and the last occurrence of a
+ * member wins, which permits to call this function on each occurrence of a
+ * repeated header field.
+ */
+void http_parse_priority(const struct ist value, uint8_t *urgency, uint8_t *incremental)
+{
+	const char *p = istptr(value);
+	const char *end = istend(value);
+	const char *key, *val, *val_end;
+	size_t key_len;
+	uint u;
+
+	while (p < end) {
+		/* skip list delimiters and optional white spaces */
+		while (p < end && (*p == ',' || HTTP_IS_SPHT(*p)))
+			p++;
+
+		key = p;
+		while (p < end && *p != '=' && *p != ',' && *p != ';' && !HTTP_IS_SPHT(*p))
+			p++;
+		key_len = p - key;
+
+		val = val_end = NULL;
+		if (p < end && *p == '=') {
+			val = ++p;
+			if (p < end && *p == '"')
+				p = http_skip_sf_string(p, end);
+			else {
+				while (p < end && *p != ',' && *p != ';' && !HTTP_IS_SPHT(*p))
+					p++;
+			}
+			val_end = p;
+		}
+
+		/* ignore parameters and anything else up to the next member */
+		while (p < end && *p != ',') {
+			if (*p == '"')
+				p = http_skip_sf_string(p, end);
+			else
+				p++;
+		}
+
+		if (key_len != 1)
+			continue;
+
+		if (*key == 'u') {
+			/* sf-integer: up to 15 digits, only 0..7 are valid */
+			if (!val || val == val_end || val_end - val > 15)
+				continue;
+			for (u = 0; val < val_end && isdigit((uchar)*val); val++)
+				u = u * 10 + *val - '0';
+			if (val == val_end && u <= HTTP_PRIO_URG_MAX)
+				*urgency = u;
+		}
+		else if (*key == 'i') {
+			/* sf-boolean: a bare key means true */
+			if (!val)
+				*incremental = 1;
+			else if (val_end - val == 2 && val[0] == '?' && (val[1] == '0' || val[1] == '1'))
+				*incremental = val[1] - '0';
+		}
+	}
+}
+
 /* Returns non-zero if the two ETags are comparable (see RFC 7232#2.3.2).
  * If any of them is a weak ETag, we discard the weakness prefix and perform
  * a strict string comparison.
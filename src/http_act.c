@@ -2259,6 +2259,79 @@ static enum act_parse_ret parse_http_set_timeout(const char **args,
 	return ACT_RET_PRS_OK;
 }
 
+/* This function executes a "set-priority-urgency" action. The RFC9218 urgency
+ * of the frontend mux stream is set to the result of the expression, bounded
+ * to 0..7. It is ignored by muxes which do not support priorities. It always
+ * returns ACT_RET_CONT.
+ */
+static enum act_return http_action_set_priority_urgency(struct act_rule *rule, struct proxy *px,
+							struct session *sess, struct stream *s, int flags)
+{
+	struct connection *conn = sc_conn(s->scf);
+	struct sample *smp;
+	int dir = (rule->from == ACT_F_HTTP_REQ) ? SMP_OPT_DIR_REQ : SMP_OPT_DIR_RES;
+	int urgency;
+
+	if (!conn || !conn->mux || !conn->mux->sctl)
+		return ACT_RET_CONT;
+
+	smp = sample_fetch_as_type(px, sess, s, dir|SMP_OPT_FINAL, rule->arg.expr, SMP_T_SINT);
+	if (!smp)
+		return ACT_RET_CONT;
+
+	urgency = smp->data.u.sint < 0 ? 0 :
+		  smp->data.u.sint > HTTP_PRIO_URG_MAX ? HTTP_PRIO_URG_MAX :
+		  smp->data.u.sint;
+	conn->mux->sctl(s->scf, MUX_SCTL_SET_URGENCY, &urgency);
+	return ACT_RET_CONT;
+}
+
+/* Release the sample expression of a "set-priority-urgency" action */
+static void release_http_set_priority_urgency(struct act_rule *rule)
+{
+	release_sample_expr(rule->arg.expr);
+}
+
+/* Parse a "set-priority-urgency" action. It takes a sample expression as
+ * argument. It returns ACT_RET_PRS_OK on success, ACT_RET_PRS_ERR on error.
+ */
+static enum act_parse_ret parse_http_set_priority_urgency(const char **args, int *orig_arg, struct proxy *px,
+							  struct act_rule *rule, char **err)
+{
+	unsigned int where = 0;
+
+	rule->arg.expr = sample_parse_expr((char **)args, orig_arg, px->conf.args.file,
+	                                   px->conf.args.line, err, &px->conf.args, NULL);
+	if (!rule->arg.expr)
+		return ACT_RET_PRS_ERR;
+
+	if (rule->from == ACT_F_HTTP_REQ) {
+		if (px->cap & PR_CAP_FE)
+			where |= SMP_VAL_FE_HRQ_HDR;
+		if (px->cap & PR_CAP_BE)
+			where |= SMP_VAL_BE_HRQ_HDR;
+	}
+	else {
+		if (px->cap & PR_CAP_FE)
+			where |= SMP_VAL_FE_HRS_HDR;
+		if (px->cap & PR_CAP_BE)
+			where |= SMP_VAL_BE_HRS_HDR;
+	}
+
+	if (!(rule->arg.expr->fetch->val & where)) {
+		memprintf(err,
+			  "fetch method '%s' extracts information from '%s', none of which is available here",
+			  args[0], sample_src_names(rule->arg.expr->fetch->use));
+		release_sample_expr(rule->arg.expr);
+		return ACT_RET_PRS_ERR;
+	}
+
+	rule->action      = ACT_CUSTOM;
+	rule->action_ptr  = http_action_set_priority_urgency;
+	rule->release_ptr = release_http_set_priority_urgency;
+	return ACT_RET_PRS_OK;
+}
+
 /* This function executes a strict-mode actions. On success, it always returns
  * ACT_RET_CONT
  */
@@ -2528,6 +2601,7 @@ static struct action_kw_list http_req_actions = {
 		{ "set-method",       parse_set_req_line,              0 },
 		{ "set-path",         parse_set_req_line,              0 },
 		{ "set-pathq",        parse_set_req_line,              0 },
+		{ "set-priority-urgency", parse_http_set_priority_urgency, 0 },
 		{ "set-query",        parse_set_req_line,              0 },
 		{ "set-uri",          parse_set_req_line,              0 },
 		{ "strict-mode",      parse_http_strict_mode,          0 },
@@ -2559,6 +2633,7 @@ static struct action_kw_list http_res_actions = {
 		{ "return",          parse_http_return,         0 },
 		{ "set-header",      parse_http_set_header,     0 },
 		{ "set-map",         parse_http_set_map,        KWF_MATCH_PREFIX },
+		{ "set-priority-urgency", parse_http_set_priority_urgency, 0 },
 		{ "set-status",      parse_http_set_status,     0 },
 		{ "strict-mode",     parse_http_strict_mode,    0 },
 		{ "track-sc",        parse_http_track_sc,       KWF_MATCH_PREFIX },
@@ -4949,6 +4949,11 @@ void http_return_srv_error(struct stream *s, struct stconn *sc)
 		http_server_error(s, sc, SF_ERR_SRVTO, SF_FINST_Q,
 				  http_error_message(s));
 	}
+	else if (err_type & STRM_ET_QUEUE_DROP) {
+		s->txn->status = s->be->queue_delay.status;
+		http_server_error(s, sc, SF_ERR_SRVTO, SF_FINST_Q,
+				  http_error_message(s));
+	}
 	else if (err_type & STRM_ET_QUEUE_ERR) {
 		s->txn->status = 503;
 		http_server_error(s, sc, SF_ERR_SRVCL, SF_FINST_Q,
@@ -2135,8 +2135,6 @@ struct bind_conf *bind_conf_alloc(struct proxy *fe, const char *file,
 	bind_conf->severity_output = CLI_SEVERITY_NONE;
 #ifdef USE_OPENSSL
 	HA_RWLOCK_INIT(&bind_conf->sni_lock);
-	bind_conf->sni_ctx = EB_ROOT;
-	bind_conf->sni_w_ctx = EB_ROOT;
 #endif
 #ifdef USE_QUIC
 	/* Use connection socket for QUIC by default. */
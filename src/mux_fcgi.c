@@ -3819,6 +3819,8 @@ static void fcgi_detach(struct sedesc *sd)
 				 !LIST_INLIST(&fconn->conn->sess_el)) {
 				srv_add_to_avail_list(__objt_server(fconn->conn->target), fconn->conn);
 			}
+			else
+				srv_refresh_avail_conn(fconn->conn);
 		}
 	}
 
@@ -1307,11 +1307,22 @@ static int h1_init(struct connection *conn, struct proxy *proxy, struct session
 
 	conn->ctx = h1c;
 
-	if (h1c->flags & H1C_F_IS_BACK) {
+	if ((h1c->flags & H1C_F_IS_BACK) && conn_ctx) {
 		/* Create a new H1S now for backend connection only */
 		if (!h1c_bck_stream_new(h1c, conn_ctx, sess))
 			goto fail;
 	}
+	else if (h1c->flags & H1C_F_IS_BACK) {
+		/* Backend connection opened in advance without any stream
+		 * (pool-min-idle), it will be stored in the server's idle
+		 * list by the caller. Just like after a detach, it may be
+		 * killed at any moment and may be taken over by another
+		 * thread.
+		 */
+		h1c->flags |= H1C_F_SILENT_SHUT;
+		HA_ATOMIC_OR(&h1c->wait_event.tasklet->state, TASK_F_USR1);
+		xprt_set_idle(conn, conn->xprt, conn->xprt_ctx);
+	}
 	else if (conn_ctx) {
 		/* Upgraded frontend connection (from TCP) */
 		if (!h1c_frt_stream_new(h1c, conn_ctx, h1c->conn->owner))
@@ -4398,6 +4409,14 @@ static int h1_wake(struct connection *conn)
 
 	TRACE_POINT(H1_EV_H1C_WAKE, conn);
 
+	if (!h1c->h1s && (h1c->flags & H1C_F_IS_BACK) && (conn->flags & CO_FL_ERROR)) {
+		/* idle backend connection opened in advance (pool-min-idle)
+		 * which failed to establish, there is nobody else to report
+		 * it to.
+		 */
+		h1c->flags |= H1C_F_ERROR;
+	}
+
 	h1_send(h1c);
 	ret = h1_process(h1c);
 	if (ret == 0) {
@@ -4405,6 +4424,13 @@ static int h1_wake(struct connection *conn)
 
 		if (h1c->state == H1_CS_UPGRADING || h1c->state == H1_CS_RUNNING)
 			h1_alert(h1s);
+		else if (!h1s && (h1c->flags & H1C_F_IS_BACK) &&
+			 !(h1c->wait_event.events & SUB_RETRY_RECV) && h1_recv_allowed(h1c)) {
+			/* idle backend connection which just got established
+			 * (pool-min-idle): watch it to detect a server close.
+			 */
+			conn->xprt->subscribe(conn, conn->xprt_ctx, SUB_RETRY_RECV, &h1c->wait_event);
+		}
 	}
 	return ret;
 }
@@ -4917,7 +4943,7 @@ static size_t h1_nego_ff(struct stconn *sc, struct buffer *input, size_t count,
 
 		if (h1c->conn->xprt->snd_pipe &&
 		    h1c->conn->xprt->get_capability &&
-		    h1c->conn->xprt->get_capability(h1c->conn, h1c->conn->xprt_ctx, XPRT_CAN_SPLICE, &can_splice) == 0 &&
+		    h1c->conn->xprt->get_capability(h1c->conn, h1c->conn->xprt_ctx, XPRT_CAN_SPLICE_SEND, &can_splice) == 0 &&
 		    can_splice == XPRT_CONN_CAN_SPLICE &&
 		    (h1s->sd->iobuf.pipe || (pipes_used < global.maxpipes && (h1s->sd->iobuf.pipe = get_pipe())))) {
 			h1s->sd->iobuf.offset = 0;
@@ -5127,7 +5153,7 @@ static int h1_fastfwd(struct stconn *sc, unsigned int count, unsigned int flags)
 		int can_splice = XPRT_CONN_CAN_NOT_SPLICE;
 
 		if (h1c->conn->xprt->get_capability &&
-		    h1c->conn->xprt->get_capability(h1c->conn, h1c->conn->xprt_ctx, XPRT_CAN_SPLICE, &can_splice) == 0 &&
+		    h1c->conn->xprt->get_capability(h1c->conn, h1c->conn->xprt_ctx, XPRT_CAN_SPLICE_RECV, &can_splice) == 0 &&
 		    can_splice == XPRT_CONN_CAN_SPLICE)
 			nego_flags |= NEGO_FF_FL_MAY_SPLICE;
 		else if (can_splice == XPRT_CONN_COULD_SPLICE)
@@ -58,6 +58,14 @@ struct h2c {
 	uint32_t rcvd_s; /* newly received data for the current stream (dsi) or zero */
 	uint32_t wu_s;   /* amount of data to write in the next WU frame for dsi, or zero */
 	uint32_t receiving_streams; /* number of streams currently receiving data */
+	uint32_t bdp_est;  /* estimated BDP bounding the rx stream windows, 0=no autotuning */
+	uint32_t bdp_rcvd; /* DATA payload received since the BDP PING was sent */
+	uint32_t bdp_rtt;  /* smoothed BDP PING round trip time in microseconds, 0=unknown */
+	uint32_t bdp_bw;   /* max bandwidth observed during BDP PINGs, in bytes per ms */
+	ullong bdp_date;   /* date the BDP PING was sent (now_ns) */
+	uint32_t bdp_max;  /* max number of rx buffers autotuning may grow to */
+	uint32_t bdp_stable; /* number of BDP samples without growth */
+	int32_t iws;       /* initial window size advertised to the peer */
 
 	/* states for the demux direction */
 	struct hpack_dht *ddht; /* demux dynamic header table */
@@ -74,6 +82,7 @@ struct h2c {
 	/* states for the mux direction */
 	struct buffer mbuf[H2C_MBUF_CNT];   /* mux buffers (ring) */
 	struct bl_elem *shared_rx_bufs;     /* shared rx bufs */
+	struct hpack_enc *henc;             /* mux HPACK encoder context, or NULL */
 	int32_t miw; /* mux initial window size for all new streams */
 	int32_t mws; /* mux window size. Can be negative. */
 	int32_t mfs; /* mux's max frame size */
@@ -124,7 +133,9 @@ struct h2s {
 	uint64_t next_max_ofs; /* max stream offset that next WU must permit (curr_rx_ofs+rx_win) */
 	uint rx_head, rx_tail; /* head and tail of rx buffer in the conn's shared rx buf */
 	uint rx_count;         /* total number of allocated rxbufs */
-	/* 4 bytes hole here */
+	uint8_t urgency;       /* RFC9218 urgency, 0 (highest) to 7 (lowest) */
+	uint8_t incremental;   /* RFC9218 incremental flag */
+	/* 2 bytes hole here */
 	struct wait_event *subs;  /* recv wait_event the stream connector associated is waiting on (via h2_subscribe) */
 	struct list list; /* To be used when adding in h2c->send_list or h2c->fctl_lsit */
 	struct tasklet *shut_tl;  /* deferred shutdown tasklet, to retry to send an RST after we failed to,
@@ -314,6 +325,11 @@ enum {
 	H2_ST_RST_STREAM_RESP,
 	H2_ST_GOAWAY_RESP,
 
+	H2_ST_HEADERS_SENT,
+	H2_ST_DATA_SENT,
+	H2_ST_WRITES,
+	H2_ST_GATHERED_SENDS,
+
 	H2_ST_OPEN_CONN,
 	H2_ST_OPEN_STREAM,
 	H2_ST_TOTAL_CONN,
@@ -343,6 +359,15 @@ static struct stat_col h2_stats[] = {
 	[H2_ST_GOAWAY_RESP]     = { .name = "h2_goaway_resp",
 	                            .desc = "Total number of GOAWAY sent on detected error" },
 
+	[H2_ST_HEADERS_SENT]    = { .name = "h2_headers_sent",
+	                            .desc = "Total number of HEADERS frames sent (including trailers)" },
+	[H2_ST_DATA_SENT]       = { .name = "h2_data_sent",
+	                            .desc = "Total number of DATA frames sent" },
+	[H2_ST_WRITES]          = { .name = "h2_writes",
+	                            .desc = "Total number of successful writes to the transport layer" },
+	[H2_ST_GATHERED_SENDS]  = { .name = "h2_gathered_sends",
+	                            .desc = "Total number of sends postponed to gather frames from other streams" },
+
 	[H2_ST_OPEN_CONN]    = { .name = "h2_open_connections",
 	                         .desc = "Count of currently open connections" },
 	[H2_ST_OPEN_STREAM]  = { .name = "h2_backend_open_streams",
@@ -365,6 +390,11 @@ static struct h2_counters {
 	long long rst_stream_resp; /* total number of RST_STREAM frame sent on error */
 	long long goaway_resp;     /* total number of GOAWAY frame sent on error */
 
+	long long headers_sent;    /* total number of HEADERS frame sent */
+	long long data_sent;       /* total number of DATA frame sent */
+	long long writes;          /* total number of successful snd_buf() calls */
+	long long gathered_sends;  /* total number of sends postponed for gathering */
+
 	long long open_conns;    /* count of currently open connections */
 	long long open_streams;  /* count of currently open streams */
 	long long total_conns;   /* total number of connections */
@@ -407,6 +437,18 @@ static int h2_fill_stats(void *data, struct field *stats, unsigned int *selected
 		case H2_ST_GOAWAY_RESP:
 			metric = mkf_u64(FN_COUNTER, counters->goaway_resp);
 			break;
+		case H2_ST_HEADERS_SENT:
+			metric = mkf_u64(FN_COUNTER, counters->headers_sent);
+			break;
+		case H2_ST_DATA_SENT:
+			metric = mkf_u64(FN_COUNTER, counters->data_sent);
+			break;
+		case H2_ST_WRITES:
+			metric = mkf_u64(FN_COUNTER, counters->writes);
+			break;
+		case H2_ST_GATHERED_SENDS:
+			metric = mkf_u64(FN_COUNTER, counters->gathered_sends);
+			break;
 		case H2_ST_OPEN_CONN:
 			metric = mkf_u64(FN_GAUGE,   counters->open_conns);
 			break;
@@ -468,6 +510,8 @@ struct pool_head *pool_head_h2_rx_bufs __read_mostly = NULL;
 
 /* a few settings from the global section */
 static int h2_settings_header_table_size      =  4096; /* initial value */
+static int h2_settings_encoder_table_size     =     0; /* encoder's dynamic table size, 0=disabled */
+static int h2_settings_encoder_huffman        =     1; /* huffman-encode strings with the encoder table */
 static int h2_settings_initial_window_size    =     0; /* default initial value: bufsize */
 static int h2_be_settings_initial_window_size =     0; /* backend's default initial value */
 static int h2_fe_settings_initial_window_size =     0; /* frontend's default initial value */
@@ -475,6 +519,12 @@ static int h2_be_glitches_threshold           =     0; /* backend's max glitches
 static int h2_fe_glitches_threshold           =     0; /* frontend's max glitches: unlimited */
 static uint h2_be_rxbuf                       =     0; /* backend's default total rxbuf (bytes) */
 static uint h2_fe_rxbuf                       =     0; /* frontend's default total rxbuf (bytes) */
+static uint h2_be_gather_size                 =     0; /* backend's min amount of data to gather before sending, 0=off */
+static uint h2_fe_gather_size                 =     0; /* frontend's min amount of data to gather before sending, 0=off */
+static int h2_be_rxbuf_autotune               =     0; /* backend's rx window autotuning, 0=off */
+static int h2_fe_rxbuf_autotune               =     0; /* frontend's rx window autotuning, 0=off */
+static uint h2_be_rxbuf_autotune_max          =     0; /* backend's max autotuned rxbuf (bytes), 0=4*rxbuf */
+static uint h2_fe_rxbuf_autotune_max          =     0; /* frontend's max autotuned rxbuf (bytes), 0=4*rxbuf */
 static unsigned int h2_settings_max_concurrent_streams    = 100; /* default value */
 static unsigned int h2_be_settings_max_concurrent_streams =   0; /* backend value */
 static unsigned int h2_fe_settings_max_concurrent_streams =   0; /* frontend value */
@@ -483,6 +533,10 @@ static int h2_settings_max_frame_size         = 0;     /* unset */
 /* other non-protocol settings */
 static unsigned int h2_fe_max_total_streams =   0;      /* frontend value */
 
+/* opaque data of the PING frames we emit */
+static const char h2_idle_ping_data[8] = "\x00\x01\x02\x03\x04\x05\x06\x07";
+static const char h2_bdp_ping_data[8]  = "h2bdpest";
+
 /* a dummy closed endpoint */
 static const struct sedesc closed_ep = {
 	.sc        = NULL,
@@ -785,6 +839,39 @@ static inline uint h2s_rxbuf_cnt(const struct h2s *h2s)
 	return h2s->rx_count;
 }
 
+/* Returns the optimal amount of data to receive per rxbuf: the HTX payload
+ * room of a buffer, so that incoming frames are aligned to copies to HTX, but
+ * at least 16384 since that's what most implems use and some might refrain
+ * from sending until a full frame is permitted. We won't be causing HoL for
+ * 56 extra bytes anyway.
+ */
+static inline int h2_rx_opt_size(void)
+{
+	return MAX(16384, (int)(global.tune.bufsize - sizeof(struct htx) - sizeof(struct htx_blk)));
+}
+
+/* Returns the number of rxbufs needed to store <size> bytes of frames */
+static inline uint h2_rx_nbufs(uint size)
+{
+	return (size + global.tune.bufsize - 9 - 1) / (global.tune.bufsize - 9);
+}
+
+/* Returns the max number of rxbufs a connection on side <back> having
+ * <nb_rxbufs> rxbufs may use. This is <nb_rxbufs> unless rx window autotuning
+ * is enabled, in which case it's the configured budget or 4 times <nb_rxbufs>.
+ */
+static inline uint h2_rx_max_bufs(int back, uint nb_rxbufs)
+{
+	uint max;
+
+	if (!(back ? h2_be_rxbuf_autotune : h2_fe_rxbuf_autotune))
+		return nb_rxbufs;
+
+	max = back ? h2_be_rxbuf_autotune_max : h2_fe_rxbuf_autotune_max;
+	max = max ? h2_rx_nbufs(max) : nb_rxbufs * 4;
+	return MAX(max, nb_rxbufs);
+}
+
 /* Tries to get an rxbuf slot from the connection for the stream, returns its
  * non-zero number on success, or 0 on failure. On success, it will update the
  * stream's tail and count, and possibly head (if there was no buffer before).
@@ -1274,7 +1361,10 @@ static inline int h2_encode_header(struct buffer *buf, const struct ist hn, cons
 			break;
 	}
 
-	ret = hpack_encode_header(buf, hn, v);
+	if (h2c && h2c->henc)
+		ret = hpack_enc_encode_header(h2c->henc, buf, hn, v);
+	else
+		ret = hpack_encode_header(buf, hn, v);
 	if (ret)
 		h2_trace_header(hn, v, mask, trc_loc, func, h2c, h2s);
 
@@ -1366,12 +1456,18 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	if (!h2c->ddht)
 		goto fail;
 
+	/* the encoder context is optional, the peer's decoder always starts
+	 * with a 4096 bytes table (RFC7540#6.5.2).
+	 */
+	h2c->henc = NULL;
+	if (h2_settings_encoder_table_size)
+		h2c->henc = hpack_enc_alloc(4096, h2_settings_encoder_huffman);
+
 	/* Initialise the context. */
 	h2c->st0 = H2_CS_PREFACE;
 	h2c->conn = conn;
 	h2c->streams_limit = h2c_max_concurrent_streams(h2c);
-	nb_rxbufs = (h2c->flags & H2_CF_IS_BACK) ? h2_be_rxbuf : h2_fe_rxbuf;
-	nb_rxbufs = (nb_rxbufs + global.tune.bufsize - 9 - 1) / (global.tune.bufsize - 9);
+	nb_rxbufs = h2_rx_nbufs((h2c->flags & H2_CF_IS_BACK) ? h2_be_rxbuf : h2_fe_rxbuf);
 	nb_rxbufs = MAX(nb_rxbufs, h2c->streams_limit);
 	bl_init(h2c->shared_rx_bufs, nb_rxbufs + 1);
 
@@ -1385,6 +1481,19 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	h2c->nb_reserved = 0;
 	h2c->stream_cnt = 0;
 	h2c->receiving_streams = 0;
+	h2c->bdp_est = 0;
+	if ((h2c->flags & H2_CF_IS_BACK) ? h2_be_rxbuf_autotune : h2_fe_rxbuf_autotune)
+		h2c->bdp_est = h2_rx_opt_size() * 2;
+	h2c->bdp_rcvd = 0;
+	h2c->bdp_rtt = 0;
+	h2c->bdp_bw = 0;
+	h2c->bdp_date = 0;
+	h2c->bdp_max = h2_rx_max_bufs(!!(h2c->flags & H2_CF_IS_BACK), nb_rxbufs);
+	h2c->bdp_stable = 0;
+	h2c->iws = (h2c->flags & H2_CF_IS_BACK) ?
+	           h2_be_settings_initial_window_size:
+	           h2_fe_settings_initial_window_size;
+	h2c->iws = h2c->iws ? h2c->iws : h2_settings_initial_window_size;
 	h2c->glitches = 0;
 	h2c->term_evts_log = 0;
 
@@ -1410,7 +1519,16 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	if (t)
 		task_queue(t);
 
-	if (h2c->flags & H2_CF_IS_BACK && likely(!conn_is_reverse(h2c->conn))) {
+	if (h2c->flags & H2_CF_IS_BACK && !conn_ctx && likely(!conn_is_reverse(h2c->conn))) {
+		/* Backend connection opened in advance without any stream
+		 * (pool-min-idle), it will be stored in the server's idle
+		 * list by the caller, so it may be taken over by another
+		 * thread.
+		 */
+		HA_ATOMIC_OR(&h2c->wait_event.tasklet->state, TASK_F_USR1);
+		xprt_set_idle(conn, conn->xprt, conn->xprt_ctx);
+	}
+	else if (h2c->flags & H2_CF_IS_BACK && likely(!conn_is_reverse(h2c->conn))) {
 		/* FIXME: this is temporary, for outgoing connections we need
 		 * to immediately allocate a stream until the code is modified
 		 * so that the caller calls ->attach(). For now the outgoing sc
@@ -1437,6 +1555,7 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	TRACE_LEAVE(H2_EV_H2C_NEW, conn);
 	return 0;
   fail_stream:
+	hpack_enc_free(h2c->henc);
 	hpack_dht_free(h2c->ddht);
   fail:
 	task_destroy(t);
@@ -1480,6 +1599,25 @@ static inline struct h2s *h2c_st_by_id(struct h2c *h2c, int id)
 	return container_of(node, struct h2s, by_id);
 }
 
+/* Appends stream <h2s> to the send or flow control list <head>. These lists
+ * are kept ordered by RFC9218 priority so that the most urgent streams are
+ * woken up first when room is made in the mux buffer: the stream is placed
+ * after all those of the same or a higher urgency, non-incremental streams
+ * being placed before incremental ones of the same urgency. Streams of equal
+ * priority remain in FIFO order, which is what happens by default.
+ */
+static inline void h2_list_add_prio(struct list *head, struct h2s *h2s)
+{
+	uint key = (h2s->urgency << 1) | h2s->incremental;
+	struct h2s *cur;
+
+	list_for_each_entry_rev(cur, head, list) {
+		if (((cur->urgency << 1) | cur->incremental) <= key)
+			break;
+	}
+	LIST_INSERT(&cur->list, &h2s->list);
+}
+
 /* release function. This one should be called to free all resources allocated
  * to the mux.
  */
@@ -1490,6 +1628,7 @@ static void h2_release(struct h2c *h2c)
 	TRACE_ENTER(H2_EV_H2C_END);
 
 	hpack_dht_free(h2c->ddht);
+	hpack_enc_free(h2c->henc);
 
 	b_dequeue(&h2c->buf_wait);
 
@@ -1831,7 +1970,9 @@ static inline void h2s_count_as_receiving(struct h2s *h2s)
 	if (!(h2s->flags & H2_SF_EXPECT_RXDATA)) {
 		TRACE_STATE("counting H2 stream as receiving data", H2_EV_H2S_RECV, h2s->h2c->conn, h2s);
 		h2s->flags |= H2_SF_EXPECT_RXDATA;
-		h2s->h2c->receiving_streams++;
+		/* resume BDP sampling on a new transfer */
+		if (!h2s->h2c->receiving_streams++)
+			h2s->h2c->bdp_stable = 0;
 	}
 }
 
@@ -1957,7 +2098,6 @@ static void h2s_destroy(struct h2s *h2s)
 static struct h2s *h2s_new(struct h2c *h2c, int id)
 {
 	struct h2s *h2s;
-	uint iws;
 
 	TRACE_ENTER(H2_EV_H2S_NEW, h2c->conn);
 
@@ -1986,6 +2126,8 @@ static struct h2s *h2s_new(struct h2c *h2c, int id)
 	h2s->rx_tail   = 0;
 	h2s->rx_head   = 0;
 	h2s->rx_count  = 0;
+	h2s->urgency   = HTTP_PRIO_URG_DFLT;
+	h2s->incremental = 0;
 	memset(h2s->upgrade_protocol, 0, sizeof(h2s->upgrade_protocol));
 
 	h2s->by_id.key = h2s->id = id;
@@ -1997,11 +2139,7 @@ static struct h2s *h2s_new(struct h2c *h2c, int id)
 	/* calculate the max offset permitted by the currently active
 	 * initial window size.
 	 */
-	iws = (h2c->flags & H2_CF_IS_BACK) ?
-	      h2_be_settings_initial_window_size:
-	      h2_fe_settings_initial_window_size;
-	iws = iws ? iws : h2_settings_initial_window_size;
-	h2s->last_adv_ofs = h2s->next_max_ofs = iws;
+	h2s->last_adv_ofs = h2s->next_max_ofs = h2c->iws;
 	h2s->curr_rx_ofs = 0;
 
 	eb32_insert(&h2c->streams_by_id, &h2s->by_id);
@@ -2188,6 +2326,11 @@ static int h2c_send_settings(struct h2c *h2c)
 		/* send settings_enable_push=0 */
 		chunk_memcat(&buf, "\x00\x02\x00\x00\x00\x00", 6);
 	}
+	else {
+		/* rfc 9218 #2.1 SETTINGS_NO_RFC7540_PRIORITIES=1, only the
+		 * extensible priorities are used */
+		chunk_memcat(&buf, "\x00\x09\x00\x00\x00\x01", 6);
+	}
 
 	/* rfc 8441 #3 SETTINGS_ENABLE_CONNECT_PROTOCOL=1,
 	 * sent automatically unless disabled in the global config */
@@ -2201,11 +2344,7 @@ static int h2c_send_settings(struct h2c *h2c)
 		chunk_memcat(&buf, str, 6);
 	}
 
-	iws = (h2c->flags & H2_CF_IS_BACK) ?
-	      h2_be_settings_initial_window_size:
-	      h2_fe_settings_initial_window_size;
-	iws = iws ? iws : h2_settings_initial_window_size;
-
+	iws = h2c->iws;
 	if (iws != 65535) {
 		char str[6] = "\x00\x04"; /* initial_window_size */
 
@@ -2639,6 +2778,7 @@ static int h2_send_empty_data_es(struct h2s *h2s)
 	ret = b_istput(res, ist2(str, 9));
 	if (likely(ret > 0)) {
 		h2s->flags |= H2_SF_ES_SENT;
+		HA_ATOMIC_INC(&h2c->px_counters->data_sent);
 	}
 	else if (!ret) {
 		if ((res = br_tail_add(h2c->mbuf)) != NULL)
@@ -2745,7 +2885,7 @@ static void h2c_unblock_sfctl(struct h2c *h2c)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2_list_add_prio(&h2c->send_list, h2s);
 		}
 		node = eb32_next(node);
 	}
@@ -2821,6 +2961,8 @@ static int h2c_handle_settings(struct h2c *h2c)
 			break;
 		case H2_SETTINGS_HEADER_TABLE_SIZE:
 			h2c->flags |= H2_CF_SHTS_UPDATED;
+			if (h2c->henc)
+				hpack_enc_set_max_size(h2c->henc, (uint32_t)arg);
 			break;
 		case H2_SETTINGS_ENABLE_PUSH:
 			if (arg < 0 || arg > 1) { // RFC7540#6.5.2
@@ -2903,6 +3045,100 @@ static int h2c_ack_settings(struct h2c *h2c)
 	return ret;
 }
 
+/* Returns the largest useful BDP estimate for <h2c>, which is the whole rx
+ * buffers budget that autotuning may grow the connection to.
+ */
+static inline uint32_t h2c_bdp_max(const struct h2c *h2c)
+{
+	return MIN((uint64_t)h2c->bdp_max * h2_rx_opt_size(), INT_MAX);
+}
+
+/* Returns the initial window size <h2c> should advertise based on its BDP
+ * estimate. It never exceeds the share of the rx buffers each stream gets when
+ * all of them are receiving, so that new streams cannot overcommit them.
+ */
+static inline int h2c_bdp_iws(const struct h2c *h2c)
+{
+	uint64_t share;
+
+	share = (uint64_t)bl_size(h2c->shared_rx_bufs) * h2_rx_opt_size() / MAX(h2c->streams_limit, 1);
+	return MIN(share, h2c->bdp_est);
+}
+
+/* Accounts <len> bytes of DATA payload received on <h2c> for rx window
+ * autotuning. Similarly to gRPC's BDP estimator, a PING is scheduled on the
+ * first DATA frame if none is already in flight and the estimate may still
+ * grow, and all DATA payload received until its ACK is counted. Once the
+ * estimate remained stable for H2_BDP_STABLE_SAMPLES PINGs, no more PING is
+ * sent until a stream starts to receive data on an idle connection.
+ */
+static inline void h2c_bdp_count(struct h2c *h2c, uint32_t len)
+{
+	if (!h2c->bdp_est)
+		return;
+
+	if (h2c->flags & (H2_CF_BDP_PING|H2_CF_BDP_PING_SENT))
+		h2c->bdp_rcvd += len;
+	else if (h2c->bdp_est < h2c_bdp_max(h2c) && h2c->bdp_stable < H2_BDP_STABLE_SAMPLES) {
+		h2c->flags |= H2_CF_BDP_PING;
+		h2c->bdp_rcvd = len;
+	}
+}
+
+/* Grows the rx buffers of <h2c> so that a single receiving stream may be
+ * granted its BDP estimate on top of the buffers reserved for new streams,
+ * within the autotuning budget. If this allows a larger initial window size,
+ * a SETTINGS frame advertising it is scheduled.
+ */
+static void h2c_bdp_grow(struct h2c *h2c)
+{
+	struct bl_elem *head = h2c->shared_rx_bufs;
+	int opt_size = h2_rx_opt_size();
+	uint32_t nbufs;
+
+	nbufs = (h2c->bdp_est + opt_size - 1) / opt_size + (h2c->streams_limit + 7) / 8;
+	nbufs = MIN(nbufs, h2c->bdp_max);
+	if (nbufs > bl_size(head)) {
+		bl_grow(head, nbufs + 1);
+		TRACE_STATE("rx buffers grown", H2_EV_RX_FRAME|H2_EV_RX_PING, h2c->conn, 0, 0, (void *)(long)nbufs);
+	}
+
+	if (h2c_bdp_iws(h2c) > h2c->iws)
+		h2c->flags |= H2_CF_BDP_SETTINGS;
+}
+
+/* Processes the ACK of the BDP PING of <h2c>. The amount of data received
+ * during this round trip is what the peer can send per RTT, so if it reached
+ * 2/3 of the current estimate, the window is the limiting factor and the
+ * estimate is set to twice this amount, within the rx buffers budget. This is
+ * only done if the bandwidth also reached its max, since a round trip which
+ * is only longer because data are queued somewhere does not justify a larger
+ * window.
+ */
+static void h2c_bdp_update(struct h2c *h2c)
+{
+	uint32_t rtt = MAX((now_ns - h2c->bdp_date) / 1000, 1);
+	uint32_t bw;
+
+	h2c->flags &= ~H2_CF_BDP_PING_SENT;
+	h2c->bdp_rtt = h2c->bdp_rtt ? (h2c->bdp_rtt + 7 * rtt) / 8 : rtt;
+	bw = MIN((uint64_t)h2c->bdp_rcvd * 1000 * 2 / (3 * (uint64_t)h2c->bdp_rtt), UINT_MAX);
+	if (bw > h2c->bdp_bw)
+		h2c->bdp_bw = bw;
+
+	if (bw == h2c->bdp_bw &&
+	    (uint64_t)h2c->bdp_rcvd * 3 >= (uint64_t)h2c->bdp_est * 2 &&
+	    h2c->bdp_est < h2c_bdp_max(h2c)) {
+		h2c->bdp_est = MIN((uint64_t)h2c->bdp_rcvd * 2, h2c_bdp_max(h2c));
+		h2c->bdp_stable = 0;
+		TRACE_STATE("BDP estimate increased", H2_EV_RX_FRAME|H2_EV_RX_PING, h2c->conn, 0, 0, (void *)(long)h2c->bdp_est);
+		h2c_bdp_grow(h2c);
+	}
+	else
+		h2c->bdp_stable++;
+	h2c->bdp_rcvd = 0;
+}
+
 /* processes a PING frame and schedules an ACK if needed. The caller must pass
  * the pointer to the payload in <payload>. Returns > 0 on success or zero on
  * missing data. The caller must have already verified frame length
@@ -2912,6 +3148,18 @@ static int h2c_handle_ping(struct h2c *h2c)
 {
 	if (h2c->dff & H2_F_PING_ACK) {
 		TRACE_PROTO("receiving H2 PING ACK frame", H2_EV_RX_FRAME|H2_EV_RX_PING, h2c->conn);
+		if (h2c->flags & H2_CF_BDP_PING_SENT) {
+			char data[8];
+
+			if (b_data(&h2c->dbuf) >= 8) {
+				h2_get_buf_bytes(data, 8, &h2c->dbuf, 0);
+				if (memcmp(data, h2_bdp_ping_data, 8) == 0) {
+					h2c_bdp_update(h2c);
+					return 1;
+				}
+			}
+		}
+
 		if ((h2c->flags & (H2_CF_IDL_PING|H2_CF_IDL_PING_SENT)) == H2_CF_IDL_PING_SENT) {
 			h2c->flags &= ~H2_CF_IDL_PING_SENT;
 			h2c_update_timeout(h2c);
@@ -3032,21 +3280,12 @@ static int h2c_update_strm_rx_win(struct h2c *h2c)
 			int to_share;
 			int opt_size;
 
-			/* let's use the configured static window size */
-			win = (h2c->flags & H2_CF_IS_BACK) ?
-				h2_be_settings_initial_window_size:
-				h2_fe_settings_initial_window_size;
-			win = win ? win : h2_settings_initial_window_size;
-
-			/* try to optimally align incoming frames to align copies
-			 * to HTX, but stick to 16384 if lower since that's what most
-			 * implems use and some might refrain from sending until a
-			 * full frame is permitted. We won't be causing HoL for 56
-			 * extra bytes anyway.
+			/* let's use the advertised initial window size, which
+			 * is the configured one unless raised by autotuning.
 			 */
-			opt_size = global.tune.bufsize - sizeof(struct htx) - sizeof(struct htx_blk);
-			if (opt_size < 16384)
-				opt_size = 16384;
+			win = h2c->iws;
+
+			opt_size = h2_rx_opt_size();
 
 			/* default to one buffer when not receiving data */
 			rxbsz = opt_size;
@@ -3080,6 +3319,15 @@ static int h2c_update_strm_rx_win(struct h2c *h2c)
 
 					rxbsz = rxbsz / opt_size * opt_size;
 				}
+
+				/* With autotuning, never grant more than what the
+				 * peer was measured to be able to send during one
+				 * RTT, so that low latency peers do not fill the
+				 * buffers, while the buffers of high BDP ones are
+				 * grown up to the autotuning budget.
+				 */
+				if (h2c->bdp_est && rxbsz > h2c->bdp_est)
+					rxbsz = (h2c->bdp_est + opt_size - 1) / opt_size * opt_size;
 			}
 
 			if (rxbsz > win)
@@ -3135,11 +3383,12 @@ static int h2c_send_strm_wu(struct h2c *h2c)
 }
 
 /* Try to send a PING frame for <h2c> connection. Set <ack> to respond to an
- * incoming PING, in this case payload is copied from demux buffer.
+ * incoming PING, in this case payload is copied from demux buffer. Otherwise
+ * the 8 bytes of opaque data are taken from <data>.
  *
  * Returns a positive value on success, else 0.
  */
-static int h2c_send_ping(struct h2c *h2c, int ack)
+static int h2c_send_ping(struct h2c *h2c, int ack, const char *data)
 {
 	struct buffer *res;
 	char str[17];
@@ -3154,7 +3403,7 @@ static int h2c_send_ping(struct h2c *h2c, int ack)
 		       "\x00\x00\x00\x00" /* stream ID */, 9);
 
 		/* opaque data */
-		memcpy(str + 9, "\x00\x01\x02\x03\x04\x05\x06\x07", 8);
+		memcpy(str + 9, data, 8);
 	}
 	else {
 		if (b_data(&h2c->dbuf) < 8) {
@@ -3197,6 +3446,72 @@ static int h2c_send_ping(struct h2c *h2c, int ack)
 	return ret;
 }
 
+/* Try to send a SETTINGS frame advertising the initial window size of <h2c>
+ * raised by rx window autotuning. The peer will adjust the windows of all
+ * existing streams by the difference (RFC9113#6.9.2), so their advertised
+ * offsets are adjusted the same way. Returns > 0 on success or zero on missing
+ * room or failure. It may return an error in h2c.
+ */
+static int h2c_send_bdp_settings(struct h2c *h2c)
+{
+	struct eb32_node *node;
+	struct buffer *res;
+	struct h2s *h2s;
+	char str[15];
+	int iws, delta;
+	int ret = 0;
+
+	TRACE_ENTER(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+
+	iws = h2c_bdp_iws(h2c);
+	if (iws <= h2c->iws) {
+		ret = 1;
+		goto out;
+	}
+
+	memcpy(str,
+	       "\x00\x00\x06"     /* length : 6 (one setting) */
+	       "\x04\x00"         /* type   : 4, flags : 0 */
+	       "\x00\x00\x00\x00" /* stream ID */
+	       "\x00\x04"         /* initial_window_size */, 11);
+	write_n32(str + 11, iws);
+
+	res = br_tail(h2c->mbuf);
+ retry:
+	if (!h2_get_buf(h2c, res)) {
+		h2c->flags |= H2_CF_MUX_MALLOC;
+		h2c->flags |= H2_CF_DEM_MROOM;
+		goto out;
+	}
+
+	ret = b_istput(res, ist2(str, 15));
+	if (unlikely(ret <= 0)) {
+		if (!ret) {
+			if ((res = br_tail_add(h2c->mbuf)) != NULL)
+				goto retry;
+			h2c->flags |= H2_CF_MUX_MFULL;
+			h2c->flags |= H2_CF_DEM_MROOM;
+		}
+		else {
+			h2c_error(h2c, H2_ERR_INTERNAL_ERROR);
+			ret = 0;
+		}
+		goto out;
+	}
+
+	delta = iws - h2c->iws;
+	h2c->iws = iws;
+	for (node = eb32_first(&h2c->streams_by_id); node; node = eb32_next(node)) {
+		h2s = container_of(node, struct h2s, by_id);
+		h2s->last_adv_ofs += delta;
+		h2s->next_max_ofs += delta;
+	}
+	TRACE_STATE("initial window size raised", H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn, 0, 0, (void *)(long)iws);
+ out:
+	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+	return ret;
+}
+
 /* processes a WINDOW_UPDATE frame whose payload is <payload> for <plen> bytes.
  * Returns > 0 on success or zero on missing data. It may return an error in
  * h2c or h2s. The caller must have already verified frame length and stream ID
@@ -3253,7 +3568,7 @@ static int h2c_handle_window_update(struct h2c *h2c, struct h2s *h2s)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2_list_add_prio(&h2c->send_list, h2s);
 		}
 	}
 	else {
@@ -3349,6 +3664,95 @@ static int h2c_handle_priority(struct h2c *h2c)
 	return 1;
 }
 
+/* processes a PRIORITY_UPDATE frame, and applies the priority field value it
+ * carries to the designated stream. Updates for streams which are not open are
+ * ignored (RFC9218#7 only suggests to buffer them for idle streams). Returns > 0
+ * on success or zero on missing data. It may return an error in h2c. The frame
+ * is only accepted on a frontend connection. Described in RFC9218#7.1.
+ */
+static int h2c_handle_priority_update(struct h2c *h2c)
+{
+	uint8_t urgency = HTTP_PRIO_URG_DFLT;
+	uint8_t incremental = 0;
+	struct h2s *h2s;
+	struct ist value;
+	int32_t sid;
+
+	TRACE_ENTER(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+
+	/* process full frame only */
+	if (b_data(&h2c->dbuf) < h2c->dfl) {
+		TRACE_DEVEL("leaving on missing data", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c->flags |= H2_CF_DEM_SHORT_READ;
+		return 0;
+	}
+
+	if (h2c->dsi != 0) {
+		/* RFC9218#7.1: must be sent on stream 0 */
+		h2c_report_glitch(h2c, 1, "PRIORITY_UPDATE on non-zero stream");
+		TRACE_ERROR("PRIORITY_UPDATE on non-zero stream", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_PROTOCOL_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	if (h2c->dfl < 4) {
+		h2c_report_glitch(h2c, 1, "invalid PRIORITY_UPDATE frame length");
+		TRACE_ERROR("invalid PRIORITY_UPDATE frame length", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_FRAME_SIZE_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	sid = h2_get_n32(&h2c->dbuf, 0) & 0x7FFFFFFF;
+	if (!sid) {
+		/* RFC9218#7.1: the prioritized stream may not be stream 0 */
+		h2c_report_glitch(h2c, 1, "PRIORITY_UPDATE for stream 0");
+		TRACE_ERROR("PRIORITY_UPDATE for stream 0", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, H2_ERR_PROTOCOL_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		goto fail;
+	}
+
+	h2s = h2c_st_by_id(h2c, sid);
+	if (!(h2c->flags & H2_CF_IS_BACK) && h2s->id && h2s->st != H2_SS_CLOSED) {
+		/* the field value may wrap at the end of the buffer */
+		value = ist2(b_peek(&h2c->dbuf, 4), h2c->dfl - 4);
+		if (b_contig_data(&h2c->dbuf, 4) < istlen(value)) {
+			struct buffer *tmp = get_trash_chunk();
+
+			b_getblk(&h2c->dbuf, tmp->area, istlen(value), 4);
+			value = ist2(tmp->area, istlen(value));
+		}
+		/* RFC9218#4: absent parameters take their default value */
+		http_parse_priority(value, &urgency, &incremental);
+		if (h2s->urgency != urgency || h2s->incremental != incremental) {
+			h2s->urgency = urgency;
+			h2s->incremental = incremental;
+
+			/* a stream already waiting in the send or fctl list is
+			 * moved to its new place in that same list, whose head
+			 * is found by walking forward from the stream.
+			 */
+			if (LIST_INLIST(&h2s->list)) {
+				struct list *head = h2s->list.n;
+
+				while (head != &h2c->send_list && head != &h2c->fctl_list)
+					head = head->n;
+				LIST_DEL_INIT(&h2s->list);
+				h2_list_add_prio(head, h2s);
+			}
+		}
+		TRACE_PROTO("updated stream priority", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn, h2s);
+	}
+
+	TRACE_LEAVE(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+	return 1;
+ fail:
+	TRACE_DEVEL("leaving on error", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+	return 0;
+}
+
 /* processes an RST_STREAM frame, and sets the 32-bit error code on the stream.
  * Returns > 0 on success or zero on missing data. The caller must have already
  * verified frame length and stream ID validity. Described in RFC7540#6.4.
@@ -3399,6 +3803,9 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 {
 	struct buffer rxbuf = BUF_NULL;
 	unsigned long long body_len = ULLONG_MAX;
+	struct http_hdr_ctx ctx = { .blk = NULL };
+	uint8_t urgency = HTTP_PRIO_URG_DFLT;
+	uint8_t incremental = 0;
 	uint32_t flags = 0;
 	int error;
 
@@ -3535,6 +3942,10 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 
 	TRACE_USER("rcvd H2 request  ", H2_EV_RX_FRAME|H2_EV_RX_HDR|H2_EV_STRM_NEW, h2c->conn, 0, &rxbuf);
 
+	/* RFC9218#5: the client may indicate the response's priority */
+	while (http_find_header(htx_from_buf(&rxbuf), ist("priority"), &ctx, 1))
+		http_parse_priority(ctx.value, &urgency, &incremental);
+
 	/* Note: we don't emit any other logs below because if we return
 	 * positively from h2c_frt_stream_new(), the stream will report the error,
 	 * and if we return in error, h2c_frt_stream_new() will emit the error.
@@ -3552,6 +3963,8 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	h2s->st = H2_SS_OPEN;
 	h2s->flags |= flags;
 	h2s->body_len = body_len;
+	h2s->urgency = urgency;
+	h2s->incremental = incremental;
 	if (h2s->flags & H2_SF_DATA_CLEN)
 		h2s->sd->kip = h2s->body_len;
 	h2s_propagate_term_flags(h2c, h2s);
@@ -4318,6 +4731,8 @@ static void h2_process_demux(struct h2c *h2c)
 			h2_skip_frame_hdr(&h2c->dbuf);
 
 		new_frame:
+			if (hdr.ft == H2_FT_DATA)
+				h2c_bdp_count(h2c, hdr.len);
 			h2c->dfl = hdr.len;
 			h2c->dsi = hdr.sid;
 			h2c->dft = hdr.ft;
@@ -4406,7 +4821,7 @@ static void h2_process_demux(struct h2c *h2c)
 
 			if (h2c->st0 == H2_CS_FRAME_A) {
 				TRACE_PROTO("sending H2 PING ACK frame", H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn, h2s);
-				ret = h2c_send_ping(h2c, 1);
+				ret = h2c_send_ping(h2c, 1, NULL);
 			}
 			break;
 
@@ -4466,6 +4881,13 @@ static void h2_process_demux(struct h2c *h2c)
 			}
 			break;
 
+		case H2_FT_PRIORITY_UPDATE:
+			if (h2c->st0 == H2_CS_FRAME_P) {
+				TRACE_PROTO("receiving H2 PRIORITY_UPDATE frame", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn, h2s);
+				ret = h2c_handle_priority_update(h2c);
+			}
+			break;
+
 		case H2_FT_RST_STREAM:
 			if (h2c->st0 == H2_CS_FRAME_P) {
 				TRACE_PROTO("receiving H2 RST_STREAM frame", H2_EV_RX_FRAME|H2_EV_RX_RST|H2_EV_RX_EOI, h2c->conn, h2s);
@@ -4690,12 +5112,29 @@ static int h2_process_mux(struct h2c *h2c)
 
 	/* emit PING to test connection liveliness */
 	if ((h2c->flags & (H2_CF_IDL_PING|H2_CF_IDL_PING_SENT)) == (H2_CF_IDL_PING|H2_CF_IDL_PING_SENT)) {
-		if (!h2c_send_ping(h2c, 0))
+		if (!h2c_send_ping(h2c, 0, h2_idle_ping_data))
 			goto fail;
 		TRACE_USER("sent ping", H2_EV_H2C_WAKE, h2c->conn);
 		h2c->flags &= ~H2_CF_IDL_PING;
 	}
 
+	/* emit PING to estimate the BDP for rx window autotuning */
+	if ((h2c->flags & H2_CF_BDP_PING) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC))) {
+		if (!h2c_send_ping(h2c, 0, h2_bdp_ping_data))
+			goto fail;
+		h2c->flags = (h2c->flags & ~H2_CF_BDP_PING) | H2_CF_BDP_PING_SENT;
+		h2c->bdp_date = now_ns;
+	}
+
+	/* emit SETTINGS with the initial window size raised by autotuning */
+	if ((h2c->flags & H2_CF_BDP_SETTINGS) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC))) {
+		if (!h2c_send_bdp_settings(h2c))
+			goto fail;
+		h2c->flags &= ~H2_CF_BDP_SETTINGS;
+	}
+
 	/* First we always process the flow control list because the streams
 	 * waiting there were already elected for immediate emission but were
 	 * blocked just on this.
@@ -4804,6 +5243,34 @@ static int h2_recv(struct h2c *h2c)
 	return !!ret || (h2c->flags & (H2_CF_RCVD_SHUT|H2_CF_ERROR));
 }
 
+/* Returns non-zero if the emission of the mux buffer may be postponed in order
+ * to gather frames from other streams into the same write, as configured by
+ * "tune.h2.{be,fe}.gather-size". This is only done for a single buffer holding
+ * less than this size on a connection having more than one stream, and never
+ * from the connection's tasklet: the caller will wake it up instead, so that
+ * the streams processed in the same scheduler pass have a chance to queue
+ * their frames before it runs and sends them all at once. This bounds the
+ * added latency to the current run queue pass.
+ */
+static inline int h2_may_gather(const struct h2c *h2c)
+{
+	uint gather = (h2c->flags & H2_CF_IS_BACK) ? h2_be_gather_size : h2_fe_gather_size;
+
+	if (!gather || h2c->nb_sc < 2)
+		return 0;
+
+	if (th_ctx->current == (struct task *)h2c->wait_event.tasklet)
+		return 0;
+
+	if (h2c->st0 < H2_CS_FRAME_H || h2c->st0 >= H2_CS_ERROR)
+		return 0;
+
+	if (h2c->flags & (H2_CF_MUX_BLOCK_ANY | H2_CF_DEM_MROOM | H2_CF_GOAWAY_FAILED))
+		return 0;
+
+	return br_single(h2c->mbuf) && br_data(h2c->mbuf) && br_data(h2c->mbuf) < gather;
+}
+
 /* Try to send data if possible.
  * The function returns 1 if data have been sent, otherwise zero.
  */
@@ -4864,6 +5331,16 @@ static int h2_send(struct h2c *h2c)
 		if (h2c->flags & (H2_CF_MUX_MFULL | H2_CF_DEM_MROOM))
 			flags |= CO_SFL_MSG_MORE;
 
+		if (!sent && h2_may_gather(h2c)) {
+			/* only a few bytes to send while other streams may
+			 * still produce frames: let them join this write.
+			 */
+			TRACE_STATE("postponing send to gather more frames", H2_EV_H2C_SEND, h2c->conn);
+			HA_ATOMIC_INC(&h2c->px_counters->gathered_sends);
+			tasklet_wakeup(h2c->wait_event.tasklet);
+			goto end;
+		}
+
 		to_send = br_count(h2c->mbuf);
 		if (to_send > 1) {
 			/* usually we want to emit small TLS records to speed
@@ -4885,6 +5362,7 @@ static int h2_send(struct h2c *h2c)
 				}
 				sent = 1;
 				to_send--;
+				HA_ATOMIC_INC(&h2c->px_counters->writes);
 				TRACE_DATA("sent data", H2_EV_H2C_SEND, h2c->conn, 0, buf, (void*)(long)ret);
 				b_del(buf, ret);
 				if (b_data(buf)) {
@@ -5497,6 +5975,9 @@ static int h2_sctl(struct stconn *sc, enum mux_sctl_type mux_sctl, void *output)
 		return ret;
 	case MUX_SCTL_TEVTS:
 		return h2s->sd->term_evts_log;
+	case MUX_SCTL_SET_URGENCY:
+		h2s->urgency = *((int *)output);
+		return ret;
 
 	default:
 		return -1;
@@ -5654,6 +6135,8 @@ static void h2_detach(struct sedesc *sd)
 					 !LIST_INLIST(&h2c->conn->sess_el)) {
 					srv_add_to_avail_list(__objt_server(h2c->conn->target), h2c->conn);
 				}
+				else
+					srv_refresh_avail_conn(h2c->conn);
 			}
 		}
 	}
@@ -5744,9 +6227,9 @@ static void h2_do_shutr(struct h2s *h2s, struct se_abort_info *reason)
 	h2s->flags |= H2_SF_WANT_SHUTR;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2_list_add_prio(&h2c->fctl_list, h2s);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2_list_add_prio(&h2c->send_list, h2s);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -5834,9 +6317,9 @@ static void h2_do_shutw(struct h2s *h2s, struct se_abort_info *reason)
 	h2s->flags |= H2_SF_WANT_SHUTW;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2_list_add_prio(&h2c->fctl_list, h2s);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2_list_add_prio(&h2c->send_list, h2s);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -6475,6 +6958,7 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 	/* marker for end of headers */
 	list[hdr].n = ist("");
 
+	hpack_enc_begin(h2c->henc);
 	mbuf = br_tail(h2c->mbuf);
  retry:
 	if (!h2_get_buf(h2c, mbuf)) {
@@ -6491,6 +6975,8 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 		if (outbuf.size >= 9 || !b_space_wraps(mbuf))
 			break;
 	realign_again:
+		/* the header block will be encoded again */
+		hpack_enc_abort(h2c->henc);
 		b_slow_realign(mbuf, trash.area, b_data(mbuf));
 	}
 
@@ -6502,7 +6988,13 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 	write_n32(outbuf.area + 5, h2s->id); // 4 bytes
 	outbuf.data = 9;
 
-	if ((h2c->flags & (H2_CF_SHTS_UPDATED|H2_CF_DTSU_EMITTED)) == H2_CF_SHTS_UPDATED) {
+	if (h2c->henc) {
+		/* the encoder context follows the peer's table size */
+		if ((h2c->flags & H2_CF_SHTS_UPDATED) &&
+		    !hpack_enc_encode_dtsu(h2c->henc, &outbuf))
+			goto full;
+	}
+	else if ((h2c->flags & (H2_CF_SHTS_UPDATED|H2_CF_DTSU_EMITTED)) == H2_CF_SHTS_UPDATED) {
 		/* SETTINGS_HEADER_TABLE_SIZE changed, we must send an HPACK
 		 * dynamic table size update so that some clients are not
 		 * confused. In practice we only need to send the DTSU when the
@@ -6610,6 +7102,7 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 	/* commit the H2 response */
 	b_add(mbuf, outbuf.data);
 	h2c->flags |= H2_CF_MBUF_HAS_DATA;
+	HA_ATOMIC_INC(&h2c->px_counters->headers_sent);
 
 	/* indicates the HEADERS frame was sent, except for 1xx responses. For
 	 * 1xx responses, another HEADERS frame is expected.
@@ -6637,6 +7130,7 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s);
 	return ret;
  full:
+	hpack_enc_abort(h2c->henc);
 	if ((mbuf = br_tail_add(h2c->mbuf)) != NULL)
 		goto retry;
 	h2c->flags |= H2_CF_MUX_MFULL;
@@ -6648,6 +7142,7 @@ static size_t h2s_snd_fhdrs(struct h2s *h2s, struct htx *htx)
 	/* unparsable HTX messages, too large ones to be produced in the local
 	 * list etc go here (unrecoverable errors).
 	 */
+	hpack_enc_abort(h2c->henc);
 	h2s_error(h2s, H2_ERR_INTERNAL_ERROR);
 	ret = 0;
 	goto end;
@@ -6799,6 +7294,7 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
 	/* marker for end of headers */
 	list[hdr].n = ist("");
 
+	hpack_enc_begin(h2c->henc);
 	mbuf = br_tail(h2c->mbuf);
  retry:
 	if (!h2_get_buf(h2c, mbuf)) {
@@ -6815,6 +7311,8 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
 		if (outbuf.size >= 9 || !b_space_wraps(mbuf))
 			break;
 	realign_again:
+		/* the header block will be encoded again */
+		hpack_enc_abort(h2c->henc);
 		b_slow_realign(mbuf, trash.area, b_data(mbuf));
 	}
 
@@ -6826,6 +7324,11 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
 	write_n32(outbuf.area + 5, h2s->id); // 4 bytes
 	outbuf.data = 9;
 
+	/* the encoder context follows the peer's table size */
+	if (h2c->henc && (h2c->flags & H2_CF_SHTS_UPDATED) &&
+	    !hpack_enc_encode_dtsu(h2c->henc, &outbuf))
+		goto full;
+
 	/* encode the method, which necessarily is the first one */
 	if (!hpack_encode_method(&outbuf, sl->info.req.meth, meth)) {
 		if (b_space_wraps(mbuf))
@@ -7048,9 +7551,16 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
 	/* commit the H2 response */
 	b_add(mbuf, outbuf.data);
 	h2c->flags |= H2_CF_MBUF_HAS_DATA;
+	HA_ATOMIC_INC(&h2c->px_counters->headers_sent);
 	h2s->flags |= H2_SF_HEADERS_SENT;
 	h2s->st = H2_SS_OPEN;
 
+	if (h2c->henc && (h2c->flags & H2_CF_SHTS_UPDATED)) {
+		/* was sent above */
+		h2c->flags |= H2_CF_DTSU_EMITTED;
+		h2c->flags &= ~H2_CF_SHTS_UPDATED;
+	}
+
 	if (es_now) {
 		TRACE_PROTO("setting ES on HEADERS frame", H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s, htx);
 		// trim any possibly pending data (eg: inconsistent content-length)
@@ -7061,6 +7571,7 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
  end:
 	return ret;
  full:
+	hpack_enc_abort(h2c->henc);
 	if ((mbuf = br_tail_add(h2c->mbuf)) != NULL)
 		goto retry;
 	h2c->flags |= H2_CF_MUX_MFULL;
@@ -7072,6 +7583,7 @@ static size_t h2s_snd_bhdrs(struct h2s *h2s, struct htx *htx)
 	/* unparsable HTX messages, too large ones to be produced in the local
 	 * list etc go here (unrecoverable errors).
 	 */
+	hpack_enc_abort(h2c->henc);
 	h2s_error(h2s, H2_ERR_INTERNAL_ERROR);
 	ret = 0;
 	goto end;
@@ -7235,6 +7747,7 @@ static size_t h2s_make_data(struct h2s *h2s, struct buffer *buf, size_t count)
 		total += fsize;
 		fsize = 0;
 		h2c->flags |= H2_CF_MBUF_HAS_DATA;
+		HA_ATOMIC_INC(&h2c->px_counters->data_sent);
 
 		TRACE_PROTO("sent H2 DATA frame (zero-copy)", H2_EV_TX_FRAME|H2_EV_TX_DATA, h2c->conn, h2s);
 		goto out;
@@ -7361,6 +7874,7 @@ static size_t h2s_make_data(struct h2s *h2s, struct buffer *buf, size_t count)
 	/* commit the H2 response */
 	b_add(mbuf, fsize + 9);
 	h2c->flags |= H2_CF_MBUF_HAS_DATA;
+	HA_ATOMIC_INC(&h2c->px_counters->data_sent);
 
  out:
 	if (es_now) {
@@ -7475,6 +7989,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	struct buffer outbuf;
 	struct buffer *mbuf;
 	enum htx_blk_type type;
+	int hdrs_start = 9;
 	int ret = 0;
 	int hdr;
 	int idx;
@@ -7517,6 +8032,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	/* marker for end of trailers */
 	list[hdr].n = ist("");
 
+	hpack_enc_begin(h2c->henc);
 	mbuf = br_tail(h2c->mbuf);
  retry:
 	if (!h2_get_buf(h2c, mbuf)) {
@@ -7533,6 +8049,8 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 		if (outbuf.size >= 9 || !b_space_wraps(mbuf))
 			break;
 	realign_again:
+		/* the header block will be encoded again */
+		hpack_enc_abort(h2c->henc);
 		b_slow_realign(mbuf, trash.area, b_data(mbuf));
 	}
 
@@ -7544,6 +8062,12 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	write_n32(outbuf.area + 5, h2s->id); // 4 bytes
 	outbuf.data = 9;
 
+	/* the encoder context follows the peer's table size */
+	if (h2c->henc && (h2c->flags & H2_CF_SHTS_UPDATED) &&
+	    !hpack_enc_encode_dtsu(h2c->henc, &outbuf))
+		goto full;
+	hdrs_start = outbuf.data;
+
 	/* encode all headers */
 	for (idx = 0; idx < hdr; idx++) {
 		/* these ones do not exist in H2 or must not appear in
@@ -7572,13 +8096,15 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 		}
 	}
 
-	if (outbuf.data == 9) {
+	if (outbuf.data == hdrs_start) {
 		/* here we have a problem, we have nothing to emit (either we
 		 * received an empty trailers block followed or we removed its
 		 * contents above). Because of this we can't send a HEADERS
 		 * frame, so we have to cheat and instead send an empty DATA
-		 * frame conveying the ES flag.
+		 * frame conveying the ES flag. A possible table size update
+		 * is dropped, it will be sent with the next header block.
 		 */
+		outbuf.data = hdrs_start = 9;
 		outbuf.area[3] = H2_FT_DATA;
 		outbuf.area[4] = H2_F_DATA_END_STREAM;
 	}
@@ -7599,8 +8125,15 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	TRACE_PROTO("sent H2 trailers HEADERS frame", H2_EV_TX_FRAME|H2_EV_TX_HDR|H2_EV_TX_EOI, h2c->conn, h2s);
 	b_add(mbuf, outbuf.data);
 	h2c->flags |= H2_CF_MBUF_HAS_DATA;
+	HA_ATOMIC_INC(&h2c->px_counters->headers_sent);
 	h2s->flags |= H2_SF_ES_SENT;
 
+	if (hdrs_start > 9) {
+		/* a table size update was sent above */
+		h2c->flags |= H2_CF_DTSU_EMITTED;
+		h2c->flags &= ~H2_CF_SHTS_UPDATED;
+	}
+
 	if (h2s->st == H2_SS_OPEN)
 		h2s->st = H2_SS_HLOC;
 	else
@@ -7624,6 +8157,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s);
 	return ret;
  full:
+	hpack_enc_abort(h2c->henc);
 	if ((mbuf = br_tail_add(h2c->mbuf)) != NULL)
 		goto retry;
 	h2c->flags |= H2_CF_MUX_MFULL;
@@ -7635,6 +8169,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	/* unparsable HTX messages, too large ones to be produced in the local
 	 * list etc go here (unrecoverable errors).
 	 */
+	hpack_enc_abort(h2c->henc);
 	h2s_error(h2s, H2_ERR_INTERNAL_ERROR);
 	ret = 0;
 	goto end;
@@ -7667,11 +8202,11 @@ static int h2_subscribe(struct stconn *sc, int event_type, struct wait_event *es
 		    !LIST_INLIST(&h2s->list)) {
 			if (h2s->flags & H2_SF_BLK_MFCTL) {
 				TRACE_DEVEL("Adding to fctl list", H2_EV_STRM_SEND, h2c->conn, h2s);
-				LIST_APPEND(&h2c->fctl_list, &h2s->list);
+				h2_list_add_prio(&h2c->fctl_list, h2s);
 			}
 			else {
 				TRACE_DEVEL("Adding to send list", H2_EV_STRM_SEND, h2c->conn, h2s);
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2_list_add_prio(&h2c->send_list, h2s);
 			}
 		}
 	}
@@ -8213,6 +8748,7 @@ static size_t h2_done_ff(struct stconn *sc)
 	b_add(mbuf, 9);
 	h2s->sws -= total;
 	h2c->mws -= total;
+	HA_ATOMIC_INC(&h2c->px_counters->data_sent);
 	if (h2_send(h2s->h2c))
 		tasklet_wakeup(h2s->h2c->wait_event.tasklet);
 
@@ -8266,8 +8802,9 @@ static int h2_dump_h2s_info(struct buffer *msg, const struct h2s *h2s, const cha
 	head = h2s_rxbuf_head(h2s);
 	tail = h2s_rxbuf_tail(h2s);
 
-	chunk_appendf(msg, " h2s.id=%d .st=%s .flg=0x%04x .rxwin=%u .rxbuf.c=%u .t=%u@%p+%u/%u .h=%u@%p+%u/%u",
+	chunk_appendf(msg, " h2s.id=%d .st=%s .flg=0x%04x .prio=%u%s .rxwin=%u .rxbuf.c=%u .t=%u@%p+%u/%u .h=%u@%p+%u/%u",
 		      h2s->id, h2s_st_to_str(h2s->st), h2s->flags,
+		      h2s->urgency, h2s->incremental ? "i" : "",
 		      (uint)(h2s->next_max_ofs - h2s->curr_rx_ofs),
 		      h2s_rxbuf_cnt(h2s),
 		      tail ? (uint)b_data(tail) : 0,
@@ -8344,9 +8881,9 @@ static int h2_dump_h2c_info(struct buffer *msg, struct h2c *h2c, const char *pfx
 	hmbuf = br_head(h2c->mbuf);
 	tmbuf = br_tail(h2c->mbuf);
 	chunk_appendf(msg, " h2c.st0=%s .err=%d .maxid=%d .lastid=%d .flg=0x%04x"
-		      " .nbst=%u .nbsc=%u .nbrcv=%u .glitches=%d .evts=%s",
+		      " .nbst=%u .nbsc=%u .nbrcv=%u .bdp=%u/%uus .glitches=%d .evts=%s",
 		      h2c_st_to_str(h2c->st0), h2c->errcode, h2c->max_id, h2c->last_sid, h2c->flags,
-		      h2c->nb_streams, h2c->nb_sc, h2c->receiving_streams, h2c->glitches,
+		      h2c->nb_streams, h2c->nb_sc, h2c->receiving_streams, h2c->bdp_est, h2c->bdp_rtt, h2c->glitches,
 		      tevt_evts2str(h2c->term_evts_log));
 
 	if (pfx)
@@ -8557,6 +9094,42 @@ static int h2_parse_header_table_size(char **args, int section_type, struct prox
 	return 0;
 }
 
+/* config parser for global "tune.h2.encoder-table-size" */
+static int h2_parse_encoder_table_size(char **args, int section_type, struct proxy *curpx,
+                                       const struct proxy *defpx, const char *file, int line,
+                                       char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	h2_settings_encoder_table_size = atoi(args[1]);
+	if (h2_settings_encoder_table_size &&
+	    (h2_settings_encoder_table_size < 256 || h2_settings_encoder_table_size > 65536)) {
+		memprintf(err, "'%s' expects 0 or a numeric value between 256 and 65536.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.h2.encoder-huffman" */
+static int h2_parse_encoder_huffman(char **args, int section_type, struct proxy *curpx,
+                                    const struct proxy *defpx, const char *file, int line,
+                                    char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		h2_settings_encoder_huffman = 1;
+	else if (strcmp(args[1], "off") == 0)
+		h2_settings_encoder_huffman = 0;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off'.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 /* config parser for global "tune.h2.{be.,fe.,}initial-window-size" */
 static int h2_parse_initial_window_size(char **args, int section_type, struct proxy *curpx,
                                         const struct proxy *defpx, const char *file, int line,
@@ -8640,7 +9213,7 @@ static int h2_parse_max_frame_size(char **args, int section_type, struct proxy *
 	return 0;
 }
 
-/* config parser for global "tune.h2.{be.,fe.}rxbuf" */
+/* config parser for global "tune.h2.{be.,fe.}rxbuf{,-autotune-max}" */
 static int h2_parse_rxbuf(char **args, int section_type, struct proxy *curpx,
                           const struct proxy *defpx, const char *file, int line,
                           char **err)
@@ -8652,7 +9225,56 @@ static int h2_parse_rxbuf(char **args, int section_type, struct proxy *curpx,
 		return -1;
 
 	/* backend/frontend */
-	vptr = (args[0][8] == 'b') ? &h2_be_rxbuf : &h2_fe_rxbuf;
+	if (strcmp(args[0] + 11, "rxbuf-autotune-max") == 0)
+		vptr = (args[0][8] == 'b') ? &h2_be_rxbuf_autotune_max : &h2_fe_rxbuf_autotune_max;
+	else
+		vptr = (args[0][8] == 'b') ? &h2_be_rxbuf : &h2_fe_rxbuf;
+
+	*vptr = atoi(args[1]);
+	if ((errptr = parse_size_err(args[1], vptr)) != NULL) {
+		memprintf(err, "'%s': unexpected character '%c' in size argument '%s'.", args[0], *errptr, args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.h2.{be.,fe.}rxbuf-autotune" */
+static int h2_parse_rxbuf_autotune(char **args, int section_type, struct proxy *curpx,
+                                   const struct proxy *defpx, const char *file, int line,
+                                   char **err)
+{
+	int *vptr;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	/* backend/frontend */
+	vptr = (args[0][8] == 'b') ? &h2_be_rxbuf_autotune : &h2_fe_rxbuf_autotune;
+
+	if (strcmp(args[1], "on") == 0)
+		*vptr = 1;
+	else if (strcmp(args[1], "off") == 0)
+		*vptr = 0;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off'.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.h2.{be.,fe.}gather-size" */
+static int h2_parse_gather_size(char **args, int section_type, struct proxy *curpx,
+                                const struct proxy *defpx, const char *file, int line,
+                                char **err)
+{
+	const char *errptr;
+	uint *vptr;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	/* backend/frontend */
+	vptr = (args[0][8] == 'b') ? &h2_be_gather_size : &h2_fe_gather_size;
 
 	*vptr = atoi(args[1]);
 	if ((errptr = parse_size_err(args[1], vptr)) != NULL) {
@@ -8719,15 +9341,23 @@ INITCALL1(STG_REGISTER, register_mux_proto, &mux_proto_h2);
 
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.h2.be.gather-size",         h2_parse_gather_size            },
 	{ CFG_GLOBAL, "tune.h2.be.glitches-threshold",  h2_parse_glitches_threshold     },
 	{ CFG_GLOBAL, "tune.h2.be.initial-window-size", h2_parse_initial_window_size    },
 	{ CFG_GLOBAL, "tune.h2.be.max-concurrent-streams", h2_parse_max_concurrent_streams },
 	{ CFG_GLOBAL, "tune.h2.be.rxbuf",               h2_parse_rxbuf                  },
+	{ CFG_GLOBAL, "tune.h2.be.rxbuf-autotune",      h2_parse_rxbuf_autotune         },
+	{ CFG_GLOBAL, "tune.h2.be.rxbuf-autotune-max",  h2_parse_rxbuf                  },
+	{ CFG_GLOBAL, "tune.h2.fe.gather-size",         h2_parse_gather_size            },
 	{ CFG_GLOBAL, "tune.h2.fe.glitches-threshold",  h2_parse_glitches_threshold     },
 	{ CFG_GLOBAL, "tune.h2.fe.initial-window-size", h2_parse_initial_window_size    },
 	{ CFG_GLOBAL, "tune.h2.fe.max-concurrent-streams", h2_parse_max_concurrent_streams },
 	{ CFG_GLOBAL, "tune.h2.fe.max-total-streams",   h2_parse_max_total_streams      },
 	{ CFG_GLOBAL, "tune.h2.fe.rxbuf",               h2_parse_rxbuf                  },
+	{ CFG_GLOBAL, "tune.h2.fe.rxbuf-autotune",      h2_parse_rxbuf_autotune         },
+	{ CFG_GLOBAL, "tune.h2.fe.rxbuf-autotune-max",  h2_parse_rxbuf                  },
+	{ CFG_GLOBAL, "tune.h2.encoder-huffman",        h2_parse_encoder_huffman        },
+	{ CFG_GLOBAL, "tune.h2.encoder-table-size",     h2_parse_encoder_table_size     },
 	{ CFG_GLOBAL, "tune.h2.header-table-size",      h2_parse_header_table_size      },
 	{ CFG_GLOBAL, "tune.h2.initial-window-size",    h2_parse_initial_window_size    },
 	{ CFG_GLOBAL, "tune.h2.max-concurrent-streams", h2_parse_max_concurrent_streams },
@@ -8754,23 +9384,41 @@ static int init_h2()
 		return (ERR_ALERT | ERR_FATAL);
 	}
 
+	if (h2_settings_encoder_table_size) {
+		/* the table relies on hpack_tbl objects to be defragmented */
+		if (h2_settings_encoder_table_size > h2_settings_header_table_size) {
+			ha_warning("tune.h2.encoder-table-size cannot be larger than tune.h2.header-table-size, limiting it to %d.\n",
+			           h2_settings_header_table_size);
+			h2_settings_encoder_table_size = h2_settings_header_table_size;
+		}
+
+		pool_head_hpack_enc = create_pool("hpack_enc",
+		                                  offsetof(struct hpack_enc, dht) + h2_settings_encoder_table_size,
+		                                  MEM_F_SHARED|MEM_F_EXACT);
+		if (!pool_head_hpack_enc) {
+			ha_alert("failed to allocate hpack_enc memory pool\n");
+			return (ERR_ALERT | ERR_FATAL);
+		}
+	}
+
 	if (!h2_settings_initial_window_size)
 		h2_settings_initial_window_size =
 			MAX(16384, global.tune.bufsize - sizeof(struct htx) - sizeof(struct htx_blk));
 
-	max_bufs = h2_fe_settings_max_concurrent_streams ?
-	           h2_fe_settings_max_concurrent_streams :
-	           h2_settings_max_concurrent_streams;
-
-	max_bufs = MAX(max_bufs,
-	               h2_be_settings_max_concurrent_streams ?
-	               h2_be_settings_max_concurrent_streams :
-	               h2_settings_max_concurrent_streams);
-
-	/* check for forced rxbufs */
-	rx_bufs = MAX(h2_be_rxbuf, h2_fe_rxbuf);
-	rx_bufs = (rx_bufs + global.tune.bufsize - 9 - 1) / (global.tune.bufsize - 9);
-	max_bufs = MAX(max_bufs, rx_bufs);
+	/* each side uses at least one rxbuf per stream, or the forced rxbufs,
+	 * possibly grown by autotuning.
+	 */
+	rx_bufs = MAX(h2_rx_nbufs(h2_fe_rxbuf),
+	              h2_fe_settings_max_concurrent_streams ?
+	              h2_fe_settings_max_concurrent_streams :
+	              h2_settings_max_concurrent_streams);
+	max_bufs = h2_rx_max_bufs(0, rx_bufs);
+
+	rx_bufs = MAX(h2_rx_nbufs(h2_be_rxbuf),
+	              h2_be_settings_max_concurrent_streams ?
+	              h2_be_settings_max_concurrent_streams :
+	              h2_settings_max_concurrent_streams);
+	max_bufs = MAX(max_bufs, h2_rx_max_bufs(1, rx_bufs));
 
 	pool_head_h2_rx_bufs = create_pool("h2_rx_bufs",
 	                                   (max_bufs + 1) * sizeof(struct bl_elem),
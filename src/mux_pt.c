@@ -595,7 +595,7 @@ static size_t mux_pt_nego_ff(struct stconn *sc, struct buffer *input, size_t cou
 		int can_splice = XPRT_CONN_CAN_NOT_SPLICE;
 
 		if (conn->xprt->snd_pipe && conn->xprt->get_capability &&
-		    conn->xprt->get_capability(conn, conn->xprt_ctx, XPRT_CAN_SPLICE, &can_splice) == 0 &&
+		    conn->xprt->get_capability(conn, conn->xprt_ctx, XPRT_CAN_SPLICE_SEND, &can_splice) == 0 &&
 		    can_splice == XPRT_CONN_CAN_SPLICE &&
 		    (ctx->sd->iobuf.pipe || (pipes_used < global.maxpipes && (ctx->sd->iobuf.pipe = get_pipe())))) {
 			ctx->sd->iobuf.offset = 0;
@@ -685,7 +685,7 @@ static int mux_pt_fastfwd(struct stconn *sc, unsigned int count, unsigned int fl
 		int can_splice = XPRT_CONN_CAN_NOT_SPLICE;
 
 		if (conn->xprt->get_capability &&
-		    conn->xprt->get_capability(conn, conn->xprt_ctx, XPRT_CAN_SPLICE, &can_splice) == 0 &&
+		    conn->xprt->get_capability(conn, conn->xprt_ctx, XPRT_CAN_SPLICE_RECV, &can_splice) == 0 &&
 		    can_splice == XPRT_CONN_CAN_SPLICE)
 			nego_flags |= NEGO_FF_FL_MAY_SPLICE;
 		else if (can_splice == XPRT_CONN_COULD_SPLICE)
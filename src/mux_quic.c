@@ -9,6 +9,7 @@
 #include <haproxy/dynbuf.h>
 #include <haproxy/global-t.h>
 #include <haproxy/h3.h>
+#include <haproxy/http-t.h>
 #include <haproxy/list.h>
 #include <haproxy/ncbuf.h>
 #include <haproxy/pool.h>
@@ -149,6 +150,8 @@ static struct qcs *qcs_new(struct qcc *qcc, uint64_t id, enum qcs_type type)
 	LIST_INIT(&qcs->el_fctl);
 	LIST_INIT(&qcs->el_buf);
 	qcs->start = TICK_ETERNITY;
+	qcs->urgency = HTTP_PRIO_URG_DFLT;
+	qcs->incremental = 0;
 
 	/* store transport layer stream descriptor in qcc tree */
 	qcs->id = qcs->by_id.key = id;
@@ -1566,6 +1569,33 @@ static void qcc_clear_frms(struct qcc *qcc)
 	}
 }
 
+/* Returns the sort key of <qcs> in its connection send_list. Streams with a
+ * pending RESET_STREAM/STOP_SENDING or used for metadata always come first,
+ * then streams are ordered by RFC9218 urgency, non-incremental ones before
+ * incremental ones of the same urgency.
+ */
+static inline int qcs_send_prio(const struct qcs *qcs)
+{
+	if (qcs->flags & (QC_SF_TO_RESET|QC_SF_TO_STOP_SENDING|QC_SF_TXBUB_OOB))
+		return -1;
+	return (qcs->urgency << 1) | qcs->incremental;
+}
+
+/* Inserts <qcs> in <qcc> send_list after all streams of the same or a higher
+ * priority. Streams of equal priority remain in FIFO order.
+ */
+static void qcc_send_list_insert(struct qcc *qcc, struct qcs *qcs)
+{
+	const int prio = qcs_send_prio(qcs);
+	struct qcs *cur;
+
+	list_for_each_entry_rev(cur, &qcc->send_list, el_send) {
+		if (qcs_send_prio(cur) <= prio)
+			break;
+	}
+	LIST_INSERT(&cur->el_send, &qcs->el_send);
+}
+
 /* Register <qcs> stream for emission of STREAM, STOP_SENDING or RESET_STREAM.
  * Set <urg> to true if stream should be emitted in priority. This is useful
  * when sending STOP_SENDING or RESET_STREAM, or for emission on an application
@@ -1586,10 +1616,47 @@ static void _qcc_send_stream(struct qcs *qcs, int urg)
 	}
 	else {
 		if (!LIST_INLIST(&qcs->el_send))
-			LIST_APPEND(&qcs->qcc->send_list, &qcs->el_send);
+			qcc_send_list_insert(qcc, qcs);
 	}
 }
 
+/* Sets the RFC9218 priority of <qcs> to <urgency> and <incremental>. If the
+ * stream is already waiting for emission, it is moved accordingly in the send
+ * list.
+ */
+void qcs_set_prio(struct qcs *qcs, uint8_t urgency, uint8_t incremental)
+{
+	struct qcc *qcc = qcs->qcc;
+
+	if (qcs->urgency == urgency && qcs->incremental == incremental)
+		return;
+
+	TRACE_STATE("updating stream priority", QMUX_EV_QCS_SEND, qcc->conn, qcs);
+	qcs->urgency = urgency;
+	qcs->incremental = incremental;
+
+	/* <el_send> is also used for purg_list by completed streams */
+	if (LIST_INLIST(&qcs->el_send) && !qcs_is_completed(qcs) &&
+	    qcs_send_prio(qcs) >= 0) {
+		qcc_clear_frms(qcc);
+		LIST_DEL_INIT(&qcs->el_send);
+		qcc_send_list_insert(qcc, qcs);
+	}
+}
+
+/* Sets the RFC9218 priority of stream <id> of <qcc> if it is currently open.
+ * This is used for priority updates which may reference streams not opened
+ * yet or already closed, which are ignored.
+ */
+void qcc_set_stream_prio(struct qcc *qcc, uint64_t id, uint8_t urgency, uint8_t incremental)
+{
+	struct eb64_node *node;
+
+	node = eb64_lookup(&qcc->streams_by_id, id);
+	if (node)
+		qcs_set_prio(eb64_entry(node, struct qcs, by_id), urgency, incremental);
+}
+
 /* Prepare for the emission of RESET_STREAM on <qcs> with error code <err>. */
 void qcc_reset_stream(struct qcs *qcs, int err)
 {
@@ -2808,7 +2875,8 @@ static int qcc_emit_rs_ss(struct qcc *qcc)
 static int qcc_build_frms(struct qcc *qcc, struct list *qcs_failed)
 {
 	struct list *frms = &qcc->tx.frms;
-	struct qcs *qcs, *qcs_tmp, *first_qcs = NULL;
+	struct list qcs_sent = LIST_HEAD_INIT(qcs_sent);
+	struct qcs *qcs, *qcs_tmp;
 	uint64_t window_conn = qfctl_rcap(&qcc->tx.fc);
 	int ret = 0, total = 0;
 
@@ -2818,10 +2886,6 @@ static int qcc_build_frms(struct qcc *qcc, struct list *qcs_failed)
 	BUG_ON(!LIST_ISEMPTY(&qcc->tx.frms));
 
 	list_for_each_entry_safe(qcs, qcs_tmp, &qcc->send_list, el_send) {
-		/* Check if all QCS were processed. */
-		if (qcs == first_qcs)
-			break;
-
 		TRACE_DATA("prepare for data transfer", QMUX_EV_QCC_SEND, qcc->conn, qcs);
 
 		/* Streams with RS/SS must be handled via qcc_emit_rs_ss(). */
@@ -2842,19 +2906,25 @@ static int qcc_build_frms(struct qcc *qcc, struct list *qcs_failed)
 			}
 
 			total += ret;
-			if (ret) {
-				/* Move QCS with some bytes transferred at the
-				 * end of send-list for next iterations.
+			if (ret && qcs->incremental) {
+				/* Incremental streams with some bytes
+				 * transferred are moved at the end of their
+				 * priority level for next iterations, so that
+				 * they share the bandwidth. Non-incremental
+				 * ones keep their place so that they are
+				 * served one after the other (RFC9218#10).
 				 */
 				LIST_DEL_INIT(&qcs->el_send);
-				LIST_APPEND(&qcc->send_list, &qcs->el_send);
-				/* Remember first moved QCS as checkpoint to interrupt loop */
-				if (!first_qcs)
-					first_qcs = qcs;
+				LIST_APPEND(&qcs_sent, &qcs->el_send);
 			}
 		}
 	}
 
+	list_for_each_entry_safe(qcs, qcs_tmp, &qcs_sent, el_send) {
+		LIST_DEL_INIT(&qcs->el_send);
+		qcc_send_list_insert(qcc, qcs);
+	}
+
 	TRACE_LEAVE(QMUX_EV_QCC_SEND, qcc->conn);
 	return total;
 }
@@ -3028,11 +3098,11 @@ static int qcc_io_send(struct qcc *qcc)
 	}
 
  out:
-	/* Re-insert on-error QCS at the end of the send-list. */
+	/* Re-insert on-error QCS at the end of their send-list priority level. */
 	if (!LIST_ISEMPTY(&qcs_failed)) {
 		list_for_each_entry_safe(qcs, qcs_tmp, &qcs_failed, el_send) {
 			LIST_DEL_INIT(&qcs->el_send);
-			LIST_APPEND(&qcc->send_list, &qcs->el_send);
+			qcc_send_list_insert(qcc, qcs);
 		}
 
 		if (!qfctl_rblocked(&qcc->tx.fc))
@@ -3938,6 +4008,8 @@ static void qmux_strm_detach(struct sedesc *sd)
 				TRACE_DEVEL("mark connection as available for reuse", QMUX_EV_STRM_END, conn);
 				srv_add_to_avail_list(__objt_server(conn->target), conn);
 			}
+			else
+				srv_refresh_avail_conn(conn);
 		}
 	}
 
@@ -4365,7 +4437,7 @@ static int qmux_ctl(struct connection *conn, enum mux_ctl_type mux_ctl, void *ou
 static int qmux_sctl(struct stconn *sc, enum mux_sctl_type mux_sctl, void *output)
 {
 	int ret = 0;
-	const struct qcs *qcs = __sc_mux_strm(sc);
+	struct qcs *qcs = __sc_mux_strm(sc);
 	const struct qcc *qcc = qcs->qcc;
 	union mux_sctl_dbg_str_ctx *dbg_ctx;
 	struct buffer *buf;
@@ -4395,6 +4467,10 @@ static int qmux_sctl(struct stconn *sc, enum mux_sctl_type mux_sctl, void *outpu
 		dbg_ctx->ret.buf = *buf;
 		return ret;
 
+	case MUX_SCTL_SET_URGENCY:
+		qcs_set_prio(qcs, *((int *)output), qcs->incremental);
+		return ret;
+
 	default:
 		return -1;
 	}
@@ -3074,6 +3074,8 @@ static void spop_detach(struct sedesc *sd)
 				 !LIST_INLIST(&spop_conn->conn->sess_el)) {
 				srv_add_to_avail_list(__objt_server(spop_conn->conn->target), spop_conn->conn);
 			}
+			else
+				srv_refresh_avail_conn(spop_conn->conn);
 		}
 	}
 
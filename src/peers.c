@@ -188,6 +188,11 @@ struct peer_prep_params {
 /* The maximum length of an encoded data length. */
 #define PEER_MSG_ENC_LENGTH_MAXLEN    5
 
+/* Room kept after a blob in an update message for its length and the next
+ * data types.
+ */
+#define PEER_MSG_BLOB_MARGIN          256
+
 /* Minimum 64-bits value encoded with 2 bytes */
 #define PEER_ENC_2BYTES_MIN                                  0xf0 /*               0xf0 (or 240) */
 /* 3 bytes */
@@ -841,6 +846,26 @@ int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_params *p)
 					}
 					break;
 				}
+				case STD_T_BLOB: {
+					struct stktable_blob *blob;
+
+					/* The data are encoded as their length followed
+					 * by the raw bytes. They are skipped if they
+					 * cannot fit in the message with some room left
+					 * for the next data types.
+					 */
+					blob = stktable_data_cast(data_ptr, std_t_blob);
+					if (!blob ||
+					    blob->len + PEER_MSG_BLOB_MARGIN > msg + size - cursor ||
+					    blob->len + PEER_MSG_BLOB_MARGIN > USHRT_MAX - (cursor - datamsg)) {
+						intencode(0, &cursor);
+						break;
+					}
+					intencode(blob->len, &cursor);
+					memcpy(cursor, blob->data, blob->len);
+					cursor += blob->len;
+					break;
+				}
 			}
 		}
 	}
@@ -2081,6 +2106,31 @@ int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt, int ex
 			}
 			break;
 		}
+		case STD_T_BLOB: {
+			struct stktable_blob *blob = NULL;
+
+			/* <decoded_int> is the length of the data */
+			if (decoded_int > msg_end - *msg_cur) {
+				TRACE_PROTO("malformed message", PEERS_EV_UPDTMSG,
+				            NULL, p, *msg_cur);
+				goto malformed_unlock;
+			}
+
+			data_ptr = stktable_data_ptr(table, ts, data_type);
+			if (data_ptr && !ignore) {
+				if (decoded_int) {
+					blob = malloc(sizeof(*blob) + decoded_int);
+					if (blob) {
+						blob->len = decoded_int;
+						memcpy(blob->data, *msg_cur, decoded_int);
+					}
+				}
+				free(stktable_data_cast(data_ptr, std_t_blob));
+				stktable_data_cast(data_ptr, std_t_blob) = blob;
+			}
+			*msg_cur += decoded_int;
+			break;
+		}
 		}
 	}
 
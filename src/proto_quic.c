@@ -24,6 +24,10 @@
 #include <netinet/udp.h>
 #include <netinet/in.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #include <import/ebtree-t.h>
 
 #include <haproxy/api.h>
@@ -41,6 +45,7 @@
 #include <haproxy/proto_quic.h>
 #include <haproxy/proto_udp.h>
 #include <haproxy/proxy-t.h>
+#include <haproxy/quic_cid.h>
 #include <haproxy/quic_conn.h>
 #include <haproxy/quic_sock.h>
 #include <haproxy/quic_tune.h>
@@ -65,6 +70,7 @@ static int quic_bind_listener(struct listener *listener, char *errmsg, int errle
 static int quic_connect_server(struct connection *conn, int flags);
 static void quic_enable_listener(struct listener *listener);
 static void quic_disable_listener(struct listener *listener);
+static void quic_sock_unbind(struct receiver *rx);
 static int quic_bind_tid_prep(struct connection *conn, int new_tid);
 static void quic_bind_tid_commit(struct connection *conn);
 static void quic_bind_tid_reset(struct connection *conn);
@@ -105,7 +111,7 @@ struct protocol proto_quic4 = {
 	.sock_prot      = IPPROTO_UDP,
 	.rx_enable      = sock_enable,
 	.rx_disable     = sock_disable,
-	.rx_unbind      = sock_unbind,
+	.rx_unbind      = quic_sock_unbind,
 	.rx_listening   = quic_sock_accepting_conn,
 	.default_iocb   = quic_lstnr_sock_fd_iocb,
 #ifdef SO_REUSEPORT
@@ -150,7 +156,7 @@ struct protocol proto_quic6 = {
 	.sock_prot      = IPPROTO_UDP,
 	.rx_enable      = sock_enable,
 	.rx_disable     = sock_disable,
-	.rx_unbind      = sock_unbind,
+	.rx_unbind      = quic_sock_unbind,
 	.rx_listening   = quic_sock_accepting_conn,
 	.default_iocb   = quic_lstnr_sock_fd_iocb,
 #ifdef SO_REUSEPORT
@@ -473,6 +479,149 @@ static int quic_alloc_rxbufs_listener(struct listener *l)
 	return 0;
 }
 
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+/* Returns the number of UDP sockets bound to the local address of <l> in the
+ * current network namespace, as reported by /proc/net/udp or /proc/net/udp6,
+ * or -1 if it cannot be determined. Sockets sharing a local address and port
+ * are necessarily in the same reuseport group.
+ */
+static int quic_cid_steering_group_size(const struct listener *l)
+{
+	const struct sockaddr_storage *addr = &l->rx.addr;
+	char line[512], local[64], key[64];
+	FILE *f;
+	int cnt = 0;
+
+	/* the kernel prints the raw 32-bit words of the address */
+	if (addr->ss_family == AF_INET) {
+		const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+
+		snprintf(key, sizeof(key), "%08X:%04X",
+		         sin->sin_addr.s_addr, ntohs(sin->sin_port));
+		f = fopen("/proc/net/udp", "r");
+	}
+	else if (addr->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)addr;
+		uint32_t w[4];
+
+		memcpy(w, &sin6->sin6_addr, sizeof(w));
+		snprintf(key, sizeof(key), "%08X%08X%08X%08X:%04X",
+		         w[0], w[1], w[2], w[3], ntohs(sin6->sin6_port));
+		f = fopen("/proc/net/udp6", "r");
+	}
+	else
+		return -1;
+
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%*d: %63s", local) == 1 && strcmp(local, key) == 0)
+			cnt++;
+	}
+	fclose(f);
+	return cnt;
+}
+#endif
+
+/* Attach to the reuseport group of the socket of <l> a classic BPF program
+ * which selects the receiving socket from the first byte of the destination
+ * CID of the datagrams modulo the number of sockets of its bind line, so that
+ * the packets of a connection are directly delivered to the socket of its
+ * owner thread (see quic_cid_steer()). This requires each listener of the bind
+ * line to be bound to a single thread ("shards by-thread") with its own socket
+ * bound by this process. The sockets being bound and appended to the group
+ * one listener at a time, the index of each one is the number of its siblings
+ * already listening, provided that the group contains no other socket. This is
+ * only guaranteed when this process created the group, so the group's size is
+ * checked first. It differs for example after a reload without socket transfer
+ * where the old process's sockets still occupy the first indexes. In this case,
+ * or if any socket was inherited, no program is attached and any program left
+ * by a previous process is detached, so that the datagrams are dispatched
+ * between threads as usual. This also remains the fallback for the ones
+ * reaching the wrong socket. See quic_sock_unbind() for sockets leaving the
+ * group.
+ */
+static void quic_cid_steering_attach(struct listener *l)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	struct listener *li;
+	struct sock_fprog prog;
+	uint idx = 0, cnt = 0, steered = 0;
+
+	list_for_each_entry(li, &l->bind_conf->listeners, by_bind) {
+		if (li->rx.flags & (RX_F_INHERITED | RX_F_MUST_DUP) ||
+		    my_popcountl(li->rx.bind_thread) != 1)
+			goto detach;
+
+		if (li != l && li->state >= LI_LISTEN) {
+			steered += !!li->rx.quic_steer_cnt;
+			idx++;
+		}
+		cnt++;
+	}
+
+	if (cnt < 2 || cnt > 256)
+		goto detach;
+
+	/* the group must only contain the sockets of the previous listeners,
+	 * all steered, and this one.
+	 */
+	if (steered != idx || quic_cid_steering_group_size(l) != idx + 1)
+		goto detach;
+
+	{
+		struct sock_filter code[] = {
+			/* A = first byte, long header if its MSB is set */
+			BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 0),
+			BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 3, 0),
+			/* short header: DCID starts right after */
+			BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 1),
+			BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, cnt),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+			/* long header: DCID after version and DCID length */
+			BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 6),
+			BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, cnt),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		};
+
+		prog.len = sizeof(code) / sizeof(code[0]);
+		prog.filter = code;
+		if (setsockopt(l->rx.fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1)
+			goto detach;
+	}
+
+	l->rx.quic_steer_idx = idx;
+	l->rx.quic_steer_cnt = cnt;
+	quic_cid_steering = 1;
+	return;
+
+ detach:
+#if defined(SO_DETACH_REUSEPORT_BPF)
+	/* harmless if no program is attached */
+	if (!(l->rx.flags & (RX_F_INHERITED | RX_F_MUST_DUP)))
+		setsockopt(l->rx.fd, SOL_SOCKET, SO_DETACH_REUSEPORT_BPF, &one, sizeof(one));
+#endif
+	return;
+#endif
+}
+
+/* Unbinds the receiver <rx> of a QUIC listener. When the socket was steered by
+ * quic_cid_steering_attach(), the kernel fills its slot in the reuseport group
+ * with the last socket, which shifts the indexes, so the program is detached
+ * first and the datagrams are dispatched between threads as usual.
+ */
+static void quic_sock_unbind(struct receiver *rx)
+{
+#if defined(__linux__) && defined(SO_DETACH_REUSEPORT_BPF)
+	if (rx->quic_steer_cnt && rx->fd != -1) {
+		setsockopt(rx->fd, SOL_SOCKET, SO_DETACH_REUSEPORT_BPF, &one, sizeof(one));
+		rx->quic_steer_cnt = 0;
+	}
+#endif
+	sock_unbind(rx);
+}
+
 /* This function tries to bind a QUIC4/6 listener. It may return a warning or
  * an error message in <errmsg> if the message is at most <errlen> bytes long
  * (including '\0'). Note that <errmsg> may be NULL if <errlen> is also zero.
@@ -540,6 +689,9 @@ static int quic_bind_listener(struct listener *listener, char *errmsg, int errle
 	if (global.tune.frontend_sndbuf)
 		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &global.tune.frontend_sndbuf, sizeof(global.tune.frontend_sndbuf));
 
+	if (quic_tune.fe.opts & QUIC_TUNE_FE_CID_STEERING)
+		quic_cid_steering_attach(listener);
+
 	listener_set_state(listener, LI_LISTEN);
 
  udp_return:
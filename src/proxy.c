@@ -1865,6 +1865,7 @@ static int proxy_defproxy_cpy(struct proxy *curproxy, const struct proxy *defpro
 		curproxy->conn_retries = defproxy->conn_retries;
 		curproxy->redispatch_after = defproxy->redispatch_after;
 		curproxy->max_ka_queue = defproxy->max_ka_queue;
+		curproxy->queue_delay = defproxy->queue_delay;
 
 		curproxy->tcpcheck_rules.flags = (defproxy->tcpcheck_rules.flags & ~TCPCHK_RULES_UNUSED_RS);
 		curproxy->tcpcheck_rules.list  = defproxy->tcpcheck_rules.list;
@@ -3014,17 +3015,25 @@ static int dump_servers_state(struct appctx *appctx)
 				     srv_check_addr, srv_agent_addr, srv->agent.port);
 		} else {
 			/* show servers conn */
+			uint avail_conns = 0, avail_strms = 0, avail_busiest = 0;
 			int thr;
 
+			for (thr = 0; thr < global.nbthread; thr++) {
+				avail_conns += HA_ATOMIC_LOAD(&srv->per_thr[thr].avail_nb);
+				avail_strms += HA_ATOMIC_LOAD(&srv->per_thr[thr].avail_strms);
+				avail_busiest = MAX(avail_busiest, HA_ATOMIC_LOAD(&srv->per_thr[thr].avail_busiest));
+			}
+
 			chunk_printf(&trash,
-			             "%s/%s %d/%d %s %u - %u %u %u %u %u %u %u %u %d %u",
+			             "%s/%s %d/%d %s %u - %u %u %u %u %u %u %u %u %d %u %u %u %u",
 			             HA_ANON_CLI(px->id), HA_ANON_CLI(srv->id),
 			             px->uuid, srv->puid, hash_ipanon(appctx->cli_ctx.anon_key, srv_addr, 0),
 			             srv->svc_port, srv->pool_purge_delay,
 			             srv->served,
 			             srv->curr_used_conns, srv->max_used_conns, srv->est_need_conns,
 			             srv->curr_sess_idle_conns,
-			             srv->curr_idle_nb, srv->curr_safe_nb, (int)srv->max_idle_conns, srv->curr_idle_conns);
+			             srv->curr_idle_nb, srv->curr_safe_nb, (int)srv->max_idle_conns, srv->curr_idle_conns,
+			             avail_conns, avail_strms, avail_busiest);
 
 			for (thr = 0; thr < global.nbthread && srv->curr_idle_thr; thr++)
 				chunk_appendf(&trash, " %u", srv->curr_idle_thr[thr]);
@@ -3053,7 +3062,7 @@ static int cli_io_handler_servers_state(struct appctx *appctx)
 			chunk_printf(&trash, "%d\n# %s\n", SRV_STATE_FILE_VERSION, SRV_STATE_FILE_FIELD_NAMES);
 		else
 			chunk_printf(&trash,
-			             "# bkname/svname bkid/svid addr port - purge_delay served used_cur used_max need_est idle_sess unsafe_nb safe_nb idle_lim idle_cur idle_per_thr[%d]\n",
+			             "# bkname/svname bkid/svid addr port - purge_delay served used_cur used_max need_est idle_sess unsafe_nb safe_nb idle_lim idle_cur avail_cur strm_cur strm_max idle_per_thr[%d]\n",
 			             global.nbthread);
 
 		if (applet_putchk(appctx, &trash) == -1)
@@ -159,8 +159,9 @@ void qmux_dump_qcc_info(struct buffer *msg, const struct qcc *qcc)
 
 void qmux_dump_qcs_info(struct buffer *msg, const struct qcs *qcs)
 {
-	chunk_appendf(msg, " qcs=%p .id=%llu .st=%s .flg=0x%04x", qcs, (ullong)qcs->id,
-	              qcs_st_to_str(qcs->st), qcs->flags);
+	chunk_appendf(msg, " qcs=%p .id=%llu .st=%s .flg=0x%04x .prio=%u%s", qcs, (ullong)qcs->id,
+	              qcs_st_to_str(qcs->st), qcs->flags,
+	              qcs->urgency, qcs->incremental ? "i" : "");
 
 	chunk_appendf(msg, " .rx=%llu/%llu rxb=%u(%u)",
 	              (ullong)qcs->rx.offset_max, (ullong)qcs->rx.msd,
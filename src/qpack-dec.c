@@ -30,6 +30,7 @@
 #include <haproxy/mux_quic.h>
 #include <haproxy/qpack-t.h>
 #include <haproxy/qpack-dec.h>
+#include <haproxy/qpack-enc.h>
 #include <haproxy/qpack-tbl.h>
 #include <haproxy/hpack-huff.h>
 #include <haproxy/hpack-tbl.h>
@@ -153,15 +154,19 @@ int qpack_decode_enc(struct buffer *buf, int fin, void *ctx)
 	return 0;
 }
 
-/* Decode an decoder stream.
+/* Decode a decoder stream. Its instructions are applied to the encoder context
+ * <enc>, which is NULL if the dynamic table is not used to encode.
  *
- * Returns 0 on success else non-zero.
+ * Returns the number of bytes consumed, or a negative value on error.
  */
-int qpack_decode_dec(struct buffer *buf, int fin, void *ctx)
+int qpack_decode_dec(struct buffer *buf, int fin, void *ctx, struct qpack_enc *enc)
 {
 	struct qcs *qcs = ctx;
-	size_t len;
+	const unsigned char *raw, *start;
+	unsigned char tmp[QPACK_DEC_INST_MAX];
+	uint64_t len, val;
 	unsigned char inst;
+	int ret = 0;
 
 	/* RFC 9204 4.2. Encoder and Decoder Streams
 	 *
@@ -175,38 +180,76 @@ int qpack_decode_dec(struct buffer *buf, int fin, void *ctx)
 		return -1;
 	}
 
-	len = b_data(buf);
-	qpack_debug_hexdump(stderr, "[QPACK-DEC-DEC] ", b_head(buf), 0, len);
+	qpack_debug_hexdump(stderr, "[QPACK-DEC-DEC] ", b_head(buf), 0, b_contig_data(buf, 0));
 
-	if (!len) {
+	if (!b_data(buf)) {
 		qpack_debug_printf(stderr, "[QPACK-DEC-DEC] empty stream\n");
 		return 0;
 	}
 
-	inst = (unsigned char)*b_head(buf) & QPACK_DEC_INST_BITMASK;
-	if (inst == QPACK_DEC_INST_ICINC) {
-		/* Insert count increment */
-
-		/* RFC 9204 4.4.3. Insert Count Increment
-		 *
-		 * An encoder that receives an Increment field equal to zero, or one
-		 * that increases the Known Received Count beyond what the encoder has
-		 * sent, MUST treat this as a connection error of type
-		 * QPACK_DECODER_STREAM_ERROR.
+	while (ret < b_data(buf)) {
+		/* Instructions are decoded one at a time. Those spanning the
+		 * buffer's wrapping point are first copied in <tmp>, which can
+		 * hold any valid one.
 		 */
+		start = raw = (const unsigned char *)b_peek(buf, ret);
+		len = b_contig_data(buf, ret);
+		if (len < b_data(buf) - ret && len < sizeof(tmp)) {
+			len = b_getblk(buf, (char *)tmp, MIN(sizeof(tmp), b_data(buf) - ret), ret);
+			start = raw = tmp;
+		}
 
-		/* For the moment haproxy does not emit dynamic table insertion. */
-		qcc_set_error(qcs->qcc, QPACK_ERR_DECODER_STREAM_ERROR, 1);
-		return -1;
-	}
-	else if (inst & QPACK_DEC_INST_SACK) {
-		/* Section Acknowledgment */
-	}
-	else if (inst & QPACK_DEC_INST_SCCL) {
-		/* Stream cancellation */
+		inst = *raw;
+		if (inst & QPACK_DEC_INST_SACK) {
+			/* Section Acknowledgment */
+			val = qpack_get_varint(&raw, &len, 7);
+		}
+		else {
+			/* Stream cancellation or Insert count increment */
+			val = qpack_get_varint(&raw, &len, 6);
+		}
+
+		if (len == (uint64_t)-1) {
+			/* truncated instruction, wait for more data */
+			break;
+		}
+
+		if (inst & QPACK_DEC_INST_SACK) {
+			/* RFC 9204 4.4.1. Section Acknowledgment
+			 *
+			 * If an encoder receives a Section Acknowledgment instruction
+			 * referring to a stream on which every encoded field section
+			 * with a non-zero Required Insert Count has already been
+			 * acknowledged, this MUST be treated as a connection error of
+			 * type QPACK_DECODER_STREAM_ERROR.
+			 */
+			if (!enc || qpack_enc_section_ack(enc, val))
+				goto err;
+		}
+		else if (inst & QPACK_DEC_INST_SCCL) {
+			if (enc)
+				qpack_enc_stream_cancel(enc, val);
+		}
+		else {
+			/* RFC 9204 4.4.3. Insert Count Increment
+			 *
+			 * An encoder that receives an Increment field equal to zero, or one
+			 * that increases the Known Received Count beyond what the encoder has
+			 * sent, MUST treat this as a connection error of type
+			 * QPACK_DECODER_STREAM_ERROR.
+			 */
+			if (!enc || qpack_enc_insert_count_inc(enc, val))
+				goto err;
+		}
+
+		ret += raw - start;
 	}
 
-	return 0;
+	return ret;
+
+ err:
+	qcc_set_error(qcs->qcc, QPACK_ERR_DECODER_STREAM_ERROR, 1);
+	return -1;
 }
 
 /* Decode a field section prefix made of <enc_ric> and <db> two varints.
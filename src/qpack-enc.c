@@ -1,7 +1,37 @@
 #include <haproxy/qpack-enc.h>
 
 #include <haproxy/buf.h>
+#include <haproxy/errors.h>
+#include <haproxy/hpack-huff.h>
+#include <haproxy/init.h>
 #include <haproxy/intops.h>
+#include <haproxy/pool.h>
+#include <haproxy/qpack-dec.h>
+#include <haproxy/qpack-tbl.h>
+#include <haproxy/quic_tune.h>
+#include <haproxy/xxhash.h>
+
+DECLARE_STATIC_TYPED_POOL(pool_head_qpack_enc, "qpack_enc", struct qpack_enc);
+
+/* Hashed indexes of the static table by name+value and by name only, giving
+ * the entry index + 1, 0 for an empty slot. Built at boot, see
+ * qpack_enc_init().
+ */
+#define QPACK_SHT_IDX_SLOTS 256
+static uint8_t qpack_sht_fv_idx[QPACK_SHT_IDX_SLOTS];
+static uint8_t qpack_sht_n_idx[QPACK_SHT_IDX_SLOTS];
+
+/* indexing policy for a header field */
+enum qpack_enc_pol {
+	QPACK_ENC_POL_INDEX = 0,  /* may be inserted in the dynamic table */
+	QPACK_ENC_POL_NOIDX,      /* must not be inserted */
+	QPACK_ENC_POL_NEVER,      /* never inserted nor looked up, never indexed by intermediaries */
+};
+
+/* max size of an encoded field section prefix for a table of at most
+ * QPACK_ENC_MAX_SIZE bytes.
+ */
+#define QPACK_ENC_PFX_MAX 6
 
 /* Returns the byte size required to encode <i> as a <prefix_size>-prefix
  * integer.
@@ -43,9 +73,8 @@ static int qpack_encode_prefix_integer(struct buffer *out, int i,
 	}
 	else {
 		int to_encode = i - mod;
-		const size_t sz = to_encode / mod;
 
-		if (b_room(out) < sz)
+		if (b_room(out) < qpack_get_prefix_int_size(i, prefix_size))
 			return 1;
 
 		b_putchr(out, before_prefix | mod);
@@ -267,14 +296,49 @@ int qpack_encode_field_section_line(struct buffer *out)
 
 #define QPACK_LFL_WLN_BIT  0x20 // Literal field line with literal name
 
-/* Encode a header in literal field line with literal name.
+/* Looks up field <n> (and <v> if not NULL) in the static table, <h> being the
+ * hash of the name (and value). Returns the entry index + 1, or 0 if not
+ * found.
+ */
+static inline int qpack_lookup_sht(uint32_t h, const struct ist n, const struct ist *v)
+{
+	const uint8_t *tbl = v ? qpack_sht_fv_idx : qpack_sht_n_idx;
+	uint32_t slot;
+	int ref;
+
+	for (slot = h % QPACK_SHT_IDX_SLOTS; (ref = tbl[slot]); slot = (slot + 1) % QPACK_SHT_IDX_SLOTS) {
+		if (isteq(qpack_sht[ref - 1].n, n) && (!v || isteq(qpack_sht[ref - 1].v, *v)))
+			return ref;
+	}
+	return 0;
+}
+
+/* Encode a header in literal field line with static name reference if its name
+ * is present in the static table, or with literal name otherwise.
  * Returns 0 on success else non-zero.
  */
 int qpack_encode_header(struct buffer *out, const struct ist n, const struct ist v)
 {
-	int i;
-	size_t sz = qpack_get_prefix_int_size(n.len, 3) + n.len +
-	            qpack_get_prefix_int_size(v.len, 7) + v.len;
+	int i, ref;
+	size_t sz;
+
+	ref = qpack_lookup_sht(XXH32(n.ptr, n.len, 0), n, NULL);
+	if (ref) {
+		sz = qpack_get_prefix_int_size(ref - 1, 4) +
+		     qpack_get_prefix_int_size(v.len, 7) + v.len;
+		if (sz > b_room(out))
+			return 1;
+
+		/* literal field line with name reference
+		 * | 0 | 1 | N | T | index (4+) |
+		 * T=1: static table
+		 */
+		qpack_encode_prefix_integer(out, ref - 1, 4, 0x50);
+		goto value;
+	}
+
+	sz = qpack_get_prefix_int_size(n.len, 3) + n.len +
+	     qpack_get_prefix_int_size(v.len, 7) + v.len;
 
 	if (sz > b_room(out))
 		return 1;
@@ -290,6 +354,7 @@ int qpack_encode_header(struct buffer *out, const struct ist n, const struct ist
 	for (i = 0; i < n.len; ++i)
 		b_putchr(out, n.ptr[i]);
 
+ value:
 	/* | 0 | . | . | . | . | . | . | . |
 	 * value len
 	 */
@@ -300,3 +365,680 @@ int qpack_encode_header(struct buffer *out, const struct ist n, const struct ist
 
 	return 0;
 }
+
+/* Encodes string literal <str> into <out> on a <bits>-bit prefix integer whose
+ * upper bits are set to <code>. The string is huffman-encoded, setting the
+ * <hbit> bit, if this makes it shorter. Returns 0 on success else non-zero, in
+ * which case <out> may have been partially filled.
+ */
+static int qpack_enc_str(struct buffer *out, const struct ist str, int bits,
+                         unsigned char code, unsigned char hbit)
+{
+	int hlen = huff_enc_len(str.ptr, str.len);
+
+	if (hlen < str.len) {
+		if (b_contig_space(out) < qpack_get_prefix_int_size(hlen, bits) + hlen)
+			return 1;
+		qpack_encode_prefix_integer(out, hlen, bits, code | hbit);
+		b_add(out, huff_enc(str.ptr, str.len, b_tail(out)));
+	}
+	else {
+		if (b_contig_space(out) < qpack_get_prefix_int_size(str.len, bits) + str.len)
+			return 1;
+		qpack_encode_prefix_integer(out, str.len, bits, code);
+		b_putblk(out, str.ptr, str.len);
+	}
+	return 0;
+}
+
+/* Returns the indexing policy for header field <n>:<v> with encoder context
+ * <enc>. Fields carrying credentials are never indexed (RFC9204#7.1.3), those
+ * whose value is almost always different are not inserted so as not to evict
+ * useful entries, and neither are those too large to leave room for at least
+ * one other entry of the same size.
+ */
+static inline enum qpack_enc_pol qpack_enc_policy(const struct qpack_enc *enc, const struct ist n, const struct ist v)
+{
+	if (isteq(n, ist("authorization")) ||
+	    isteq(n, ist("proxy-authorization")) ||
+	    isteq(n, ist("cookie")) ||
+	    isteq(n, ist("set-cookie")))
+		return QPACK_ENC_POL_NEVER;
+
+	if (2 * (n.len + v.len + 32) > enc->dht->size)
+		return QPACK_ENC_POL_NOIDX;
+
+	if (isteq(n, ist("content-length")) ||
+	    isteq(n, ist("date")) ||
+	    isteq(n, ist("age")) ||
+	    isteq(n, ist("etag")) ||
+	    isteq(n, ist("expires")) ||
+	    isteq(n, ist("last-modified")) ||
+	    isteq(n, ist("location")) ||
+	    isteq(n, ist("if-modified-since")) ||
+	    isteq(n, ist("if-none-match")) ||
+	    isteq(n, ist("content-range")))
+		return QPACK_ENC_POL_NOIDX;
+
+	return QPACK_ENC_POL_INDEX;
+}
+
+/* Returns the descriptor of the dynamic table entry of <enc> with absolute
+ * index <abs>, or NULL if it was evicted.
+ */
+static inline const struct qpack_dte *qpack_enc_get_dte(const struct qpack_enc *enc, uint64_t abs)
+{
+	const struct qpack_dht *dht = enc->dht;
+	unsigned int slot;
+
+	if (abs >= enc->ins_cnt || abs < enc->ins_cnt - dht->used)
+		return NULL;
+
+	slot = qpack_dht_get_tail(dht) + (abs - (enc->ins_cnt - dht->used));
+	if (slot >= dht->wrap)
+		slot -= dht->wrap;
+	return &dht->dte[slot];
+}
+
+/* Checks that reference <ref> (absolute index + 1) found in one of the indexes
+ * of <enc> still designates an entry of the dynamic table whose name is <n>
+ * and, if <v> is not NULL, whose value is <v>. Returns <ref> if so, otherwise
+ * 0.
+ */
+static inline uint64_t qpack_enc_lookup(const struct qpack_enc *enc, uint64_t ref,
+                                        const struct ist n, const struct ist *v)
+{
+	const struct qpack_dte *dte;
+
+	if (!ref || !(dte = qpack_enc_get_dte(enc, ref - 1)))
+		return 0;
+
+	if (!isteq(qpack_get_name(enc->dht, dte), n))
+		return 0;
+
+	if (v && !isteq(qpack_get_value(enc->dht, dte), *v))
+		return 0;
+
+	return ref;
+}
+
+/* Returns non-zero if the current field section of <enc> may reference the
+ * dynamic table entry of absolute index <abs>, and accounts for it.
+ */
+static inline int qpack_enc_use(struct qpack_enc *enc, uint64_t abs)
+{
+	if (!(enc->flags & QPACK_ENC_F_REF))
+		return 0;
+
+	/* referencing an entry not acknowledged yet may block the stream */
+	if (abs >= enc->krc && !(enc->flags & QPACK_ENC_F_BLOCK))
+		return 0;
+
+	if (abs + 1 > enc->ric)
+		enc->ric = abs + 1;
+	if (abs < enc->min_ref)
+		enc->min_ref = abs;
+	return 1;
+}
+
+/* Returns non-zero if an entry of <len> bytes (name + value) may be inserted
+ * in the dynamic table of <enc>, which requires that all entries it would
+ * evict are evictable (RFC9204#2.1.1): their insertion was acknowledged and
+ * they are not referenced by a field section not acknowledged yet, including
+ * the current one.
+ */
+static int qpack_enc_can_insert(const struct qpack_enc *enc, uint32_t len)
+{
+	const struct qpack_dht *dht = enc->dht;
+	uint64_t oldest, limit;
+	unsigned int tail, slot;
+	uint32_t room, k;
+
+	if (len + 32 > dht->size)
+		return 0;
+
+	room = dht->size - (dht->used * 32 + dht->total);
+	if (room >= len + 32)
+		return 1;
+
+	limit = MIN(enc->krc, enc->min_ref);
+	for (k = 0; k < enc->nb_sect; k++)
+		limit = MIN(limit, enc->sect[k].min_ref);
+
+	oldest = enc->ins_cnt - dht->used;
+	tail = qpack_dht_get_tail(dht);
+	for (k = 0; k < dht->used && oldest + k < limit; k++) {
+		slot = tail + k;
+		if (slot >= dht->wrap)
+			slot -= dht->wrap;
+		room += 32 + dht->dte[slot].nlen + dht->dte[slot].vlen;
+		if (room >= len + 32)
+			return 1;
+	}
+	return 0;
+}
+
+/* Emits into <ins> the encoder instruction to insert <n>:<v> in the dynamic
+ * table of <enc>, referencing the name of static entry <sref> or of dynamic
+ * entry <dref> (index + 1) if not null, and inserts it. Returns 0 on success
+ * else non-zero, in which case nothing was done.
+ */
+static int qpack_enc_insert(struct qpack_enc *enc, struct buffer *ins,
+                            int sref, uint64_t dref, uint32_t hn, uint32_t hnv,
+                            const struct ist n, const struct ist v)
+{
+	size_t data = b_data(ins);
+
+	if (!qpack_enc_can_insert(enc, n.len + v.len))
+		return 1;
+
+	if (sref) {
+		/* Insert with name reference (RFC9204#4.3.2)
+		 * | 1 | T | name index (6+) |, T=1: static table
+		 */
+		if (b_contig_space(ins) < qpack_get_prefix_int_size(sref - 1, 6))
+			goto full;
+		qpack_encode_prefix_integer(ins, sref - 1, 6, 0xc0);
+	}
+	else if (dref) {
+		/* relative index as per RFC9204#3.2.5 */
+		const uint64_t rel = enc->ins_cnt - dref;
+
+		if (b_contig_space(ins) < qpack_get_prefix_int_size(rel, 6))
+			goto full;
+		qpack_encode_prefix_integer(ins, rel, 6, 0x80);
+	}
+	else {
+		/* Insert with literal name (RFC9204#4.3.3)
+		 * | 0 | 1 | H | name length (5+) |
+		 */
+		if (qpack_enc_str(ins, n, 5, 0x40, 0x20))
+			goto full;
+	}
+
+	if (qpack_enc_str(ins, v, 7, 0x00, 0x80))
+		goto full;
+
+	/* room was checked above, entries are evicted exactly as the peer's
+	 * decoder will do.
+	 */
+	if (qpack_dht_insert(enc->dht, n, v) < 0)
+		goto full;
+
+	enc->ins_cnt++;
+	enc->fv_idx[hnv & (QPACK_ENC_IDX_SLOTS - 1)] = enc->ins_cnt;
+	enc->n_idx[hn & (QPACK_ENC_IDX_SLOTS - 1)] = enc->ins_cnt;
+	return 0;
+
+ full:
+	ins->data = data;
+	return 1;
+}
+
+/* Allocates an encoder context for a dynamic table of <capacity> bytes, which
+ * must not be larger than the one of pool_head_qpack_tbl objects. <max_capacity>
+ * is the SETTINGS_QPACK_MAX_TABLE_CAPACITY advertised by the peer, from which
+ * MaxEntries is derived regardless of the capacity really used. At most
+ * <max_blocked> streams may be blocked by references to entries not
+ * acknowledged yet. Returns NULL on allocation failure.
+ */
+struct qpack_enc *qpack_enc_alloc(uint32_t capacity, uint64_t max_capacity, uint32_t max_blocked)
+{
+	struct qpack_enc *enc;
+
+	enc = pool_alloc(pool_head_qpack_enc);
+	if (!enc)
+		return NULL;
+
+	enc->dht = qpack_dht_alloc();
+	if (!enc->dht) {
+		pool_free(pool_head_qpack_enc, enc);
+		return NULL;
+	}
+
+	qpack_dht_init(enc->dht, MIN(capacity, pool_head_qpack_tbl->size));
+	enc->ins_cnt = enc->krc = 0;
+	enc->max_entries = max_capacity / 32;
+	enc->max_blocked = max_blocked;
+	enc->flags = 0;
+	enc->nb_sect = 0;
+	enc->ric = 0;
+	enc->min_ref = ~0ULL;
+	memset(enc->fv_idx, 0, sizeof(enc->fv_idx));
+	memset(enc->n_idx, 0, sizeof(enc->n_idx));
+	return enc;
+}
+
+/* Releases encoder context <enc> which may be NULL. */
+void qpack_enc_free(struct qpack_enc *enc)
+{
+	if (!enc)
+		return;
+
+	qpack_dht_free(enc->dht);
+	pool_free(pool_head_qpack_enc, enc);
+}
+
+/* Emits into <ins> the Set Dynamic Table Capacity encoder instruction for the
+ * table of <enc>. This must be the first instruction emitted on the encoder
+ * stream. Returns 0 on success else non-zero.
+ */
+int qpack_enc_encode_sdtc(struct qpack_enc *enc, struct buffer *ins)
+{
+	if (b_room(ins) < qpack_get_prefix_int_size(enc->dht->size, 5))
+		return 1;
+
+	/* | 0 | 0 | 1 | capacity (5+) | */
+	qpack_encode_prefix_integer(ins, enc->dht->size, 5, 0x20);
+	return 0;
+}
+
+/* Starts encoding into <out> a field section for stream <id> with encoder
+ * context <enc>. Room is reserved for the prefix which will be written by
+ * qpack_enc_field_section_end() once known. Returns 0 on success else
+ * non-zero.
+ */
+int qpack_enc_field_section_begin(struct qpack_enc *enc, struct buffer *out, uint64_t id)
+{
+	uint32_t blocked = 0, k, j;
+	int self = 0;
+
+	if (b_contig_space(out) < QPACK_ENC_PFX_MAX)
+		return 1;
+
+	enc->id = id;
+	enc->base = enc->ins_cnt;
+	enc->ric = 0;
+	enc->min_ref = ~0ULL;
+	enc->flags = 0;
+
+	/* the section needs a slot to be tracked until acknowledged if it
+	 * references the table.
+	 */
+	if (enc->nb_sect < QPACK_ENC_MAX_SECT && enc->max_entries)
+		enc->flags |= QPACK_ENC_F_REF;
+
+	/* count the streams which are currently blocked by unacknowledged
+	 * entries (RFC9204#2.1.2), this one being allowed to reference such
+	 * entries if it is already blocked or if the limit is not reached.
+	 */
+	for (k = 0; k < enc->nb_sect; k++) {
+		if (enc->sect[k].ric <= enc->krc)
+			continue;
+		if (enc->sect[k].id == id)
+			self = 1;
+		for (j = 0; j < k; j++) {
+			if (enc->sect[j].id == enc->sect[k].id && enc->sect[j].ric > enc->krc)
+				break;
+		}
+		if (j == k)
+			blocked++;
+	}
+
+	if (self || blocked < enc->max_blocked)
+		enc->flags |= QPACK_ENC_F_BLOCK;
+
+	enc->pfx = b_data(out);
+	b_add(out, QPACK_ENC_PFX_MAX);
+	return 0;
+}
+
+/* Encodes header <n>:<v> into <out> for the current field section of encoder
+ * context <enc>. Fields present in the static or dynamic table are sent as
+ * indexed field lines, others as literals reusing a static or dynamic name
+ * reference when possible. Depending on the indexing policy, fields not found
+ * in the dynamic table are inserted by emitting an encoder instruction into
+ * <ins> if not NULL. Returns 0 on success else non-zero, in which case the
+ * whole field section must be encoded again. Instructions emitted into <ins>
+ * must be sent in any case.
+ */
+int qpack_enc_encode_header(struct qpack_enc *enc, struct buffer *out, struct buffer *ins,
+                            const struct ist n, const struct ist v)
+{
+	enum qpack_enc_pol pol;
+	size_t data = b_data(out);
+	uint32_t hn, hnv;
+	uint64_t dref = 0, abs;
+	int sref, found = 0;
+	unsigned char n_bit;
+
+	pol = qpack_enc_policy(enc, n, v);
+	hn  = XXH32(n.ptr, n.len, 0);
+	hnv = XXH32(v.ptr, v.len, hn);
+
+	if (pol != QPACK_ENC_POL_NEVER) {
+		sref = qpack_lookup_sht(hnv, n, &v);
+		if (sref) {
+			/* Indexed field line (RFC9204#4.5.2)
+			 * | 1 | T | index (6+) |, T=1: static table
+			 */
+			if (b_contig_space(out) < qpack_get_prefix_int_size(sref - 1, 6))
+				return 1;
+			qpack_encode_prefix_integer(out, sref - 1, 6, 0xc0);
+			return 0;
+		}
+
+		dref = qpack_enc_lookup(enc, enc->fv_idx[hnv & (QPACK_ENC_IDX_SLOTS - 1)], n, &v);
+		if (dref) {
+			found = 1;
+			if (qpack_enc_use(enc, dref - 1))
+				goto indexed;
+		}
+	}
+
+	sref = qpack_lookup_sht(hn, n, NULL);
+	dref = sref ? 0 : qpack_enc_lookup(enc, enc->n_idx[hn & (QPACK_ENC_IDX_SLOTS - 1)], n, NULL);
+
+	if (pol == QPACK_ENC_POL_INDEX && !found && ins &&
+	    !qpack_enc_insert(enc, ins, sref, dref, hn, hnv, n, v)) {
+		dref = enc->ins_cnt;
+		if (qpack_enc_use(enc, dref - 1))
+			goto indexed;
+		/* restore the name reference */
+		dref = sref ? 0 : qpack_enc_lookup(enc, enc->n_idx[hn & (QPACK_ENC_IDX_SLOTS - 1)], n, NULL);
+	}
+
+	if (dref && !qpack_enc_use(enc, dref - 1))
+		dref = 0;
+
+	/* Literal field lines: the N bit asks intermediaries never to index
+	 * the field.
+	 */
+	n_bit = (pol == QPACK_ENC_POL_NEVER);
+	if (sref) {
+		/* with name reference (RFC9204#4.5.4)
+		 * | 0 | 1 | N | T | name index (4+) |, T=1: static table
+		 */
+		if (b_contig_space(out) < qpack_get_prefix_int_size(sref - 1, 4))
+			goto full;
+		qpack_encode_prefix_integer(out, sref - 1, 4, 0x50 | (n_bit ? 0x20 : 0));
+	}
+	else if (dref && dref - 1 < enc->base) {
+		abs = enc->base - dref;
+		if (b_contig_space(out) < qpack_get_prefix_int_size(abs, 4))
+			goto full;
+		qpack_encode_prefix_integer(out, abs, 4, 0x40 | (n_bit ? 0x20 : 0));
+	}
+	else if (dref) {
+		/* with post-base name reference (RFC9204#4.5.5)
+		 * | 0 | 0 | 0 | 0 | N | name index (3+) |
+		 */
+		abs = dref - 1 - enc->base;
+		if (b_contig_space(out) < qpack_get_prefix_int_size(abs, 3))
+			goto full;
+		qpack_encode_prefix_integer(out, abs, 3, n_bit ? 0x08 : 0);
+	}
+	else {
+		/* with literal name (RFC9204#4.5.6)
+		 * | 0 | 0 | 1 | N | H | name length (3+) |
+		 */
+		if (qpack_enc_str(out, n, 3, QPACK_LFL_WLN_BIT | (n_bit ? 0x10 : 0), 0x08))
+			goto full;
+	}
+
+	if (qpack_enc_str(out, v, 7, 0x00, 0x80))
+		goto full;
+	return 0;
+
+ indexed:
+	if (dref - 1 < enc->base) {
+		/* Indexed field line (RFC9204#4.5.2)
+		 * | 1 | T | relative index (6+) |, T=0: dynamic table
+		 */
+		abs = enc->base - dref;
+		if (b_contig_space(out) < qpack_get_prefix_int_size(abs, 6))
+			goto full;
+		qpack_encode_prefix_integer(out, abs, 6, 0x80);
+	}
+	else {
+		/* Indexed field line with post-base index (RFC9204#4.5.3)
+		 * | 0 | 0 | 0 | 1 | index (4+) |
+		 */
+		abs = dref - 1 - enc->base;
+		if (b_contig_space(out) < qpack_get_prefix_int_size(abs, 4))
+			goto full;
+		qpack_encode_prefix_integer(out, abs, 4, 0x10);
+	}
+	return 0;
+
+ full:
+	out->data = data;
+	return 1;
+}
+
+/* Terminates the current field section encoded into <out> with encoder context
+ * <enc> by writing its prefix (RFC9204#4.5.1) in the room reserved for it by
+ * qpack_enc_field_section_begin(). If the section references the dynamic
+ * table, it is recorded until acknowledged by the decoder.
+ */
+void qpack_enc_field_section_end(struct qpack_enc *enc, struct buffer *out)
+{
+	char tmp[QPACK_ENC_PFX_MAX];
+	struct buffer pfx = b_make(tmp, sizeof(tmp), 0, 0);
+	char *start = b_head(out) + enc->pfx;
+
+	if (!enc->ric) {
+		qpack_encode_prefix_integer(&pfx, 0, 8, 0x00);
+		qpack_encode_prefix_integer(&pfx, 0, 7, 0x00);
+	}
+	else {
+		/* Encoded Required Insert Count (RFC9204#4.5.1.1) */
+		qpack_encode_prefix_integer(&pfx, enc->ric % (2 * enc->max_entries) + 1, 8, 0x00);
+
+		/* | S | Delta Base (7+) | (RFC9204#4.5.1.2) */
+		if (enc->base >= enc->ric)
+			qpack_encode_prefix_integer(&pfx, enc->base - enc->ric, 7, 0x00);
+		else
+			qpack_encode_prefix_integer(&pfx, enc->ric - enc->base - 1, 7, 0x80);
+
+		BUG_ON(enc->nb_sect >= QPACK_ENC_MAX_SECT);
+		enc->sect[enc->nb_sect].id = enc->id;
+		enc->sect[enc->nb_sect].ric = enc->ric;
+		enc->sect[enc->nb_sect].min_ref = enc->min_ref;
+		enc->nb_sect++;
+	}
+
+	memmove(start + b_data(&pfx), start + QPACK_ENC_PFX_MAX,
+	        b_data(out) - enc->pfx - QPACK_ENC_PFX_MAX);
+	memcpy(start, tmp, b_data(&pfx));
+	out->data -= QPACK_ENC_PFX_MAX - b_data(&pfx);
+
+	enc->flags = 0;
+	enc->min_ref = ~0ULL;
+}
+
+/* Removes entry <k> from the unacknowledged sections of <enc>. */
+static inline void qpack_enc_del_sect(struct qpack_enc *enc, uint32_t k)
+{
+	memmove(&enc->sect[k], &enc->sect[k + 1], (enc->nb_sect - k - 1) * sizeof(enc->sect[0]));
+	enc->nb_sect--;
+}
+
+/* Processes a Section Acknowledgment decoder instruction for stream <id>
+ * (RFC9204#4.4.1). Returns 0 on success or non-zero if there is no
+ * outstanding field section for this stream, which is a connection error.
+ */
+int qpack_enc_section_ack(struct qpack_enc *enc, uint64_t id)
+{
+	uint32_t k;
+
+	for (k = 0; k < enc->nb_sect; k++) {
+		if (enc->sect[k].id != id)
+			continue;
+
+		if (enc->sect[k].ric > enc->krc)
+			enc->krc = enc->sect[k].ric;
+		qpack_enc_del_sect(enc, k);
+		return 0;
+	}
+	return 1;
+}
+
+/* Processes a Stream Cancellation decoder instruction for stream <id>
+ * (RFC9204#4.4.2): its field sections will never be acknowledged.
+ */
+void qpack_enc_stream_cancel(struct qpack_enc *enc, uint64_t id)
+{
+	uint32_t k = 0;
+
+	while (k < enc->nb_sect) {
+		if (enc->sect[k].id == id)
+			qpack_enc_del_sect(enc, k);
+		else
+			k++;
+	}
+}
+
+/* Processes an Insert Count Increment decoder instruction of <inc>
+ * (RFC9204#4.4.3). Returns 0 on success or non-zero if <inc> is null or
+ * exceeds the number of insertions, which is a connection error.
+ */
+int qpack_enc_insert_count_inc(struct qpack_enc *enc, uint64_t inc)
+{
+	if (!inc || inc > enc->ins_cnt - enc->krc)
+		return 1;
+
+	enc->krc += inc;
+	return 0;
+}
+
+/* Builds the static table indexes and the pool of dynamic tables used by the
+ * encoders if enabled.
+ */
+static int qpack_enc_init(void)
+{
+	uint32_t hn, hnv, slot;
+	int i;
+
+	for (i = 0; i < QPACK_SHT_SIZE; i++) {
+		hn  = XXH32(qpack_sht[i].n.ptr, qpack_sht[i].n.len, 0);
+		hnv = XXH32(qpack_sht[i].v.ptr, qpack_sht[i].v.len, hn);
+
+		/* only the first entry of a given name is indexed by name */
+		if (!qpack_lookup_sht(hn, qpack_sht[i].n, NULL)) {
+			for (slot = hn % QPACK_SHT_IDX_SLOTS; qpack_sht_n_idx[slot]; slot = (slot + 1) % QPACK_SHT_IDX_SLOTS)
+				;
+			qpack_sht_n_idx[slot] = i + 1;
+		}
+
+		for (slot = hnv % QPACK_SHT_IDX_SLOTS; qpack_sht_fv_idx[slot]; slot = (slot + 1) % QPACK_SHT_IDX_SLOTS)
+			;
+		qpack_sht_fv_idx[slot] = i + 1;
+	}
+
+	if (quic_tune.qpack_enc_tbl_size) {
+		pool_head_qpack_tbl = create_pool("qpack_tbl", quic_tune.qpack_enc_tbl_size,
+		                                  MEM_F_SHARED|MEM_F_EXACT);
+		if (!pool_head_qpack_tbl) {
+			ha_alert("failed to allocate qpack_tbl memory pool\n");
+			return ERR_ALERT | ERR_FATAL;
+		}
+	}
+
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(qpack_enc_init);
+
+
+/* Encodes the same field section twice with the dynamic table, acknowledging
+ * the insertions in between: the first one must only use literals and emit
+ * insertions, the second one must only reference the table.
+ */
+static int qpack_enc_test_ack(void)
+{
+	char area[256], ins_area[256];
+	struct buffer out, ins = b_make(ins_area, sizeof(ins_area), 0, 0);
+	const struct ist n = ist("x-custom"), v = ist("some-value");
+	struct qpack_enc *enc;
+
+	enc = qpack_enc_alloc(4096, 4096, 0);
+	if (!enc || qpack_enc_encode_sdtc(enc, &ins))
+		return 1;
+
+	/* first section: RIC=0, Base=0, literal with literal name */
+	out = b_make(area, sizeof(area), 0, 0);
+	if (qpack_enc_field_section_begin(enc, &out, 0) ||
+	    qpack_enc_encode_header(enc, &out, &ins, n, v))
+		return 1;
+	qpack_enc_field_section_end(enc, &out);
+	if (area[0] != 0 || area[1] != 0 || (area[2] & 0xe0) != QPACK_LFL_WLN_BIT || enc->ins_cnt != 1)
+		return 1;
+
+	/* the insertion cannot be acknowledged twice */
+	if (qpack_enc_insert_count_inc(enc, 1) || !qpack_enc_insert_count_inc(enc, 1))
+		return 1;
+
+	/* second section: RIC=1 encoded as 2, Base=1, relative index 0 */
+	out = b_make(area, sizeof(area), 0, 0);
+	if (qpack_enc_field_section_begin(enc, &out, 200) ||
+	    qpack_enc_encode_header(enc, &out, &ins, n, v))
+		return 1;
+	qpack_enc_field_section_end(enc, &out);
+	if (b_data(&out) != 3 || area[0] != 2 || area[1] != 0 || (uchar)area[2] != 0x80)
+		return 1;
+
+	/* only the second section may be acknowledged, here by a two-byte
+	 * instruction split by the wrapping of the decoder stream's buffer.
+	 */
+	out = b_make(area, 8, 7, 2);
+	area[7] = (char)0xff; area[0] = 200 - 127;
+	if (!qpack_enc_section_ack(enc, 0) || qpack_decode_dec(&out, 0, NULL, enc) != 2 ||
+	    !qpack_enc_section_ack(enc, 200))
+		return 1;
+
+	qpack_enc_free(enc);
+	return 0;
+}
+
+/* With a table smaller than the peer's maximum capacity of 96000 bytes, the
+ * Required Insert Count must be encoded modulo 2 * MaxEntries = 6000 as derived
+ * from the peer's capacity (RFC9204#4.5.1.1), and not from the table's size.
+ * 6100 distinct fields are inserted and acknowledged, then the last one is
+ * referenced, hence an encoded RIC of 6100 % 6000 + 1 = 101.
+ */
+static int qpack_enc_test_ric_wrap(void)
+{
+	char area[256], ins_area[256], val[16];
+	struct buffer out, ins;
+	const struct ist n = ist("x-custom");
+	struct qpack_enc *enc;
+	struct ist v;
+	int i;
+
+	enc = qpack_enc_alloc(4096, 96000, 0);
+	if (!enc)
+		return 1;
+
+	for (i = 1; i <= 6100; i++) {
+		v = ist2(val, snprintf(val, sizeof(val), "v%d", i));
+		ins = b_make(ins_area, sizeof(ins_area), 0, 0);
+		out = b_make(area, sizeof(area), 0, 0);
+		if (qpack_enc_field_section_begin(enc, &out, 0) ||
+		    qpack_enc_encode_header(enc, &out, &ins, n, v))
+			return 1;
+		qpack_enc_field_section_end(enc, &out);
+		if (enc->ins_cnt != i || qpack_enc_insert_count_inc(enc, 1))
+			return 1;
+	}
+
+	out = b_make(area, sizeof(area), 0, 0);
+	if (qpack_enc_field_section_begin(enc, &out, 4) ||
+	    qpack_enc_encode_header(enc, &out, NULL, n, v))
+		return 1;
+	qpack_enc_field_section_end(enc, &out);
+	if (b_data(&out) != 3 || (uchar)area[0] != 101 || area[1] != 0 || (uchar)area[2] != 0x80)
+		return 1;
+
+	qpack_enc_free(enc);
+	return 0;
+}
+
+int qpack_enc_unittest(int argc, char **argv)
+{
+	if (!pool_head_qpack_tbl)
+		pool_head_qpack_tbl = create_pool("qpack_tbl", 4096, MEM_F_SHARED|MEM_F_EXACT);
+
+	return qpack_enc_test_ack() || qpack_enc_test_ric_wrap();
+}
+REGISTER_UNITTEST("qpack_enc", qpack_enc_unittest);
@@ -72,7 +72,9 @@ s *     queue's lock.
 #include <import/eb32tree.h>
 #include <haproxy/api.h>
 #include <haproxy/backend.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/counters.h>
+#include <haproxy/http.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/pool.h>
 #include <haproxy/queue.h>
@@ -239,6 +241,157 @@ static struct pendconn *pendconn_first(struct eb_root *pendconns)
 	return eb32_entry(node2, struct pendconn, node);
 }
 
+/* Retrieve the most recently queued pendconn from tree <pendconns> among
+ * those of the first class. Keys located before the time boundary are those
+ * which wrapped, so they are the most recent ones when they exist.
+ */
+static struct pendconn *pendconn_last(struct eb_root *pendconns)
+{
+	struct eb32_node *node, *node2;
+	u32 key;
+
+	node = eb32_first(pendconns);
+	if (!node)
+		return NULL;
+
+	key = KEY_CLASS_OFFSET_BOUNDARY(node->key);
+	if (KEY_OFFSET(key)) {
+		node2 = eb32_lookup_le(pendconns, key - 1);
+		if (node2 && KEY_CLASS(node2->key) == KEY_CLASS(node->key))
+			return eb32_entry(node2, struct pendconn, node);
+	}
+
+	/* no wrapped key in this class, take the last one of the class */
+	node2 = eb32_lookup_le(pendconns, KEY_CLASS(node->key) | 0xfffff);
+	return eb32_entry(node2, struct pendconn, node);
+}
+
+/* returns the integer square root of <x>, used by the queue delay control law */
+static inline uint queue_isqrt(uint x)
+{
+	uint r = 0, bit = 1U << 30;
+
+	while (bit > x)
+		bit >>= 2;
+
+	while (bit) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		}
+		else
+			r >>= 1;
+		bit >>= 2;
+	}
+	return r;
+}
+
+/* Returns the date of the next drop after <date> for queue <q> of proxy <px>,
+ * which is spaced by interval/sqrt(drop_count) from it.
+ */
+static inline uint queue_next_drop(const struct queue *q, const struct proxy *px, uint date)
+{
+	return tick_add(date, px->queue_delay.interval / queue_isqrt(q->drop_count ? q->drop_count : 1));
+}
+
+/* Returns non-zero if head entry <p> of queue <q> waited long enough for the
+ * queue to be considered as standing above the delay target, and updates the
+ * first_above date accordingly. The caller must hold the queue's lock.
+ */
+static int queue_above_target(struct queue *q, const struct pendconn *p)
+{
+	const struct proxy *px = q->px;
+
+	if ((uint)(now_ms - p->enq_date) < px->queue_delay.target || q->length <= 1) {
+		/* went below target, or would leave the queue empty */
+		q->first_above = TICK_ETERNITY;
+		return 0;
+	}
+
+	if (!tick_isset(q->first_above)) {
+		q->first_above = tick_add(now_ms, px->queue_delay.interval);
+		return 0;
+	}
+
+	return tick_is_expired(q->first_above, now_ms);
+}
+
+/* Drops pendconn <p> from queue <q> on behalf of the queue delay control. The
+ * entry is unlinked and marked PENDCONN_F_DROPPED and its stream is woken up
+ * so that it reports the error. All counters are updated. The caller must hold
+ * the queue's lock.
+ */
+static void pendconn_drop(struct queue *q, struct pendconn *p)
+{
+	if (q->sv)
+		__pendconn_unlink_srv(p);
+	else
+		__pendconn_unlink_prx(p);
+
+	p->flags |= PENDCONN_F_DROPPED;
+
+	/* the stream will need the queue's lock to see the entry unlinked */
+	task_wakeup(p->strm->task, TASK_WOKEN_RES);
+
+	_HA_ATOMIC_DEC(&q->length);
+	if (q->sv)
+		_HA_ATOMIC_DEC(&q->sv->queueslength);
+	else
+		_HA_ATOMIC_DEC(&q->px->queueslength);
+	_HA_ATOMIC_DEC(&q->px->totpend);
+}
+
+/* Applies the queue delay control law to queue <q> whose head is <p>, just
+ * before dequeuing it. This follows the CoDel algorithm (RFC8289): once the
+ * head's sojourn time has remained above the proxy's target for at least one
+ * interval, head entries are dropped at a pace which increases with the
+ * square root of the number of drops, until the sojourn time goes back below
+ * the target. This way requests which already waited too long are rejected
+ * early during brownouts instead of waiting for "timeout queue". The new head
+ * is returned, which may be NULL if all entries were dropped. The caller must
+ * hold the queue's lock.
+ */
+static struct pendconn *pendconn_apply_delay_target(struct queue *q, struct pendconn *p)
+{
+	const struct proxy *px = q->px;
+	int above = queue_above_target(q, p);
+
+	if (q->dropping) {
+		if (!above) {
+			q->dropping = 0;
+			return p;
+		}
+
+		while (q->dropping && tick_is_expired(q->drop_next, now_ms)) {
+			pendconn_drop(q, p);
+			q->drop_count++;
+			p = pendconn_first(&q->head);
+			if (!p || !queue_above_target(q, p))
+				q->dropping = 0;
+			else
+				q->drop_next = queue_next_drop(q, px, q->drop_next);
+		}
+	}
+	else if (above) {
+		uint delta = q->drop_count - q->drop_last;
+
+		pendconn_drop(q, p);
+		p = pendconn_first(&q->head);
+		q->dropping = 1;
+
+		/* if we were recently dropping, restart close to the
+		 * previous drop rate.
+		 */
+		if (delta > 1 && (int)(now_ms - q->drop_next) < (int)(16 * px->queue_delay.interval))
+			q->drop_count = delta;
+		else
+			q->drop_count = 1;
+		q->drop_next = queue_next_drop(q, px, now_ms);
+		q->drop_last = q->drop_count;
+	}
+	return p;
+}
+
 /* Process the next pending connection from either a server or a proxy, and
  * returns a strictly positive value on success (see below). If no pending
  * connection is found, 0 is returned.  Note that neither <srv> nor <px> may be
@@ -261,26 +414,44 @@ static struct pendconn *pendconn_first(struct eb_root *pendconns)
  */
 static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int px_ok, int tgrp)
 {
+	struct queue *srv_queue = &srv->per_tgrp[tgrp - 1].queue;
+	struct queue *px_queue = &px->per_tgrp[tgrp - 1].queue;
 	struct pendconn *p = NULL;
 	struct pendconn *pp = NULL;
 	u32 pkey, ppkey;
 	int served;
 	int maxconn;
 	int got_it = 0;
+	int lifo = 0;
 
 	p = NULL;
-	if (srv->per_tgrp[tgrp - 1].queue.length)
-		p = pendconn_first(&srv->per_tgrp[tgrp - 1].queue.head);
+	if (srv_queue->length) {
+		p = pendconn_first(&srv_queue->head);
+		if (p && px->queue_delay.target) {
+			p = pendconn_apply_delay_target(srv_queue, p);
+			if (p && srv_queue->dropping && (px->queue_delay.flags & PR_QD_F_LIFO)) {
+				p = pendconn_last(&srv_queue->head);
+				lifo = 1;
+			}
+		}
+	}
 
 	pp = NULL;
-	if (px_ok && px->per_tgrp[tgrp - 1].queue.length) {
+	if (px_ok && px_queue->length) {
 		/* the lock only remains held as long as the pp is
 		 * in the proxy's queue.
 		 */
-		HA_SPIN_LOCK(QUEUE_LOCK,  &px->per_tgrp[tgrp - 1].queue.lock);
-		pp = pendconn_first(&px->per_tgrp[tgrp - 1].queue.head);
+		HA_SPIN_LOCK(QUEUE_LOCK,  &px_queue->lock);
+		pp = pendconn_first(&px_queue->head);
+		if (pp && px->queue_delay.target) {
+			pp = pendconn_apply_delay_target(px_queue, pp);
+			if (pp && px_queue->dropping && (px->queue_delay.flags & PR_QD_F_LIFO)) {
+				pp = pendconn_last(&px_queue->head);
+				lifo = 1;
+			}
+		}
 		if (!pp)
-			HA_SPIN_UNLOCK(QUEUE_LOCK,  &px->per_tgrp[tgrp - 1].queue.lock);
+			HA_SPIN_UNLOCK(QUEUE_LOCK,  &px_queue->lock);
 	}
 
 	if (!p && !pp)
@@ -295,7 +466,7 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 	/* No more slot available, give up */
 	if (!got_it) {
 		if (pp)
-			HA_SPIN_UNLOCK(QUEUE_LOCK, &px->per_tgrp[tgrp - 1].queue.lock);
+			HA_SPIN_UNLOCK(QUEUE_LOCK, &px_queue->lock);
 		return 0;
 	}
 
@@ -325,7 +496,8 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 	if (ppkey < NOW_OFFSET_BOUNDARY())
 		ppkey += 0x100000; // key in the future
 
-	if (pkey <= ppkey)
+	/* while overloaded in LIFO mode, the most recent one is preferred */
+	if (lifo ? pkey >= ppkey : pkey <= ppkey)
 		goto use_p;
 
  use_pp:
@@ -337,7 +509,7 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 
 	/* now the element won't go, we can release the proxy */
 	__pendconn_unlink_prx(pp);
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &px->per_tgrp[tgrp - 1].queue.lock);
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &px_queue->lock);
 
 	pp->strm_flags |= SF_ASSIGNED;
 	pp->target = srv;
@@ -351,15 +523,15 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 	task_wakeup(pp->strm->task, TASK_WOKEN_RES);
 	HA_SPIN_UNLOCK(QUEUE_LOCK, &pp->del_lock);
 
-	_HA_ATOMIC_DEC(&px->per_tgrp[tgrp - 1].queue.length);
-	_HA_ATOMIC_INC(&px->per_tgrp[tgrp - 1].queue.idx);
+	_HA_ATOMIC_DEC(&px_queue->length);
+	_HA_ATOMIC_INC(&px_queue->idx);
 	_HA_ATOMIC_DEC(&px->queueslength);
 	return 1;
 
  use_p:
 	/* we don't need the px queue lock anymore, we have the server's lock */
 	if (pp)
-		HA_SPIN_UNLOCK(QUEUE_LOCK, &px->per_tgrp[tgrp - 1].queue.lock);
+		HA_SPIN_UNLOCK(QUEUE_LOCK, &px_queue->lock);
 
 	p->strm_flags |= SF_ASSIGNED;
 	p->target = srv;
@@ -373,8 +545,8 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 	task_wakeup(p->strm->task, TASK_WOKEN_RES);
 	__pendconn_unlink_srv(p);
 
-	_HA_ATOMIC_DEC(&srv->per_tgrp[tgrp - 1].queue.length);
-	_HA_ATOMIC_INC(&srv->per_tgrp[tgrp - 1].queue.idx);
+	_HA_ATOMIC_DEC(&srv_queue->length);
+	_HA_ATOMIC_INC(&srv_queue->idx);
 	_HA_ATOMIC_DEC(&srv->queueslength);
 	return 1;
 }
@@ -569,6 +741,8 @@ struct pendconn *pendconn_add(struct stream *strm)
 	p->node.key   = MAKE_KEY(strm->priority_class, strm->priority_offset);
 	p->strm       = strm;
 	p->strm_flags = strm->flags;
+	p->enq_date   = now_ms;
+	p->flags      = 0;
 	HA_SPIN_INIT(&p->del_lock);
 	strm->pend_pos = p;
 
@@ -697,9 +871,10 @@ int pendconn_redistribute(struct server *s)
 
 /* Try to dequeue pending connection attached to the stream <strm>. It must
  * always exists here. If the pendconn is still linked to the server or the
- * proxy queue, nothing is done and the function returns 1. Otherwise,
- * <strm>->flags and <strm>->target are updated, the pendconn is released and 0
- * is returned.
+ * proxy queue, nothing is done and the function returns 1. If it was dropped
+ * by the queue delay control, the pendconn is released and -1 is returned.
+ * Otherwise, <strm>->flags and <strm>->target are updated, the pendconn is
+ * released and 0 is returned.
  *
  * This function must be called by the stream itself, so in the context of
  * process_stream.
@@ -738,6 +913,12 @@ int pendconn_dequeue(struct stream *strm)
 	/* the pendconn is not queued anymore and will not be so we're safe
 	 * to proceed.
 	 */
+	if (p->flags & PENDCONN_F_DROPPED) {
+		strm->pend_pos = NULL;
+		pool_free(pool_head_pendconn, p);
+		return -1;
+	}
+
 	strm->flags &= ~(SF_DIRECT | SF_ASSIGNED);
 	strm->flags |= p->strm_flags & (SF_DIRECT | SF_ASSIGNED);
 
@@ -855,6 +1036,92 @@ static struct action_kw_list http_req_kws = {ILH, {
 
 INITCALL1(STG_REGISTER, http_req_keywords_register, &http_req_kws);
 
+/* parse the "queue-delay-target" backend keyword */
+static int proxy_parse_queue_delay_target(char **args, int section, struct proxy *curpx,
+                                          const struct proxy *defpx, const char *file, int line,
+                                          char **err)
+{
+	const char *res;
+	uint target, interval = 100;
+	uint flags = 0;
+	int status = 503;
+	int cur_arg;
+
+	if (!*args[1]) {
+		memprintf(err, "'%s' expects a delay (in milliseconds by default) or 'off'", args[0]);
+		return -1;
+	}
+
+	if (!(curpx->cap & PR_CAP_BE)) {
+		memprintf(err, "'%s' only available in backend or listen section", args[0]);
+		return -1;
+	}
+
+	if (strcmp(args[1], "off") == 0) {
+		curpx->queue_delay.target = 0;
+		curpx->queue_delay.flags = 0;
+		return 0;
+	}
+
+	res = parse_time_err(args[1], &target, TIME_UNIT_MS);
+	if (res == PARSE_TIME_OVER) {
+		memprintf(err, "timer overflow in argument '%s' to '%s' (maximum value is 2147483647 ms or ~24.8 days)",
+		          args[1], args[0]);
+		return -1;
+	}
+	else if (res == PARSE_TIME_UNDER || (!res && !target)) {
+		memprintf(err, "timer underflow in argument '%s' to '%s' (minimum value is 1 ms)",
+		          args[1], args[0]);
+		return -1;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in argument to '%s'", *res, args[0]);
+		return -1;
+	}
+
+	for (cur_arg = 2; *args[cur_arg]; cur_arg++) {
+		if (strcmp(args[cur_arg], "interval") == 0) {
+			res = parse_time_err(args[cur_arg + 1], &interval, TIME_UNIT_MS);
+			if (!*args[cur_arg + 1] || res || !interval) {
+				memprintf(err, "'%s' : '%s' expects a strictly positive delay (got '%s')",
+				          args[0], args[cur_arg], args[cur_arg + 1]);
+				return -1;
+			}
+			cur_arg++;
+		}
+		else if (strcmp(args[cur_arg], "status") == 0) {
+			status = atoi(args[cur_arg + 1]);
+			if (http_err_codes[http_get_status_idx(status)] != status) {
+				memprintf(err, "'%s' : '%s' expects a status code supported by 'errorfile' (got '%s')",
+				          args[0], args[cur_arg], args[cur_arg + 1]);
+				return -1;
+			}
+			cur_arg++;
+		}
+		else if (strcmp(args[cur_arg], "lifo") == 0) {
+			flags |= PR_QD_F_LIFO;
+		}
+		else {
+			memprintf(err, "'%s' : unknown argument '%s', expects 'interval', 'status' or 'lifo'",
+			          args[0], args[cur_arg]);
+			return -1;
+		}
+	}
+
+	curpx->queue_delay.target = target;
+	curpx->queue_delay.interval = interval;
+	curpx->queue_delay.status = status;
+	curpx->queue_delay.flags = flags;
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_LISTEN, "queue-delay-target", proxy_parse_queue_delay_target },
+	{ 0, NULL, NULL },
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 static int
 smp_fetch_priority_class(const struct arg *args, struct sample *smp, const char *kw, void *private)
 {
@@ -37,6 +37,13 @@
 #define QUIC_CID_TREES_CNT 256
 struct quic_cid_tree *quic_cid_trees;
 
+/* Set when CID steering is active on at least one listener. The first byte of
+ * the CIDs then designates the socket of their owner thread in the reuseport
+ * group, and is preserved by derived CIDs so that they reach the same socket
+ * as the client Initial packets.
+ */
+int quic_cid_steering;
+
 /* Initialize the stateless reset token attached to <conn_id> connection ID.
  * Returns 1 if succeeded, 0 if not.
  */
@@ -56,7 +63,8 @@ static int quic_stateless_reset_token_init(struct quic_connection_id *conn_id)
  *
  * This function is used to calculate the first connection CID derived from
  * client ODCID. This allows to optimize CID global tree by not inserting ODCID
- * as client is expected to replace it early.
+ * as client is expected to replace it early. With CID steering, the first byte
+ * of <orig> is kept so that the derived CID is steered to the same socket.
  *
  * Returns the derived CID.
  */
@@ -111,6 +119,9 @@ static struct quic_cid quic_derive_cid(const struct quic_cid *orig,
 		cid.data[i] = hash >> ((sizeof(hash) * 7) - (8 * i));
 	cid.len = sizeof(hash);
 
+	if (quic_cid_steering)
+		cid.data[0] = orig->data[0];
+
 	return cid;
 }
 
@@ -151,6 +162,10 @@ struct quic_connection_id *new_quic_cid(struct eb_root *root,
 			TRACE_ERROR("RAND_bytes() failed", QUIC_EV_CONN_TXPKT, qc);
 			goto err;
 		}
+		else if (qc && qc->li && qc->li->rx.quic_steer_cnt) {
+			quic_cid_steer(conn_id->cid.data, qc->li->rx.quic_steer_idx,
+			               qc->li->rx.quic_steer_cnt);
+		}
 	}
 	else {
 		/* Derive the new CID value from original CID. */
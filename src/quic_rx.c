@@ -14,6 +14,8 @@
 
 #include <haproxy/quic_rx.h>
 
+#include <haproxy/errors.h>
+#include <haproxy/global.h>
 #include <haproxy/h3.h>
 #include <haproxy/list.h>
 #include <haproxy/ncbmbuf.h>
@@ -34,11 +36,18 @@
 #include <haproxy/quic_tx.h>
 #include <haproxy/quic_utils.h>
 #include <haproxy/ssl_sock.h>
+#include <haproxy/task.h>
 #include <haproxy/trace.h>
 
 DECLARE_POOL(pool_head_quic_conn_rxbuf, "quic_conn_rxbuf", QUIC_CONN_RX_BUFSZ);
 DECLARE_TYPED_POOL(pool_head_quic_dgram, "quic_dgram", struct quic_dgram);
 DECLARE_TYPED_POOL(pool_head_quic_rx_packet, "quic_rx_packet", struct quic_rx_packet);
+DECLARE_TYPED_POOL(pool_head_quic_rx_decrypt_job, "quic_rx_decrypt_job", struct quic_rx_decrypt_job);
+
+/* Per-thread queues of packet decryption jobs, only allocated when helper
+ * threads were configured with "tune.quic.{fe,be}.rx.decrypt-helpers".
+ */
+static struct quic_rx_decrypt_queue *quic_rx_decrypt_queues;
 
 /* Decode an expected packet number from <truncated_on> its truncated value,
  * depending on <largest_pn> the largest received packet number, and <pn_nbits>
@@ -1219,6 +1228,154 @@ static int qc_qel_may_rm_hp(struct quic_conn *qc, struct quic_enc_level *qel)
 	return ret;
 }
 
+/* Decrypt the payload of the packets of <job> with <ctx> AEAD context until
+ * none is left to claim. Each packet is flagged with the result, and its
+ * length is updated on success as done by qc_pkt_decrypt().
+ */
+static void quic_rx_decrypt_job_run(struct quic_rx_decrypt_job *job, QUIC_AEAD_CTX *ctx)
+{
+	unsigned char iv[QUIC_TLS_IV_LEN];
+	uint i;
+
+	while ((i = HA_ATOMIC_FETCH_ADD(&job->next, 1)) < job->count) {
+		struct quic_rx_packet *pkt = job->pkts[i];
+
+		quic_aead_iv_build(iv, sizeof iv, job->iv, job->ivlen, pkt->pn);
+		if (quic_tls_decrypt(pkt->data + pkt->aad_len, pkt->len - pkt->aad_len,
+		                     pkt->data, pkt->aad_len,
+		                     ctx, job->aead, job->key, iv)) {
+			pkt->len -= QUIC_TLS_TAG_LEN;
+			pkt->flags |= QUIC_FL_RX_PACKET_DECRYPTED;
+		}
+		else
+			pkt->flags |= QUIC_FL_RX_PACKET_DECRYPT_ERR;
+	}
+}
+
+/* Release a reference on <job>, freeing it if it was the last one. */
+static void quic_rx_decrypt_job_drop(struct quic_rx_decrypt_job *job)
+{
+	if (!HA_ATOMIC_SUB_FETCH(&job->refcnt, 1))
+		pool_free(pool_head_quic_rx_decrypt_job, job);
+}
+
+/* Helper tasklet callback: takes part in the decryption jobs queued for the
+ * current thread. A job which was closed by its owner is only dereferenced.
+ * The keys are only accessed while the owner waits for the job to complete,
+ * so a private AEAD context is initialized for each job.
+ */
+static struct task *quic_rx_decrypt_helper(struct task *t, void *ctx, unsigned int state)
+{
+	struct quic_rx_decrypt_queue *queue = ctx;
+	struct quic_rx_decrypt_ref *ref;
+
+	while ((ref = MT_LIST_POP(&queue->jobs, struct quic_rx_decrypt_ref *, el))) {
+		struct quic_rx_decrypt_job *job = ref->job;
+		QUIC_AEAD_CTX *aead_ctx = NULL;
+
+		HA_ATOMIC_INC(&job->active);
+		__ha_barrier_full();
+		if (!HA_ATOMIC_LOAD(&job->closed) &&
+		    HA_ATOMIC_LOAD(&job->next) < job->count &&
+		    quic_tls_rx_ctx_init(&aead_ctx, job->aead, job->key)) {
+			quic_rx_decrypt_job_run(job, aead_ctx);
+			QUIC_AEAD_CTX_free(aead_ctx);
+		}
+		HA_ATOMIC_DEC(&job->active);
+		quic_rx_decrypt_job_drop(job);
+	}
+
+	return t;
+}
+
+/* Share the payload decryption of the 1-RTT packets of <qel> application
+ * encryption level for <qc> with helper threads of the same thread group when
+ * enough of them are pending. Only the packets of the current key phase are
+ * considered, the other ones are left to qc_pkt_decrypt() which also handles
+ * the key updates. The calling thread takes its share of the work and waits
+ * for the helpers which started to complete, so that the packets are all
+ * flagged as decrypted or failed on return. Nothing is done on memory
+ * allocation failure, the packets being then decrypted as usual.
+ */
+static void qc_rx_decrypt_offload(struct quic_conn *qc, struct quic_enc_level *qel)
+{
+	struct quic_tls_ctx *tls_ctx = &qel->tls_ctx;
+	struct quic_rx_decrypt_job *job;
+	struct eb64_node *node;
+	uint helpers, count = 0, i;
+
+	helpers = QUIC_TUNE_FB_GET(rx_decrypt_helpers, qc);
+	helpers = MIN(helpers, tg->count - 1);
+	if (!quic_rx_decrypt_queues || !helpers)
+		return;
+
+	for (node = eb64_first(&qel->rx.pkts); node; node = eb64_next(node)) {
+		if (++count >= QUIC_RX_DECRYPT_JOB_MIN)
+			break;
+	}
+	if (count < QUIC_RX_DECRYPT_JOB_MIN)
+		return;
+
+	job = pool_alloc(pool_head_quic_rx_decrypt_job);
+	if (!job)
+		return;
+
+	count = 0;
+	for (node = eb64_first(&qel->rx.pkts); node && count < QUIC_RX_DECRYPT_JOB_MAX;
+	     node = eb64_next(node)) {
+		struct quic_rx_packet *pkt = eb64_entry(node, struct quic_rx_packet, pn_node);
+
+		/* Same test as in qc_pkt_decrypt() */
+		if (pkt->type != QUIC_PACKET_TYPE_SHORT ||
+		    !(*pkt->data & QUIC_PACKET_KEY_PHASE_BIT) ^ !(tls_ctx->flags & QUIC_FL_TLS_KP_BIT_SET))
+			continue;
+
+		job->pkts[count++] = pkt;
+	}
+
+	if (count < QUIC_RX_DECRYPT_JOB_MIN) {
+		pool_free(pool_head_quic_rx_decrypt_job, job);
+		return;
+	}
+
+	TRACE_PROTO("sharing packets decryption", QUIC_EV_CONN_RXPKT, qc);
+
+	/* No more than one helper per QUIC_RX_DECRYPT_JOB_MIN packets */
+	helpers = MIN(helpers, count / QUIC_RX_DECRYPT_JOB_MIN);
+
+	job->aead = tls_ctx->rx.aead;
+	job->key = tls_ctx->rx.key;
+	job->iv = tls_ctx->rx.iv;
+	job->ivlen = tls_ctx->rx.ivlen;
+	job->count = count;
+	job->next = 0;
+	job->active = 0;
+	job->closed = 0;
+	job->refcnt = 1 + helpers;
+
+	for (i = 0; i < helpers; i++) {
+		struct quic_rx_decrypt_queue *queue =
+			&quic_rx_decrypt_queues[tg->base + (ti->ltid + 1 + i) % tg->count];
+
+		job->refs[i].job = job;
+		MT_LIST_INIT(&job->refs[i].el);
+		MT_LIST_APPEND(&queue->jobs, &job->refs[i].el);
+		tasklet_wakeup(queue->tasklet);
+	}
+
+	quic_rx_decrypt_job_run(job, tls_ctx->rx.ctx);
+
+	/* Prevent the helpers which did not start yet from accessing the
+	 * packets and wait for the other ones.
+	 */
+	HA_ATOMIC_STORE(&job->closed, 1);
+	__ha_barrier_full();
+	while (HA_ATOMIC_LOAD(&job->active))
+		__ha_cpu_relax();
+
+	quic_rx_decrypt_job_drop(job);
+}
+
 /* Process all the packets for all the encryption levels listed in <qc> QUIC connection.
  * Return 1 if succeeded, 0 if not.
  */
@@ -1237,6 +1394,9 @@ int qc_treat_rx_pkts(struct quic_conn *qc)
 		if (!LIST_ISEMPTY(&qel->rx.pqpkts) && qc_qel_may_rm_hp(qc, qel))
 			qc_rm_hp_pkts(qc, qel);
 
+		if (qel == qc->ael)
+			qc_rx_decrypt_offload(qc, qel);
+
 		node = eb64_first(&qel->rx.pkts);
 		while (node) {
 			struct quic_rx_packet *pkt;
@@ -1244,7 +1404,9 @@ int qc_treat_rx_pkts(struct quic_conn *qc)
 			pkt = eb64_entry(node, struct quic_rx_packet, pn_node);
 			TRACE_DATA("new packet", QUIC_EV_CONN_RXPKT,
 			           qc, pkt, NULL, qc->xprt_ctx->ssl);
-			if (!qc_pkt_decrypt(qc, qel, pkt)) {
+			if (!(pkt->flags & QUIC_FL_RX_PACKET_DECRYPTED) &&
+			    ((pkt->flags & QUIC_FL_RX_PACKET_DECRYPT_ERR) ||
+			     !qc_pkt_decrypt(qc, qel, pkt))) {
 				/* Drop the packet */
 				TRACE_ERROR("packet decryption failed -> dropped",
 				            QUIC_EV_CONN_RXPKT, qc, pkt);
@@ -2387,6 +2549,53 @@ int quic_dgram_parse(struct quic_dgram *dgram, struct quic_conn *from_qc,
 	return -1;
 }
 
+static int quic_alloc_rx_decrypt_queues(void)
+{
+	int i;
+
+	if (!quic_tune.fe.rx_decrypt_helpers && !quic_tune.be.rx_decrypt_helpers)
+		return ERR_NONE;
+
+	quic_rx_decrypt_queues = calloc(global.nbthread, sizeof(*quic_rx_decrypt_queues));
+	if (!quic_rx_decrypt_queues) {
+		ha_alert("Failed to allocate the quic decryption queues.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	for (i = 0; i < global.nbthread; ++i) {
+		struct quic_rx_decrypt_queue *queue = &quic_rx_decrypt_queues[i];
+
+		MT_LIST_INIT(&queue->jobs);
+		queue->tasklet = tasklet_new();
+		if (!queue->tasklet) {
+			ha_alert("Failed to allocate the quic decryption queue on thread %d.\n", i);
+			return ERR_ALERT | ERR_FATAL;
+		}
+
+		tasklet_set_tid(queue->tasklet, i);
+		queue->tasklet->context = queue;
+		queue->tasklet->process = quic_rx_decrypt_helper;
+	}
+
+	return ERR_NONE;
+}
+REGISTER_POST_CHECK(quic_alloc_rx_decrypt_queues);
+
+static int quic_deallocate_rx_decrypt_queues(void)
+{
+	int i;
+
+	if (quic_rx_decrypt_queues) {
+		for (i = 0; i < global.nbthread; ++i)
+			tasklet_free(quic_rx_decrypt_queues[i].tasklet);
+		free(quic_rx_decrypt_queues);
+		quic_rx_decrypt_queues = NULL;
+	}
+
+	return 1;
+}
+REGISTER_POST_DEINIT(quic_deallocate_rx_decrypt_queues);
+
 /*
  * Local variables:
  *  c-indent-level: 8
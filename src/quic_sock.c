@@ -39,6 +39,8 @@
 #include <haproxy/quic_rx.h>
 #include <haproxy/quic_sock.h>
 #include <haproxy/quic_tp-t.h>
+#include <haproxy/quic_tune.h>
+#include <haproxy/quic_tx-t.h>
 #include <haproxy/quic_trace.h>
 #include <haproxy/session.h>
 #include <haproxy/stats-t.h>
@@ -705,6 +707,257 @@ static int qc_may_use_saddr(struct quic_conn *qc)
 	        is_addr(&qc->local_addr));
 }
 
+/* Storage for the ancillary data of an emitted datagram: source address and
+ * GSO segment size.
+ */
+union quic_sock_cmsg {
+#ifdef IP_PKTINFO
+	char buf[CMSG_SPACE(sizeof(struct in_pktinfo)) + CMSG_SPACE(sizeof(uint16_t))];
+#endif /* IP_PKTINFO */
+#ifdef IPV6_RECVPKTINFO
+	char buf6[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(uint16_t))];
+#endif /* IPV6_RECVPKTINFO */
+	char bufaddr[CMSG_SPACE(sizeof(struct in_addr)) + CMSG_SPACE(sizeof(uint16_t))];
+	struct cmsghdr align;
+};
+
+/* Per-thread TX batches, only allocated with "tune.quic.fe.tx.batch". */
+static struct quic_tx_batch *quic_tx_batches;
+
+/* Returns non-zero if <sz> bytes emitted by <qc>, made of datagrams of
+ * <gso_size> bytes if not null, may be appended to the batched message <m> as
+ * new GSO segments. This requires the same socket and addresses, GSO to be
+ * usable, and all segments but the last one to have the same size.
+ */
+static int quic_tx_batch_may_merge(struct quic_conn *qc, const struct quic_tx_batch_msg *m,
+                                   size_t sz, uint16_t gso_size, int use_src)
+{
+#ifdef UDP_SEGMENT
+	size_t seg = m->gso ? m->gso : m->len;
+
+	if (m->li != qc->li || m->use_src != use_src)
+		return 0;
+
+	if (!quic_tune_test(QUIC_TUNE_FB_TX_UDP_GSO, qc) ||
+	    (qc->flags & QUIC_FL_CONN_UDP_GSO_EIO) ||
+	    (HA_ATOMIC_LOAD(&qc->li->flags) & LI_F_UDP_GSO_NOTSUPP))
+		return 0;
+
+	/* the last segment must be complete, and the new one(s) must fit */
+	if (m->len % seg || (gso_size ? gso_size != seg : sz > seg))
+		return 0;
+
+	if (m->len / seg + (sz + seg - 1) / seg > QUIC_MAX_GSO_DGRAMS)
+		return 0;
+
+	if (ipcmp(&m->dst, &qc->peer_addr, 1) != 0 ||
+	    (use_src && ipcmp(&m->src, &qc->local_addr, 1) != 0))
+		return 0;
+
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* Prepares <msg> to emit <len> bytes from <data> for the batched message <m>,
+ * using <vec> and <anc> as storage. <gso> is the GSO segment size, or 0.
+ */
+static void quic_tx_batch_prep_msg(struct msghdr *msg, struct iovec *vec, union quic_sock_cmsg *anc,
+                                   struct quic_tx_batch_msg *m, char *data, size_t len, uint16_t gso)
+{
+	struct cmsghdr *cmsg __maybe_unused = NULL;
+
+	memset(anc, 0, sizeof(*anc));
+	vec->iov_base = data;
+	vec->iov_len = len;
+
+	msg->msg_name = &m->dst;
+	msg->msg_namelen = get_addr_len(&m->dst);
+	msg->msg_iov = vec;
+	msg->msg_iovlen = 1;
+	msg->msg_control = NULL;
+	msg->msg_controllen = 0;
+	msg->msg_flags = 0;
+
+	if (m->use_src) {
+		msg->msg_control = anc->bufaddr;
+		cmsg_set_saddr(msg, &cmsg, &m->src);
+	}
+
+	if (gso) {
+		if (!msg->msg_control)
+			msg->msg_control = anc->bufaddr;
+		cmsg_set_gso(msg, &cmsg, gso);
+	}
+}
+
+/* Sends all the messages of TX batch <batch> then empties it. Consecutive
+ * messages using the same socket are sent with a single sendmmsg() call when
+ * available. The connections already consider the batched datagrams as sent,
+ * so emission errors are only accounted on the listener's proxy and the
+ * datagrams are lost, which is what already happens to connections using the
+ * listener socket on transient errors. If GSO is refused by the kernel, it is
+ * disabled on the listener and the message is sent again as individual
+ * datagrams.
+ */
+static void quic_tx_batch_flush(struct quic_tx_batch *batch)
+{
+	struct {
+		struct msghdr hdr;
+		struct iovec vec;
+		union quic_sock_cmsg anc;
+		uint idx;                 /* batched message index */
+		uint16_t gso;             /* GSO segment size or 0 */
+	} out[QUIC_TX_BATCH_MAXMSG];
+#ifdef __linux__
+	struct mmsghdr mmsg[QUIC_TX_BATCH_MAXMSG];
+#endif
+	uint idx = 0, seg = 0;
+
+	while (idx < batch->count) {
+		struct listener *li = batch->msgs[idx].li;
+		struct quic_counters *prx_counters;
+		int fd = li->rx.fd;
+		int n = 0, sent = 0;
+		int ret;
+
+		/* prepare all the consecutive messages for this socket */
+		while (n < QUIC_TX_BATCH_MAXMSG && idx < batch->count && batch->msgs[idx].li == li) {
+			struct quic_tx_batch_msg *m = &batch->msgs[idx];
+			size_t len = m->len - seg;
+			uint16_t gso = m->gso;
+
+			if (gso && (HA_ATOMIC_LOAD(&li->flags) & LI_F_UDP_GSO_NOTSUPP)) {
+				/* emit segments one at a time */
+				if (len > gso)
+					len = gso;
+				gso = 0;
+			}
+
+			quic_tx_batch_prep_msg(&out[n].hdr, &out[n].vec, &out[n].anc,
+			                       m, batch->area + m->ofs + seg, len, gso);
+			out[n].idx = idx;
+			out[n].gso = gso;
+			n++;
+
+			seg += len;
+			if (seg >= m->len) {
+				idx++;
+				seg = 0;
+			}
+		}
+
+		if (fd < 0)
+			continue;
+
+		prx_counters = EXTRA_COUNTERS_GET(li->bind_conf->frontend->extra_counters_fe, &quic_stats_module);
+		while (sent < n) {
+#ifdef __linux__
+			int i;
+
+			for (i = sent; i < n; i++)
+				mmsg[i].msg_hdr = out[i].hdr;
+
+			do {
+				ret = sendmmsg(fd, mmsg + sent, n - sent, MSG_DONTWAIT|MSG_NOSIGNAL);
+			} while (ret < 0 && errno == EINTR);
+#else
+			do {
+				ret = sendmsg(fd, &out[sent].hdr, MSG_DONTWAIT|MSG_NOSIGNAL);
+			} while (ret < 0 && errno == EINTR);
+			if (ret >= 0)
+				ret = 1;
+#endif
+			if (ret > 0) {
+				sent += ret;
+				continue;
+			}
+
+			if (errno == EIO && out[sent].gso) {
+				/* GSO not supported, rebuild from this message */
+				HA_ATOMIC_OR(&li->flags, LI_F_UDP_GSO_NOTSUPP);
+				idx = out[sent].idx;
+				seg = 0;
+				break;
+			}
+			else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* socket full, drop the remaining datagrams */
+				HA_ATOMIC_ADD(&prx_counters->socket_full, n - sent);
+				sent = n;
+			}
+			else if (errno == ENOTCONN || errno == EINPROGRESS) {
+				HA_ATOMIC_INC(&prx_counters->sendto_err);
+				sent++;
+			}
+			else {
+				HA_ATOMIC_INC(&prx_counters->sendto_err_unknown);
+				sent++;
+			}
+		}
+	}
+
+	batch->count = 0;
+	batch->data = 0;
+}
+
+/* Queues <sz> bytes from <buf> emitted by <qc> into the current thread's TX
+ * batch, possibly merged with the previous message as GSO segments. If not
+ * null, <gso_size> is the size of the datagrams in <buf>. The batch is flushed
+ * by its tasklet once the tasks of the current scheduler pass have run, so
+ * that the datagrams prepared by all the connections woken up at the same time
+ * (e.g. by the same pacing tick) are sent together. Returns non-zero on
+ * success, or zero if the datagrams must be sent directly.
+ */
+static int quic_tx_batch_add(struct quic_conn *qc, const struct buffer *buf,
+                             size_t sz, uint16_t gso_size)
+{
+	struct quic_tx_batch *batch = &quic_tx_batches[tid];
+	struct quic_tx_batch_msg *m;
+	int use_src = qc_may_use_saddr(qc);
+
+	if (sz > QUIC_TX_BATCH_BUFSZ)
+		return 0;
+
+	if (batch->count == QUIC_TX_BATCH_MAXMSG || batch->data + sz > QUIC_TX_BATCH_BUFSZ)
+		quic_tx_batch_flush(batch);
+
+	if (batch->count) {
+		m = &batch->msgs[batch->count - 1];
+		if (quic_tx_batch_may_merge(qc, m, sz, gso_size, use_src)) {
+			memcpy(batch->area + batch->data, b_peek(buf, b_head_ofs(buf)), sz);
+			if (!m->gso)
+				m->gso = m->len;
+			m->len += sz;
+			batch->data += sz;
+			return 1;
+		}
+	}
+
+	m = &batch->msgs[batch->count++];
+	m->li = qc->li;
+	m->dst = qc->peer_addr;
+	m->use_src = use_src;
+	if (use_src)
+		m->src = qc->local_addr;
+	m->ofs = batch->data;
+	m->len = sz;
+	m->gso = gso_size;
+	memcpy(batch->area + batch->data, b_peek(buf, b_head_ofs(buf)), sz);
+	batch->data += sz;
+
+	if (batch->count == 1)
+		tasklet_wakeup(batch->tasklet);
+	return 1;
+}
+
+/* TX batch flushing tasklet */
+static struct task *quic_tx_batch_io_cb(struct task *t, void *ctx, unsigned int state)
+{
+	quic_tx_batch_flush(ctx);
+	return t;
+}
+
 /* Send a datagram stored into <buf> buffer with <sz> as size. The caller must
  * ensure there is at least <sz> bytes in this buffer.
  *
@@ -727,16 +980,11 @@ int qc_snd_buf(struct quic_conn *qc, const struct buffer *buf, size_t sz,
 	struct iovec vec;
 	struct cmsghdr *cmsg __maybe_unused = NULL;
 
-	union {
-#ifdef IP_PKTINFO
-		char buf[CMSG_SPACE(sizeof(struct in_pktinfo)) + CMSG_SPACE(sizeof(gso_size))];
-#endif /* IP_PKTINFO */
-#ifdef IPV6_RECVPKTINFO
-		char buf6[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(gso_size))];
-#endif /* IPV6_RECVPKTINFO */
-		char bufaddr[CMSG_SPACE(sizeof(struct in_addr)) + CMSG_SPACE(sizeof(gso_size))];
-		struct cmsghdr align;
-	} ancillary_data;
+	union quic_sock_cmsg ancillary_data;
+
+	/* Connections using the listener socket may batch their datagrams */
+	if (quic_tx_batches && !qc_test_fd(qc) && quic_tx_batch_add(qc, buf, sz, gso_size))
+		return sz;
 
 	/* man 3 cmsg
 	 *
@@ -1194,3 +1442,52 @@ static int quic_deallocate_accept_queues(void)
 	return 1;
 }
 REGISTER_POST_DEINIT(quic_deallocate_accept_queues);
+
+static int quic_alloc_tx_batches(void)
+{
+	int i;
+
+	if (!(quic_tune.fe.opts & QUIC_TUNE_FE_TX_BATCH))
+		return ERR_NONE;
+
+	quic_tx_batches = calloc(global.nbthread, sizeof(*quic_tx_batches));
+	if (!quic_tx_batches) {
+		ha_alert("Failed to allocate the quic TX batches.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	for (i = 0; i < global.nbthread; ++i) {
+		struct quic_tx_batch *batch = &quic_tx_batches[i];
+
+		batch->area = malloc(QUIC_TX_BATCH_BUFSZ);
+		batch->tasklet = tasklet_new();
+		if (!batch->area || !batch->tasklet) {
+			ha_alert("Failed to allocate the quic TX batch on thread %d.\n", i);
+			return ERR_ALERT | ERR_FATAL;
+		}
+
+		tasklet_set_tid(batch->tasklet, i);
+		batch->tasklet->context = batch;
+		batch->tasklet->process = quic_tx_batch_io_cb;
+	}
+
+	return ERR_NONE;
+}
+REGISTER_POST_CHECK(quic_alloc_tx_batches);
+
+static int quic_deallocate_tx_batches(void)
+{
+	int i;
+
+	if (quic_tx_batches) {
+		for (i = 0; i < global.nbthread; ++i) {
+			tasklet_free(quic_tx_batches[i].tasklet);
+			free(quic_tx_batches[i].area);
+		}
+		free(quic_tx_batches);
+		quic_tx_batches = NULL;
+	}
+
+	return 1;
+}
+REGISTER_POST_DEINIT(quic_deallocate_tx_batches);
@@ -1,3 +1,4 @@
+#include <haproxy/clock.h>
 #include <haproxy/errors.h>
 #include <haproxy/ncbmbuf.h>
 #include <haproxy/proxy.h>
@@ -7,9 +8,14 @@
 #include <haproxy/quic_tls.h>
 #include <haproxy/quic_tp.h>
 #include <haproxy/quic_trace.h>
+#include <haproxy/quic_tune.h>
 #include <haproxy/ssl_sock.h>
 #include <haproxy/stats.h>
+#include <haproxy/thread.h>
+#include <haproxy/ticks.h>
+#include <haproxy/tools.h>
 #include <haproxy/trace.h>
+#include <haproxy/xxhash.h>
 
 DECLARE_TYPED_POOL(pool_head_quic_ssl_sock_ctx, "quic_ssl_sock_ctx", struct ssl_sock_ctx);
 const char *quic_ciphers = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384"
@@ -20,6 +26,28 @@ const char *quic_groups = "X25519:P-256:P-384:P-521:X25519MLKEM768";
 const char *quic_groups = "X25519:P-256:P-384:P-521";
 #endif
 
+/* The 0-RTT anti-replay filter relies on the allow_early_data callback which
+ * is not provided by BoringSSL nor AWS-LC.
+ */
+#if defined(HAVE_SSL_0RTT_QUIC) && !defined(OPENSSL_IS_BORINGSSL) && !defined(OPENSSL_IS_AWSLC)
+#define HAVE_QUIC_0RTT_REPLAY_FILTER
+
+#define QUIC_0RTT_FILTER_BITS    (1U << 20) /* bits per generation */
+#define QUIC_0RTT_FILTER_HASHES  4
+
+/* 0-RTT anti-replay filter shared by all the frontend connections. It records
+ * the ClientHello random values of the 0-RTT attempts in two generations of a
+ * bloom filter which rotate every "tune.quic.fe.sec.0rtt-replay-window", so
+ * that any value is remembered during at least one window.
+ */
+static struct {
+	__decl_thread(HA_SPINLOCK_T lock);
+	uint64_t seed;                     /* secret hash seed */
+	unsigned int start;                /* date of the current generation (ticks) */
+	ulong *gen[2];                     /* current and previous generations */
+} quic_0rtt_filter;
+#endif
+
 
 /* Set the encoded version of the transport parameter into the TLS
  * stack depending on <ver> QUIC version and <server> boolean which must
@@ -771,6 +799,11 @@ int ssl_quic_initial_ctx(struct bind_conf *bind_conf)
 		SSL_CTX_set_options(ctx, SSL_OP_NO_ANTI_REPLAY);
 		SSL_CTX_set_max_early_data(ctx, 0xffffffff);
 #endif /* ! HAVE_SSL_0RTT_QUIC  */
+#if defined(HAVE_SSL_0RTT_QUIC) && !defined(HAVE_QUIC_0RTT_REPLAY_FILTER)
+		if (quic_tune.fe.sec_0rtt_replay_window)
+			ha_warning("Binding [%s:%d] for %s %s: 0-RTT anti-replay filter is not supported by this SSL library, ignored.\n",
+			           bind_conf->file, bind_conf->line, proxy_type_str(bind_conf->frontend), bind_conf->frontend->id);
+#endif
 	}
 
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
@@ -1211,6 +1244,11 @@ static int qc_ssl_sess_init(struct quic_conn *qc, SSL_CTX *ssl_ctx, SSL **ssl,
 		goto retry;
 	}
 
+#ifdef SSL_MODE_ASYNC
+	/* the QUIC handshake does not support SSL_ERROR_WANT_ASYNC */
+	SSL_clear_mode(*ssl, SSL_MODE_ASYNC);
+#endif
+
 	ret = 0;
  leave:
 	TRACE_LEAVE(QUIC_EV_CONN_NEW, qc);
@@ -1220,6 +1258,122 @@ static int qc_ssl_sess_init(struct quic_conn *qc, SSL_CTX *ssl_ctx, SSL **ssl,
 	goto leave;
 }
 
+#ifdef HAVE_QUIC_0RTT_REPLAY_FILTER
+
+/* Look up <key> of <len> bytes in the 0-RTT anti-replay filter and record it.
+ * The generations are rotated first if the current one is older than the
+ * replay window. Returns 1 if <key> was not found, 0 if it was found, which
+ * may also be a false positive.
+ */
+static int quic_0rtt_filter_check(const unsigned char *key, size_t len)
+{
+	uint64_t hash = XXH3(key, len, quic_0rtt_filter.seed);
+	uint32_t h1 = hash, h2 = (hash >> 32) | 1;
+	int seen_cur = 1, seen_prv = 1;
+	int i;
+
+	HA_SPIN_LOCK(OTHER_LOCK, &quic_0rtt_filter.lock);
+
+	if (tick_is_expired(tick_add(quic_0rtt_filter.start, quic_tune.fe.sec_0rtt_replay_window), now_ms)) {
+		ulong *gen = quic_0rtt_filter.gen[1];
+
+		memset(gen, 0, QUIC_0RTT_FILTER_BITS / 8);
+		quic_0rtt_filter.gen[1] = quic_0rtt_filter.gen[0];
+		quic_0rtt_filter.gen[0] = gen;
+		quic_0rtt_filter.start = now_ms;
+	}
+
+	for (i = 0; i < QUIC_0RTT_FILTER_HASHES; i++) {
+		uint bit = (h1 + i * h2) % QUIC_0RTT_FILTER_BITS;
+		ulong mask = 1UL << (bit % LONGBITS);
+
+		if (!(quic_0rtt_filter.gen[1][bit / LONGBITS] & mask))
+			seen_prv = 0;
+		if (!(quic_0rtt_filter.gen[0][bit / LONGBITS] & mask)) {
+			seen_cur = 0;
+			quic_0rtt_filter.gen[0][bit / LONGBITS] |= mask;
+		}
+	}
+
+	HA_SPIN_UNLOCK(OTHER_LOCK, &quic_0rtt_filter.lock);
+
+	return !seen_cur && !seen_prv;
+}
+
+/* Callback called by the SSL library when the client of <arg> connection
+ * attempts 0-RTT with the session resumed on <ssl>. Early data are only
+ * accepted if the session is younger than the replay window and if the
+ * ClientHello random was not already recorded by the anti-replay filter
+ * (RFC8446 8.2). The filter is local to the process and starts empty, so
+ * early data are refused during the first window after the process became
+ * ready: any ClientHello accepted by a previous process before that date is
+ * then older than the window and rejected on its session age. Otherwise the
+ * handshake goes on without early data.
+ *
+ * Returns 1 to accept early data, 0 to reject them.
+ */
+static int qc_ssl_allow_early_data_cb(SSL *ssl, void *arg)
+{
+	struct quic_conn *qc = arg;
+	SSL_SESSION *sess = SSL_get0_session(ssl);
+	unsigned char random[SSL3_RANDOM_SIZE];
+	long long age;
+
+	if (!sess)
+		return 0;
+
+	/* The session time has a one second resolution */
+	age = (long long)date.tv_sec - (long long)SSL_SESSION_get_time(sess);
+	if (age < 0 || (age + 1) * 1000 > quic_tune.fe.sec_0rtt_replay_window) {
+		TRACE_STATE("0-RTT rejected on too old session", QUIC_EV_CONN_IO_CB, qc);
+		return 0;
+	}
+
+	if (tv_ms_elapsed(&ready_date, &date) < quic_tune.fe.sec_0rtt_replay_window) {
+		TRACE_STATE("0-RTT rejected during the first replay window", QUIC_EV_CONN_IO_CB, qc);
+		return 0;
+	}
+
+	if (SSL_get_client_random(ssl, random, sizeof(random)) != sizeof(random))
+		return 0;
+
+	if (!quic_0rtt_filter_check(random, sizeof(random))) {
+		TRACE_STATE("0-RTT rejected on replayed ClientHello", QUIC_EV_CONN_IO_CB, qc);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int quic_alloc_0rtt_filter(void)
+{
+	if (!quic_tune.fe.sec_0rtt_replay_window)
+		return ERR_NONE;
+
+	quic_0rtt_filter.gen[0] = calloc(1, QUIC_0RTT_FILTER_BITS / 8);
+	quic_0rtt_filter.gen[1] = calloc(1, QUIC_0RTT_FILTER_BITS / 8);
+	if (!quic_0rtt_filter.gen[0] || !quic_0rtt_filter.gen[1]) {
+		ha_alert("Failed to allocate the QUIC 0-RTT anti-replay filter.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	HA_SPIN_INIT(&quic_0rtt_filter.lock);
+	quic_0rtt_filter.seed = ha_random64();
+	quic_0rtt_filter.start = now_ms;
+	return ERR_NONE;
+}
+REGISTER_POST_CHECK(quic_alloc_0rtt_filter);
+
+static int quic_deallocate_0rtt_filter(void)
+{
+	ha_free(&quic_0rtt_filter.gen[0]);
+	ha_free(&quic_0rtt_filter.gen[1]);
+	return 1;
+}
+REGISTER_POST_DEINIT(quic_deallocate_0rtt_filter);
+
+#endif /* HAVE_QUIC_0RTT_REPLAY_FILTER */
+
 #ifdef HAVE_SSL_0RTT_QUIC
 
 /* Enable early data for <ssl> QUIC TLS session.
@@ -1253,6 +1407,11 @@ static int qc_set_quic_early_data_enabled(struct quic_conn *qc, SSL *ssl)
 	SSL_set_quic_early_data_enabled(ssl, 1);
 #endif
 
+#ifdef HAVE_QUIC_0RTT_REPLAY_FILTER
+	if (quic_tune.fe.sec_0rtt_replay_window)
+		SSL_set_allow_early_data_cb(ssl, qc_ssl_allow_early_data_cb, qc);
+#endif
+
 	return 1;
 }
 #endif // HAVE_SSL_0RTT_QUIC
@@ -553,6 +553,8 @@ static int raw_sock_get_capability(struct connection *conn, void *xprt_ctx, enum
 
 	switch (cap) {
 		case XPRT_CAN_SPLICE:
+		case XPRT_CAN_SPLICE_RECV:
+		case XPRT_CAN_SPLICE_SEND:
 			ret = arg;
 			*ret = XPRT_CONN_CAN_SPLICE;
 			return 0;
@@ -1249,6 +1249,27 @@ static int srv_parse_pool_purge_delay(char **args, int *cur_arg, struct proxy *c
 	return 0;
 }
 
+static int srv_parse_pool_target_streams(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	char *arg;
+	int val;
+
+	arg = args[*cur_arg + 1];
+	if (!*arg) {
+		memprintf(err, "'%s' expects <value> as argument.\n", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	val = atoi(arg);
+	if (val < 0) {
+		memprintf(err, "'%s' must be >= 0", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	newsrv->target_streams = val;
+	return 0;
+}
+
 static int srv_parse_pool_conn_name(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
 {
 	char *arg;
@@ -1283,6 +1304,27 @@ static int srv_parse_pool_low_conn(char **args, int *cur_arg, struct proxy *curp
 	return 0;
 }
 
+static int srv_parse_pool_min_idle(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	char *arg;
+	int val;
+
+	arg = args[*cur_arg + 1];
+	if (!*arg) {
+		memprintf(err, "'%s' expects <value> as argument.\n", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	val = atoi(arg);
+	if (val < 0) {
+		memprintf(err, "'%s' must be >= 0", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	newsrv->min_idle_conns = val;
+	return 0;
+}
+
 static int srv_parse_pool_max_conn(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
 {
 	char *arg;
@@ -2447,7 +2489,9 @@ static struct srv_kw_list srv_kws = { "ALL", { }, {
 	{ "pool-conn-name",       srv_parse_pool_conn_name,       1,  1,  1 }, /* Define expression to identify connections in idle pool */
 	{ "pool-low-conn",        srv_parse_pool_low_conn,        1,  1,  1 }, /* Set the min number of orphan idle connecbefore being allowed to pick from other threads */
 	{ "pool-max-conn",        srv_parse_pool_max_conn,        1,  1,  1 }, /* Set the max number of orphan idle connections, -1 means unlimited */
+	{ "pool-min-idle",        srv_parse_pool_min_idle,        1,  1,  0 }, /* Set the number of idle connections to keep pre-established per thread group */
 	{ "pool-purge-delay",     srv_parse_pool_purge_delay,     1,  1,  1 }, /* Set the time before we destroy orphan idle connections, defaults to 1s */
+	{ "pool-target-streams",  srv_parse_pool_target_streams,  1,  1,  1 }, /* Set the number of streams per connection above which a new connection is preferred */
 	{ "proto",                srv_parse_proto,                1,  1,  1 }, /* Set the proto to use for all outgoing connections */
 	{ "proxy-v2-options",     srv_parse_proxy_v2_options,     1,  1,  1 }, /* options for send-proxy-v2 */
 	{ "redir",                srv_parse_redir,                1,  1,  0 }, /* Enable redirection mode */
@@ -3041,6 +3085,8 @@ void srv_settings_cpy(struct server *srv, const struct server *src, int srv_tmpl
 	srv->pool_purge_delay = src->pool_purge_delay;
 	srv->low_idle_conns = src->low_idle_conns;
 	srv->max_idle_conns = src->max_idle_conns;
+	srv->min_idle_conns = src->min_idle_conns;
+	srv->target_streams = src->target_streams;
 	srv->max_reuse = src->max_reuse;
 
 	if (srv_tmpl)
@@ -3211,6 +3257,7 @@ void srv_free_params(struct server *srv)
 struct server *srv_drop(struct server *srv)
 {
 	struct server *next = NULL;
+	int i;
 
 	if (!srv)
 		goto end;
@@ -3237,6 +3284,8 @@ struct server *srv_drop(struct server *srv)
 		tasklet_kill(srv->requeue_tasklet);
 	task_destroy(srv->warmup);
 	task_destroy(srv->srvrq_check);
+	for (i = 0; srv->per_tgrp && i < global.nbtgroups; i++)
+		task_destroy(srv->per_tgrp[i].prewarm_task);
 
 	free(srv->id);
 	srv_free_params(srv);
@@ -3520,6 +3569,7 @@ int srv_preinit(struct server *srv)
  */
 static int init_srv_requeue(struct server *srv);
 static int init_srv_slowstart(struct server *srv);
+static int init_srv_prewarm(struct server *srv);
 int srv_postinit(struct server *srv)
 {
 	int err_code = ERR_NONE;
@@ -3566,6 +3616,8 @@ int srv_postinit(struct server *srv)
 		}
 	}
 
+	err_code |= init_srv_prewarm(srv);
+
  out:
 	return err_code;
 }
@@ -6008,6 +6060,8 @@ static int srv_init_per_thr(struct server *srv)
 	for (i = 0; i < global.nbtgroups; i++) {
 		srv->per_tgrp[i].server = srv;
 		queue_init(&srv->per_tgrp[i].queue, srv->proxy, srv);
+		MT_LIST_INIT(&srv->per_tgrp[i].shared_conns[0]);
+		MT_LIST_INIT(&srv->per_tgrp[i].shared_conns[1]);
 	}
 
 	return 0;
@@ -7285,7 +7339,7 @@ void srv_release_conn(struct server *srv, struct connection *conn)
 	}
 
 	/* Remove the connection from any tree (safe, idle or available) */
-	if (ceb_intree(&conn->hash_node.node)) {
+	if (ceb_intree(&conn->hash_node.node) || (conn->flags & CO_FL_PARKED)) {
 		HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
 		conn_delete_from_tree(conn, tid);
 		conn->flags &= ~CO_FL_LIST_MASK;
@@ -7331,6 +7385,95 @@ void _srv_add_idle(struct server *srv, struct connection *conn, int is_safe)
 	LIST_APPEND(&srv->per_thr[tid].idle_conn_list, &conn->idle_list);
 }
 
+/* Returns non-zero if idle connection <conn> about to be inserted for the
+ * current thread should rather be parked into the thread group's shared pool,
+ * which is the case once this thread already keeps "tune.idle-pool.park-above"
+ * idle connections of its own for <srv>. Only connections whose mux knows how
+ * to migrate them between threads are eligible.
+ *
+ * Must be called with idle_conns_lock held.
+ */
+static inline int srv_may_park_conn(const struct server *srv, const struct connection *conn)
+{
+	if (!global.tune.idle_pool_park || !(global.tune.options & GTUNE_IDLE_POOL_SHARED))
+		return 0;
+
+	if (tg->count < 2 || !conn->mux->takeover || (conn->flags & (CO_FL_FDLESS|CO_FL_WAIT_XPRT)))
+		return 0;
+
+	return srv->curr_idle_thr[tid] - srv->per_thr[tid].parked_conns >= global.tune.idle_pool_park;
+}
+
+/* Parks <conn> into the shared pool of <srv> for the current thread group
+ * depending on <is_safe>. The connection remains owned and polled by the
+ * current thread, which keeps it in its idle_conn_list so that purges find it,
+ * but it is only reachable by lookups via the shared pool, from which any
+ * thread of the group may pick it without scanning other threads' trees (see
+ * srv_pick_shared_conn()).
+ *
+ * Must be called with idle_conns_lock held.
+ */
+static void _srv_park_idle(struct server *srv, struct connection *conn, int is_safe)
+{
+	conn->flags |= CO_FL_PARKED;
+	srv->per_thr[tid].parked_conns++;
+	LIST_APPEND(&srv->per_thr[tid].idle_conn_list, &conn->idle_list);
+	MT_LIST_APPEND(&srv->per_tgrp[tgid - 1].shared_conns[!!is_safe], &conn->toremove_list);
+}
+
+/* Inserts <conn> into the idle or safe tree of <srv> for the current thread
+ * depending on <is_safe>, and updates the server's idle counters. The caller
+ * must have verified that the connection is eligible. Returns 1 on success, or
+ * 0 if the server's max idle connections count was reached.
+ */
+static int _srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_safe)
+{
+	int retadd;
+
+	retadd = _HA_ATOMIC_ADD_FETCH(&srv->curr_idle_conns, 1);
+	if (retadd > srv->max_idle_conns) {
+		_HA_ATOMIC_DEC(&srv->curr_idle_conns);
+		return 0;
+	}
+	_HA_ATOMIC_DEC(&srv->curr_used_conns);
+
+	HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	conn_delete_from_tree(conn, tid);
+
+	if (is_safe) {
+		conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_SAFE_LIST;
+		_HA_ATOMIC_INC(&srv->curr_safe_nb);
+	} else {
+		conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_IDLE_LIST;
+		_HA_ATOMIC_INC(&srv->curr_idle_nb);
+	}
+
+	if (srv_may_park_conn(srv, conn))
+		_srv_park_idle(srv, conn, is_safe);
+	else
+		_srv_add_idle(srv, conn, is_safe);
+	HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	_HA_ATOMIC_INC(&srv->curr_idle_thr[tid]);
+
+	__ha_barrier_full();
+	if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
+		HA_SPIN_LOCK(OTHER_LOCK, &idle_conn_srv_lock);
+		if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
+			srv->idle_node.key = tick_add(srv->pool_purge_delay,
+			                              now_ms);
+			eb32_insert(&idle_conn_srv, &srv->idle_node);
+			if (!task_in_wq(idle_conn_task) && !
+			    task_in_rq(idle_conn_task)) {
+				task_schedule(idle_conn_task,
+				              srv->idle_node.key);
+			}
+
+		}
+		HA_SPIN_UNLOCK(OTHER_LOCK, &idle_conn_srv_lock);
+	}
+	return 1;
+}
+
 /* This adds an idle connection to the server's list if the connection is
  * reusable, not held by any owner anymore, but still has available streams.
  */
@@ -7355,59 +7498,396 @@ int srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_saf
 	       MAX(srv->curr_used_conns, srv->est_need_conns) + srv->low_idle_conns ||
 	       (conn->flags & CO_FL_REVERSED)))) &&
 	    !conn->mux->used_streams(conn) && conn->mux->avail_streams(conn)) {
-		int retadd;
+		return _srv_add_to_idle_list(srv, conn, is_safe);
+	}
+	return 0;
+}
 
-		retadd = _HA_ATOMIC_ADD_FETCH(&srv->curr_idle_conns, 1);
-		if (retadd > srv->max_idle_conns) {
-			_HA_ATOMIC_DEC(&srv->curr_idle_conns);
-			return 0;
-		}
-		_HA_ATOMIC_DEC(&srv->curr_used_conns);
+/* Insert <conn> connection in <srv> server available list. This is reserved
+ * for backend connection currently in used with usable streams left.
+ */
+void srv_add_to_avail_list(struct server *srv, struct connection *conn)
+{
+	/* connection cannot be in idle list if used as an avail idle conn. */
+	BUG_ON(LIST_INLIST(&conn->idle_list));
+	ceb64_item_insert(&srv->per_thr[tid].avail_conns, hash_node.node, hash_node.key, conn);
+	_HA_ATOMIC_INC(&srv->per_thr[tid].avail_nb);
+	srv_set_avail_strms(srv, conn, tid, conn->mux->used_streams(conn));
+}
 
-		HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
-		conn_delete_from_tree(conn, tid);
+/* Sets to <strms> the number of streams of <conn> accounted in the available
+ * connections counters of thread <thr> of <srv>, 0 meaning that it left the
+ * available tree. The busiest connection is tracked together with the number
+ * of connections sharing its stream count, so that the thread's tree only has
+ * to be walked again when the last of them gets fewer streams. The counters
+ * are only updated by the owner thread, except on deinit, and are read without
+ * locking by "show servers conn".
+ */
+void srv_set_avail_strms(struct server *srv, struct connection *conn, int thr, uint strms)
+{
+	struct srv_per_thread *pt = &srv->per_thr[thr];
+	uint old = conn->avail_strms;
+	uint busiest, nb;
 
-		if (is_safe) {
-			conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_SAFE_LIST;
-			_srv_add_idle(srv, conn, 1);
-			_HA_ATOMIC_INC(&srv->curr_safe_nb);
-		} else {
-			conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_IDLE_LIST;
-			_srv_add_idle(srv, conn, 0);
-			_HA_ATOMIC_INC(&srv->curr_idle_nb);
-		}
-		HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
-		_HA_ATOMIC_INC(&srv->curr_idle_thr[tid]);
+	if (strms == old)
+		return;
 
-		__ha_barrier_full();
-		if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
-			HA_SPIN_LOCK(OTHER_LOCK, &idle_conn_srv_lock);
-			if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
-				srv->idle_node.key = tick_add(srv->pool_purge_delay,
-				                              now_ms);
-				eb32_insert(&idle_conn_srv, &srv->idle_node);
-				if (!task_in_wq(idle_conn_task) && !
-				    task_in_rq(idle_conn_task)) {
-					task_schedule(idle_conn_task,
-					              srv->idle_node.key);
+	conn->avail_strms = strms;
+	HA_ATOMIC_STORE(&pt->avail_strms, pt->avail_strms + strms - old);
+
+	busiest = pt->avail_busiest;
+	nb = pt->avail_busiest_nb;
+	if (old && old == busiest)
+		nb--;
+
+	if (strms > busiest) {
+		busiest = strms;
+		nb = 1;
+	}
+	else if (strms && strms == busiest)
+		nb++;
+	else if (!nb) {
+		struct connection *c;
+
+		/* the busiest one got fewer streams, look for the new one,
+		 * which is only possible from the owner thread.
+		 */
+		busiest = 0;
+		if (thr == tid) {
+			for (c = ceb64_item_first(&pt->avail_conns, hash_node.node, hash_node.key, struct connection);
+			     c;
+			     c = ceb64_item_next(&pt->avail_conns, hash_node.node, hash_node.key, c)) {
+				if (c->avail_strms > busiest) {
+					busiest = c->avail_strms;
+					nb = 1;
 				}
+				else if (c->avail_strms && c->avail_strms == busiest)
+					nb++;
+			}
+		}
+	}
+
+	HA_ATOMIC_STORE(&pt->avail_busiest, busiest);
+	HA_ATOMIC_STORE(&pt->avail_busiest_nb, nb);
+}
+
+/* Updates the number of streams of <conn> accounted in the available
+ * connections counters of its server after a stream was attached or detached,
+ * if it is in the current thread's available tree.
+ */
+void srv_refresh_avail_conn(struct connection *conn)
+{
+	struct server *srv = objt_server(conn->target);
+
+	if (srv && ceb_intree(&conn->hash_node.node) && !LIST_INLIST(&conn->idle_list))
+		srv_set_avail_strms(srv, conn, tid, conn->mux->used_streams(conn));
+}
+
+/* Tries to pick an idle connection matching <hash> from the shared pool of
+ * <srv> for the current thread group. Only safe connections are considered if
+ * <is_safe> is set, otherwise idle ones are tried first, then safe ones. A
+ * connection parked by another thread is migrated to the current one using
+ * its mux's takeover() method, under its owner's idle_conns_lock which is only
+ * tried so as never to wait on a busy thread. On success, the connection is
+ * returned detached from the pool and from its owner's lists, but still
+ * accounted as idle for thread <*thr> where it was found. Otherwise NULL is
+ * returned.
+ */
+struct connection *srv_pick_shared_conn(struct server *srv, int is_safe, int64_t hash, int *thr)
+{
+	struct connection *conn, *found = NULL;
+	struct mt_list back;
+	int pool;
+
+	for (pool = !!is_safe; !found && pool <= 1; pool++) {
+		struct mt_list *list = &srv->per_tgrp[tgid - 1].shared_conns[pool];
+
+		if (MT_LIST_ISEMPTY(list))
+			continue;
+
+		/* the visited element is locked, so its owner cannot withdraw it
+		 * while we're trying to get its lock, and the trylock avoids the
+		 * deadlock with an owner waiting for the element under its lock.
+		 */
+		MT_LIST_FOR_EACH_ENTRY_LOCKED(conn, list, toremove_list, back) {
+			int owner;
+
+			if (conn->hash_node.key != hash)
+				continue;
+
+			owner = tg->base + my_ffsl(_HA_ATOMIC_LOAD(&fdtab[conn->handle.fd].thread_mask)) - 1;
+			if (HA_SPIN_TRYLOCK(IDLE_CONNS_LOCK, &idle_conns[owner].idle_conns_lock) != 0)
+				continue;
+
+			if (owner == tid || conn->mux->takeover(conn, owner, 0) == 0) {
+				LIST_DEL_INIT(&conn->idle_list);
+				conn->flags &= ~CO_FL_PARKED;
+				srv->per_thr[owner].parked_conns--;
+				*thr = owner;
+				found = conn;
+			}
+			HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[owner].idle_conns_lock);
 
+			if (found) {
+				mt_list_unlock_self(&conn->toremove_list);
+				conn = NULL;
+				break;
 			}
-			HA_SPIN_UNLOCK(OTHER_LOCK, &idle_conn_srv_lock);
 		}
-		return 1;
 	}
+
+	return found;
+}
+
+/* Returns non-zero if sample expression <expr> only relies on values known at
+ * configuration time, and may thus be evaluated without any stream.
+ */
+static int srv_expr_is_const(const struct sample_expr *expr)
+{
+	return !(expr->fetch->use & ~SMP_USE_CONST);
+}
+
+/* Checks whether connections to <srv> may be opened in advance by the
+ * "pool-min-idle" task, i.e. without any stream to take their parameters from.
+ * Returns NULL if so, otherwise a message indicating the reason why not.
+ */
+static const char *srv_prewarm_unsupported(const struct server *srv)
+{
+	const struct conn_src *src;
+
+	if (srv->proxy->mode != PR_MODE_HTTP)
+		return "the backend is not in HTTP mode";
+
+	if ((srv->proxy->options & PR_O_REUSE_MASK) == PR_O_REUSE_NEVR)
+		return "connection reuse is disabled by 'http-reuse never'";
+
+	if (!srv->max_idle_conns || !srv->pool_purge_delay)
+		return "idle connections are disabled for this server";
+
+	if (srv->flags & SRV_F_RHTTP)
+		return "reverse HTTP servers cannot initiate connections";
+
+	if (srv->flags & (SRV_F_MAPPORTS | SRV_F_SOCKS4_PROXY))
+		return "the destination depends on the client connection";
+
+	if (srv->pp_opts & SRV_PP_ENABLED)
+		return "the PROXY protocol header depends on the client connection";
+
+	src = (srv->conn_src.opts & CO_SRC_BIND) ? &srv->conn_src : &srv->proxy->conn_src;
+	if ((src->opts & CO_SRC_BIND) &&
+	    (src->opts & CO_SRC_TPROXY_MASK) &&
+	    (src->opts & CO_SRC_TPROXY_MASK) != CO_SRC_TPROXY_ADDR)
+		return "the source address depends on the client connection";
+
+	if (srv->pool_conn_name_expr && !srv_expr_is_const(srv->pool_conn_name_expr))
+		return "'pool-conn-name' (or 'sni') depends on the stream";
+
+#ifdef USE_OPENSSL
+	if (srv->ssl_ctx.sni && !srv_expr_is_const(srv->ssl_ctx.sni))
+		return "'sni' depends on the stream";
+#endif
+
+	return NULL;
+}
+
+/* Opens a new connection to <srv> from the current thread, without any stream
+ * attached to it, and stores it into the server's idle tree so that the next
+ * request does not have to wait for the TCP and TLS handshakes. The connection
+ * is set up with the same parameters connect_server() uses for streams not
+ * carrying any specific connection setting so that both produce the same hash.
+ * The connection is stored in the idle tree rather than the safe one since the
+ * server did not prove yet that it keeps it alive. Returns 1 if a connection
+ * was added, otherwise 0.
+ */
+static int srv_prewarm_conn(struct server *srv)
+{
+	struct connection *conn;
+	struct sockaddr_storage *bind_addr = NULL;
+	struct ist name = IST_NULL;
+
+#if defined(USE_OPENSSL) && defined(TLSEXT_TYPE_application_layer_protocol_negotiation)
+	/* The mux may only be chosen after the handshake if ALPN is used and
+	 * was never negotiated yet. Wait for a regular connection to learn it.
+	 */
+	if (srv->use_ssl && !srv->mux_proto &&
+	    (srv->ssl_ctx.alpn_str || srv->ssl_ctx.npn_str)) {
+		int known;
+
+		HA_RWLOCK_RDLOCK(SERVER_LOCK, &srv->path_params.param_lock);
+		known = !!srv->path_params.nego_alpn[0];
+		HA_RWLOCK_RDUNLOCK(SERVER_LOCK, &srv->path_params.param_lock);
+		if (!known)
+			return 0;
+	}
+#endif
+
+	if (srv->flags & SRV_F_STRICT_MAXCONN) {
+		uint total_conns = HA_ATOMIC_LOAD(&srv->curr_total_conns);
+
+		do {
+			if (total_conns >= srv->maxconn)
+				return 0;
+		} while (!_HA_ATOMIC_CAS(&srv->curr_total_conns, &total_conns, total_conns + 1));
+	}
+
+	conn = conn_new(srv);
+	if (!conn) {
+		if (srv->flags & SRV_F_STRICT_MAXCONN)
+			_HA_ATOMIC_DEC(&srv->curr_total_conns);
+		return 0;
+	}
+
+	if (alloc_bind_address(&bind_addr, srv, srv->proxy, NULL) != SRV_STATUS_OK)
+		goto err;
+	conn->src = bind_addr;
+
+	*conn->dst = srv->addr;
+	set_host_port(conn->dst, srv->svc_port);
+
+	if (srv->pool_conn_name_expr) {
+		struct sample *name_smp;
+
+		name_smp = sample_fetch_as_type(srv->proxy, NULL, NULL,
+		                                SMP_OPT_DIR_REQ | SMP_OPT_FINAL,
+		                                srv->pool_conn_name_expr, SMP_T_STR);
+		if (name_smp)
+			name = ist2(name_smp->data.u.str.area, name_smp->data.u.str.data);
+	}
+	conn->hash_node.key = be_calculate_conn_hash(srv, NULL, NULL, conn->src, conn->dst, name);
+
+	if (conn_prepare(conn, protocol_lookup(conn->dst->ss_family, srv->addr_type.proto_type, srv->alt_proto), srv->xprt))
+		goto err;
+
+	if (conn->ctrl->connect(conn, 0) != SF_ERR_NONE)
+		goto err;
+
+#ifdef USE_OPENSSL
+	if (conn_is_ssl(conn) && srv->ssl_ctx.sni) {
+		struct sample *sni_smp;
+
+		sni_smp = sample_fetch_as_type(srv->proxy, NULL, NULL,
+		                               SMP_OPT_DIR_REQ | SMP_OPT_FINAL,
+		                               srv->ssl_ctx.sni, SMP_T_STR);
+		if (smp_make_safe(sni_smp))
+			ssl_sock_set_servername(conn, sni_smp->data.u.str.area);
+	}
+#endif
+
+	if (conn->flags & CO_FL_HANDSHAKE) {
+		if (xprt_add_hs(conn) < 0)
+			goto err;
+	}
+
+	if (conn_xprt_start(conn) < 0)
+		goto err;
+
+	/* the mux knows it has to wait idle when no upper context is passed */
+	if (conn_install_mux_be(conn, NULL, NULL, NULL) < 0)
+		goto err;
+
+	if (!_srv_add_to_idle_list(srv, conn, 0)) {
+		conn->mux->destroy(conn->ctx);
+		return 0;
+	}
+	return 1;
+
+ err:
+	conn_full_close(conn);
+	conn_free(conn);
 	return 0;
 }
 
-/* Insert <conn> connection in <srv> server available list. This is reserved
- * for backend connection currently in used with usable streams left.
+/* Task in charge of keeping at least "pool-min-idle" idle connections to a
+ * server for the thread group <context> belongs to. Each run opens its share of
+ * the missing connections on the current thread then, if some are still
+ * missing, immediately migrates to the next thread of the group so that the
+ * connections are evenly spread. Otherwise it checks again one second later,
+ * unless it is woken up earlier because an idle connection was picked.
  */
-void srv_add_to_avail_list(struct server *srv, struct connection *conn)
+static struct task *srv_prewarm_task(struct task *t, void *context, unsigned int state)
 {
-	/* connection cannot be in idle list if used as an avail idle conn. */
-	BUG_ON(LIST_INLIST(&conn->idle_list));
-	ceb64_item_insert(&srv->per_thr[tid].avail_conns, hash_node.node, hash_node.key, conn);
+	struct srv_per_tgroup *per_tgrp = context;
+	struct server *srv = per_tgrp->server;
+	const struct tgroup_info *tg = &ha_tgroup_info[per_tgrp - srv->per_tgrp];
+	uint idle = 0;
+	uint batch;
+	int i;
+
+	t->expire = tick_add(now_ms, MS_TO_TICKS(1000));
+
+	if (stopping || !srv_currently_usable(srv) ||
+	    ha_used_fds >= global.tune.pool_high_count)
+		return t;
+
+	for (i = 0; i < tg->count; i++)
+		idle += HA_ATOMIC_LOAD(&srv->curr_idle_thr[tg->base + i]);
+
+	if (idle >= srv->min_idle_conns)
+		return t;
+
+	batch = MIN((srv->min_idle_conns - idle + tg->count - 1) / tg->count, 8);
+	while (batch--) {
+		if (!srv_prewarm_conn(srv))
+			return t;
+		idle++;
+	}
+
+	if (idle < srv->min_idle_conns) {
+		if (tg->count > 1) {
+			/* let the next thread open its share. The task must
+			 * leave the wait queue since it's not allowed to be
+			 * queued on a foreign thread.
+			 */
+			per_tgrp->prewarm_next = (per_tgrp->prewarm_next + 1) % tg->count;
+			task_unlink_wq(t);
+			t->expire = TICK_ETERNITY;
+			task_set_thread(t, tg->base + per_tgrp->prewarm_next);
+			task_wakeup(t, TASK_WOKEN_MSG);
+		}
+		else
+			t->expire = tick_add(now_ms, MS_TO_TICKS(1));
+	}
+
+	return t;
+}
+
+/* Allocates and starts the per-thread group tasks maintaining the pre-warmed
+ * idle connections of <srv> if "pool-min-idle" is set. The setting is ignored
+ * with a warning when it cannot be applied to this server.
+ *
+ * Returns 0 on success else non-zero.
+ */
+static int init_srv_prewarm(struct server *srv)
+{
+	const char *reason;
+	struct task *t;
+	int i;
+
+	if (!srv->min_idle_conns)
+		return ERR_NONE;
+
+	reason = srv_prewarm_unsupported(srv);
+	if (reason) {
+		ha_warning("'pool-min-idle' ignored for server %s/%s: %s.\n",
+		           srv->proxy->id, srv->id, reason);
+		srv->min_idle_conns = 0;
+		return ERR_WARN;
+	}
+
+	for (i = 0; i < global.nbtgroups; i++) {
+		t = task_new_on(ha_tgroup_info[i].base);
+		if (!t) {
+			ha_alert("Cannot allocate the idle connections pre-warming task for server %s/%s: out of memory.\n",
+			         srv->proxy->id, srv->id);
+			return ERR_ALERT | ERR_FATAL;
+		}
+		t->process = srv_prewarm_task;
+		t->context = &srv->per_tgrp[i];
+		srv->per_tgrp[i].prewarm_task = t;
+		task_wakeup(t, TASK_WOKEN_INIT);
+	}
+
+	return ERR_NONE;
 }
 
 struct task *srv_cleanup_idle_conns(struct task *task, void *context, unsigned int state)
@@ -7453,6 +7933,14 @@ struct task *srv_cleanup_idle_conns(struct task *task, void *context, unsigned i
 		exceed_conns = srv->curr_used_conns + curr_idle - MAX(srv->max_used_conns, srv->est_need_conns);
 		exceed_conns = to_kill = exceed_conns / 2 + (exceed_conns & 1);
 
+		/* never purge the pre-warmed connections below their floor */
+		if (srv->min_idle_conns) {
+			int keep = srv->min_idle_conns * global.nbtgroups;
+
+			if (exceed_conns > curr_idle - keep)
+				exceed_conns = to_kill = curr_idle - keep;
+		}
+
 		srv->est_need_conns = (srv->est_need_conns + srv->max_used_conns) / 2;
 		if (srv->est_need_conns < srv->max_used_conns)
 			srv->est_need_conns = srv->max_used_conns;
@@ -7528,6 +8016,14 @@ static void srv_close_idle_conns(struct server *srv)
 				conn_delete_from_tree(conn, i);
 			}
 		}
+
+		/* only connections parked in the shared pool remain there */
+		while (!LIST_ISEMPTY(&srv->per_thr[i].idle_conn_list)) {
+			conn = LIST_ELEM(srv->per_thr[i].idle_conn_list.n, struct connection *, idle_list);
+			if (conn->ctrl->ctrl_close)
+				conn->ctrl->ctrl_close(conn);
+			conn_delete_from_tree(conn, i);
+		}
 	}
 }
 
@@ -7552,6 +8048,28 @@ static int cfg_parse_idle_pool_shared(char **args, int section_type, struct prox
 	return 0;
 }
 
+/* config parser for global "tune.idle-pool.park-above" */
+static int cfg_parse_idle_pool_park(char **args, int section_type, struct proxy *curpx,
+                                    const struct proxy *defpx, const char *file, int line,
+                                    char **err)
+{
+	int arg = -1;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) != 0)
+		arg = atoi(args[1]);
+
+	if (arg < 0) {
+		memprintf(err, "'%s' expects a positive integer argument.", args[0]);
+		return -1;
+	}
+
+	global.tune.idle_pool_park = arg;
+	return 0;
+}
+
 /* config parser for global "tune.pool-{low,high}-fd-ratio" */
 static int cfg_parse_pool_fd_ratio(char **args, int section_type, struct proxy *curpx,
                                    const struct proxy *defpx, const char *file, int line,
@@ -7579,6 +8097,7 @@ static int cfg_parse_pool_fd_ratio(char **args, int section_type, struct proxy *
 
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.idle-pool.park-above",   cfg_parse_idle_pool_park },
 	{ CFG_GLOBAL, "tune.idle-pool.shared",       cfg_parse_idle_pool_shared },
 	{ CFG_GLOBAL, "tune.pool-high-fd-ratio",     cfg_parse_pool_fd_ratio },
 	{ CFG_GLOBAL, "tune.pool-low-fd-ratio",      cfg_parse_pool_fd_ratio },
@@ -100,7 +100,7 @@ struct show_jwt_ctx {
 struct show_sni_ctx {
 	struct proxy *px;
 	struct bind_conf *bind;
-	struct ebmb_node *n;
+	struct sni_ctx *n;
 	int nodetype;
 	int options;
 	unsigned int offset;
@@ -648,6 +648,180 @@ int ssl_sock_load_key_into_ckch(const char *path, char *buf, struct ckch_data *d
 	return ret;
 }
 
+/*
+ * Certificate files preloading. During the configuration parsing, the PEM
+ * files referenced by a crt-list or a certificate directory may be parsed in
+ * advance by "tune.ssl.load-threads" threads, since this mostly consists in
+ * base64 and ASN.1 decoding which only depends on the file itself. The
+ * results are indexed by path, and ssl_sock_load_pem_into_ckch() picks them
+ * instead of parsing the file again, so that everything else (private key
+ * check, extra files, ckch_store and SSL_CTX creation) remains sequential and
+ * in the configuration order. Files which failed to parse are parsed again
+ * to report the error as usual.
+ */
+struct ckch_preload {
+	struct ckch_data data;  /* parsed contents when ret is 0 */
+	int ret;                /* return of ssl_sock_load_pem_into_ckch() */
+	struct ebmb_node node;  /* indexed by path, must be last */
+	char path[VAR_ARRAY];
+};
+
+static struct eb_root ckch_preload_tree = EB_ROOT_UNIQUE;
+static int ckch_preload_ready;  /* results are valid and may be used */
+static int ckch_preload_cnt;    /* number of entries in the tree */
+
+/* Registers <path> to be preloaded by the next call to ckch_preload_run(),
+ * unless preloading is disabled, or the file was already loaded, already
+ * registered or is not a regular file, in which case it will be loaded as
+ * usual. Returns 0 on success or if nothing was done, or -1 on memory error.
+ */
+int ckch_preload_add(const char *path)
+{
+	struct ckch_preload *pl;
+	struct stat st;
+	size_t len;
+
+	if (global_ssl.load_threads <= 1 || ckch_preload_ready)
+		return 0;
+
+	if (ebst_lookup(&ckch_preload_tree, path) || ckchs_lookup((char *)path))
+		return 0;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return 0;
+
+	len = strlen(path);
+	pl = calloc(1, sizeof(*pl) + len + 1);
+	if (!pl)
+		return -1;
+
+	memcpy(pl->path, path, len + 1);
+	pl->ret = 1;
+	ebst_insert(&ckch_preload_tree, &pl->node);
+	ckch_preload_cnt++;
+	return 0;
+}
+
+/* shared by the threads running ckch_preload_worker() */
+struct ckch_preload_ctx {
+	struct ckch_preload **jobs;  /* all entries to be parsed */
+	int next;                    /* index of the next entry to parse */
+};
+
+/* Parses the files referenced in <arg>'s jobs until there is none left. This
+ * runs in parallel in several threads, none of which touches anything but its
+ * own entries, and the global issuers chain tree which is read-only at this
+ * stage.
+ */
+
+static void *ckch_preload_worker(void *arg)
+{
+	struct ckch_preload_ctx *ctx = arg;
+	struct ckch_preload *pl;
+	int i;
+
+	while ((i = HA_ATOMIC_FETCH_ADD(&ctx->next, 1)) < ckch_preload_cnt) {
+		pl = ctx->jobs[i];
+		pl->ret = ssl_sock_load_pem_into_ckch(pl->path, NULL, &pl->data, NULL);
+	}
+	return NULL;
+}
+
+/* Parses all the files registered with ckch_preload_add() using up to
+ * "tune.ssl.load-threads" threads including the current one, then makes the
+ * results available to ssl_sock_load_pem_into_ckch(). If threads cannot be
+ * created, the remaining work is simply done by the current thread.
+ */
+void ckch_preload_run(void)
+{
+	struct ckch_preload_ctx ctx = { };
+	struct ebmb_node *node;
+	int i;
+#ifdef USE_THREAD
+	pthread_t *thr = NULL;
+	int nbthr;
+#endif
+
+	if (!ckch_preload_cnt || ckch_preload_ready)
+		return;
+
+	ctx.jobs = calloc(ckch_preload_cnt, sizeof(*ctx.jobs));
+	if (!ctx.jobs)
+		goto done;
+
+	for (i = 0, node = ebmb_first(&ckch_preload_tree); node; node = ebmb_next(node))
+		ctx.jobs[i++] = ebmb_entry(node, struct ckch_preload, node);
+
+#ifdef USE_THREAD
+	nbthr = MIN(global_ssl.load_threads, ckch_preload_cnt) - 1;
+	if (nbthr > 0)
+		thr = calloc(nbthr, sizeof(*thr));
+	if (!thr)
+		nbthr = 0;
+
+	for (i = 0; i < nbthr; i++) {
+		if (pthread_create(&thr[i], NULL, ckch_preload_worker, &ctx) != 0)
+			break;
+	}
+	nbthr = i;
+#endif
+	ckch_preload_worker(&ctx);
+
+#ifdef USE_THREAD
+	for (i = 0; i < nbthr; i++)
+		pthread_join(thr[i], NULL);
+	free(thr);
+#endif
+	free(ctx.jobs);
+done:
+	ckch_preload_ready = 1;
+}
+
+/* Looks up a successfully preloaded entry for <path> and detaches it from the
+ * tree. Returns it or NULL if none is found, in which case the file must be
+ * parsed as usual. The caller is responsible for freeing the entry.
+ */
+static struct ckch_preload *ckch_preload_take(const char *path)
+{
+	struct ebmb_node *node;
+	struct ckch_preload *pl;
+
+	if (!ckch_preload_ready)
+		return NULL;
+
+	node = ebst_lookup(&ckch_preload_tree, path);
+	if (!node)
+		return NULL;
+
+	pl = ebmb_entry(node, struct ckch_preload, node);
+	ebmb_delete(&pl->node);
+	ckch_preload_cnt--;
+	if (pl->ret != 0) {
+		free(pl);
+		return NULL;
+	}
+	return pl;
+}
+
+/* Releases all the preloaded entries which were not used, and rearms the
+ * preloading for the next crt-list or directory.
+ */
+void ckch_preload_flush(void)
+{
+	struct ebmb_node *node, *next;
+	struct ckch_preload *pl;
+
+	for (node = ebmb_first(&ckch_preload_tree); node; node = next) {
+		next = ebmb_next(node);
+		pl = ebmb_entry(node, struct ckch_preload, node);
+		ebmb_delete(&pl->node);
+		ssl_sock_free_cert_key_and_chain_contents(&pl->data);
+		free(pl);
+	}
+	ckch_preload_cnt = 0;
+	ckch_preload_ready = 0;
+}
+
 /*
  *  Try to load a PEM file from a <path> or a buffer <buf>
  *  The PEM must contain at least a Certificate,
@@ -667,6 +841,7 @@ int ssl_sock_load_pem_into_ckch(const char *path, char *buf, struct ckch_data *d
 	HASSL_DH *dh = NULL;
 	STACK_OF(X509) *chain = NULL;
 	struct issuer_chain *issuer_chain = NULL;
+	struct ckch_preload *pl;
 
 	if (buf) {
 		/* reading from a buffer */
@@ -676,6 +851,15 @@ int ssl_sock_load_pem_into_ckch(const char *path, char *buf, struct ckch_data *d
 			goto end;
 		}
 
+	} else if ((pl = ckch_preload_take(path)) != NULL) {
+		/* already parsed by ckch_preload_run() */
+		SWAP(key, pl->data.key);
+		SWAP(dh, pl->data.dh);
+		SWAP(cert, pl->data.cert);
+		SWAP(chain, pl->data.chain);
+		SWAP(issuer_chain, pl->data.extra_chain);
+		free(pl);
+		goto loaded;
 	} else {
 		/* reading from a file */
 		in = BIO_new(BIO_s_file());
@@ -748,6 +932,7 @@ int ssl_sock_load_pem_into_ckch(const char *path, char *buf, struct ckch_data *d
 		goto end;
 	}
 
+loaded:
 	/* once it loaded the PEM, it should remove everything else in the data */
 	if (data->ocsp_response) {
 		ha_free(&data->ocsp_response->area);
@@ -1216,7 +1401,8 @@ void ckch_inst_free(struct ckch_inst *inst)
 	list_for_each_entry_safe(sni, sni_s, &inst->sni_ctx, by_ckch_inst) {
 		SSL_CTX_free(sni->ctx);
 		LIST_DELETE(&sni->by_ckch_inst);
-		ebmb_delete(&sni->name);
+		if (inst->bind_conf)
+			ssl_sock_delete_sni(inst->bind_conf, sni);
 		free(sni);
 	}
 	SSL_CTX_free(inst->ctx);
@@ -1654,7 +1840,7 @@ static int cli_io_handler_show_sni(struct appctx *appctx)
 {
 	struct show_sni_ctx *ctx = appctx->svcctx;
 	struct buffer *trash = alloc_trash_chunk();
-	struct ebmb_node *n = NULL;
+	struct sni_ctx *n = NULL;
 	int type = 0;
 	struct bind_conf *bind = NULL;
 	struct proxy *px = NULL;
@@ -1690,25 +1876,17 @@ static int cli_io_handler_show_sni(struct appctx *appctx)
 
 				n = ctx->n; /* get the node from previous yield */
 
-				if (!n) {
-					if (type == 0)
-						n = ebmb_first(&bind->sni_ctx);
-					else
-						n = ebmb_first(&bind->sni_w_ctx);
-				}
-				/* empty SNI tree, skip */
 				if (!n)
-					continue;
+					n = ssl_sock_next_sni(bind, NULL);
 
-				for (; n; n = ebmb_next(n)) {
-					struct sni_ctx *sni;
+				for (; n; n = ssl_sock_next_sni(bind, n)) {
+					struct sni_ctx *sni = n;
 					const char *name;
 					const char *certalg;
 					int isneg = 0; /* is there any negative filters associated to this node */
 
-					sni = ebmb_entry(n, struct sni_ctx, name);
-
-					if (sni->neg)
+					/* full names first, then wildcards */
+					if (sni->neg || sni->wild != type)
 						continue;
 #ifdef HAVE_ASN1_TIME_TO_TM
 					if (ctx->options & SHOW_SNI_OPT_NOTAFTER) {
@@ -1720,7 +1898,7 @@ static int cli_io_handler_show_sni(struct appctx *appctx)
 
 					chunk_appendf(trash, "%s/%s:%d\t", bind->frontend->id, bind->file, bind->line);
 
-					name = (char *)sni->name.key;
+					name = sni->name;
 
 					chunk_appendf(trash, "%s%s%s\t", sni->neg ? "!" : "", type ? "*" : "",  name);
 
@@ -1729,7 +1907,7 @@ static int cli_io_handler_show_sni(struct appctx *appctx)
 						struct sni_ctx *sni_tmp;
 						list_for_each_entry(sni_tmp, &sni->ckch_inst->sni_ctx, by_ckch_inst) {
 							if (sni_tmp->neg) {
-								chunk_appendf(trash, "%s%s ", sni_tmp->neg ? "!" : "",  (char *)sni_tmp->name.key);
+								chunk_appendf(trash, "%s%s ", sni_tmp->neg ? "!" : "",  sni_tmp->name);
 								isneg = 1;
 							}
 						}
@@ -2774,6 +2952,10 @@ static void __ssl_sock_load_new_ckch_instance(struct ckch_inst *ckchi)
 			ha_free(&ckchi->server->ssl_ctx.reused_sess[i].sni);
 			ha_free(&ckchi->server->ssl_ctx.reused_sess[i].ptr);
 		}
+		for (i = 0; ckchi->server->ssl_ctx.shared_sess && i < global_ssl.srv_sess_pool; i++) {
+			ha_free(&ckchi->server->ssl_ctx.shared_sess[i].sni);
+			ha_free(&ckchi->server->ssl_ctx.shared_sess[i].ptr);
+		}
 		HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &ckchi->server->ssl_ctx.lock);
 
 	} else {
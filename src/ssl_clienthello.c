@@ -31,16 +31,51 @@ static void ssl_sock_switchctx_set(SSL *ssl, SSL_CTX *ctx)
 	SSL_set_SSL_CTX(ssl, ctx);
 }
 
+/* Switches <ssl> to the SSL context of <sni>, which is built first if it is
+ * lazy. Returns 0 if it could not be built, otherwise non-zero.
+ */
+static int ssl_sock_switchctx_sni(SSL *ssl, struct sni_ctx *sni)
+{
+	SSL_CTX *ctx;
+
+	if (sni->ctx) {
+		ssl_sock_switchctx_set(ssl, sni->ctx);
+		return 1;
+	}
+
+	ctx = ckch_inst_get_lazy_ctx(sni->ckch_inst);
+	if (!ctx)
+		return 0;
+
+	ssl_sock_switchctx_set(ssl, ctx);
+	SSL_CTX_free(ctx);
+	return 1;
+}
+
+/* Returns non-zero if <servername> is excluded from the wildcard <sni> by a
+ * negative filter on the same crt-list line.
+ */
+static int ssl_sock_sni_is_excluded(struct bind_conf *s, struct sni_ctx *sni, const char *servername)
+{
+	struct sni_ctx *neg;
+
+	for (neg = ssl_sock_lookup_sni(s, servername, 0); neg; neg = ssl_sock_lookup_sni_next(s, neg)) {
+		if (neg->neg && neg->ckch_inst == sni->ckch_inst)
+			return 1;
+	}
+	return 0;
+}
+
 /*
  * Return the right sni_ctx for a <bind_conf> and a chosen <servername> (must be in lowercase)
  * RSA <have_rsa_sig> and ECDSA <have_ecdsa_sig> capabilities of the client can also be used.
  *
- * This function does a lookup in the bind_conf sni tree so the caller should lock its tree.
+ * This function does a lookup in the bind_conf sni index so the caller should lock it.
  */
 struct sni_ctx *ssl_sock_chose_sni_ctx(struct bind_conf *s, struct connection *conn,
                                        const char *servername, int have_rsa_sig, int have_ecdsa_sig)
 {
-	struct ebmb_node *node, *n, *node_ecdsa = NULL, *node_rsa = NULL, *node_anonymous = NULL;
+	struct sni_ctx *node, *n, *node_ecdsa = NULL, *node_rsa = NULL, *node_anonymous = NULL;
 	const char *wildp = NULL;
 	int i;
 
@@ -61,33 +96,21 @@ struct sni_ctx *ssl_sock_chose_sni_ctx(struct bind_conf *s, struct connection *c
 	 * name and if not found in the wildcard  */
 	for (i = 0; i < 2; i++) {
 		if (i == 0) 	/* lookup in full qualified names */
-			node = ebst_lookup(&s->sni_ctx, trash.area);
+			node = ssl_sock_lookup_sni(s, servername, 0);
 		else if (i == 1 && wildp)  /* lookup in wildcards names */
-			node = ebst_lookup(&s->sni_w_ctx, wildp);
+			node = ssl_sock_lookup_sni(s, wildp, 1);
 		else
 			break;
 
-		for (n = node; n; n = ebmb_next_dup(n)) {
+		for (n = node; n; n = ssl_sock_lookup_sni_next(s, n)) {
 
 			/* lookup a not neg filter */
-			if (!container_of(n, struct sni_ctx, name)->neg) {
-				struct sni_ctx *sni, *sni_tmp;
-				int skip = 0;
-
-				if (i == 1 && wildp) { /* wildcard */
-					/* If this is a wildcard, look for an exclusion on the same crt-list line */
-					sni = container_of(n, struct sni_ctx, name);
-					list_for_each_entry(sni_tmp, &sni->ckch_inst->sni_ctx, by_ckch_inst) {
-						if (sni_tmp->neg && (strcmp((const char *)sni_tmp->name.key, trash.area) == 0)) {
-							skip = 1;
-							break;
-						}
-					}
-					if (skip)
-						continue;
-				}
+			if (!n->neg) {
+				/* If this is a wildcard, look for an exclusion on the same crt-list line */
+				if (i == 1 && ssl_sock_sni_is_excluded(s, n, servername))
+					continue;
 
-				switch(container_of(n, struct sni_ctx, name)->kinfo.sig) {
+				switch(n->kinfo.sig) {
 				case TLSEXT_signature_ecdsa:
 					if (!node_ecdsa)
 						node_ecdsa = n;
@@ -126,7 +149,7 @@ struct sni_ctx *ssl_sock_chose_sni_ctx(struct bind_conf *s, struct connection *c
 
 	if (node) {
 		TRACE_LEAVE(SSL_EV_CONN_CHOOSE_SNI_CTX, conn);
-		return container_of(node, struct sni_ctx, name);
+		return node;
 	}
 
 	TRACE_STATE("No SNI context found", SSL_EV_CONN_CHOOSE_SNI_CTX, conn);
@@ -454,7 +477,12 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 	if (sni_ctx) {
 		/* switch ctx */
 		struct ssl_bind_conf *conf = sni_ctx->conf;
-		ssl_sock_switchctx_set(ssl, sni_ctx->ctx);
+
+		if (!ssl_sock_switchctx_sni(ssl, sni_ctx)) {
+			HA_RWLOCK_RDUNLOCK(SNI_LOCK, &s->sni_lock);
+			TRACE_ERROR("Failed to build lazy SSL context", SSL_EV_CONN_SWITCHCTX_CB|SSL_EV_CONN_ERR, conn);
+			goto abort;
+		}
 		if (conf) {
 			methodVersions[conf->ssl_methods.min].ssl_set_version(ssl, SET_MIN);
 			methodVersions[conf->ssl_methods.max].ssl_set_version(ssl, SET_MAX);
@@ -536,7 +564,7 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *priv)
 {
 	const char *servername;
 	const char *wildp = NULL;
-	struct ebmb_node *node, *n;
+	struct sni_ctx *node, *n;
 	struct bind_conf *s = priv;
 	int default_lookup = 0; /* did we lookup for a default yet? */
 #ifdef USE_QUIC
@@ -608,9 +636,9 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *priv)
 	node = NULL;
 	/* lookup in full qualified names */
 	TRACE_STATE("Lookup in fully qualified names", SSL_EV_CONN_SWITCHCTX_CB, NULL, ssl, servername);
-	for (n = ebst_lookup(&s->sni_ctx, trash.area); n; n = ebmb_next_dup(n)) {
+	for (n = ssl_sock_lookup_sni(s, trash.area, 0); n; n = ssl_sock_lookup_sni_next(s, n)) {
 		/* lookup a not neg filter */
-		if (!container_of(n, struct sni_ctx, name)->neg) {
+		if (!n->neg) {
 			node = n;
 			break;
 		}
@@ -618,9 +646,9 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *priv)
 	if (!node && wildp) {
 		/* lookup in wildcards names */
 		TRACE_STATE("Lookup in wildcard names", SSL_EV_CONN_SWITCHCTX_CB, NULL, ssl, servername);
-		for (n = ebst_lookup(&s->sni_w_ctx, wildp); n; n = ebmb_next_dup(n)) {
+		for (n = ssl_sock_lookup_sni(s, wildp, 1); n; n = ssl_sock_lookup_sni_next(s, n)) {
 			/* lookup a not neg filter */
-			if (!container_of(n, struct sni_ctx, name)->neg) {
+			if (!n->neg) {
 				node = n;
 				break;
 			}
@@ -651,7 +679,11 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *priv)
 	}
 
 	/* switch ctx */
-	ssl_sock_switchctx_set(ssl, container_of(node, struct sni_ctx, name)->ctx);
+	if (!ssl_sock_switchctx_sni(ssl, node)) {
+		HA_RWLOCK_RDUNLOCK(SNI_LOCK, &s->sni_lock);
+		TRACE_ERROR("Failed to build lazy SSL context", SSL_EV_CONN_SWITCHCTX_CB, NULL, ssl, servername);
+		return SSL_TLSEXT_ERR_ALERT_FATAL;
+	}
 	HA_RWLOCK_RDUNLOCK(SNI_LOCK, &s->sni_lock);
 	TRACE_LEAVE(SSL_EV_CONN_SWITCHCTX_CB);
 	return SSL_TLSEXT_ERR_OK;
@@ -749,7 +781,11 @@ int ssl_sock_switchctx_wolfSSL_cbk(WOLFSSL* ssl, void* arg)
 	if (sni_ctx) {
 		/* switch ctx */
 		struct ssl_bind_conf *conf = sni_ctx->conf;
-		ssl_sock_switchctx_set(ssl, sni_ctx->ctx);
+
+		if (!ssl_sock_switchctx_sni(ssl, sni_ctx)) {
+			HA_RWLOCK_RDUNLOCK(SNI_LOCK, &s->sni_lock);
+			goto abort;
+		}
 		if (conf) {
 			methodVersions[conf->ssl_methods.min].ssl_set_version(ssl, SET_MIN);
 			methodVersions[conf->ssl_methods.max].ssl_set_version(ssl, SET_MAX);
@@ -638,6 +638,44 @@ int crtlist_load_crt(char *crt_path, struct ckch_conf *cc, struct crtlist *newli
 }
 
 
+/* Registers the certificate files referenced by the crt-list <f> to be
+ * preloaded in parallel, then preloads them and rewinds <f>. Only the first
+ * word of each line is considered, errors are left to the regular parser.
+ */
+static void crtlist_preload_file(FILE *f)
+{
+	char thisline[CRT_LINESIZE];
+	char path[MAXPATHLEN+1];
+	char *line, *end;
+
+	while (fgets(thisline, sizeof(thisline), f) != NULL) {
+		line = thisline;
+		if (*line == '#')
+			continue;
+
+		while (isspace((unsigned char)*line))
+			line++;
+
+		for (end = line; *end && *end != '[' && !isspace((unsigned char)*end); end++)
+			;
+		*end = 0;
+
+		if (!*line)
+			continue;
+
+		if (*line != '@' && *line != '/' && global_ssl.crt_base) {
+			if (snprintf(path, sizeof(path), "%s/%s", global_ssl.crt_base, line) >= sizeof(path))
+				continue;
+			line = path;
+		}
+
+		if (ckch_preload_add(line) < 0)
+			break;
+	}
+	rewind(f);
+	ckch_preload_run();
+}
+
 /* This function parse a crt-list file and store it in a struct crtlist, each line is a crtlist_entry structure
  * Fill the <crtlist> argument with a pointer to a new crtlist struct
  *
@@ -665,6 +703,9 @@ int crtlist_parse_file(char *file, struct bind_conf *bind_conf, struct proxy *cu
 		goto error;
 	}
 
+	if (global_ssl.load_threads > 1)
+		crtlist_preload_file(f);
+
 	while (fgets(thisline, sizeof(thisline), f) != NULL) {
 		char *end;
 		char *line = thisline;
@@ -750,6 +791,7 @@ int crtlist_parse_file(char *file, struct bind_conf *bind_conf, struct proxy *cu
 
 	newlist->linecount = linenum;
 
+	ckch_preload_flush();
 	fclose(f);
 	*crtlist = newlist;
 
@@ -759,6 +801,7 @@ int crtlist_parse_file(char *file, struct bind_conf *bind_conf, struct proxy *cu
 
 	/* FIXME: free cc */
 
+	ckch_preload_flush();
 	fclose(f);
 	crtlist_free(newlist);
 	return cfgerr;
@@ -793,6 +836,19 @@ int crtlist_load_cert_dir(char *path, struct bind_conf *bind_conf, struct crtlis
 		cfgerr |= ERR_ALERT | ERR_FATAL;
 	}
 	else {
+		for (i = 0; global_ssl.load_threads > 1 && i < n; i++) {
+			end = strrchr(de_list[i]->d_name, '.');
+			if (end && (de_list[i]->d_name[0] == '.' ||
+			            strcmp(end, ".issuer") == 0 || strcmp(end, ".ocsp") == 0 ||
+			            strcmp(end, ".sctl") == 0 || strcmp(end, ".key") == 0))
+				continue;
+
+			snprintf(fp, sizeof(fp), "%s/%s", path, de_list[i]->d_name);
+			if (ckch_preload_add(fp) < 0)
+				break;
+		}
+		ckch_preload_run();
+
 		for (i = 0; i < n; i++) {
 			struct crtlist_entry *entry;
 			struct dirent *de = de_list[i];
@@ -840,6 +896,7 @@ int crtlist_load_cert_dir(char *path, struct bind_conf *bind_conf, struct crtlis
 		}
 end:
 		free(de_list);
+		ckch_preload_flush();
 	}
 
 	if (cfgerr & ERR_CODE) {
@@ -1581,7 +1638,7 @@ static int cli_parse_del_crtlist(char **args, char *payload, struct appctx *appc
 
 		HA_RWLOCK_WRLOCK(SNI_LOCK, &inst->bind_conf->sni_lock);
 		list_for_each_entry_safe(sni, sni_s, &inst->sni_ctx, by_ckch_inst) {
-			ebmb_delete(&sni->name);
+			ssl_sock_delete_sni(inst->bind_conf, sni);
 			LIST_DELETE(&sni->by_ckch_inst);
 			SSL_CTX_free(sni->ctx);
 			free(sni);
@@ -15,6 +15,7 @@
 #include <haproxy/quic_ssl.h>
 #include <haproxy/ssl_ckch.h>
 #include <haproxy/ssl_sock.h>
+#include <haproxy/stick_table.h>
 #include <haproxy/xxhash.h>
 
 #if (defined SSL_CTRL_SET_TLSEXT_HOSTNAME && !defined SSL_NO_GENERATE_CERTIFICATES)
@@ -34,6 +35,9 @@ static char *x509v3_ext_values[X509V3_EXT_SIZE] = {
 	"keyid,issuer:always",
 	"nonRepudiation,digitalSignature,keyEncipherment"
 };
+/* maximum length of a DER encoded certificate stored in the "ssl-gencert-table" */
+#define SSL_GENCERT_MAX_LEN 4096
+
 /* LRU cache to store generated certificate */
 static struct lru64_head *ssl_ctx_lru_tree = NULL;
 static unsigned int       ssl_ctx_lru_seed = 0;
@@ -81,38 +85,21 @@ int ssl_sock_add_san_ext(X509V3_CTX* ctx, X509* cert, const char *servername) {
 	return failure;
 }
 
-/* Create a X509 certificate with the specified servername and serial. This
- * function returns a SSL_CTX object or NULL if an error occurs. */
-static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf *bind_conf, SSL *ssl)
+/* Signs with the CA of <bind_conf> a new X509 certificate for <servername> and
+ * public key <pkey>, using the next serial. This function returns the
+ * certificate or NULL if an error occurs.
+ */
+static X509 *ssl_sock_do_sign_cert(const char *servername, struct bind_conf *bind_conf, EVP_PKEY *pkey)
 {
 	X509         *cacert  = bind_conf->ca_sign_ckch->cert;
 	EVP_PKEY     *capkey  = bind_conf->ca_sign_ckch->key;
-	SSL_CTX      *ssl_ctx = NULL;
 	X509         *newcrt  = NULL;
-	EVP_PKEY     *pkey    = NULL;
-	SSL          *tmp_ssl = NULL;
 	CONF         *ctmp    = NULL;
 	X509_NAME    *name;
 	const EVP_MD *digest;
 	X509V3_CTX    ctx;
 	unsigned int  i;
 	int 	      key_type;
-	struct sni_ctx *sni_ctx;
-
-	sni_ctx = ssl_sock_chose_sni_ctx(bind_conf, NULL, "", 1, 1);
-	if (!sni_ctx)
-		goto mkcert_error;
-
-	/* Get the private key of the default certificate and use it */
-#ifdef HAVE_SSL_CTX_get0_privatekey
-	pkey = SSL_CTX_get0_privatekey(sni_ctx->ctx);
-#else
-	tmp_ssl = SSL_new(sni_ctx->ctx);
-	if (tmp_ssl)
-		pkey = SSL_get_privatekey(tmp_ssl);
-#endif
-	if (!pkey)
-		goto mkcert_error;
 
 	/* Create the certificate */
 	if (!(newcrt = X509_new()))
@@ -199,6 +186,23 @@ static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf
 	if (!(X509_sign(newcrt, capkey, digest)))
 		goto mkcert_error;
 
+	NCONF_free(ctmp);
+	return newcrt;
+
+ mkcert_error:
+	if (ctmp) NCONF_free(ctmp);
+	if (newcrt)  X509_free(newcrt);
+	return NULL;
+}
+
+/* Creates a SSL_CTX for <bind_conf> presenting the generated certificate
+ * <newcrt> with private key <pkey>. This function returns the SSL_CTX object
+ * or NULL if an error occurs.
+ */
+static SSL_CTX *ssl_sock_do_create_ctx(X509 *newcrt, EVP_PKEY *pkey, struct bind_conf *bind_conf)
+{
+	SSL_CTX      *ssl_ctx = NULL;
+
 	/* Create and set the new SSL_CTX */
 	if (!(ssl_ctx = SSL_CTX_new(SSLv23_server_method())))
 		goto mkcert_error;
@@ -220,6 +224,8 @@ static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf
 	}
 
 	if (bind_conf->ca_sign_ckch->chain) {
+		int i;
+
 		for (i = 0; i < sk_X509_num(bind_conf->ca_sign_ckch->chain); i++) {
 			X509 *chain_cert = sk_X509_value(bind_conf->ca_sign_ckch->chain, i);
 			if (!SSL_CTX_add1_chain_cert(ssl_ctx, chain_cert)) {
@@ -229,8 +235,6 @@ static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf
 	}
 #endif
 
-	if (newcrt) X509_free(newcrt);
-
 #ifndef OPENSSL_NO_DH
 #if (HA_OPENSSL_VERSION_NUMBER < 0x3000000fL)
 	SSL_CTX_set_tmp_dh_callback(ssl_ctx, ssl_get_tmp_dh_cbk);
@@ -267,13 +271,149 @@ static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf
 	return ssl_ctx;
 
  mkcert_error:
-	if (ctmp) NCONF_free(ctmp);
-	if (tmp_ssl) SSL_free(tmp_ssl);
 	if (ssl_ctx) SSL_CTX_free(ssl_ctx);
-	if (newcrt)  X509_free(newcrt);
 	return NULL;
 }
 
+/* Looks up the certificate generated for <servername> in the
+ * "ssl-gencert-table", which may have been learned from a peer or from the
+ * previous process. It is only returned if it was issued by the CA of
+ * <bind_conf> for private key <pkey> and is not expired, otherwise NULL is
+ * returned.
+ */
+static X509 *ssl_gencert_table_lookup(const char *servername, struct bind_conf *bind_conf, EVP_PKEY *pkey)
+{
+	struct stktable *t = global_ssl.gencert_table;
+	struct stktable_key key = { .key = (void *)servername, .key_len = strlen(servername) };
+	struct stktable_blob *blob;
+	const unsigned char *p;
+	struct stksess *ts;
+	X509 *cert = NULL;
+	void *ptr;
+
+	/* longer names would be truncated in the table */
+	if (key.key_len >= t->key_size)
+		return NULL;
+
+	ts = stktable_lookup_key(t, &key);
+	if (!ts)
+		return NULL;
+
+	HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = stktable_data_ptr(t, ts, STKTABLE_DT_SSL_GENCERT);
+	blob = ptr ? stktable_data_cast(ptr, std_t_blob) : NULL;
+	if (blob) {
+		p = blob->data;
+		cert = d2i_X509(NULL, &p, blob->len);
+	}
+	HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+	HA_ATOMIC_DEC(&ts->ref_cnt);
+
+	if (!cert)
+		return NULL;
+
+	if (X509_check_issued(bind_conf->ca_sign_ckch->cert, cert) != X509_V_OK ||
+	    X509_cmp_current_time(X509_getm_notAfter(cert)) <= 0 ||
+	    !X509_check_private_key(cert, pkey)) {
+		/* it will be replaced by a new one */
+		ERR_clear_error();
+		X509_free(cert);
+		return NULL;
+	}
+	return cert;
+}
+
+/* Stores the certificate <cert> generated for <servername> into the
+ * "ssl-gencert-table" so that it is pushed to the peers.
+ */
+static void ssl_gencert_table_store(const char *servername, X509 *cert)
+{
+	struct stktable *t = global_ssl.gencert_table;
+	struct stktable_key key = { .key = (void *)servername, .key_len = strlen(servername) };
+	struct stktable_blob *blob;
+	struct stksess *ts;
+	unsigned char *p;
+	void *ptr;
+	int len;
+
+	if (key.key_len >= t->key_size)
+		return;
+
+	len = i2d_X509(cert, NULL);
+	if (len <= 0 || len > SSL_GENCERT_MAX_LEN)
+		return;
+
+	blob = malloc(sizeof(*blob) + len);
+	if (!blob)
+		return;
+	p = blob->data;
+	blob->len = i2d_X509(cert, &p);
+
+	ts = stktable_get_entry(t, &key);
+	if (!ts) {
+		free(blob);
+		return;
+	}
+
+	HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = stktable_data_ptr(t, ts, STKTABLE_DT_SSL_GENCERT);
+	if (ptr) {
+		free(stktable_data_cast(ptr, std_t_blob));
+		stktable_data_cast(ptr, std_t_blob) = blob;
+		blob = NULL;
+	}
+	HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &ts->lock);
+	free(blob);
+
+	stktable_touch_local(t, ts, 1);
+}
+
+/* Create a X509 certificate with the specified servername and serial, or
+ * reuse the one found in the "ssl-gencert-table" if any. This function
+ * returns a SSL_CTX object or NULL if an error occurs.
+ */
+static SSL_CTX *ssl_sock_do_create_cert(const char *servername, struct bind_conf *bind_conf, SSL *ssl)
+{
+	SSL_CTX      *ssl_ctx = NULL;
+	X509         *newcrt  = NULL;
+	EVP_PKEY     *pkey    = NULL;
+	SSL          *tmp_ssl = NULL;
+	struct sni_ctx *sni_ctx;
+
+	sni_ctx = ssl_sock_chose_sni_ctx(bind_conf, NULL, "", 1, 1);
+	if (!sni_ctx)
+		goto end;
+
+	/* Get the private key of the default certificate and use it */
+#ifdef HAVE_SSL_CTX_get0_privatekey
+	pkey = SSL_CTX_get0_privatekey(sni_ctx->ctx);
+#else
+	tmp_ssl = SSL_new(sni_ctx->ctx);
+	if (tmp_ssl)
+		pkey = SSL_get_privatekey(tmp_ssl);
+#endif
+	if (!pkey)
+		goto end;
+
+	if (global_ssl.gencert_table)
+		newcrt = ssl_gencert_table_lookup(servername, bind_conf, pkey);
+
+	if (!newcrt) {
+		newcrt = ssl_sock_do_sign_cert(servername, bind_conf, pkey);
+		if (!newcrt)
+			goto end;
+		if (global_ssl.gencert_table)
+			ssl_gencert_table_store(servername, newcrt);
+	}
+
+	ssl_ctx = ssl_sock_do_create_ctx(newcrt, pkey, bind_conf);
+
+ end:
+	if (tmp_ssl) SSL_free(tmp_ssl);
+	if (newcrt)  X509_free(newcrt);
+	return ssl_ctx;
+}
+
 
 /* Do a lookup for a certificate in the LRU cache used to store generated
  * certificates and immediately assign it to the SSL session if not null. */
@@ -336,6 +476,9 @@ ssl_sock_generated_cert_key(const void *data, size_t len)
 
 /* Generate a cert and immediately assign it to the SSL session so that the cert's
  * refcount is maintained regardless of the cert's presence in the LRU cache.
+ * The certificate is created out of the LRU lock so that other threads are not
+ * blocked meanwhile, hence the second lookup in case another thread created
+ * the same one in parallel.
  */
 int ssl_sock_generate_certificate(const char *servername, struct bind_conf *bind_conf, SSL *ssl)
 {
@@ -346,15 +489,24 @@ int ssl_sock_generate_certificate(const char *servername, struct bind_conf *bind
 
 	key = ssl_sock_generated_cert_key(servername, strlen(servername));
 	if (ssl_ctx_lru_tree) {
+		if (ssl_sock_assign_generated_cert(key, bind_conf, ssl))
+			return 1;
+
+		ssl_ctx = ssl_sock_do_create_cert(servername, bind_conf, ssl);
+
 		HA_RWLOCK_WRLOCK(SSL_GEN_CERTS_LOCK, &ssl_ctx_lru_rwlock);
 		lru = lru64_get(key, ssl_ctx_lru_tree, cacert, 0);
-		if (lru && lru->domain)
+		if (lru && lru->domain && lru->data) {
+			SSL_CTX_free(ssl_ctx);
 			ssl_ctx = (SSL_CTX *)lru->data;
-		if (!ssl_ctx && lru) {
-			ssl_ctx = ssl_sock_do_create_cert(servername, bind_conf, ssl);
-			lru64_commit(lru, ssl_ctx, cacert, 0, (void (*)(void *))SSL_CTX_free);
 		}
+		else if (lru)
+			lru64_commit(lru, ssl_ctx, cacert, 0, (void (*)(void *))SSL_CTX_free);
 		SSL_set_SSL_CTX(ssl, ssl_ctx);
+		if (!lru) {
+			/* not cached, will be released with the session */
+			SSL_CTX_free(ssl_ctx);
+		}
 		HA_RWLOCK_WRUNLOCK(SSL_GEN_CERTS_LOCK, &ssl_ctx_lru_rwlock);
 		return 1;
 	}
@@ -445,6 +597,37 @@ ssl_sock_gencert_load_ca(struct bind_conf *bind_conf)
 	return ret;
 }
 
+/* resolves the "ssl-gencert-table" stick-table and checks it is suitable to
+ * store the generated certificates.
+ */
+static int ssl_gencert_table_finalize_config(void)
+{
+	struct stktable *t;
+
+	if (!global_ssl.gencert_table_name)
+		return ERR_NONE;
+
+	t = stktable_find_by_name(global_ssl.gencert_table_name);
+	if (!t) {
+		ha_alert("ssl-gencert-table: unable to find table '%s'.\n", global_ssl.gencert_table_name);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (t->type != SMP_T_STR) {
+		ha_alert("ssl-gencert-table: table '%s' must be of type 'string'.\n", t->id);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (!t->data_ofs[STKTABLE_DT_SSL_GENCERT]) {
+		ha_alert("ssl-gencert-table: table '%s' must store 'ssl_gencert'.\n", t->id);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	global_ssl.gencert_table = t;
+	return ERR_NONE;
+}
+REGISTER_POST_CHECK(ssl_gencert_table_finalize_config);
+
 /* Release CA cert and private key used to generate certificated */
 void
 ssl_sock_gencert_free_ca(struct bind_conf *bind_conf)
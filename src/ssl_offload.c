@@ -0,0 +1,467 @@
+/*
+ * Offloading of the SSL private key operations to crypto threads.
+ *
+ * When "tune.ssl.offload-threads" is set, the RSA and EC private keys loaded
+ * into the SSL contexts are wrapped into keys using dedicated methods. When
+ * such a key is used from an OpenSSL async job (i.e. during a handshake in
+ * async mode), the operation is queued to a pool of crypto threads and the job
+ * is paused. The crypto thread then writes to a pipe registered as the job's
+ * wait fd, which is polled by the connection's thread like any async engine
+ * fd, and the handshake resumes from the connection's tasklet. Outside of an
+ * async job, the operation is performed inline as usual.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+/* RSA_METHOD and EC_KEY_METHOD are deprecated since OpenSSL 3.0, but they are
+ * still the only way to intercept private key operations short of writing a
+ * whole provider, so the deprecation warnings are silenced for this file.
+ */
+#define OPENSSL_SUPPRESS_DEPRECATED
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <haproxy/api.h>
+#include <haproxy/errors.h>
+#include <haproxy/global.h>
+#include <haproxy/openssl-compat.h>
+#include <haproxy/ssl_offload.h>
+#include <haproxy/ssl_sock.h>
+#include <haproxy/thread.h>
+#include <haproxy/tools.h>
+
+#if defined(HAVE_SSL_ASYNC_OFFLOAD) && defined(USE_THREAD)
+
+/* operation types */
+#define SSL_OFFLOAD_RSA_PRIV_ENC   1
+#define SSL_OFFLOAD_RSA_PRIV_DEC   2
+#define SSL_OFFLOAD_EC_SIGN        3
+
+/* A private key operation waiting for a crypto thread. It is allocated on the
+ * stack of the paused async job, which cannot be released before the crypto
+ * thread notifies <wfd>.
+ */
+struct ssl_offload_op {
+	struct ssl_offload_op *next;  /* next operation in the queue */
+	int type;                     /* SSL_OFFLOAD_* */
+	int ret;                      /* operation's return value */
+	int wfd;                      /* notification fd, written once done */
+	union {
+		struct {
+			int flen;
+			const unsigned char *from;
+			unsigned char *to;
+			RSA *rsa;
+			int padding;
+		} rsa;
+		struct {
+			int type;
+			const unsigned char *dgst;
+			int dlen;
+			unsigned char *sig;
+			unsigned int *siglen;
+			const BIGNUM *kinv;
+			const BIGNUM *r;
+			EC_KEY *eckey;
+		} ec;
+	};
+};
+
+static RSA_METHOD *ssl_offload_rsa_meth;
+static EC_KEY_METHOD *ssl_offload_ec_meth;
+
+/* default implementations, called by the crypto threads */
+static int (*ssl_offload_rsa_priv_enc_fct)(int, const unsigned char *, unsigned char *, RSA *, int);
+static int (*ssl_offload_rsa_priv_dec_fct)(int, const unsigned char *, unsigned char *, RSA *, int);
+static int (*ssl_offload_ec_sign_fct)(int, const unsigned char *, int, unsigned char *, unsigned int *,
+                                      const BIGNUM *, const BIGNUM *, EC_KEY *);
+
+/* key used to store our pipe in the async jobs' wait contexts */
+static const char ssl_offload_waitctx_key;
+
+/* queue of pending operations and crypto threads */
+static pthread_mutex_t ssl_offload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ssl_offload_cond = PTHREAD_COND_INITIALIZER;
+static struct ssl_offload_op *ssl_offload_head;
+static struct ssl_offload_op *ssl_offload_tail;
+static int ssl_offload_queued;   /* number of operations in the queue */
+static int ssl_offload_idle;     /* number of threads waiting for operations */
+static pthread_t *ssl_offload_threads;
+static int ssl_offload_nbthreads;
+static int ssl_offload_stopping;
+
+/* Performs operation <op> in the current thread and returns its result */
+static int ssl_offload_exec(struct ssl_offload_op *op)
+{
+	switch (op->type) {
+	case SSL_OFFLOAD_RSA_PRIV_ENC:
+		return ssl_offload_rsa_priv_enc_fct(op->rsa.flen, op->rsa.from, op->rsa.to, op->rsa.rsa, op->rsa.padding);
+	case SSL_OFFLOAD_RSA_PRIV_DEC:
+		return ssl_offload_rsa_priv_dec_fct(op->rsa.flen, op->rsa.from, op->rsa.to, op->rsa.rsa, op->rsa.padding);
+	case SSL_OFFLOAD_EC_SIGN:
+		return ssl_offload_ec_sign_fct(op->ec.type, op->ec.dgst, op->ec.dlen, op->ec.sig, op->ec.siglen,
+		                               op->ec.kinv, op->ec.r, op->ec.eckey);
+	}
+	return 0;
+}
+
+/* Performs the <count> operations of <batch> in their queuing order and
+ * notifies their initiators.
+ */
+static void ssl_offload_exec_batch(struct ssl_offload_op **batch, int count)
+{
+	struct ssl_offload_op *op;
+	int i, fd, ret;
+
+	for (i = 0; i < count; i++) {
+		op = batch[i];
+		ret = ssl_offload_exec(op);
+
+		/* <op> may vanish as soon as the notification is sent */
+		fd = op->wfd;
+		op->ret = ret;
+		while (write(fd, "", 1) < 0 && errno == EINTR)
+			;
+	}
+}
+
+/* crypto thread: processes queued operations by batches until stopping */
+static void *ssl_offload_worker(void *arg)
+{
+	struct ssl_offload_op **batch, *single;
+	sigset_t blocked_sig;
+	int batch_size = MAX(global_ssl.offload_batch, 1);
+	int count, max;
+
+	sigfillset(&blocked_sig);
+	sigdelset(&blocked_sig, SIGPROF);
+	sigdelset(&blocked_sig, SIGBUS);
+	sigdelset(&blocked_sig, SIGFPE);
+	sigdelset(&blocked_sig, SIGILL);
+	sigdelset(&blocked_sig, SIGSEGV);
+	pthread_sigmask(SIG_SETMASK, &blocked_sig, NULL);
+
+	batch = calloc(batch_size, sizeof(*batch));
+	if (!batch) {
+		/* process operations one at a time */
+		batch = &single;
+		batch_size = 1;
+	}
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	while (1) {
+		while (!ssl_offload_head && !ssl_offload_stopping) {
+			ssl_offload_idle++;
+			pthread_cond_wait(&ssl_offload_cond, &ssl_offload_lock);
+			ssl_offload_idle--;
+		}
+
+		if (!ssl_offload_head)
+			break;
+
+		/* take our share of the queue so that other threads may work
+		 * in parallel, within the batch size.
+		 */
+		max = (ssl_offload_queued + global_ssl.offload_threads - 1) / global_ssl.offload_threads;
+		if (max > batch_size)
+			max = batch_size;
+
+		for (count = 0; count < max && ssl_offload_head; count++) {
+			batch[count] = ssl_offload_head;
+			ssl_offload_head = ssl_offload_head->next;
+		}
+		if (!ssl_offload_head)
+			ssl_offload_tail = NULL;
+		ssl_offload_queued -= count;
+		pthread_mutex_unlock(&ssl_offload_lock);
+
+		ssl_offload_exec_batch(batch, count);
+
+		pthread_mutex_lock(&ssl_offload_lock);
+	}
+	pthread_mutex_unlock(&ssl_offload_lock);
+	if (batch != &single)
+		free(batch);
+	return NULL;
+}
+
+/* releases the pipe attached to an async job's wait context */
+static void ssl_offload_waitctx_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
+                                        OSSL_ASYNC_FD rfd, void *custom)
+{
+	close(rfd);
+	close((int)(intptr_t)custom);
+}
+
+/* Runs operation <op>. From an async job, the operation is passed to a crypto
+ * thread and the job is paused until it completes, otherwise it's performed
+ * inline. Returns the operation's result.
+ */
+static int ssl_offload_run(struct ssl_offload_op *op)
+{
+	ASYNC_JOB *job = ASYNC_get_current_job();
+	ASYNC_WAIT_CTX *waitctx;
+	OSSL_ASYNC_FD rfd;
+	void *custom;
+	char c;
+
+	if (!job || !ssl_offload_nbthreads)
+		return ssl_offload_exec(op);
+
+	waitctx = ASYNC_get_wait_ctx(job);
+	if (!waitctx)
+		return ssl_offload_exec(op);
+
+	if (!ASYNC_WAIT_CTX_get_fd(waitctx, &ssl_offload_waitctx_key, &rfd, &custom)) {
+		int fds[2];
+
+		if (pipe(fds) < 0)
+			return ssl_offload_exec(op);
+
+		fcntl(fds[0], F_SETFL, O_NONBLOCK);
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, &ssl_offload_waitctx_key, fds[0],
+		                                (void *)(intptr_t)fds[1], ssl_offload_waitctx_cleanup)) {
+			close(fds[0]);
+			close(fds[1]);
+			return ssl_offload_exec(op);
+		}
+		rfd = fds[0];
+		custom = (void *)(intptr_t)fds[1];
+	}
+
+	op->wfd = (int)(intptr_t)custom;
+	op->next = NULL;
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	if (ssl_offload_tail)
+		ssl_offload_tail->next = op;
+	else
+		ssl_offload_head = op;
+	ssl_offload_tail = op;
+	ssl_offload_queued++;
+	/* busy threads pick pending operations once done with their batch */
+	if (ssl_offload_idle)
+		pthread_cond_signal(&ssl_offload_cond);
+	pthread_mutex_unlock(&ssl_offload_lock);
+
+	/* The job is resumed by the connection once the fd is readable. The
+	 * byte is only written once the result is available.
+	 */
+	while (read(rfd, &c, 1) != 1) {
+		if (!ASYNC_pause_job()) {
+			struct pollfd pfd = { .fd = rfd, .events = POLLIN };
+
+			poll(&pfd, 1, -1);
+		}
+	}
+	return op->ret;
+}
+
+static int ssl_offload_rsa_priv_enc(int flen, const unsigned char *from, unsigned char *to,
+                                    RSA *rsa, int padding)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_RSA_PRIV_ENC,
+		.rsa  = { .flen = flen, .from = from, .to = to, .rsa = rsa, .padding = padding },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+static int ssl_offload_rsa_priv_dec(int flen, const unsigned char *from, unsigned char *to,
+                                    RSA *rsa, int padding)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_RSA_PRIV_DEC,
+		.rsa  = { .flen = flen, .from = from, .to = to, .rsa = rsa, .padding = padding },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+static int ssl_offload_ec_sign(int type, const unsigned char *dgst, int dlen, unsigned char *sig,
+                               unsigned int *siglen, const BIGNUM *kinv, const BIGNUM *r,
+                               EC_KEY *eckey)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_EC_SIGN,
+		.ec   = { .type = type, .dgst = dgst, .dlen = dlen, .sig = sig, .siglen = siglen,
+		          .kinv = kinv, .r = r, .eckey = eckey },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+/* Creates the key methods. It's called from the configuration parser and may
+ * be called several times. Returns 0 on success, otherwise non-zero with <err>
+ * filled.
+ */
+int ssl_offload_init(char **err)
+{
+	int (*sign_setup)(EC_KEY *, BN_CTX *, BIGNUM **, BIGNUM **);
+	ECDSA_SIG *(*sign_sig)(const unsigned char *, int, const BIGNUM *, const BIGNUM *, EC_KEY *);
+
+	if (ssl_offload_rsa_meth)
+		return 0;
+
+	ssl_offload_rsa_meth = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+	ssl_offload_ec_meth = EC_KEY_METHOD_new(EC_KEY_OpenSSL());
+	if (!ssl_offload_rsa_meth || !ssl_offload_ec_meth)
+		goto fail;
+
+	ssl_offload_rsa_priv_enc_fct = RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL());
+	ssl_offload_rsa_priv_dec_fct = RSA_meth_get_priv_dec(RSA_PKCS1_OpenSSL());
+	if (!RSA_meth_set1_name(ssl_offload_rsa_meth, "haproxy offload RSA method") ||
+	    !RSA_meth_set_priv_enc(ssl_offload_rsa_meth, ssl_offload_rsa_priv_enc) ||
+	    !RSA_meth_set_priv_dec(ssl_offload_rsa_meth, ssl_offload_rsa_priv_dec))
+		goto fail;
+
+	EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &ssl_offload_ec_sign_fct, &sign_setup, &sign_sig);
+	EC_KEY_METHOD_set_sign(ssl_offload_ec_meth, ssl_offload_ec_sign, sign_setup, sign_sig);
+	return 0;
+
+ fail:
+	RSA_meth_free(ssl_offload_rsa_meth);
+	ssl_offload_rsa_meth = NULL;
+	EC_KEY_METHOD_free(ssl_offload_ec_meth);
+	ssl_offload_ec_meth = NULL;
+	memprintf(err, "unable to create the SSL offload key methods");
+	return 1;
+}
+
+/* Returns a new reference to a key equivalent to <pkey> but whose private key
+ * operations may be offloaded, or a new reference to <pkey> itself if
+ * offloading is not enabled or not supported for this key type, or on error.
+ */
+EVP_PKEY *ssl_offload_wrap_key(EVP_PKEY *pkey)
+{
+	EVP_PKEY *ret = NULL;
+	RSA *rsa = NULL, *rsa_dup = NULL;
+	EC_KEY *ec_dup = NULL;
+
+	if (!global_ssl.offload_threads || !ssl_offload_rsa_meth)
+		goto keep;
+
+	switch (EVP_PKEY_base_id(pkey)) {
+	case EVP_PKEY_RSA:
+		rsa = EVP_PKEY_get1_RSA(pkey);
+		if (!rsa)
+			goto keep;
+		rsa_dup = RSAPrivateKey_dup(rsa);
+		RSA_free(rsa);
+		if (!rsa_dup || !RSA_set_method(rsa_dup, ssl_offload_rsa_meth))
+			goto fail;
+		ret = EVP_PKEY_new();
+		if (!ret || !EVP_PKEY_assign_RSA(ret, rsa_dup))
+			goto fail;
+		return ret;
+
+	case EVP_PKEY_EC:
+		if (!EVP_PKEY_get0_EC_KEY(pkey))
+			goto keep;
+		ec_dup = EC_KEY_dup(EVP_PKEY_get0_EC_KEY(pkey));
+		if (!ec_dup || !EC_KEY_set_method(ec_dup, ssl_offload_ec_meth))
+			goto fail;
+		ret = EVP_PKEY_new();
+		if (!ret || !EVP_PKEY_assign_EC_KEY(ret, ec_dup))
+			goto fail;
+		return ret;
+	}
+	goto keep;
+
+ fail:
+	EVP_PKEY_free(ret);
+	RSA_free(rsa_dup);
+	EC_KEY_free(ec_dup);
+ keep:
+	EVP_PKEY_up_ref(pkey);
+	return pkey;
+}
+
+/* Each connection may hold a notification pipe in addition to its socket */
+static int ssl_offload_post_check(void)
+{
+	if (global_ssl.offload_threads)
+		global.ssl_used_async_engines += 2;
+	return ERR_NONE;
+}
+
+/* Starts the crypto threads from the first thread, once the process is fully
+ * set up (i.e. after forking in daemon mode).
+ */
+static int ssl_offload_start(void)
+{
+	int i;
+
+	if (tid != 0 || master || !global_ssl.offload_threads || ssl_offload_threads)
+		return 1;
+
+	ssl_offload_threads = calloc(global_ssl.offload_threads, sizeof(*ssl_offload_threads));
+	if (!ssl_offload_threads) {
+		ha_alert("Failed to allocate the SSL offload threads.\n");
+		return 0;
+	}
+
+	for (i = 0; i < global_ssl.offload_threads; i++) {
+		if (pthread_create(&ssl_offload_threads[i], NULL, ssl_offload_worker, NULL) != 0) {
+			ha_alert("Failed to start the SSL offload threads.\n");
+			return 0;
+		}
+		ssl_offload_nbthreads++;
+	}
+	return 1;
+}
+
+static void ssl_offload_deinit(void)
+{
+	int i;
+
+	if (!ssl_offload_threads)
+		return;
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	ssl_offload_stopping = 1;
+	pthread_cond_broadcast(&ssl_offload_cond);
+	pthread_mutex_unlock(&ssl_offload_lock);
+
+	for (i = 0; i < ssl_offload_nbthreads; i++)
+		pthread_join(ssl_offload_threads[i], NULL);
+	ha_free(&ssl_offload_threads);
+	ssl_offload_nbthreads = 0;
+
+	/* the key methods are left in place since they may still be
+	 * referenced by keys released later.
+	 */
+}
+
+REGISTER_POST_CHECK(ssl_offload_post_check);
+REGISTER_PER_THREAD_INIT(ssl_offload_start);
+REGISTER_POST_DEINIT(ssl_offload_deinit);
+
+#else /* !HAVE_SSL_ASYNC_OFFLOAD || !USE_THREAD */
+
+int ssl_offload_init(char **err)
+{
+	memprintf(err, "offloading is not supported by this SSL library or without thread support");
+	return 1;
+}
+
+EVP_PKEY *ssl_offload_wrap_key(EVP_PKEY *pkey)
+{
+	EVP_PKEY_up_ref(pkey);
+	return pkey;
+}
+
+#endif /* HAVE_SSL_ASYNC_OFFLOAD && USE_THREAD */
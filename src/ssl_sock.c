@@ -77,6 +77,7 @@
 #include <haproxy/ssl_gencert.h>
 #include <haproxy/ssl_sock.h>
 #include <haproxy/ssl_utils.h>
+#include <haproxy/stick_table.h>
 #include <haproxy/stats.h>
 #include <haproxy/stconn.h>
 #include <haproxy/stream-t.h>
@@ -88,6 +89,7 @@
 #include <haproxy/xxhash.h>
 #include <haproxy/istbuf.h>
 #include <haproxy/ssl_ocsp.h>
+#include <haproxy/ssl_offload.h>
 #include <haproxy/trace.h>
 #include <haproxy/ssl_trace.h>
 #ifdef USE_ECH
@@ -136,6 +138,10 @@ struct global_ssl global_ssl = {
 	.hard_max_record = 0,
 	.default_dh_param = SSL_DEFAULT_DH_PARAM,
 	.ctx_cache = DEFAULT_SSL_CTX_CACHE,
+	.offload_batch = DEFAULT_SSL_OFFLOAD_BATCH,
+	.srv_sess_pool = DEFAULT_SSL_SRV_SESS_POOL,
+	.ticket_key_lifetime = DEFAULT_SSL_TICKET_KEY_LIFETIME,
+	.ticket_key_overlap = DEFAULT_SSL_TICKET_KEY_OVERLAP,
 	.capture_buffer_size = 0,
 	.extra_files = SSL_GF_ALL,
 	.extra_files_noext = 0,
@@ -261,22 +267,24 @@ struct task *ssl_sock_io_cb(struct task *, void *, unsigned int);
 static int ssl_sock_handshake(struct connection *conn, unsigned int flag);
 
 #if defined(USE_LINUX_SPLICE) && defined(HA_USE_KTLS)
+/* receives decrypted data into <pipe>, which requires kTLS receive */
 static int ssl_sock_to_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count)
 {
 	struct ssl_sock_ctx *ctx = xprt_ctx;
 
 	if (!(ctx->flags & SSL_SOCK_F_KTLS_RECV))
 		return -1;
-	return ctx->xprt->snd_pipe(conn, ctx->xprt_ctx, pipe, count);
+	return ctx->xprt->rcv_pipe(conn, ctx->xprt_ctx, pipe, count);
 }
 
+/* sends data from <pipe> to be encrypted by the kernel, which requires kTLS send */
 static int ssl_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count)
 {
 	struct ssl_sock_ctx *ctx = xprt_ctx;
 
 	if (!(ctx->flags & SSL_SOCK_F_KTLS_SEND))
 		return -1;
-	return ctx->xprt->rcv_pipe(conn, ctx->xprt_ctx, pipe, count);
+	return ctx->xprt->snd_pipe(conn, ctx->xprt_ctx, pipe, count);
 }
 #endif /* USE_LINUX_SPLICE && HA_USE_KTLS */
 
@@ -1136,6 +1144,82 @@ static int ssl_hmac_init(MAC_CTX *hctx, unsigned char *key, int key_len, const E
 
 #if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
 
+/* Derives into <key> the TLS ticket key of epoch <epoch> from the secret of
+ * <ref> using HKDF-SHA256 (RFC5869), the epoch being the context. This way all
+ * the processes sharing the same secret derive the same keys at the same time
+ * without having to exchange them. Returns 1 on success, 0 on failure.
+ */
+static int ssl_tlskeys_derive(const struct tls_keys_ref *ref, unsigned long long epoch,
+                              struct tls_sess_key_256 *key)
+{
+	static const char salt[] = "HAProxy TLS ticket keys";
+	unsigned char prk[EVP_MAX_MD_SIZE];
+	unsigned char blk[EVP_MAX_MD_SIZE + 8 + 1];
+	unsigned char out[EVP_MAX_MD_SIZE];
+	unsigned int prk_len, out_len = 0;
+	size_t done, len;
+	int i;
+
+	if (!HMAC(EVP_sha256(), salt, sizeof(salt) - 1, ref->secret, ref->secret_len, prk, &prk_len))
+		return 0;
+
+	/* T(n) = HMAC(PRK, T(n-1) | epoch | n) */
+	for (done = 0; done < sizeof(*key); done += len) {
+		len = 0;
+		memcpy(blk, out, out_len);
+		len += out_len;
+		for (i = 7; i >= 0; i--)
+			blk[len++] = epoch >> (8 * i);
+		blk[len++] = done / prk_len + 1;
+
+		if (!HMAC(EVP_sha256(), prk, prk_len, blk, len, out, &out_len))
+			return 0;
+
+		len = MIN(out_len, sizeof(*key) - done);
+		memcpy((unsigned char *)key + done, out, len);
+	}
+	return 1;
+}
+
+/* Makes sure the keys of <ref> derived from its secret are those of the current
+ * epoch: the key used for encryption is placed at the head of the ring, then
+ * the next epoch's key which is accepted to cope with small clock differences
+ * between nodes, then the previous ones. The keys are derived into a temporary
+ * ring which only replaces the current one once all of them were derived, so
+ * that a failure leaves the previous ring untouched. Nothing is done if the
+ * keys were not derived from a secret or are up to date. Returns 1 if the keys
+ * may be used, or 0 if they could not be derived for the current epoch, in
+ * which case no ticket must be issued nor accepted.
+ */
+static int ssl_tlskeys_rotate(struct tls_keys_ref *ref)
+{
+	union tls_sess_key keys[TLS_TICKETS_NO];
+	unsigned long long epoch;
+	int i;
+
+	if (!ref->secret)
+		return 1;
+
+	epoch = date.tv_sec / global_ssl.ticket_key_lifetime;
+	if (HA_ATOMIC_LOAD(&ref->epoch) == epoch)
+		return 1;
+
+	for (i = 0; i < TLS_TICKETS_NO; i++) {
+		if (!ssl_tlskeys_derive(ref, i ? epoch + 1 - (i > 1 ? i : 0) : epoch,
+		                        &keys[i].key_256))
+			return 0;
+	}
+
+	HA_RWLOCK_WRLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+	if (ref->epoch != epoch) {
+		memcpy(ref->tlskeys, keys, sizeof(keys));
+		ref->tls_ticket_enc_index = 0;
+		HA_ATOMIC_STORE(&ref->epoch, epoch);
+	}
+	HA_RWLOCK_WRUNLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+	return 1;
+}
+
 static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned char *iv, EVP_CIPHER_CTX *ectx, MAC_CTX *hctx, int enc)
 {
 	union tls_sess_key *keys;
@@ -1150,6 +1234,12 @@ static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned
 	ref = l->bind_conf->keys_ref;
 	BUG_ON(!ref);
 
+	/* keys derived from a secret which are not those of the current epoch
+	 * (e.g. never derived yet) must neither be used nor trusted.
+	 */
+	if (!ssl_tlskeys_rotate(ref))
+		return 0;
+
 	HA_RWLOCK_RDLOCK(TLSKEYS_REF_LOCK, &ref->lock);
 
 	keys = ref->tlskeys;
@@ -1188,6 +1278,15 @@ static int ssl_tlsext_ticket_key_cb(SSL *s, unsigned char key_name[16], unsigned
 		goto end;
 
 	  found:
+		/* keys derived from a secret for the previous epochs are only
+		 * accepted during the overlap following their lifetime.
+		 */
+		if (ref->secret && i > 1 &&
+		    (long long)date.tv_sec - (long long)(ref->epoch + 2 - i) * global_ssl.ticket_key_lifetime >= global_ssl.ticket_key_overlap) {
+			ret = 0;
+			goto end;
+		}
+
 		if (ref->key_size_bits == 128) {
 			if (ssl_hmac_init(hctx, keys[(head + i) % TLS_TICKETS_NO].key_128.hmac_key, 16, TLS_TICKET_HASH_FUNCT()) < 0)
 				goto end;
@@ -1232,12 +1331,16 @@ struct tls_keys_ref *tlskeys_ref_lookupid(int unique_id)
 }
 
 /* Update the key into ref: if keysize doesn't
- * match existing ones, this function returns -1
+ * match existing ones, or if the keys are derived
+ * from a secret, this function returns -1
  * else it returns 0 on success.
  */
 int ssl_sock_update_tlskey_ref(struct tls_keys_ref *ref,
 				struct buffer *tlskey)
 {
+	if (ref->secret)
+		return -1;
+
 	if (ref->key_size_bits == 128) {
 		if (tlskey->data != sizeof(struct tls_sess_key_128))
 			       return -1;
@@ -2701,6 +2804,186 @@ int ssl_sock_load_global_dh_param_from_file(const char *filename)
 }
 #endif
 
+/* The SNI index of a bind_conf is a hash table holding all its sni_ctx, full
+ * names and wildcards, keyed on their name. It is the only place where they
+ * are stored, the lookups as well as the walks over all the entries go
+ * through it. Entries with the same name are kept in insertion order in their
+ * bucket. The table is doubled when it holds more than one entry per bucket,
+ * which happens under the SNI write lock when names are added at runtime, but
+ * only once each time the number of names doubles. The walks visit the entries
+ * in bucket order, which is not the name order.
+ */
+#define SNI_HASH_MIN_BITS 4
+
+static inline unsigned int ssl_sock_sni_hash(const char *name, int wild)
+{
+	return XXH32(name, strlen(name), wild);
+}
+
+/* appends <sni> to its bucket in <tbl> made of 1 << <bits> buckets */
+static void ssl_sock_sni_hash_append(struct sni_ctx **tbl, unsigned int bits, struct sni_ctx *sni)
+{
+	struct sni_ctx **pos = &tbl[sni->hash & ((1U << bits) - 1)];
+
+	while (*pos)
+		pos = &(*pos)->hash_next;
+	sni->hash_next = NULL;
+	*pos = sni;
+}
+
+/* Resizes the SNI index of <bind_conf> to 1 << <bits> buckets. Returns 0 if
+ * the new index could not be allocated, in which case the current one is left
+ * untouched, otherwise non-zero.
+ */
+static int ssl_sock_sni_hash_resize(struct bind_conf *bind_conf, unsigned int bits)
+{
+	struct sni_ctx **tbl, *sni, *next;
+	unsigned int i;
+
+	tbl = calloc(1U << bits, sizeof(*tbl));
+	if (!tbl)
+		return 0;
+
+	for (i = 0; i < (1U << bind_conf->sni_hash_bits); i++) {
+		for (sni = bind_conf->sni_hash[i]; sni; sni = next) {
+			next = sni->hash_next;
+			ssl_sock_sni_hash_append(tbl, bits, sni);
+		}
+	}
+
+	free(bind_conf->sni_hash);
+	bind_conf->sni_hash = tbl;
+	bind_conf->sni_hash_bits = bits;
+	return 1;
+}
+
+/* Allocates the SNI index of <bind_conf> if it does not exist yet, so that
+ * inserting entries cannot fail. Returns 0 on allocation failure, otherwise
+ * non-zero.
+ */
+static int ssl_sock_sni_hash_init(struct bind_conf *bind_conf)
+{
+	struct sni_ctx **tbl;
+
+	if (bind_conf->sni_hash)
+		return 1;
+
+	tbl = calloc(1U << SNI_HASH_MIN_BITS, sizeof(*tbl));
+	if (!tbl)
+		return 0;
+
+	HA_RWLOCK_WRLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	if (!bind_conf->sni_hash) {
+		bind_conf->sni_hash = tbl;
+		bind_conf->sni_hash_bits = SNI_HASH_MIN_BITS;
+		tbl = NULL;
+	}
+	HA_RWLOCK_WRUNLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	free(tbl);
+	return 1;
+}
+
+/* Inserts <sni> into the SNI index of <bind_conf>, which must exist. The index
+ * is grown so that it holds at most one entry per bucket on average, or stays
+ * as is if this is not possible.
+ */
+static void ssl_sock_insert_sni(struct bind_conf *bind_conf, struct sni_ctx *sni)
+{
+	unsigned int bits;
+
+	ssl_sock_sni_hash_append(bind_conf->sni_hash, bind_conf->sni_hash_bits, sni);
+	sni->indexed = 1;
+	bind_conf->sni_hash_count++;
+
+	if (bind_conf->sni_hash_count > (1U << bind_conf->sni_hash_bits)) {
+		for (bits = bind_conf->sni_hash_bits; bits < 30 && (1U << bits) < bind_conf->sni_hash_count; bits++)
+			;
+		ssl_sock_sni_hash_resize(bind_conf, bits);
+	}
+}
+
+/* Removes <sni> from the SNI index of <bind_conf> if it was inserted. The
+ * caller must hold the bind_conf's SNI lock if needed.
+ */
+void ssl_sock_delete_sni(struct bind_conf *bind_conf, struct sni_ctx *sni)
+{
+	struct sni_ctx **pos;
+
+	if (!sni->indexed)
+		return;
+
+	pos = &bind_conf->sni_hash[sni->hash & ((1U << bind_conf->sni_hash_bits) - 1)];
+	for (; *pos; pos = &(*pos)->hash_next) {
+		if (*pos == sni) {
+			*pos = sni->hash_next;
+			bind_conf->sni_hash_count--;
+			break;
+		}
+	}
+	sni->indexed = 0;
+}
+
+/* Returns the first sni_ctx of <bind_conf> for servername <name>, which must be
+ * in lower case, in the wildcard names if <wild> is set, otherwise in the full
+ * names, or NULL if not found. The caller must hold the bind_conf's SNI lock.
+ */
+struct sni_ctx *ssl_sock_lookup_sni(struct bind_conf *bind_conf, const char *name, int wild)
+{
+	struct sni_ctx *sni;
+	unsigned int hash;
+
+	if (!bind_conf->sni_hash)
+		return NULL;
+
+	wild = !!wild;
+	hash = ssl_sock_sni_hash(name, wild);
+	sni = bind_conf->sni_hash[hash & ((1U << bind_conf->sni_hash_bits) - 1)];
+	for (; sni; sni = sni->hash_next) {
+		if (sni->hash == hash && sni->wild == wild && strcmp(sni->name, name) == 0)
+			return sni;
+	}
+	return NULL;
+}
+
+/* Returns the sni_ctx of <bind_conf> following <sni> with the same name, in
+ * insertion order, or NULL if there is none.
+ */
+struct sni_ctx *ssl_sock_lookup_sni_next(struct bind_conf *bind_conf, struct sni_ctx *sni)
+{
+	struct sni_ctx *next;
+
+	for (next = sni->hash_next; next; next = next->hash_next) {
+		if (next->hash == sni->hash && next->wild == sni->wild &&
+		    strcmp(next->name, sni->name) == 0)
+			return next;
+	}
+	return NULL;
+}
+
+/* Returns the sni_ctx of <bind_conf> following <sni> in the SNI index, or the
+ * first one if <sni> is NULL, or NULL once all of them were visited. The
+ * caller must hold the bind_conf's SNI lock.
+ */
+struct sni_ctx *ssl_sock_next_sni(struct bind_conf *bind_conf, struct sni_ctx *sni)
+{
+	unsigned int i = 0;
+
+	if (!bind_conf->sni_hash)
+		return NULL;
+
+	if (sni) {
+		if (sni->hash_next)
+			return sni->hash_next;
+		i = (sni->hash & ((1U << bind_conf->sni_hash_bits) - 1)) + 1;
+	}
+
+	for (; i < (1U << bind_conf->sni_hash_bits); i++) {
+		if (bind_conf->sni_hash[i])
+			return bind_conf->sni_hash[i];
+	}
+	return NULL;
+}
+
 /* This function allocates a sni_ctx and adds it to the ckch_inst */
 static int ckch_inst_add_cert_sni(SSL_CTX *ctx, struct ckch_inst *ckch_inst,
                                  struct bind_conf *s, struct ssl_bind_conf *conf,
@@ -2735,10 +3018,14 @@ static int ckch_inst_add_cert_sni(SSL_CTX *ctx, struct ckch_inst *ckch_inst,
 			return -1;
 		trash.area[j] = 0;
 
+		/* the bind_conf's SNI index must exist to insert it later */
+		if (!ssl_sock_sni_hash_init(s))
+			return -1;
+
 		sc = malloc(sizeof(struct sni_ctx) + len + 1);
 		if (!sc)
 			return -1;
-		memcpy(sc->name.key, trash.area, len + 1);
+		memcpy(sc->name, trash.area, len + 1);
 		SSL_CTX_up_ref(ctx);
 		sc->ctx = ctx;
 		sc->conf = conf;
@@ -2746,7 +3033,8 @@ static int ckch_inst_add_cert_sni(SSL_CTX *ctx, struct ckch_inst *ckch_inst,
 		sc->order = order++;
 		sc->neg = neg;
 		sc->wild = wild;
-		sc->name.node.leaf_p = NULL;
+		sc->indexed = 0;
+		sc->hash = ssl_sock_sni_hash(sc->name, wild);
 		sc->ckch_inst = ckch_inst;
 		LIST_APPEND(&ckch_inst->sni_ctx, &sc->by_ckch_inst);
 	}
@@ -2754,32 +3042,26 @@ static int ckch_inst_add_cert_sni(SSL_CTX *ctx, struct ckch_inst *ckch_inst,
 }
 
 /*
- * Insert the sni_ctxs that are listed in the ckch_inst, in the bind_conf's sni_ctx tree
+ * Insert the sni_ctxs that are listed in the ckch_inst, in the bind_conf's SNI index
  * This function can't return an error.
  *
- * *CAUTION*: The caller must lock the sni tree if called in multithreading mode
+ * *CAUTION*: The caller must lock the SNI index if called in multithreading mode
  */
 void ssl_sock_load_cert_sni(struct ckch_inst *ckch_inst, struct bind_conf *bind_conf)
 {
 
 	struct sni_ctx *sc0, *sc0b, *sc1;
-	struct ebmb_node *node;
 	int nb_neg = 0, nb_wild = 0;
 
 	list_for_each_entry_safe(sc0, sc0b, &ckch_inst->sni_ctx, by_ckch_inst) {
 
-		/* ignore if sc0 was already inserted in a tree */
-		if (sc0->name.node.leaf_p)
+		/* ignore if sc0 was already inserted in the index */
+		if (sc0->indexed)
 			continue;
 
 		/* Check for duplicates. */
-		if (sc0->wild)
-			node = ebst_lookup(&bind_conf->sni_w_ctx, (char *)sc0->name.key);
-		else
-			node = ebst_lookup(&bind_conf->sni_ctx, (char *)sc0->name.key);
-
-		for (; node; node = ebmb_next_dup(node)) {
-			sc1 = ebmb_entry(node, struct sni_ctx, name);
+		sc1 = ssl_sock_lookup_sni(bind_conf, sc0->name, sc0->wild);
+		for (; sc1; sc1 = ssl_sock_lookup_sni_next(bind_conf, sc1)) {
 			if (sc1->ctx == sc0->ctx && sc1->conf == sc0->conf
 			    && sc1->neg == sc0->neg && sc1->wild == sc0->wild) {
 				/* it's a duplicate, we should remove and free it */
@@ -2794,15 +3076,12 @@ void ssl_sock_load_cert_sni(struct ckch_inst *ckch_inst, struct bind_conf *bind_
 		if (!sc0)
 			continue;
 
-		if (sc0->wild && sc0->name.key[0]) /* count wildcard but exclude the default */
+		if (sc0->wild && sc0->name[0]) /* count wildcard but exclude the default */
 			nb_wild++;
 		if (sc0->neg)
 			nb_neg++;
 
-		if (sc0->wild)
-			ebst_insert(&bind_conf->sni_w_ctx, &sc0->name);
-		else
-			ebst_insert(&bind_conf->sni_ctx, &sc0->name);
+		ssl_sock_insert_sni(bind_conf, sc0);
 	}
 
 	if (nb_neg > 0 && nb_wild == 0) {
@@ -3007,18 +3286,23 @@ static int ssl_sock_put_ckch_into_ctx(const char *path, struct ckch_store *store
 	int errcode = 0;
 	struct ckch_data *data = store->data;
 	STACK_OF(X509) *find_chain = NULL;
+	EVP_PKEY *key;
 
 	ERR_clear_error();
 
-	if (SSL_CTX_use_PrivateKey(ctx, data->key) <= 0) {
+	/* the key may be replaced by one supporting offloading */
+	key = ssl_offload_wrap_key(data->key);
+	if (SSL_CTX_use_PrivateKey(ctx, key) <= 0) {
 		int ret;
 
 		ret = ERR_get_error();
 		memprintf(err, "%sunable to load SSL private key into SSL Context '%s': %s.\n",
 				err && *err ? *err : "", path, ERR_reason_error_string(ret));
 		errcode |= ERR_ALERT | ERR_FATAL;
+		EVP_PKEY_free(key);
 		return errcode;
 	}
+	EVP_PKEY_free(key);
 
 	/* Load certificate chain */
 	errcode |= ssl_sock_load_cert_chain(path, data, ctx, &find_chain, err);
@@ -3088,13 +3372,16 @@ static int ssl_sock_put_srv_ckch_into_ctx(const char *path, const struct ckch_da
 {
 	int errcode = 0;
 	STACK_OF(X509) *find_chain = NULL;
+	EVP_PKEY *key;
 
-	/* Load the private key */
-	if (SSL_CTX_use_PrivateKey(ctx, data->key) <= 0) {
+	/* Load the private key, possibly replaced by one supporting offloading */
+	key = ssl_offload_wrap_key(data->key);
+	if (SSL_CTX_use_PrivateKey(ctx, key) <= 0) {
 		memprintf(err, "%sunable to load SSL private key into SSL Context '%s'.\n",
 				err && *err ? *err : "", path);
 		errcode |= ERR_ALERT | ERR_FATAL;
 	}
+	EVP_PKEY_free(key);
 
 	/* Load certificate chain */
 	errcode |= ssl_sock_load_cert_chain(path, data, ctx, &find_chain, err);
@@ -3481,7 +3768,7 @@ int ssl_sock_load_cert_list_file(char *file, int dir, struct bind_conf *bind_con
 
 		/* if the SNI trees were empty the first "crt" become a default certificate,
 		 * it can be applied on multiple certificates if it's a bundle */
-		if (eb_is_empty(&bind_conf->sni_ctx) && eb_is_empty(&bind_conf->sni_w_ctx))
+		if (!bind_conf->sni_hash_count)
 			is_default = CKCH_INST_IMPL_DEFAULT;
 
 
@@ -3538,7 +3825,7 @@ int ssl_sock_load_cert(char *path, struct bind_conf *bind_conf, int is_default,
 	/* if the SNI trees were empty the first "crt" become a default certificate,
 	 * it can be applied on multiple certificates if it's a bundle */
 	if (is_default == CKCH_INST_NO_DEFAULT) {
-		if (eb_is_empty(&bind_conf->sni_ctx) && eb_is_empty(&bind_conf->sni_w_ctx))
+		if (!bind_conf->sni_hash_count)
 			is_default = CKCH_INST_IMPL_DEFAULT;
 	}
 
@@ -4160,6 +4447,123 @@ static int sh_ssl_sess_store(unsigned char *s_id, unsigned char *data, int data_
 	return 1;
 }
 
+/* store a session into the sessions stick-table so that it is pushed to the
+ * peers. Same arguments as sh_ssl_sess_store().
+ */
+static void sh_ssl_sess_table_store(const unsigned char *s_id, const unsigned char *data, int data_len)
+{
+	struct stktable *t = global_ssl.sess_table;
+	struct stktable_key key = { .key = (void *)s_id, .key_len = SSL_MAX_SSL_SESSION_ID_LENGTH };
+	struct stktable_blob *blob;
+	struct stksess *ts;
+	void *ptr;
+
+	blob = malloc(sizeof(*blob) + data_len);
+	if (!blob)
+		return;
+	blob->len = data_len;
+	memcpy(blob->data, data, data_len);
+
+	ts = stktable_get_entry(t, &key);
+	if (!ts) {
+		free(blob);
+		return;
+	}
+
+	HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = stktable_data_ptr(t, ts, STKTABLE_DT_SSL_SESS);
+	if (ptr) {
+		free(stktable_data_cast(ptr, std_t_blob));
+		stktable_data_cast(ptr, std_t_blob) = blob;
+		blob = NULL;
+	}
+	HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &ts->lock);
+	free(blob);
+
+	stktable_touch_local(t, ts, 1);
+}
+
+/* looks up a session in the sessions stick-table, possibly learned from a
+ * peer, and copies it into <data> of <size> bytes.
+ * s_id : session id padded with zero to SSL_MAX_SSL_SESSION_ID_LENGTH
+ * Returns the asn1 encoded session length, or 0 if not found.
+ */
+static int sh_ssl_sess_table_lookup(const unsigned char *s_id, unsigned char *data, int size)
+{
+	struct stktable *t = global_ssl.sess_table;
+	struct stktable_key key = { .key = (void *)s_id, .key_len = SSL_MAX_SSL_SESSION_ID_LENGTH };
+	struct stktable_blob *blob;
+	struct stksess *ts;
+	void *ptr;
+	int len = 0;
+
+	ts = stktable_lookup_key(t, &key);
+	if (!ts)
+		return 0;
+
+	HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = stktable_data_ptr(t, ts, STKTABLE_DT_SSL_SESS);
+	blob = ptr ? stktable_data_cast(ptr, std_t_blob) : NULL;
+	if (blob && blob->len <= size) {
+		memcpy(data, blob->data, blob->len);
+		len = blob->len;
+	}
+	HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+	HA_ATOMIC_DEC(&ts->ref_cnt);
+	return len;
+}
+
+/* removes a session from the sessions stick-table */
+static void sh_ssl_sess_table_remove(const unsigned char *s_id)
+{
+	struct stktable *t = global_ssl.sess_table;
+	struct stktable_key key = { .key = (void *)s_id, .key_len = SSL_MAX_SSL_SESSION_ID_LENGTH };
+	struct stksess *ts;
+
+	ts = stktable_lookup_key(t, &key);
+	if (ts)
+		stksess_kill(t, ts);
+}
+
+/* Copies the encoded session <data> of <size> bytes established with SNI <sni>
+ * (possibly NULL) into the next entry of the pool of sessions of server <s>
+ * shared between all threads. Each new session goes to a different entry so
+ * that the multiple tickets sent by TLS 1.3 servers are all kept, and that
+ * the threads picking from the pool resume with different tickets. Must be
+ * called with the server's ssl_ctx lock held.
+ */
+static void ssl_sock_srv_share_sess(struct server *s, const unsigned char *data, int size, const char *sni)
+{
+	struct srv_ssl_sess *e;
+	unsigned char *ptr;
+	int len;
+
+	e = &s->ssl_ctx.shared_sess[HA_ATOMIC_FETCH_ADD(&s->ssl_ctx.shared_sess_idx, 1) % global_ssl.srv_sess_pool];
+
+	HA_RWLOCK_WRLOCK(SSL_SERVER_LOCK, &e->sess_lock);
+	ptr = e->ptr;
+	if (!ptr || e->allocated_size < size) {
+		len = (size + 7) & -8; /* round to the nearest 8 bytes */
+		ptr = realloc(ptr, len);
+		if (!ptr)
+			free(e->ptr);
+		e->ptr = ptr;
+		e->allocated_size = len;
+	}
+
+	if (ptr) {
+		memcpy(ptr, data, size);
+		e->size = size;
+	}
+
+	if (!sni || !e->sni || strcmp(e->sni, sni) != 0) {
+		ha_free(&e->sni);
+		if (sni)
+			e->sni = strdup(sni);
+	}
+	HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &e->sess_lock);
+}
+
 /* SSL callback used when a new session is created while connecting to a server */
 static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 {
@@ -4234,6 +4638,12 @@ static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 			s->ssl_ctx.reused_sess[tid].sni = strdup(sni);
 		}
 		HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+
+		/* only the current thread may change its own entry */
+		if (s->ssl_ctx.shared_sess && s->ssl_ctx.reused_sess[tid].ptr)
+			ssl_sock_srv_share_sess(s, s->ssl_ctx.reused_sess[tid].ptr,
+			                        s->ssl_ctx.reused_sess[tid].size, sni);
+
 		HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
 	} else {
 		HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
@@ -4301,6 +4711,8 @@ static int sh_ssl_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
 
 	/* store to cache */
 	sh_ssl_sess_store(encid, encsess, data_len);
+	if (global_ssl.sess_table)
+		sh_ssl_sess_table_store(encid, encsess, data_len);
 err:
 	/* reset original length values */
 	SSL_SESSION_set1_id(sess, encid, sid_length);
@@ -4317,6 +4729,7 @@ static SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned
 	unsigned char tmpkey[SSL_MAX_SSL_SESSION_ID_LENGTH];
 	SSL_SESSION *sess;
 	struct shared_block *first;
+	int data_len;
 
 	_HA_ATOMIC_INC(&global.shctx_lookups);
 
@@ -4336,22 +4749,34 @@ static SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned
 	/* lookup for session */
 	sh_ssl_sess = sh_ssl_sess_tree_lookup(key);
 	if (!sh_ssl_sess) {
-		/* no session found: unlock cache and exit */
+		/* no session found: unlock cache */
 		shctx_wrunlock(ssl_shctx);
 		_HA_ATOMIC_INC(&global.shctx_misses);
-		return NULL;
+
+		/* it may have been learned from a peer, in which case it's
+		 * also stored into the cache for next lookups.
+		 */
+		if (!global_ssl.sess_table)
+			return NULL;
+		data_len = sh_ssl_sess_table_lookup(key, data, sizeof(data));
+		if (!data_len)
+			return NULL;
+		sh_ssl_sess_store((unsigned char *)key, data, data_len);
+		goto decode;
 	}
 
 	/* sh_ssl_sess (shared_block->data) is at the end of shared_block */
 	first = sh_ssl_sess_first_block(sh_ssl_sess);
+	data_len = first->len - sizeof(struct sh_ssl_sess_hdr);
 
-	shctx_row_data_get(ssl_shctx, first, data, sizeof(struct sh_ssl_sess_hdr), first->len-sizeof(struct sh_ssl_sess_hdr));
+	shctx_row_data_get(ssl_shctx, first, data, sizeof(struct sh_ssl_sess_hdr), data_len);
 
 	shctx_wrunlock(ssl_shctx);
 
+ decode:
 	/* decode ASN1 session */
 	p = data;
-	sess = d2i_SSL_SESSION(NULL, (const unsigned char **)&p, first->len-sizeof(struct sh_ssl_sess_hdr));
+	sess = d2i_SSL_SESSION(NULL, (const unsigned char **)&p, data_len);
 	/* Reset session id and session id contenxt */
 	if (sess) {
 		SSL_SESSION_set1_id(sess, key, key_len);
@@ -4390,6 +4815,9 @@ static void sh_ssl_sess_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
 
 	/* unlock cache */
 	shctx_wrunlock(ssl_shctx);
+
+	if (global_ssl.sess_table)
+		sh_ssl_sess_table_remove(sid_data);
 }
 
 /* Set session cache mode to server and disable openssl internal cache.
@@ -4938,6 +5366,14 @@ int ssl_sock_prepare_srv_ctx(struct server *srv)
 		}
 	}
 
+	if (!srv->ssl_ctx.shared_sess && global_ssl.srv_sess_pool && global.nbthread > 1) {
+		if ((srv->ssl_ctx.shared_sess = calloc(global_ssl.srv_sess_pool, sizeof(*srv->ssl_ctx.shared_sess))) == NULL) {
+			ha_alert("out of memory.\n");
+			cfgerr++;
+			return cfgerr;
+		}
+	}
+
 	/* The QUIC server xprt has already been set. */
 	if (srv->use_ssl == 1 && !srv_is_quic(srv))
 		srv->xprt = &ssl_sock;
@@ -5254,13 +5690,153 @@ static int ssl_initial_ctx(struct bind_conf *bind_conf)
 }
 #endif
 
+/* LRU cache of the SSL contexts built on demand for lazy ckch_inst, indexed
+ * by their lazy_id which is never reused, so that the entries of released
+ * instances simply age out.
+ */
+static struct lru64_head *ssl_lazy_ctx_lru = NULL;
+static unsigned long long ssl_lazy_ctx_id = 0; /* last assigned lazy_id */
+__decl_rwlock(ssl_lazy_ctx_lock);
+
+/* Returns non-zero if the SSL_CTX of <inst> may be released after startup and
+ * built again on demand. This excludes default instances which are used
+ * without SNI lookup, instances depending on OCSP or CA files since these
+ * register their SSL_CTX for updates, and those of bind lines generating
+ * certificates since these sign with the default SSL_CTX's key.
+ */
+static int ckch_inst_may_be_lazy(const struct ckch_inst *inst)
+{
+	const struct ckch_data *data = inst->ckch_store ? inst->ckch_store->data : NULL;
+
+	return data && inst->bind_conf && !inst->is_default && !inst->is_server_instance &&
+	       !(inst->bind_conf->options & BC_O_GENERATE_CERTS) &&
+	       !data->ocsp_response && !data->ocsp_cid &&
+	       LIST_ISEMPTY(&inst->cafile_link_refs);
+}
+
+/* Releases the SSL_CTX of all the instances of <bind_conf> which may be built
+ * on demand instead, once they were all prepared and validated, when
+ * "tune.ssl.lazy-ctx-cache-size" is set. The default instance(s) are kept.
+ */
+static void ssl_sock_release_lazy_ctx(struct bind_conf *bind_conf)
+{
+	struct ckch_inst *inst;
+	struct sni_ctx *node, *sni;
+	int released = 0;
+
+	if (!global_ssl.lazy_ctx_cache)
+		return;
+
+	if (!ssl_lazy_ctx_lru) {
+		ssl_lazy_ctx_lru = lru64_new(global_ssl.lazy_ctx_cache);
+		if (!ssl_lazy_ctx_lru)
+			return;
+	}
+
+	for (node = ssl_sock_next_sni(bind_conf, NULL); node; node = ssl_sock_next_sni(bind_conf, node)) {
+		inst = node->ckch_inst;
+		if (inst->lazy_id || !ckch_inst_may_be_lazy(inst))
+			continue;
+
+		list_for_each_entry(sni, &inst->sni_ctx, by_ckch_inst) {
+			SSL_CTX_free(sni->ctx);
+			sni->ctx = NULL;
+		}
+		SSL_CTX_free(inst->ctx);
+		inst->ctx = NULL;
+		inst->lazy_id = ++ssl_lazy_ctx_id;
+		released++;
+	}
+
+	/* the released contexts are interleaved with the certificates and keys
+	 * which remain, give the memory back to the system.
+	 */
+	if (released)
+		malloc_trim(0);
+}
+
+/* Builds a new SSL_CTX for the lazy instance <inst> the same way it was built
+ * at startup. Returns it or NULL on error.
+ */
+static SSL_CTX *ssl_sock_build_lazy_ctx(struct ckch_inst *inst)
+{
+	SSL_CTX *ctx;
+	char *err = NULL;
+	int errcode;
+
+	ctx = SSL_CTX_new(SSLv23_server_method());
+	if (!ctx)
+		return NULL;
+
+	if (global_ssl.security_level > -1)
+		SSL_CTX_set_security_level(ctx, global_ssl.security_level);
+
+	errcode = ssl_sock_put_ckch_into_ctx(inst->ckch_store->path, inst->ckch_store, ctx, &err);
+	if (!(errcode & ERR_CODE))
+		errcode |= ssl_sock_prepare_ctx(inst->bind_conf, inst->ssl_conf, ctx, &err);
+	free(err);
+
+	if (errcode & ERR_CODE) {
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* Returns the SSL_CTX of the lazy instance <inst>, from the LRU cache or
+ * after building it. The caller gets its own reference and must release it
+ * with SSL_CTX_free(). Returns NULL if the context could not be built.
+ */
+SSL_CTX *ckch_inst_get_lazy_ctx(struct ckch_inst *inst)
+{
+	struct lru64 *lru;
+	SSL_CTX *ctx = NULL, *new_ctx;
+
+	HA_RWLOCK_WRLOCK(SSL_LAZY_CTX_LOCK, &ssl_lazy_ctx_lock);
+	lru = lru64_lookup(inst->lazy_id, ssl_lazy_ctx_lru, inst, 0);
+	if (lru) {
+		ctx = lru->data;
+		SSL_CTX_up_ref(ctx);
+	}
+	HA_RWLOCK_WRUNLOCK(SSL_LAZY_CTX_LOCK, &ssl_lazy_ctx_lock);
+
+	if (ctx)
+		return ctx;
+
+	/* built out of the lock, another thread might do the same */
+	new_ctx = ssl_sock_build_lazy_ctx(inst);
+	if (!new_ctx)
+		return NULL;
+
+	HA_RWLOCK_WRLOCK(SSL_LAZY_CTX_LOCK, &ssl_lazy_ctx_lock);
+	lru = lru64_get(inst->lazy_id, ssl_lazy_ctx_lru, inst, 0);
+	if (lru && lru->domain) {
+		ctx = lru->data;
+		SSL_CTX_up_ref(ctx);
+	}
+	else if (lru) {
+		lru64_commit(lru, new_ctx, inst, 0, (void (*)(void *))SSL_CTX_free);
+		ctx = new_ctx;
+		SSL_CTX_up_ref(ctx);
+		new_ctx = NULL;
+	}
+	else {
+		/* no cache entry, the caller keeps the only reference */
+		ctx = new_ctx;
+		new_ctx = NULL;
+	}
+	HA_RWLOCK_WRUNLOCK(SSL_LAZY_CTX_LOCK, &ssl_lazy_ctx_lock);
+
+	SSL_CTX_free(new_ctx);
+	return ctx;
+}
+
 /* Walks down the two trees in bind_conf and prepares all certs. The pointer may
  * be NULL, in which case nothing is done. Returns the number of errors
  * encountered.
  */
 int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf)
 {
-	struct ebmb_node *node;
 	struct sni_ctx *sni;
 	int err = 0;
 	int errcode = 0;
@@ -5278,24 +5854,11 @@ int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf)
 		errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, NULL, bind_conf->initial_ctx, NULL, &errmsg);
 	}
 
-	node = ebmb_first(&bind_conf->sni_ctx);
-	while (node) {
-		sni = ebmb_entry(node, struct sni_ctx, name);
-		if (!sni->order) {
-			/* only initialize the CTX on its first occurrence */
-			errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, sni->conf, sni->ctx, sni->ckch_inst, &errmsg);
-		}
-		node = ebmb_next(node);
-	}
-
-	node = ebmb_first(&bind_conf->sni_w_ctx);
-	while (node) {
-		sni = ebmb_entry(node, struct sni_ctx, name);
+	for (sni = ssl_sock_next_sni(bind_conf, NULL); sni; sni = ssl_sock_next_sni(bind_conf, sni)) {
 		if (!sni->order) {
 			/* only initialize the CTX on its first occurrence */
 			errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, sni->conf, sni->ctx, sni->ckch_inst, &errmsg);
 		}
-		node = ebmb_next(node);
 	}
 
 	if (errcode & ERR_WARN) {
@@ -5305,6 +5868,9 @@ int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf)
 		err++;
 	}
 
+	if (!err)
+		ssl_sock_release_lazy_ctx(bind_conf);
+
 	free(errmsg);
 	return err;
 }
@@ -5321,7 +5887,7 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 
 	/* check if some certificates were loaded but no ssl keyword is used */
 	if (!(bind_conf->options & BC_O_USE_SSL)) {
-		if (!eb_is_empty(&bind_conf->sni_ctx) || !eb_is_empty(&bind_conf->sni_w_ctx)) {
+		if (bind_conf->sni_hash_count) {
 			ha_warning("Proxy '%s': A certificate was specified but SSL was not enabled on bind '%s' at [%s:%d] (use 'ssl').\n",
 				   px->id, bind_conf->arg, bind_conf->file, bind_conf->line);
 		}
@@ -5329,7 +5895,7 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 	}
 
 	/* check if we have certificates */
-	if (eb_is_empty(&bind_conf->sni_ctx) && eb_is_empty(&bind_conf->sni_w_ctx)) {
+	if (!bind_conf->sni_hash_count) {
 		if ((bind_conf->ssl_options & BC_SSL_O_STRICT_SNI) && !(bind_conf->options & BC_O_GENERATE_CERTS)) {
 			ha_warning("Proxy '%s': no SSL certificate specified for bind '%s' at [%s:%d], ssl connections will fail (use 'crt').\n",
 				   px->id, bind_conf->arg, bind_conf->file, bind_conf->line);
@@ -5349,15 +5915,12 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 
 	/* check that we didn't use "strict-sni" and "default-crt" together */
 	if (bind_conf->ssl_options & BC_SSL_O_STRICT_SNI) {
-		struct ebmb_node *node, *n;
+		struct sni_ctx *sni;
 		const char *wildp = "";
 		int is_default = CKCH_INST_NO_DEFAULT;
 
-		node = ebst_lookup(&bind_conf->sni_w_ctx, wildp);
-		for (n = node; n; n = ebmb_next_dup(n)) {
-			struct sni_ctx *sni;
-
-			sni = container_of(n, struct sni_ctx, name);
+		sni = ssl_sock_lookup_sni(bind_conf, wildp, 1);
+		for (; sni; sni = ssl_sock_lookup_sni_next(bind_conf, sni)) {
 			if (!sni->neg) {
 
 				if (sni->ckch_inst->is_default == CKCH_INST_EXPL_DEFAULT) {
@@ -5436,6 +5999,16 @@ void ssl_sock_free_srv_ctx(struct server *srv)
 		ha_free(&srv->ssl_ctx.reused_sess);
 	}
 
+	if (srv->ssl_ctx.shared_sess) {
+		int i;
+
+		for (i = 0; i < global_ssl.srv_sess_pool; i++) {
+			ha_free(&srv->ssl_ctx.shared_sess[i].ptr);
+			ha_free(&srv->ssl_ctx.shared_sess[i].sni);
+		}
+		ha_free(&srv->ssl_ctx.shared_sess);
+	}
+
 	if (srv->ssl_ctx.ctx) {
 		SSL_CTX_free(srv->ssl_ctx.ctx);
 		srv->ssl_ctx.ctx = NULL;
@@ -5458,35 +6031,23 @@ void ssl_sock_free_srv_ctx(struct server *srv)
 	ckch_inst_free(srv->ssl_ctx.inst);
 }
 
-/* Walks down the two trees in bind_conf and frees all the certs. The pointer may
+/* Walks down the SNI index of bind_conf and frees all the certs. The pointer may
  * be NULL, in which case nothing is done. The default_ctx is nullified too.
  */
 void ssl_sock_free_all_ctx(struct bind_conf *bind_conf)
 {
-	struct ebmb_node *node, *back;
-	struct sni_ctx *sni;
-
-	node = ebmb_first(&bind_conf->sni_ctx);
-	while (node) {
-		sni = ebmb_entry(node, struct sni_ctx, name);
-		back = ebmb_next(node);
-		ebmb_delete(node);
-		SSL_CTX_free(sni->ctx);
-		LIST_DELETE(&sni->by_ckch_inst);
-		free(sni);
-		node = back;
-	}
+	struct sni_ctx *sni, *back;
 
-	node = ebmb_first(&bind_conf->sni_w_ctx);
-	while (node) {
-		sni = ebmb_entry(node, struct sni_ctx, name);
-		back = ebmb_next(node);
-		ebmb_delete(node);
+	/* the entries are not removed from the index which is freed at once */
+	for (sni = ssl_sock_next_sni(bind_conf, NULL); sni; sni = back) {
+		back = ssl_sock_next_sni(bind_conf, sni);
 		SSL_CTX_free(sni->ctx);
 		LIST_DELETE(&sni->by_ckch_inst);
 		free(sni);
-		node = back;
 	}
+	ha_free(&bind_conf->sni_hash);
+	bind_conf->sni_hash_bits = 0;
+	bind_conf->sni_hash_count = 0;
 
 	SSL_CTX_free(bind_conf->initial_ctx);
 	bind_conf->initial_ctx = NULL;
@@ -5497,6 +6058,10 @@ static void ssl_sock_deinit()
 {
 	crtlist_deinit(); /* must be free'd before the ckchs */
 	ckch_deinit();
+	if (ssl_lazy_ctx_lru) {
+		lru64_destroy(ssl_lazy_ctx_lru);
+		HA_RWLOCK_DESTROY(&ssl_lazy_ctx_lock);
+	}
 }
 REGISTER_POST_DEINIT(ssl_sock_deinit);
 
@@ -5513,6 +6078,7 @@ void ssl_sock_destroy_bind_conf(struct bind_conf *bind_conf)
 	if (bind_conf->keys_ref && !--bind_conf->keys_ref->refcount) {
 		free(bind_conf->keys_ref->filename);
 		free(bind_conf->keys_ref->tlskeys);
+		free(bind_conf->keys_ref->secret);
 		LIST_DELETE(&bind_conf->keys_ref->list);
 		free(bind_conf->keys_ref);
 	}
@@ -5627,6 +6193,41 @@ int increment_sslconn()
 	return next_sslconn;
 }
 
+/* Try to assign to <ctx> one of the sessions of the pool of <srv> shared
+ * between threads. Each thread starts to look at a different entry so that
+ * concurrent connections resume with different sessions or tickets. Must be
+ * called with the server's ssl_ctx lock held. Returns non-zero if a session
+ * was assigned, otherwise zero.
+ */
+static int ssl_sock_srv_try_shared_sess(struct ssl_sock_ctx *ctx, struct server *srv)
+{
+	struct srv_ssl_sess *e;
+	const unsigned char *ptr;
+	SSL_SESSION *sess;
+	uint start;
+	int ret = 0;
+	int i;
+
+	start = HA_ATOMIC_LOAD(&srv->ssl_ctx.shared_sess_idx) + tid;
+	for (i = 0; !ret && i < global_ssl.srv_sess_pool; i++) {
+		e = &srv->ssl_ctx.shared_sess[(start + i) % global_ssl.srv_sess_pool];
+
+		HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &e->sess_lock);
+		ptr = e->ptr;
+		if (ptr) {
+			sess = d2i_SSL_SESSION(NULL, &ptr, e->size);
+			if (sess) {
+				ret = SSL_set_session(ctx->ssl, sess);
+				SSL_SESSION_free(sess);
+			}
+			if (ret && e->sni)
+				SSL_set_tlsext_host_name(ctx->ssl, e->sni);
+		}
+		HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &e->sess_lock);
+	}
+	return ret;
+}
+
 /* Try to reuse an SSL session (SSL_SESSION object) for <srv> server with <ctx>
  * as SSL socket context.
  */
@@ -5662,7 +6263,7 @@ void ssl_sock_srv_try_reuse_sess(struct ssl_sock_ctx *ctx, struct server *srv)
 				SSL_set_tlsext_host_name(ctx->ssl, srv->ssl_ctx.reused_sess[tid].sni);
 			HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &srv->ssl_ctx.reused_sess[tid].sess_lock);
 		}
-	} else {
+	} else if (!srv->ssl_ctx.shared_sess || !ssl_sock_srv_try_shared_sess(ctx, srv)) {
 		/* No session available yet, let's see if we can pick one
 		 * from another thread. If old_tid is non-null, it designates
 		 * the index of a recently updated thread that might still have
@@ -7772,6 +8373,41 @@ void ssl_free_global_issuers(void)
 	}
 }
 
+/* resolves the "ssl-session-table" stick-table and checks it is suitable to
+ * store the sessions.
+ */
+static int ssl_sess_table_finalize_config(void)
+{
+	struct stktable *t;
+
+	if (!global_ssl.sess_table_name)
+		return ERR_NONE;
+
+	t = stktable_find_by_name(global_ssl.sess_table_name);
+	if (!t) {
+		ha_alert("ssl-session-table: unable to find table '%s'.\n", global_ssl.sess_table_name);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (t->type != SMP_T_BIN || t->key_size != SSL_MAX_SSL_SESSION_ID_LENGTH) {
+		ha_alert("ssl-session-table: table '%s' must be of type 'binary' with a key length of %d.\n",
+		         t->id, SSL_MAX_SSL_SESSION_ID_LENGTH);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (!t->data_ofs[STKTABLE_DT_SSL_SESS]) {
+		ha_alert("ssl-session-table: table '%s' must store 'ssl_sess'.\n", t->id);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (!global.tune.sslcachesize)
+		ha_warning("ssl-session-table: ignored since the SSL session cache is disabled (tune.ssl.cachesize).\n");
+	else
+		global_ssl.sess_table = t;
+
+	return ERR_NONE;
+}
+
 #if defined(USE_ENGINE) && !defined(OPENSSL_NO_ENGINE)
 static int ssl_check_async_engine_count(void) {
 	int err_code = ERR_NONE;
@@ -7923,6 +8559,9 @@ static int cli_io_handler_tlskeys_files(struct appctx *appctx)
 			if (ctx->dump_entries) {
 				int head;
 
+				if (ctx->next_index == 0)
+					ssl_tlskeys_rotate(ref);
+
 				HA_RWLOCK_RDLOCK(TLSKEYS_REF_LOCK, &ref->lock);
 				head = ref->tls_ticket_enc_index;
 				while (ctx->next_index < TLS_TICKETS_NO) {
@@ -8020,6 +8659,9 @@ static int cli_parse_set_tlskeys(char **args, char *payload, struct appctx *appc
 	if (!ref)
 		return cli_err(appctx, "'set ssl tls-key' unable to locate referenced filename\n");
 
+	if (ref->secret)
+		return cli_err(appctx, "'set ssl tls-key' cannot update keys derived from a secret.\n");
+
 	ret = base64dec(args[4], strlen(args[4]), trash.area, trash.size);
 	if (ret < 0)
 		return cli_err(appctx, "'set ssl tls-key' received invalid base64 encoded TLS key.\n");
@@ -8113,31 +8755,49 @@ static int ssl_sock_get_capability(struct connection *conn, void *xprt_ctx, enum
 #ifdef HA_USE_KTLS
 	struct ssl_sock_ctx *ctx = xprt_ctx;
 	int *ret;
+	int flags;
 
 	switch (cap) {
 		case XPRT_CAN_SPLICE:
-			ret = arg;
-			if ((ctx->flags & (SSL_SOCK_F_KTLS_RECV | SSL_SOCK_F_KTLS_SEND)) ==
-			                  (SSL_SOCK_F_KTLS_RECV | SSL_SOCK_F_KTLS_SEND)) {
-#ifdef USE_VANILLA_OPENSSL
-				/*
-				 * We can splice yet if there's still
-				 * data in OpenSSL internal buffers
-				 */
-				if (SSL_has_pending(ctx->ssl))
-					*ret = XPRT_CONN_COULD_SPLICE;
-				else
+			flags = SSL_SOCK_F_KTLS_RECV | SSL_SOCK_F_KTLS_SEND;
+			break;
+		case XPRT_CAN_SPLICE_RECV:
+			flags = SSL_SOCK_F_KTLS_RECV;
+			break;
+		case XPRT_CAN_SPLICE_SEND:
+			flags = SSL_SOCK_F_KTLS_SEND;
+			break;
+		default:
+			return -1;
+	}
+
+	ret = arg;
+	if ((ctx->flags & flags) == flags) {
+#ifdef HAVE_VANILLA_OPENSSL
+		/*
+		 * We can't splice yet if there's still
+		 * data in OpenSSL internal buffers
+		 */
+		if ((flags & SSL_SOCK_F_KTLS_RECV) && SSL_has_pending(ctx->ssl))
+			*ret = XPRT_CONN_COULD_SPLICE;
+		else
 #endif
-				{
-					ctx->conn->flags &= ~CO_FL_WANT_SPLICING;
-					*ret = XPRT_CONN_CAN_SPLICE;
-				}
-			} else if (ctx->flags & SSL_SOCK_F_KTLS_ENABLED)
-				*ret = XPRT_CONN_COULD_SPLICE;
-			else
-				*ret = XPRT_CONN_CAN_NOT_SPLICE;
-			return 0;
+		{
+			ctx->conn->flags &= ~CO_FL_WANT_SPLICING;
+			*ret = XPRT_CONN_CAN_SPLICE;
+		}
 	}
+	else if ((ctx->flags & SSL_SOCK_F_KTLS_ENABLED) &&
+	         (cap == XPRT_CAN_SPLICE || (ctx->conn->flags & CO_FL_SSL_WAIT_HS))) {
+		/* kTLS is set up for each direction during the handshake,
+		 * so a direction still not offloaded once it is complete
+		 * never will be.
+		 */
+		*ret = XPRT_CONN_COULD_SPLICE;
+	}
+	else
+		*ret = XPRT_CONN_CAN_NOT_SPLICE;
+	return 0;
 #endif
 	return -1;
 }
@@ -8165,8 +8825,8 @@ struct xprt_ops ssl_sock = {
 	.remove_xprt = ssl_remove_xprt,
 	.add_xprt = ssl_add_xprt,
 #if defined(HA_USE_KTLS) && defined(USE_LINUX_SPLICE)
-	.rcv_pipe = ssl_sock_from_pipe,
-	.snd_pipe = ssl_sock_to_pipe,
+	.rcv_pipe = ssl_sock_to_pipe,
+	.snd_pipe = ssl_sock_from_pipe,
 #endif
 	.shutr    = NULL,
 	.shutw    = ssl_sock_shutw,
@@ -8279,6 +8939,8 @@ static void ssl_free_global(void)
 	ha_free(&global_ssl.ca_base);
 
 	ha_free(&global_ssl.issuers_chain_path);
+	ha_free(&global_ssl.sess_table_name);
+	ha_free(&global_ssl.gencert_table_name);
 
 	ha_free(&global_ssl.listen_default_ciphers);
 	ha_free(&global_ssl.connect_default_ciphers);
@@ -8370,6 +9032,7 @@ static void __ssl_sock_init(void)
 #if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
 	hap_register_post_check(tlskeys_finalize_config);
 #endif
+	hap_register_post_check(ssl_sess_table_finalize_config);
 
 	global.ssl_session_max_cost   = SSL_SESSION_MAX_COST;
 	global.ssl_handshake_max_cost = SSL_HANDSHAKE_MAX_COST;
@@ -211,8 +211,7 @@ static void ssl_trace(enum trace_level level, uint64_t mask, const struct trace_
 			chunk_appendf(&trace_buf, " : servername=\"%s\"", servername);
 		}
 		if (a3) {
-			const struct ebmb_node *node = a3;
-			struct sni_ctx *sni_ctx = container_of(node, struct sni_ctx, name);
+			const struct sni_ctx *sni_ctx = a3;
 
 			chunk_appendf(&trace_buf, " crt=\"%s\"", sni_ctx->ckch_inst->ckch_store->path);
 		}
@@ -90,6 +90,18 @@ struct stktable *stktable_find_by_name(const char *name)
  */
 void __stksess_free(struct stktable *t, struct stksess *ts)
 {
+	void *data;
+	int type;
+
+	/* release the allocated areas of blob data types */
+	for (type = 0; type < STKTABLE_DATA_TYPES; type++) {
+		if (stktable_data_types[type].std_type != STD_T_BLOB)
+			continue;
+		data = stktable_data_ptr(t, ts, type);
+		if (data)
+			ha_free(&stktable_data_cast(data, std_t_blob));
+	}
+
 	HA_ATOMIC_DEC(&t->current);
 	pool_free(t->pool, (void *)ts - round_ptr_size(t->data_size));
 }
@@ -1866,6 +1878,8 @@ struct stktable_data_type stktable_data_types[STKTABLE_DATA_TYPES] = {
 	[STKTABLE_DT_GPC_RATE]      = { .name = "gpc_rate",       .std_type = STD_T_FRQP, .is_array = 1, .arg_type = ARG_T_DELAY },
 	[STKTABLE_DT_GLITCH_CNT]    = { .name = "glitch_cnt",     .std_type = STD_T_UINT  },
 	[STKTABLE_DT_GLITCH_RATE]   = { .name = "glitch_rate",    .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
+	[STKTABLE_DT_SSL_SESS]      = { .name = "ssl_sess",       .std_type = STD_T_BLOB, .as_is = 1  },
+	[STKTABLE_DT_SSL_GENCERT]   = { .name = "ssl_gencert",    .std_type = STD_T_BLOB, .as_is = 1  },
 };
 
 /* Registers stick-table extra data type with index <idx>, name <name>, type
@@ -5383,6 +5397,14 @@ static int table_dump_entry_to_buffer(struct buffer *msg,
 			chunk_appendf(msg, "%s", de ? (char *)de->value.key : "-");
 			break;
 		}
+		case STD_T_BLOB: {
+			struct stktable_blob *blob;
+
+			/* only report the size, the contents may be sensitive */
+			blob = stktable_data_cast(ptr, std_t_blob);
+			chunk_appendf(msg, "%zu", blob ? blob->len : 0);
+			break;
+		}
 		}
 	}
 	chunk_appendf(msg, "\n");
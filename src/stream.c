@@ -2834,6 +2834,10 @@ void default_srv_error(struct stream *s, struct stconn *sc)
 		err = SF_ERR_SRVTO;
 		fin = SF_FINST_Q;
 	}
+	else if (err_type & STRM_ET_QUEUE_DROP) {
+		err = SF_ERR_SRVTO;
+		fin = SF_FINST_Q;
+	}
 	else if (err_type & STRM_ET_QUEUE_ERR) {
 		err = SF_ERR_SRVCL;
 		fin = SF_FINST_Q;
@@ -207,6 +207,90 @@ struct list *__tasklet_wakeup_after(struct list *head, struct tasklet *tl)
 	return &tl->list;
 }
 
+#ifdef USE_THREAD
+/* Work stealing: wakes up one sleeping thread of the current group so that it
+ * comes stealing tasks from the current thread's shared run queue, which is
+ * considered as loaded. This is done at most once per scheduler round.
+ */
+static void sched_wake_idle_sibling(void)
+{
+	int thr;
+
+	if (th_ctx->flags & TH_FL_STEAL_NOTIFIED)
+		return;
+
+	_HA_ATOMIC_OR(&th_ctx->flags, TH_FL_STEAL_NOTIFIED);
+	for (thr = tg->base; thr < tg->base + tg->count; thr++) {
+		if (thr != tid && (_HA_ATOMIC_LOAD(&ha_thread_ctx[thr].flags) & TH_FL_SLEEPING)) {
+			wake_thread(thr);
+			break;
+		}
+	}
+}
+
+/* Work stealing: moves up to half of the stealable tasks queued in the shared
+ * run queue of the most loaded thread of the group to the current thread's
+ * run queue. Only tasks which are not bound to a thread (tid < 0) are
+ * considered, and no more than 16 are taken at once. Returns the number of
+ * tasks stolen.
+ */
+static int sched_steal_tasks(void)
+{
+	struct thread_ctx *victim = NULL;
+	struct task *stolen[16];
+	struct eb32_node *rq;
+	uint load, best = 1;
+	int thr, max, nb = 0;
+
+	for (thr = tg->base; thr < tg->base + tg->count; thr++) {
+		if (thr == tid || eb_is_empty(&ha_thread_ctx[thr].rqueue_shared))
+			continue;
+		load = _HA_ATOMIC_LOAD(&ha_thread_ctx[thr].rq_total);
+		if (load > best) {
+			best = load;
+			victim = &ha_thread_ctx[thr];
+		}
+	}
+
+	if (!victim)
+		return 0;
+
+	max = MIN(best / 2, sizeof(stolen) / sizeof(*stolen));
+
+	HA_SPIN_LOCK(TASK_RQ_LOCK, &victim->rqsh_lock);
+	rq = eb32_first(&victim->rqueue_shared);
+	while (rq && nb < max) {
+		struct task *t = eb32_entry(rq, struct task, rq);
+
+		rq = eb32_next(rq);
+		if (t->tid >= 0)
+			continue;
+		eb32_delete(&t->rq);
+		stolen[nb++] = t;
+	}
+	HA_SPIN_UNLOCK(TASK_RQ_LOCK, &victim->rqsh_lock);
+
+	if (!nb)
+		return 0;
+
+	_HA_ATOMIC_SUB(&victim->rq_total, nb);
+	_HA_ATOMIC_ADD(&activity[victim - ha_thread_ctx].lost_tasks, nb);
+	activity[tid].stolen_tasks += nb;
+
+	/* queue them locally, preserving their niceness */
+	for (thr = 0; thr < nb; thr++) {
+		struct task *t = stolen[thr];
+
+		_HA_ATOMIC_INC(&th_ctx->rq_total);
+		t->rq.key = _HA_ATOMIC_ADD_FETCH(&th_ctx->rqueue_ticks, 1);
+		if (t->nice)
+			t->rq.key += t->nice * (int)global.tune.runqueue_depth;
+		eb32_insert(&th_ctx->rqueue, &t->rq);
+	}
+	return nb;
+}
+#endif
+
 /* Puts the task <t> in run queue at a position depending on t->nice. <t> is
  * returned. The nice value assigns boosts in 32th of the run queue size. A
  * nice value of -1024 sets the task to -tasks_run_queue*32, while a nice value
@@ -219,9 +303,16 @@ void __task_wakeup(struct task *t)
 {
 	struct eb_root *root = &th_ctx->rqueue;
 	int thr __maybe_unused = t->tid >= 0 ? t->tid : tid;
+	int stealable __maybe_unused = 0;
 
 #ifdef USE_THREAD
-	if (thr != tid) {
+	/* with work stealing, tasks that may run anywhere go to the shared
+	 * run queue so that idle threads of the group may pick them.
+	 */
+	if (t->tid < 0 && (global.tune.options & GTUNE_SCHED_WORK_STEALING))
+		stealable = 1;
+
+	if (thr != tid || stealable) {
 		root = &ha_thread_ctx[thr].rqueue_shared;
 
 		_HA_ATOMIC_INC(&ha_thread_ctx[thr].rq_total);
@@ -250,13 +341,16 @@ void __task_wakeup(struct task *t)
 	eb32_insert(root, &t->rq);
 
 #ifdef USE_THREAD
-	if (thr != tid) {
+	if (thr != tid || stealable) {
 		HA_SPIN_UNLOCK(TASK_RQ_LOCK, &ha_thread_ctx[thr].rqsh_lock);
 
 		/* If all threads that are supposed to handle this task are sleeping,
 		 * wake one.
 		 */
-		wake_thread(thr);
+		if (thr != tid)
+			wake_thread(thr);
+		else if (th_ctx->rq_total >= global.tune.runqueue_depth)
+			sched_wake_idle_sibling();
 	}
 #endif
 	return;
@@ -733,11 +827,16 @@ void process_runnable_tasks()
 	int heavy_queued = 0;
 	int budget;
 
-	_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_STUCK); // this thread is still running
+	_HA_ATOMIC_AND(&th_ctx->flags, ~(TH_FL_STUCK | TH_FL_STEAL_NOTIFIED)); // this thread is still running
 
 	if (!thread_has_tasks()) {
-		activity[tid].empty_rq++;
-		return;
+#ifdef USE_THREAD
+		if (!(global.tune.options & GTUNE_SCHED_WORK_STEALING) || !sched_steal_tasks())
+#endif
+		{
+			activity[tid].empty_rq++;
+			return;
+		}
 	}
 
 	max_processed = global.tune.runqueue_depth;
@@ -997,9 +1096,29 @@ static int cfg_parse_tune_sched_low_latency(char **args, int section_type, struc
 	return 0;
 }
 
+/* config parser for global "tune.sched.work-stealing", accepts "on" or "off" */
+static int cfg_parse_tune_sched_work_stealing(char **args, int section_type, struct proxy *curpx,
+                                              const struct proxy *defpx, const char *file, int line,
+                                              char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global.tune.options |= GTUNE_SCHED_WORK_STEALING;
+	else if (strcmp(args[1], "off") == 0)
+		global.tune.options &= ~GTUNE_SCHED_WORK_STEALING;
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.sched.low-latency", cfg_parse_tune_sched_low_latency },
+	{ CFG_GLOBAL, "tune.sched.work-stealing", cfg_parse_tune_sched_work_stealing },
 	{ 0, NULL, NULL }
 }};
 
@@ -7,6 +7,7 @@ check() {
 run() {
 	${HAPROXY_PROGRAM} -U quic_enc
 	${HAPROXY_PROGRAM} -U quic_tx
+	${HAPROXY_PROGRAM} -U qpack_enc
 }
 
 case "$1" in